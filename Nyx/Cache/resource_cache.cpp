@@ -19,12 +19,17 @@ namespace NYX {
 	const std::string DIR_SEPARATOR = "\\";
 #endif
 
+static const std::string COOKED_DIRECTORY = "Cooked";
+
 ResourceCache::ResourceCache(IRenderer *curRenderer)
 {
     mRunDirectory = FileManager::GetInstance()->GetWorkingDirectory();
     
 	mRenderer = curRenderer;
 
+    // nothing has been cooked yet if it's not there: it's mounted when the first cooked file is stored.
+    bCookedDataMounted = FileManager::GetInstance()->RegisterSearchPath("/", FileManager::GetInstance()->GetBaseWriteDirectory() + COOKED_DIRECTORY);
+
     LogManager::GetInstance()->LogMessage("Resource Cache Initialized.");
 }
 
@@ -261,6 +266,58 @@ ubyte* ResourceCache::RequestBinary(string resName, int &size)
 	}
 }
 
+bool ResourceCache::RequestCookedData(string resName, string& data)
+{
+	if (PHYSFS_exists(resName.c_str()) == 0)
+		return false;
+
+	PHYSFS_file* f = PHYSFS_openRead(resName.c_str());
+
+	if (f == NULL)
+		return false;
+
+	PHYSFS_sint64 f_size = PHYSFS_fileLength(f);
+
+	if (f_size < 0)
+	{
+		PHYSFS_close(f);
+		return false;
+	}
+
+	data.resize((size_t)f_size);
+
+	PHYSFS_sint64 length_read = f_size > 0 ? PHYSFS_read(f, &data[0], 1, (PHYSFS_uint32)f_size) : 0;
+
+	PHYSFS_close(f);
+
+	if (length_read < f_size)
+	{
+		string msg = string("Resource Cache Error: Cooked data was not entirely loaded. ") + resName;
+		LogManager::GetInstance()->LogMessage(msg.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+bool ResourceCache::StoreCookedData(string resName, const string& data)
+{
+	if (!FileManager::GetInstance()->Write(data, resName, COOKED_DIRECTORY))
+	{
+		string msg = string("Resource Cache Error: Failed to store cooked data: ") + resName;
+		LogManager::GetInstance()->LogMessage(msg.c_str());
+		return false;
+	}
+
+	if (!bCookedDataMounted)
+		bCookedDataMounted = FileManager::GetInstance()->RegisterSearchPath("/", FileManager::GetInstance()->GetBaseWriteDirectory() + COOKED_DIRECTORY);
+
+	string msg = "Cooked data stored: " + resName;
+	LogManager::GetInstance()->LogMessage(msg.c_str());
+
+	return true;
+}
+
 bool ResourceCache::UnloadResource(string resName)
 {
 	ResMap::iterator resIter = mResources.find(resName);
@@ -28,6 +28,9 @@ public:
     ResourcePtr RequestFontResource( string fontName, int size );
     char* RequestSourceCode(string srcName); //used for both scripts and shaders
 	ubyte* RequestBinary(string resName, int &size);
+    // data built on a first load to speed up the next ones (e.g. physics BVHs). No error if it's not there.
+    bool RequestCookedData(string resName, string& data);
+    bool StoreCookedData(string resName, const string& data);
     bool UnloadResource(string resName);
     void UnloadAllResources();
 
@@ -41,6 +44,7 @@ private:
     string mAppName;
     string mRunDirectory; // full path to the directory from which the executable is being run.
     list<string> mSearchPaths; // search directories and / or archives with relative paths
+    bool bCookedDataMounted; // the cooked data directory, in the write directory
 
     ResMap mResources;
 	
@@ -0,0 +1,340 @@
+/*
+
+Typed Event Channels
+
+*/
+
+#ifndef EVENTCHANNEL_H
+#define EVENTCHANNEL_H
+
+#include "ievent.h"
+
+#include <vector>
+
+namespace NYX {
+
+//type-erased base of the typed channels, so that the event manager can keep them all
+//in a single table indexed by event type.
+class IEventChannel
+{
+public:
+    virtual ~IEventChannel() {}
+
+    virtual bool IsEmpty() = 0;
+    virtual uint SubscriptionCount() = 0;
+    virtual void Dispatch(IEvent* event) = 0;
+    //removes the subscription in slot if it still belongs to the given generation.
+    virtual bool Unsubscribe(uint slot, uint generation) = 0;
+    //removes all the subscriptions tagged with group. returns how many were removed.
+    virtual uint UnsubscribeGroup(void* group) = 0;
+};
+
+/*
+Handle to a typed subscription, returned by EventChannel::Subscribe. The subscription lasts as
+long as the handle does: the destructor unsubscribes in constant time. Handles can be moved but
+not copied.
+Each slot of a channel carries a generation number, bumped when the slot is released, so a handle
+whose subscription has already been removed (i.e. by UnsubscribeGroup) is simply ignored.
+The channel must outlive the handle: channels belong to the EventManager, which is destroyed
+after the scene.
+*/
+class EventSubscription
+{
+public:
+
+    EventSubscription();
+    EventSubscription(IEventChannel* channel, uint slot, uint generation);
+    EventSubscription(EventSubscription&& source);
+    ~EventSubscription();
+
+    EventSubscription& operator= (EventSubscription&& source);
+
+    //unsubscribes now.
+    void Reset();
+    bool IsValid();
+
+private:
+
+    EventSubscription(const EventSubscription&);
+    EventSubscription& operator= (const EventSubscription&);
+
+    IEventChannel* mChannel;
+    uint mSlot;
+    uint mGeneration;
+};
+
+/*
+All the subscribers to one event class. T must expose its event type as T::TYPE, and be the only
+class raising that type, which is what makes the static_cast in Dispatch() safe: there is no RTTI
+and no string involved in delivering an event, just one indirect call per subscriber.
+Subscribers are (object, handler) pairs rather than listener objects. The usual way to subscribe
+is through a member function, via EventManager::Subscribe:
+    mSubscription = EventManager::GetInstance()->Subscribe<ObjectMovedEvent, SceneNode, &SceneNode::OnObjectMoved>(this, root);
+Subscriptions live in slots recycled through a free list, so subscribing and unsubscribing
+are O(1) and never move the other subscribers. Subscriptions can be tagged with a group (usually
+the scene root) and removed all at once.
+Handlers may subscribe and unsubscribe (themselves or others) while an event is being dispatched:
+new subscribers only receive the following events, removed ones are skipped straight away.
+*/
+template<typename T>
+class EventChannel : public IEventChannel
+{
+public:
+
+    typedef void (*Handler)(void* subscriber, T& event);
+
+    //adapts a member function to the Handler signature.
+    template<class C, void (C::*Method)(T&)>
+    static void MethodHandler(void* subscriber, T& event);
+
+    EventChannel();
+    virtual ~EventChannel();
+
+    EventSubscription Subscribe(void* subscriber, Handler handler, void* group = NULL);
+
+    virtual bool IsEmpty();
+    virtual uint SubscriptionCount();
+    virtual void Dispatch(IEvent* event);
+    virtual bool Unsubscribe(uint slot, uint generation);
+    virtual uint UnsubscribeGroup(void* group);
+
+private:
+
+    static const uint INVALID_SLOT = 0xffffffff;
+
+    struct Slot
+    {
+        void* mSubscriber;
+        Handler mHandler; //NULL when the slot is free
+        void* mGroup;
+        uint mGeneration;
+        uint mNextFree;
+    };
+
+    std::vector<Slot> mSlots;
+    uint mFreeList;
+    //slots released during a dispatch. they are recycled once it's over, so that a new
+    //subscriber can't take the place of an old one and receive the current event.
+    std::vector<uint> mReleasedSlots;
+    uint mActiveCount;
+    uint mDispatchDepth;
+
+    void ReleaseSlot(uint slot);
+};
+
+//------------------------------
+// Implementation
+//------------------------------
+
+template<typename T>
+template<class C, void (C::*Method)(T&)>
+void EventChannel<T>::MethodHandler(void* subscriber, T& event)
+{
+    (static_cast<C*>(subscriber)->*Method)(event);
+}
+
+template<typename T>
+EventChannel<T>::EventChannel() :
+    mFreeList(INVALID_SLOT),
+    mActiveCount(0),
+    mDispatchDepth(0)
+{
+
+}
+
+template<typename T>
+EventChannel<T>::~EventChannel()
+{
+
+}
+
+template<typename T>
+EventSubscription EventChannel<T>::Subscribe(void* subscriber, Handler handler, void* group)
+{
+    uint slot;
+
+    if (mFreeList != INVALID_SLOT)
+    {
+        slot = mFreeList;
+        mFreeList = mSlots[slot].mNextFree;
+    }
+    else
+    {
+        slot = (uint)mSlots.size();
+        mSlots.push_back(Slot());
+        mSlots[slot].mGeneration = 0;
+    }
+
+    Slot& newSlot = mSlots[slot];
+    newSlot.mSubscriber = subscriber;
+    newSlot.mHandler = handler;
+    newSlot.mGroup = group;
+    newSlot.mNextFree = INVALID_SLOT;
+
+    mActiveCount++;
+
+    return EventSubscription(this, slot, newSlot.mGeneration);
+}
+
+template<typename T>
+bool EventChannel<T>::Unsubscribe(uint slot, uint generation)
+{
+    if (slot >= mSlots.size() || mSlots[slot].mGeneration != generation || mSlots[slot].mHandler == NULL)
+        return false;
+
+    ReleaseSlot(slot);
+
+    return true;
+}
+
+template<typename T>
+uint EventChannel<T>::UnsubscribeGroup(void* group)
+{
+    uint count = 0;
+
+    for (uint i = 0; i < mSlots.size(); i++)
+    {
+        if (mSlots[i].mHandler != NULL && mSlots[i].mGroup == group)
+        {
+            ReleaseSlot(i);
+            count++;
+        }
+    }
+
+    return count;
+}
+
+template<typename T>
+void EventChannel<T>::ReleaseSlot(uint slot)
+{
+    Slot& oldSlot = mSlots[slot];
+
+    //invalidates any handle still pointing to this slot.
+    oldSlot.mHandler = NULL;
+    oldSlot.mSubscriber = NULL;
+    oldSlot.mGroup = NULL;
+    oldSlot.mGeneration++;
+
+    mActiveCount--;
+
+    if (mDispatchDepth > 0)
+    {
+        mReleasedSlots.push_back(slot);
+    }
+    else
+    {
+        oldSlot.mNextFree = mFreeList;
+        mFreeList = slot;
+    }
+}
+
+template<typename T>
+bool EventChannel<T>::IsEmpty()
+{
+    return mActiveCount == 0;
+}
+
+template<typename T>
+uint EventChannel<T>::SubscriptionCount()
+{
+    return mActiveCount;
+}
+
+template<typename T>
+void EventChannel<T>::Dispatch(IEvent* event)
+{
+    T& typedEvent = static_cast<T&>(*event);
+
+    //subscribers added by a handler will get the next event, not this one.
+    size_t count = mSlots.size();
+
+    mDispatchDepth++;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        //copy: the vector may grow (and move) if a handler subscribes someone.
+        Handler handler = mSlots[i].mHandler;
+
+        if (handler != NULL)
+            handler(mSlots[i].mSubscriber, typedEvent);
+    }
+
+    mDispatchDepth--;
+
+    if (mDispatchDepth == 0)
+    {
+        for (size_t i = 0; i < mReleasedSlots.size(); i++)
+        {
+            mSlots[mReleasedSlots[i]].mNextFree = mFreeList;
+            mFreeList = mReleasedSlots[i];
+        }
+
+        mReleasedSlots.clear();
+    }
+}
+
+//------------------------------
+// EventSubscription
+//------------------------------
+
+inline EventSubscription::EventSubscription() :
+    mChannel(NULL),
+    mSlot(0),
+    mGeneration(0)
+{
+
+}
+
+inline EventSubscription::EventSubscription(IEventChannel* channel, uint slot, uint generation) :
+    mChannel(channel),
+    mSlot(slot),
+    mGeneration(generation)
+{
+
+}
+
+inline EventSubscription::EventSubscription(EventSubscription&& source) :
+    mChannel(source.mChannel),
+    mSlot(source.mSlot),
+    mGeneration(source.mGeneration)
+{
+    source.mChannel = NULL;
+}
+
+inline EventSubscription::~EventSubscription()
+{
+    Reset();
+}
+
+inline EventSubscription& EventSubscription::operator= (EventSubscription&& source)
+{
+    if (this != &source)
+    {
+        Reset();
+
+        mChannel = source.mChannel;
+        mSlot = source.mSlot;
+        mGeneration = source.mGeneration;
+
+        source.mChannel = NULL;
+    }
+
+    return *this;
+}
+
+inline void EventSubscription::Reset()
+{
+    if (mChannel != NULL)
+        mChannel->Unsubscribe(mSlot, mGeneration);
+
+    mChannel = NULL;
+}
+
+inline bool EventSubscription::IsValid()
+{
+    return mChannel != NULL;
+}
+
+}
+
+#endif // EVENTCHANNEL_H
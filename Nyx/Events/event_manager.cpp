@@ -7,7 +7,7 @@
 
 #include "event_manager.h"
 
-#include <ctime>
+#include <chrono>
 
 namespace NYX {
 
@@ -30,8 +30,7 @@ bool BaseEventListener::ProcessEvent(EventPtr event)
 {
     //Listens for all events and logs their types
 #ifdef __DEBUG__
-        string evT = event->GetEventTypeStr();
-        string msg = "Event " + evT +" received by listener: " + mName;
+        string msg = string("Event ") + GetEventTypeName(event->GetEventType()) + " received by listener: " + mName;
 
         LogManager::GetInstance()->LogMessage(msg.c_str());
 #endif
@@ -39,25 +38,180 @@ bool BaseEventListener::ProcessEvent(EventPtr event)
     return true;
 }
 
-EventManager::EventManager()
+EventManager::EventManager(uint queueCapacity) :
+    mIncomingEvents(queueCapacity),
+    mCoalescingStamp(0),
+    mCoalescingCount(0)
 {
     LogManager::GetInstance()->LogMessage("Initialising Event Manager...");
 
-    mActiveQueue = 0;
     mMaxProcessingTime = 0.01; //10 milli-seconds.
+    mBudgetCheckInterval = 8;
+    mDroppedEvents.store(0);
+    mFrameNumber.store(0);
+
+    for (int i = 0; i < EV_EVENT_TYPE_COUNT; i++)
+    {
+        mEventPriority[i] = EV_PRIORITY_NORMAL;
+        mCoalesce[i] = false;
+        mChannels[i] = NULL;
+    }
+
+    //default lanes: application flow and camera switches first, per-object updates last.
+    mEventPriority[EventTypeIndex(EV_KEY_PRESS)] = EV_PRIORITY_HIGH;
+    mEventPriority[EventTypeIndex(EV_ACTIVE_CAMERA_CHANGED)] = EV_PRIORITY_HIGH;
+    mEventPriority[EventTypeIndex(EV_START_GAME_REQUESTED)] = EV_PRIORITY_HIGH;
+    mEventPriority[EventTypeIndex(EV_GAME_ENDED)] = EV_PRIORITY_HIGH;
+    mEventPriority[EventTypeIndex(EV_QUIT_APPLICATION)] = EV_PRIORITY_HIGH;
+    mEventPriority[EventTypeIndex(EV_OBJECT_MOVED)] = EV_PRIORITY_LOW;
+    mEventPriority[EventTypeIndex(EV_CONTACTS)] = EV_PRIORITY_LOW;
+
+    mCoalescingTable.resize(1024);
 }
 
 EventManager::~EventManager()
 {
     LogManager::GetInstance()->LogMessage("Event Manager Shutting Down.");
+
+    mRecorder.StopRecording();
+
+    for (int i = 0; i < EV_EVENT_TYPE_COUNT; i++)
+        delete mChannels[i];
 }
 
-void EventManager::SwapQueues()
+void EventManager::DrainIncomingEvents()
 {
-    if (mActiveQueue == 0)
-        mActiveQueue = 1;
-    else
-        mActiveQueue = 0;
+    //reclaim the space of the events processed so far. erasing from the front moves the
+    //backlog but never allocates.
+    bool backlog = false;
+
+    for (int p = 0; p < EV_PRIORITY_COUNT; p++)
+    {
+        EventLane& lane = mLanes[p];
+
+        if (lane.mNext == lane.mEvents.size())
+        {
+            lane.mBase += lane.mEvents.size();
+            lane.mEvents.clear();
+            lane.mNext = 0;
+        }
+        else if (lane.mNext > 0 && lane.mNext >= lane.mEvents.size() / 2)
+        {
+            lane.mEvents.erase(lane.mEvents.begin(), lane.mEvents.begin() + lane.mNext);
+            lane.mBase += lane.mNext;
+            lane.mNext = 0;
+        }
+
+        backlog = backlog || !lane.mEvents.empty();
+        lane.mStats.coalesced = 0;
+    }
+
+    //nothing left over: invalidate all the coalescing entries at once. Otherwise they are kept,
+    //so that new events also replace the ones waiting in the backlog.
+    if (!backlog)
+    {
+        mCoalescingStamp++;
+        mCoalescingCount = 0;
+    }
+
+    //only take what was published when draining started, so that busy producers
+    //cannot keep the main thread here forever.
+    uint pending = mIncomingEvents.ApproximateSize();
+    EventPtr event;
+
+    for (uint i = 0; i < pending; i++)
+    {
+        if (!mIncomingEvents.Pop(event))
+            break;
+
+        eEventType evT = event->GetEventType();
+        int typeIndex = EventTypeIndex(evT);
+        bool validType = (typeIndex >= 0 && typeIndex < EV_EVENT_TYPE_COUNT);
+
+        int priority = validType ? mEventPriority[typeIndex] : EV_PRIORITY_NORMAL;
+        EventLane& lane = mLanes[priority];
+
+        uint key;
+
+        if (validType && mCoalesce[typeIndex] && event->GetCoalescingKey(key))
+        {
+            unsigned long long fullKey = ((unsigned long long)typeIndex << 32) | key;
+            size_t index = lane.mBase + lane.mEvents.size();
+            CoalescingEntry* entry = FindCoalescingEntry(fullKey, priority, index);
+
+            if (entry != NULL)
+            {
+                //superseded: the newer event takes the place of the older one in the lane,
+                //unless that one is gone already (or the type moved to another lane since).
+                if (entry->mLane == priority && entry->mIndex >= lane.mBase + lane.mNext)
+                {
+                    lane.mEvents[entry->mIndex - lane.mBase].swap(event);
+                    lane.mStats.coalesced++;
+                    continue;
+                }
+
+                entry->mLane = priority;
+                entry->mIndex = index;
+            }
+        }
+
+        lane.mEvents.push_back(event);
+    }
+
+    event.reset();
+
+    uint dropped = mDroppedEvents.exchange(0);
+
+    if (dropped > 0)
+    {
+        string msg = "Event System Warning: Event queue full! Dropped events: " + to_string(dropped);
+        LogManager::GetInstance()->LogMessage(msg.c_str());
+    }
+}
+
+EventManager::CoalescingEntry* EventManager::FindCoalescingEntry(unsigned long long key, int lane, size_t index)
+{
+    //keep the load factor under 1/2
+    if ((mCoalescingCount + 1) * 2 > mCoalescingTable.size())
+        GrowCoalescingTable();
+
+    size_t mask = mCoalescingTable.size() - 1;
+    size_t slot = (size_t)((key ^ (key >> 29)) * 0x9E3779B97F4A7C15ULL) & mask;
+
+    for (;;)
+    {
+        CoalescingEntry& entry = mCoalescingTable[slot];
+
+        if (entry.mStamp != mCoalescingStamp)
+        {
+            entry.mKey = key;
+            entry.mStamp = mCoalescingStamp;
+            entry.mLane = lane;
+            entry.mIndex = index;
+            mCoalescingCount++;
+            return NULL;
+        }
+
+        if (entry.mKey == key)
+            return &entry;
+
+        slot = (slot + 1) & mask;
+    }
+}
+
+void EventManager::GrowCoalescingTable()
+{
+    vector<CoalescingEntry> oldTable;
+    oldTable.swap(mCoalescingTable);
+
+    mCoalescingTable.resize(oldTable.size() * 2);
+    mCoalescingCount = 0;
+
+    for (size_t i = 0; i < oldTable.size(); i++)
+    {
+        if (oldTable[i].mStamp == mCoalescingStamp)
+            FindCoalescingEntry(oldTable[i].mKey, oldTable[i].mLane, oldTable[i].mIndex);
+    }
 }
 
 void EventManager::ResetTimeoutThreshold(float maxTime)
@@ -65,6 +219,26 @@ void EventManager::ResetTimeoutThreshold(float maxTime)
     mMaxProcessingTime = maxTime;
 }
 
+void EventManager::SetBudgetCheckInterval(uint interval)
+{
+    mBudgetCheckInterval = (interval > 0) ? interval : 1;
+}
+
+void EventManager::SetEventPriority(eEventType eventType, eEventPriority priority)
+{
+    mEventPriority[EventTypeIndex(eventType)] = priority;
+}
+
+void EventManager::SetCoalescing(eEventType eventType, bool coalesce)
+{
+    mCoalesce[EventTypeIndex(eventType)] = coalesce;
+}
+
+const EventLaneStats& EventManager::GetLaneStats(eEventPriority priority)
+{
+    return mLanes[priority].mStats;
+}
+
 bool EventManager::RegisterListener(eEventType eventType, EventListenerPtr listener)
 {
     /*insert the requested event type in the set of registered events.
@@ -99,14 +273,17 @@ bool EventManager::RegisterListener(eEventType eventType, EventListenerPtr liste
     ListenerList & tmpList = (*it).second;
 
     //if the listener is already registered to the requested event, return false
-    for (ListenerList::iterator it2 = tmpList.begin(); it2 != tmpList.end(); ++it2)
+    pair<ListenerIndex::iterator, ListenerIndex::iterator> registrations = mListenerIndex.equal_range(listener.get());
+
+    for (ListenerIndex::iterator it2 = registrations.first; it2 != registrations.second; ++it2)
     {
-        if ( *it2 == listener )
+        if ( (*it2).second.first == &tmpList )
             return false;
     }
 
     //register the listener to the requested event
     tmpList.push_back( listener );
+    mListenerIndex.insert( ListenerIndex::value_type(listener.get(), make_pair(&tmpList, --tmpList.end())) );
 
     return true;
 
@@ -114,139 +291,312 @@ bool EventManager::RegisterListener(eEventType eventType, EventListenerPtr liste
 
 bool EventManager::UnregisterListener(EventListenerPtr listener)
 {
-    bool ret = false;
+    //list iterators stay valid until erased, so each registration can be removed directly
+    pair<ListenerIndex::iterator, ListenerIndex::iterator> registrations = mListenerIndex.equal_range(listener.get());
+
+    if (registrations.first == registrations.second)
+        return false;
+
+    for (ListenerIndex::iterator it = registrations.first; it != registrations.second; ++it)
+        (*it).second.first->erase( (*it).second.second );
+
+    mListenerIndex.erase(registrations.first, registrations.second);
+
+    return true;
+}
+
+uint EventManager::UnsubscribeGroup(void* group)
+{
+    uint count = 0;
 
-    //for each event type, search for a registered listener that matches the requested one
-    for (ListenerMap::iterator m_it = mRegisteredListeners.begin(); m_it != mRegisteredListeners.end(); ++m_it)
+    for (int i = 0; i < EV_EVENT_TYPE_COUNT; i++)
     {
-        ListenerList & regList = (*m_it).second;
+        if (mChannels[i] != NULL)
+            count += mChannels[i]->UnsubscribeGroup(group);
+    }
 
-        for (ListenerList::iterator l_it = regList.begin(); l_it != regList.end(); ++l_it)
-        {
-            //if one is
-            if ( (*l_it) == listener )
-            {
-                regList.erase( l_it );
+    return count;
+}
 
-                ret = true;
-                break;
-            }
-        }
+uint EventManager::GetSubscriptionCount()
+{
+    uint count = 0;
+
+    for (int i = 0; i < EV_EVENT_TYPE_COUNT; i++)
+    {
+        if (mChannels[i] != NULL)
+            count += mChannels[i]->SubscriptionCount();
     }
 
-    return ret;
+    return count;
 }
 
-bool EventManager::ProcessEvent(EventPtr event)
+uint EventManager::GetListenerCount()
+{
+    return (uint)mListenerIndex.size();
+}
+
+bool EventManager::ProcessEvent(const EventPtr& event)
 {
     eEventType evT = event->GetEventType();
+    int typeIndex = EventTypeIndex(evT);
+    bool delivered = false;
+    bool hasChannel = false;
 
-    //Validate Event
-    EventTypeSet::iterator it_set;
+    //typed subscribers first: a table look up and a static cast.
+    if (typeIndex >= 0 && typeIndex < EV_EVENT_TYPE_COUNT)
+    {
+        IEventChannel* channel = mChannels[typeIndex];
+        hasChannel = (channel != NULL);
 
-    it_set = mRegisteredEvents.find(evT);
+        if (hasChannel && !channel->IsEmpty())
+        {
+            channel->Dispatch(event.get());
+            delivered = true;
+        }
+    }
 
-    //the event is not a registered event, log a warning message and return false
-    if (it_set == mRegisteredEvents.end())
+    //then the generic listeners, if any
+    if (!mRegisteredListeners.empty())
     {
-        string msg = "Event System Warning: An Unregistered Event Has Been Requested! Event: " + event->GetEventTypeStr();
-
-        LogManager::GetInstance()->LogMessage(msg.c_str());
+        ListenerMap::iterator it_map;
 
-        return false;
-    }
+        it_map = mRegisteredListeners.find(evT);
 
-    ListenerMap::iterator it_map;
+        if (it_map != mRegisteredListeners.end())
+        {
+            //get the list of registered listeners
+            ListenerList & lstList = (*it_map).second;
 
-    it_map = mRegisteredListeners.find(evT);
+            //iterate through all listeners and send them the event
+            for (ListenerList::iterator it_lst = lstList.begin(); it_lst != lstList.end(); ++it_lst)
+            {
+                bool processed;
 
-    //no registered listeners found for this event, return false
-    if (it_map == mRegisteredListeners.end())
-        return false;
+                processed = (*it_lst)->ProcessEvent(event);
+            }
 
-    //get the list of registered listeners
-    ListenerList & lstList = (*it_map).second;
+            delivered = delivered || !lstList.empty();
+        }
+    }
 
-    //iterate through all listeners and send them the event
-    for (ListenerList::iterator it_lst = lstList.begin(); it_lst != lstList.end(); ++it_lst)
+    //nobody is interested in this event, log a warning message and return false
+    if (!delivered && !hasChannel && mRegisteredEvents.find(evT) == mRegisteredEvents.end())
     {
-        EventListenerPtr listener = (*it_lst);
+        string msg = string("Event System Warning: An Unregistered Event Has Been Requested! Event: ") + GetEventTypeName(evT);
 
-        bool processed;
+        LogManager::GetInstance()->LogMessage(msg.c_str());
 
-        processed = listener->ProcessEvent(event);
+        return false;
     }
 
-    return true;
+    return delivered;
 }
 
-void EventManager::QueueEvent(EventPtr event)
+bool EventManager::QueueEvent(EventPtr event)
 {
-    unsigned short insertQueue;
+    if (mRecorder.IsReplaying())
+        return true; //live events are replaced by the recorded ones
+
+    if (mRecorder.IsRecording())
+        mRecorder.Record(event, mFrameNumber.load(std::memory_order_relaxed), false);
 
-    /*Queue the newly created event in the inactive queue.
-      Queues are swapped each time the currently active cue is empty (usually at the end of every main loop)
+    /*Queue the newly created event in the concurrent queue. It will be moved to the active queue
+      and processed the next time the active queue is empty (usually at the beginning of the next main loop)
     */
-    if (mActiveQueue == 0)
-        insertQueue = 1;
-    else
-        insertQueue = 0;
+    if (mIncomingEvents.Push(event))
+        return true;
+
+    mDroppedEvents.fetch_add(1, std::memory_order_relaxed);
+
+    return false;
+}
+
+bool EventManager::QueueEvents(EventPtr* events, uint count)
+{
+    if (mRecorder.IsReplaying())
+        return true;
+
+    if (mRecorder.IsRecording())
+    {
+        uint frame = mFrameNumber.load(std::memory_order_relaxed);
+
+        for (uint i = 0; i < count; i++)
+            mRecorder.Record(events[i], frame, false);
+    }
+
+    if (mIncomingEvents.PushBatch(events, count))
+        return true;
 
-    mPendingEvents[insertQueue].push_back(event);
+    //not enough room for the whole batch, queue as many single events as possible.
+    bool ret = true;
 
+    for (uint i = 0; i < count; i++)
+    {
+        if (!mIncomingEvents.Push(events[i]))
+        {
+            mDroppedEvents.fetch_add(1, std::memory_order_relaxed);
+            ret = false;
+        }
+    }
+
+    return ret;
 }
 
 void EventManager::ProcessEventQueue()
 {
-    clock_t startTime, time;
-    float dt = 0.0; //elapsed time in seconds.
+    typedef std::chrono::steady_clock Clock;
+
+    mFrameNumber.fetch_add(1, std::memory_order_relaxed);
 
-    EventQueue & activeQueue = mPendingEvents[mActiveQueue];
+    if (mRecorder.IsReplaying())
+        ReplayEvents();
 
-    startTime = clock();
+    //collect the events published since the last call. Events left over from previous calls
+    //due to timeout stay ahead of the new ones in their lane.
+    DrainIncomingEvents();
+
+    Clock::time_point startTime = Clock::now();
+    Clock::duration maxTime = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(mMaxProcessingTime));
+    uint sinceLastCheck = 0;
+    bool timeout = false;
 
     /*the time allowed to process the event queue is limited during each main loop, to avoid lagging
       when too many events are spawned. The remaining events, if any, are processed in the next loop.
-      The timeout is set by default at 1/4 of the main loop time.*/
-    while (dt <= mMaxProcessingTime)
+      The timeout is set by default at 1/4 of the main loop time.
+      Lanes are processed in order of priority, so only the least urgent events are ever postponed.*/
+    for (int p = 0; p < EV_PRIORITY_COUNT; p++)
     {
-        EventQueue::iterator q_it;
-        q_it = activeQueue.begin();
+        EventLane& lane = mLanes[p];
 
-        //if the queue is empty, all pending events have been processed in less than the max allowed time.
-        if (q_it == activeQueue.end())
-            break;
+        lane.mStats.processed = 0;
 
-        //copy the first event in the queue
-        EventPtr event = (*q_it);
-        //delete the first event in the queue
-        activeQueue.pop_front();
+        while (!timeout && lane.mNext < lane.mEvents.size())
+        {
+            //move the first event out of the lane
+            EventPtr event;
+            event.swap(lane.mEvents[lane.mNext++]);
 
-        bool processed;
+            bool processed;
 
-        processed = ProcessEvent(event);
+            processed = ProcessEvent(event);
 
-        //The reference count for event is now 1. it will automatically drop to 0 when the variable event goes out
-        //of scope at the end of the loop cycle, and the instance of the contained class will be automatically deleted.
-        //Note: shared_ptr remembers the actual class it contains along with the correct deconstructor, even if the demplete
-        //is declared with the parent interface.
+            lane.mStats.processed++;
 
-        //might check if event was correctly processed.
+            //The reference count for event is now 1. it will automatically drop to 0 when the variable event goes out
+            //of scope at the end of the loop cycle, and the event will be returned to its pool.
+            //Note: the virtual destructor makes sure the correct class and pool are used, even if the template
+            //is declared with the parent interface.
 
-        time = clock();
-        dt = (time - startTime)/(float)CLOCKS_PER_SEC;
-    }
+            //might check if event was correctly processed.
+
+            if (++sinceLastCheck >= mBudgetCheckInterval)
+            {
+                sinceLastCheck = 0;
+                timeout = (Clock::now() - startTime) > maxTime;
+            }
+        }
 
-    //if there are still pending events that could not be processed due to timeout,
-    //the queues will not be swapped and the waiting events will be processed in 2 turns.
-    if (activeQueue.empty())
-        SwapQueues();
+        lane.mStats.backlog = (uint)(lane.mEvents.size() - lane.mNext);
+
+        if (lane.mStats.backlog > lane.mStats.peakBacklog)
+            lane.mStats.peakBacklog = lane.mStats.backlog;
+    }
 }
 
 
 bool EventManager::SendEvent(EventPtr event)
 {
+    if (mRecorder.IsReplaying())
+        return true;
+
+    if (mRecorder.IsRecording())
+        mRecorder.Record(event, mFrameNumber.load(std::memory_order_relaxed), true);
+
     return ProcessEvent(event);
 }
 
+bool EventManager::StartRecording(const string& fileName)
+{
+    if (mRecorder.IsReplaying())
+    {
+        LogManager::GetInstance()->LogMessage("Event System Warning: Can't record while replaying.");
+        return false;
+    }
+
+    //frame numbers in the log start from 0, wherever the recording starts.
+    mFrameNumber.store(0);
+
+    return mRecorder.StartRecording(fileName);
+}
+
+void EventManager::StopRecording()
+{
+    mRecorder.StopRecording();
+}
+
+bool EventManager::StartReplay(const string& fileName)
+{
+    mRecorder.StopRecording();
+
+    mFrameNumber.store(0);
+
+    return mRecorder.StartReplay(fileName);
+}
+
+void EventManager::StopReplay()
+{
+    mRecorder.StopReplay();
+}
+
+void EventManager::ReplayEvents()
+{
+    /*events recorded during the previous frame are due now. Queued events go through the concurrent
+      queue, as they did originally. Sent events were dispatched on the spot during the previous frame:
+      they are dispatched here instead, ahead of the queued ones.*/
+    uint frame = mFrameNumber.load(std::memory_order_relaxed);
+    EventPtr event;
+    bool sent;
+
+    while (mRecorder.NextReplayEvent(frame, event, sent))
+    {
+        if (sent)
+            ProcessEvent(event);
+        else if (!mIncomingEvents.Push(event))
+            mDroppedEvents.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+EventBatch::EventBatch() :
+    mCount(0)
+{
+
+}
+
+EventBatch::~EventBatch()
+{
+    Flush();
+}
+
+void EventBatch::Add(EventPtr event)
+{
+    mEvents[mCount++] = event;
+
+    if (mCount == BATCH_SIZE)
+        Flush();
+}
+
+void EventBatch::Flush()
+{
+    if (mCount == 0)
+        return;
+
+    EventManager::GetInstance()->QueueEvents(mEvents, mCount);
+
+    for (uint i = 0; i < mCount; i++)
+        mEvents[i].reset();
+
+    mCount = 0;
+}
+
 }
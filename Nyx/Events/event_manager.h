@@ -8,13 +8,18 @@ Event Manager
 */
 
 #include "events.h"
+#include "event_channel.h"
+#include "event_queue.h"
+#include "event_recorder.h"
 #include "log_manager.h"
 
+#include <vector>
+
 //This event-based system is largely based on the book "Game Coding Complete, 3rd Edition"
 //and the Qt SDK documentation
 
 /*global typedefs, visible by all other subsystems including eventmanager.h
-shared_ptr is needed here beacause:
+reference counted pointers are needed here beacause:
 - For the event system to work in an elegant way, the events must be queued
     as pointers to interfaces
 - Events are created elsewhere in local scopes and in the majority of cases
@@ -26,6 +31,11 @@ shared_ptr is needed here beacause:
     removed or the object's destructor will be called. the reference counting feature
     of shared_ptr allows multiple objetcs to point to the same instance without
     the risk of one of them destroying it prematurely.
+Events use an intrusive counter (EventPtr) rather than shared_ptr, since they are created and
+destroyed by the thousands every frame. Listeners are long lived and still use shared_ptr.
+Engine subsystems subscribe to typed channels instead (see event_channel.h): the handler gets the
+concrete event class directly. Listeners are kept as the generic, IEvent based interface, and both
+are notified of every event.
 */
 
 namespace NYX {
@@ -46,18 +56,52 @@ protected:
 
 };
 
+//events are dispatched lane by lane, highest priority first, so that a flood of
+//low priority events can't delay the urgent ones.
+enum eEventPriority
+{
+    EV_PRIORITY_HIGH,
+    EV_PRIORITY_NORMAL,
+    EV_PRIORITY_LOW,
+    EV_PRIORITY_COUNT
+};
+
+struct EventLaneStats
+{
+    EventLaneStats() :
+        backlog(0),
+        peakBacklog(0),
+        processed(0),
+        coalesced(0)
+    {}
+
+    uint backlog; //events left in the lane after the last ProcessEventQueue()
+    uint peakBacklog; //highest backlog so far
+    uint processed; //events dispatched during the last ProcessEventQueue()
+    uint coalesced; //events superseded by a newer one during the last ProcessEventQueue()
+};
+
 //the event manager is a singleton within the application for easy access
 //anywhere.
+/*Threading model:
+  - QueueEvent() and QueueEvents() are lock-free and can be called from any thread (physics, loading,
+    scripting workers...).
+  - everything else (SendEvent, listener registration, ProcessEventQueue) belongs to the main thread.
+*/
 class EventManager : public SingletonClass<EventManager>
 {
 public:
 
-    EventManager();
+    //the queue is bounded: once queueCapacity events are waiting, new ones are dropped
+    //(and reported in the log) until the main loop catches up.
+    EventManager(uint queueCapacity = 65536);
     virtual ~EventManager();
 
     //queue an event for later (asyncronous) processing. Used for the
-    //majoruty of messages.
-    void QueueEvent(EventPtr event);
+    //majoruty of messages. Returns false if the queue is full.
+    bool QueueEvent(EventPtr event);
+    //queue several events with a single reservation in the queue. Used by EventBatch.
+    bool QueueEvents(EventPtr* events, uint count);
     //send and event instantanously (sincronous processing).
     //useful for urgent messages.
     bool SendEvent(EventPtr event);
@@ -66,6 +110,7 @@ public:
     bool RegisterListener(eEventType eventType, EventListenerPtr listener);
     //a listener is tied to a game subsystem, therefore it's unregistered only when the subsystem
     //is shutting down and hence it gets unsuscribed to all the events it was listening for.
+    //only the lists the listener was registered to are visited.
     bool UnregisterListener(EventListenerPtr listener);
     //sends all the event queued for processing in the prevoius loop.
     //this function gets called by the main loop.
@@ -73,6 +118,47 @@ public:
     //the time allocated to the event manager for event processing is limited.
     //this function resets the maximum time allowed.
     void ResetTimeoutThreshold(float maxTime);
+    //reading the clock is not free: the time budget is checked every 'interval' events.
+    void SetBudgetCheckInterval(uint interval);
+
+    //selects the lane events of a given type are queued in.
+    void SetEventPriority(eEventType eventType, eEventPriority priority);
+    //when enabled, a queued event of this type is replaced by a newer one with the same
+    //coalescing key (see IEvent::GetCoalescingKey) raised before it was dispatched, including
+    //events left over by a frame that ran out of time.
+    //i.e. only the latest ObjectMovedEvent per object is delivered.
+    void SetCoalescing(eEventType eventType, bool coalesce);
+    const EventLaneStats& GetLaneStats(eEventPriority priority);
+
+    //typed subscriptions. Method is called with the concrete event class for every event of type T::TYPE,
+    //until the returned handle is reset or destroyed.
+    //group is an optional tag (i.e. the scene root) used to drop many subscriptions at once.
+    template<typename T, class C, void (C::*Method)(T&)>
+    EventSubscription Subscribe(C* subscriber, void* group = NULL);
+    //drops all the typed subscriptions tagged with group, in a single pass over each channel.
+    //the handles left behind become harmless. returns the number of subscriptions removed.
+    uint UnsubscribeGroup(void* group);
+    //typed subscriptions and listener registrations currently in place, over all the event types.
+    uint GetSubscriptionCount();
+    uint GetListenerCount();
+    template<typename T>
+    EventChannel<T>& GetChannel();
+
+    /*Recording and replay (see event_recorder.h).
+      While recording, every event queued or sent is logged with the number of the frame it was raised in.
+      While replaying, live events are ignored: the events recorded during frame N are fed back at
+      the beginning of frame N+1, exactly when they were originally due. Combined with a fixed time step
+      (see Scene::Update) every run of the same log gets the same per-frame workload. With the HEADLESS
+      renderer (see Application::Initialise) a replay needs no display.*/
+    bool StartRecording(const string& fileName);
+    void StopRecording();
+    bool StartReplay(const string& fileName);
+    void StopReplay();
+    bool IsRecording();
+    bool IsReplaying();
+    bool IsReplayFinished();
+    //incremented by each call to ProcessEventQueue.
+    uint GetFrameNumber();
 
 private:
 
@@ -80,26 +166,121 @@ private:
     typedef set< eEventType > EventTypeSet;
     typedef list< EventListenerPtr > ListenerList;
     typedef map< eEventType, ListenerList > ListenerMap;
-    typedef list< EventPtr > EventQueue;
+    typedef multimap< IEventListener*, pair< ListenerList*, ListenerList::iterator > > ListenerIndex;
+    typedef vector< EventPtr > EventQueue;
 
     EventTypeSet mRegisteredEvents;
     ListenerMap mRegisteredListeners;
-    EventQueue mPendingEvents[2];
+    //where each listener sits in mRegisteredListeners, so that it can be removed without searching.
+    ListenerIndex mListenerIndex;
+
+    //one typed channel per event type, created on the first subscription.
+    IEventChannel* mChannels[EV_EVENT_TYPE_COUNT];
+
+    //the event queue is still double buffered: producers post into the concurrent queue, and
+    //ProcessEventQueue() only dispatches the events that were published before it started.
+    //Events raised during processing are therefore handled the next time around, as before.
+    ConcurrentEventQueue mIncomingEvents;
+
+    //each lane is consumed front to back through mNext and only compacted when drained, so that
+    //the storage is reused every frame without any allocation.
+    struct EventLane
+    {
+        EventLane() : mNext(0), mBase(0) {}
+
+        EventQueue mEvents;
+        size_t mNext;
+        size_t mBase; //events removed from the front so far: mEvents[i] is the event number mBase + i
+        EventLaneStats mStats;
+    };
+
+    EventLane mLanes[EV_PRIORITY_COUNT];
+    eEventPriority mEventPriority[EV_EVENT_TYPE_COUNT];
+    bool mCoalesce[EV_EVENT_TYPE_COUNT];
+
+    //open addressing table: (event type, coalescing key) -> lane and number of the queued event.
+    //entries are only valid for the current stamp, so it never needs clearing: the stamp moves on
+    //whenever the lanes are empty, otherwise entries are kept for the events still in a backlog.
+    struct CoalescingEntry
+    {
+        CoalescingEntry() : mKey(0), mStamp(0), mLane(0), mIndex(0) {}
+
+        unsigned long long mKey;
+        uint mStamp;
+        int mLane;
+        size_t mIndex;
+    };
+
+    vector<CoalescingEntry> mCoalescingTable;
+    uint mCoalescingStamp;
+    uint mCoalescingCount;
 
     float mMaxProcessingTime;
+    uint mBudgetCheckInterval;
 
-    //the event queue is double buffered to avoid an event being added while
-    //the queue is being processed. newly created events go into an inactive queue
-    //and are processed the next time around.
-    unsigned short mActiveQueue;
+    //events rejected because the concurrent queue was full. Logged by the main thread.
+    std::atomic<uint> mDroppedEvents;
 
-    //swaps the active/inactive queues.
-    inline void SwapQueues();
+    //read by producers to tag recorded events.
+    std::atomic<uint> mFrameNumber;
+    EventRecorder mRecorder;
+
+    //moves the events published so far into their lanes.
+    inline void DrainIncomingEvents();
+    //feeds the recorded events due in the current frame.
+    void ReplayEvents();
+    //returns the slot holding the position of the last event queued with the same key, if any,
+    //which may have been dispatched since. otherwise a new slot is taken for the key and NULL is returned.
+    CoalescingEntry* FindCoalescingEntry(unsigned long long key, int lane, size_t index);
+    void GrowCoalescingTable();
 
     //broadcast a single event. called both by sendEvent() and processEventQueue()
-    inline bool ProcessEvent(EventPtr event);
+    inline bool ProcessEvent(const EventPtr& event);
+};
+
+template<typename T, class C, void (C::*Method)(T&)>
+inline EventSubscription EventManager::Subscribe(C* subscriber, void* group)
+{
+    return GetChannel<T>().Subscribe(subscriber, &EventChannel<T>::template MethodHandler<C, Method>, group);
+}
+
+template<typename T>
+inline EventChannel<T>& EventManager::GetChannel()
+{
+    int index = EventTypeIndex(T::TYPE);
+
+    if (mChannels[index] == NULL)
+        mChannels[index] = new EventChannel<T>();
+
+    return *static_cast<EventChannel<T>*>(mChannels[index]);
+}
+
+//Collects the events raised by a single producer (usually a worker thread running a whole
+//simulation step) and hands them to the event manager with one atomic reservation per
+//BATCH_SIZE events instead of one per event. Not shared between threads.
+class EventBatch
+{
+public:
+
+    EventBatch();
+    ~EventBatch(); //flushes any pending event
+
+    void Add(EventPtr event);
+    void Flush();
+
+private:
+
+    static const uint BATCH_SIZE = 64;
+
+    EventPtr mEvents[BATCH_SIZE];
+    uint mCount;
 };
 
+inline bool EventManager::IsRecording() { return mRecorder.IsRecording(); }
+inline bool EventManager::IsReplaying() { return mRecorder.IsReplaying(); }
+inline bool EventManager::IsReplayFinished() { return mRecorder.IsReplayFinished(); }
+inline uint EventManager::GetFrameNumber() { return mFrameNumber.load(std::memory_order_relaxed); }
+
 }
 
 #endif // EVENTMANAGER_H
@@ -0,0 +1,201 @@
+/*
+
+Event Pools
+
+*/
+
+#ifndef EVENTPOOL_H
+#define EVENTPOOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <vector>
+
+namespace NYX {
+
+/*
+Fixed-size block allocator, one instance per event class.
+Blocks are carved out of chunks of CHUNK_SIZE events and recycled through a free list, so once
+the pool has grown to the peak number of events alive at the same time, creating and destroying
+events does not touch the heap anymore.
+Events can be created on any thread (see EventManager::QueueEvent), the free list is therefore
+protected by a spin lock: the critical section is a couple of pointer swaps.
+*/
+template<typename T>
+class EventPool
+{
+public:
+
+    static EventPool& GetInstance();
+
+    void* Allocate();
+    void Free(void* block);
+
+    //number of chunks requested from the heap so far. constant in steady state.
+    uint ChunkCount();
+    //number of events currently alive.
+    uint LiveCount();
+
+private:
+
+    static const uint CHUNK_SIZE = 256;
+
+    union Block
+    {
+        Block* mNext;
+        alignas(T) char mStorage[sizeof(T)];
+    };
+
+    EventPool();
+    ~EventPool();
+
+    void Lock();
+    void Unlock();
+
+    void Grow();
+
+    Block* mFreeList;
+    std::vector<Block*> mChunks;
+    std::atomic_flag mLock;
+    uint mLiveCount;
+};
+
+/*
+Mixin giving an event class its own pool. Usage:
+    class MyEvent : public BaseEvent, public PooledEvent<MyEvent>
+Classes deriving from a pooled event without declaring their own pool fall back to the
+global heap, since their size does not match the pool block size.
+*/
+template<typename T>
+class PooledEvent
+{
+public:
+
+    static void* operator new(size_t size)
+    {
+        if (size != sizeof(T))
+            return ::operator new(size);
+
+        return EventPool<T>::GetInstance().Allocate();
+    }
+
+    static void operator delete(void* block, size_t size)
+    {
+        if (block == nullptr)
+            return;
+
+        if (size != sizeof(T))
+            ::operator delete(block);
+        else
+            EventPool<T>::GetInstance().Free(block);
+    }
+};
+
+//------------------------------
+// Implementation
+//------------------------------
+
+template<typename T>
+EventPool<T>& EventPool<T>::GetInstance()
+{
+    static EventPool<T> pool;
+    return pool;
+}
+
+template<typename T>
+EventPool<T>::EventPool() :
+    mFreeList(nullptr),
+    mLiveCount(0)
+{
+    mLock.clear();
+}
+
+template<typename T>
+EventPool<T>::~EventPool()
+{
+    for (size_t i = 0; i < mChunks.size(); i++)
+        delete [] mChunks[i];
+}
+
+template<typename T>
+void EventPool<T>::Lock()
+{
+    while (mLock.test_and_set(std::memory_order_acquire))
+        ;
+}
+
+template<typename T>
+void EventPool<T>::Unlock()
+{
+    mLock.clear(std::memory_order_release);
+}
+
+template<typename T>
+void EventPool<T>::Grow()
+{
+    Block* chunk = new Block[CHUNK_SIZE];
+
+    for (uint i = 0; i < CHUNK_SIZE - 1; i++)
+        chunk[i].mNext = &chunk[i + 1];
+
+    chunk[CHUNK_SIZE - 1].mNext = mFreeList;
+    mFreeList = chunk;
+
+    mChunks.push_back(chunk);
+}
+
+template<typename T>
+void* EventPool<T>::Allocate()
+{
+    Lock();
+
+    if (mFreeList == nullptr)
+        Grow();
+
+    Block* block = mFreeList;
+    mFreeList = block->mNext;
+    mLiveCount++;
+
+    Unlock();
+
+    return block->mStorage;
+}
+
+template<typename T>
+void EventPool<T>::Free(void* ptr)
+{
+    Block* block = reinterpret_cast<Block*>(ptr);
+
+    Lock();
+
+    block->mNext = mFreeList;
+    mFreeList = block;
+    mLiveCount--;
+
+    Unlock();
+}
+
+template<typename T>
+uint EventPool<T>::ChunkCount()
+{
+    Lock();
+    uint count = (uint)mChunks.size();
+    Unlock();
+
+    return count;
+}
+
+template<typename T>
+uint EventPool<T>::LiveCount()
+{
+    Lock();
+    uint count = mLiveCount;
+    Unlock();
+
+    return count;
+}
+
+}
+
+#endif // EVENTPOOL_H
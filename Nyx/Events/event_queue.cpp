@@ -0,0 +1,141 @@
+/*
+
+Concurrent Event Queue
+
+*/
+
+#include "event_queue.h"
+
+namespace NYX {
+
+ConcurrentEventQueue::ConcurrentEventQueue(uint capacity)
+{
+    size_t size = 2;
+
+    while (size < capacity)
+        size <<= 1;
+
+    mMask = size - 1;
+    mCells = new Cell[size];
+
+    //a cell is free for the producer claiming position pos when its sequence equals pos.
+    for (size_t i = 0; i < size; i++)
+        mCells[i].mSequence.store(i, std::memory_order_relaxed);
+
+    mEnqueuePos.store(0, std::memory_order_relaxed);
+    mDequeuePos.store(0, std::memory_order_relaxed);
+}
+
+ConcurrentEventQueue::~ConcurrentEventQueue()
+{
+    delete [] mCells;
+}
+
+bool ConcurrentEventQueue::Push(const EventPtr& event)
+{
+    Cell* cell;
+    size_t pos = mEnqueuePos.load(std::memory_order_relaxed);
+
+    for (;;)
+    {
+        cell = &mCells[pos & mMask];
+        size_t seq = cell->mSequence.load(std::memory_order_acquire);
+        ptrdiff_t diff = (ptrdiff_t)seq - (ptrdiff_t)pos;
+
+        if (diff == 0)
+        {
+            //the cell is free, try to claim it.
+            if (mEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            //the consumer has not released this cell yet: the queue is full.
+            return false;
+        }
+        else
+        {
+            //another producer claimed the cell first, try again with the new position.
+            pos = mEnqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    cell->mEvent = event;
+    cell->mSequence.store(pos + 1, std::memory_order_release);
+
+    return true;
+}
+
+bool ConcurrentEventQueue::PushBatch(EventPtr* events, uint count)
+{
+    if (count == 0)
+        return true;
+
+    if (count > Capacity())
+        return false;
+
+    size_t pos = mEnqueuePos.load(std::memory_order_relaxed);
+
+    for (;;)
+    {
+        /*The consumer releases cells strictly in order, so if the last cell of the range is free
+          for this lap, every cell before it is free as well. Winning the CAS below gives this
+          producer exclusive ownership of the whole range.*/
+        size_t last = pos + count - 1;
+        size_t seq = mCells[last & mMask].mSequence.load(std::memory_order_acquire);
+        ptrdiff_t diff = (ptrdiff_t)seq - (ptrdiff_t)last;
+
+        if (diff == 0)
+        {
+            if (mEnqueuePos.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            return false;
+        }
+        else
+        {
+            pos = mEnqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    for (uint i = 0; i < count; i++)
+    {
+        Cell& cell = mCells[(pos + i) & mMask];
+        cell.mEvent = events[i];
+        cell.mSequence.store(pos + i + 1, std::memory_order_release);
+    }
+
+    return true;
+}
+
+bool ConcurrentEventQueue::Pop(EventPtr& event)
+{
+    size_t pos = mDequeuePos.load(std::memory_order_relaxed);
+    Cell& cell = mCells[pos & mMask];
+    size_t seq = cell.mSequence.load(std::memory_order_acquire);
+
+    //either empty, or the next cell has been claimed but not published yet.
+    if ((ptrdiff_t)seq - (ptrdiff_t)(pos + 1) < 0)
+        return false;
+
+    event = cell.mEvent;
+    cell.mEvent.reset();
+
+    //hand the cell back to the producers for the next lap around the ring.
+    cell.mSequence.store(pos + mMask + 1, std::memory_order_release);
+    mDequeuePos.store(pos + 1, std::memory_order_relaxed);
+
+    return true;
+}
+
+uint ConcurrentEventQueue::ApproximateSize()
+{
+    size_t enqueued = mEnqueuePos.load(std::memory_order_relaxed);
+    size_t dequeued = mDequeuePos.load(std::memory_order_relaxed);
+
+    return (enqueued > dequeued) ? (uint)(enqueued - dequeued) : 0;
+}
+
+}
@@ -0,0 +1,68 @@
+/*
+
+Concurrent Event Queue
+
+*/
+
+#ifndef EVENTQUEUE_H
+#define EVENTQUEUE_H
+
+#include "ievent.h"
+
+#include <atomic>
+#include <cstddef>
+
+namespace NYX {
+
+/*
+Bounded, lock-free, multi-producer / single-consumer ring buffer of events.
+It follows D. Vyukov's bounded queue design: every cell carries a sequence number telling
+producers and the consumer whether the cell is free or holds a published event, so producers
+only ever contend on a single atomic counter and never wait for each other.
+- Push() and PushBatch() can be called from any thread.
+- Pop() must only be called by a single consumer thread (the main loop).
+*/
+class ConcurrentEventQueue
+{
+public:
+
+    //capacity is rounded up to the next power of 2.
+    ConcurrentEventQueue(uint capacity);
+    ~ConcurrentEventQueue();
+
+    //returns false if the queue is full. the event is not queued in that case.
+    bool Push(const EventPtr& event);
+    //reserves count consecutive cells with a single atomic operation and publishes
+    //all the events in one go. all or nothing: returns false if there is not enough room.
+    bool PushBatch(EventPtr* events, uint count);
+    //consumer only. returns false if there are no published events left.
+    bool Pop(EventPtr& event);
+
+    uint Capacity();
+    //only a hint when producers are active.
+    uint ApproximateSize();
+
+private:
+
+    struct Cell
+    {
+        std::atomic<size_t> mSequence;
+        EventPtr mEvent;
+    };
+
+    Cell* mCells;
+    size_t mMask;
+
+    //keep producer and consumer counters on separate cache lines to avoid false sharing.
+    char mPad0[64];
+    std::atomic<size_t> mEnqueuePos;
+    char mPad1[64];
+    std::atomic<size_t> mDequeuePos;
+    char mPad2[64];
+};
+
+inline uint ConcurrentEventQueue::Capacity() { return (uint)(mMask + 1); }
+
+}
+
+#endif // EVENTQUEUE_H
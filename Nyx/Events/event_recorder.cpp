@@ -0,0 +1,470 @@
+/*
+
+Event Recorder
+
+*/
+
+#include "event_recorder.h"
+#include "log_manager.h"
+
+#include <cstring>
+
+namespace NYX {
+
+static const char RECORDING_MAGIC[4] = { 'N', 'Y', 'X', 'R' };
+static const uint RECORDING_VERSION = 3;
+
+//frame, type, flags, reserved, payload size
+static const size_t RECORD_HEADER_SIZE = sizeof(uint) + sizeof(unsigned short) + 2*sizeof(unsigned char) + sizeof(uint);
+
+EventRecorder::EventRecorder() :
+    bRecording(false),
+    mRecordedCount(0),
+    mSkippedCount(0),
+    mReplayPos(0),
+    bReplaying(false)
+{
+
+}
+
+EventRecorder::~EventRecorder()
+{
+    StopRecording();
+}
+
+bool EventRecorder::StartRecording(const std::string& fileName)
+{
+    StopRecording();
+
+    mOutput.open(fileName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+
+    if (!mOutput.is_open())
+    {
+        string msg = "Event Recorder Error: Unable to create " + fileName;
+        LogManager::GetInstance()->LogMessage(msg.c_str());
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    mBuffer.clear();
+    mBuffer.reserve(FLUSH_SIZE * 2);
+    mRecordedCount = 0;
+    mSkippedCount = 0;
+
+    WriteBytes(RECORDING_MAGIC, sizeof(RECORDING_MAGIC));
+    Write<uint>(RECORDING_VERSION);
+
+    bRecording = true;
+
+    string msg = "Recording events to " + fileName;
+    LogManager::GetInstance()->LogMessage(msg.c_str());
+
+    return true;
+}
+
+void EventRecorder::StopRecording()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    if (!bRecording)
+        return;
+
+    bRecording = false;
+
+    Flush();
+    mOutput.close();
+
+    string msg = "Event recording stopped. Events recorded: " + to_string(mRecordedCount) + ", skipped: " + to_string(mSkippedCount);
+    LogManager::GetInstance()->LogMessage(msg.c_str());
+}
+
+void EventRecorder::Record(const EventPtr& event, uint frame, bool sent)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    if (!bRecording)
+        return;
+
+    eEventType eventType = event->GetEventType();
+    int typeIndex = EventTypeIndex(eventType);
+
+    if (typeIndex < 0 || typeIndex >= EV_EVENT_TYPE_COUNT)
+    {
+        mSkippedCount++;
+        return;
+    }
+
+    Write<uint>(frame);
+    Write<unsigned short>((unsigned short)typeIndex);
+    Write<unsigned char>(sent ? REC_SENT : 0);
+    Write<unsigned char>(0);
+
+    //the payload size is patched once the payload has been written.
+    size_t sizePos = mBuffer.size();
+    Write<uint>(0);
+
+    WritePayload(event.get());
+
+    uint payloadSize = (uint)(mBuffer.size() - sizePos - sizeof(uint));
+    memcpy(&mBuffer[sizePos], &payloadSize, sizeof(uint));
+
+    mRecordedCount++;
+
+    if (mBuffer.size() >= FLUSH_SIZE)
+        Flush();
+}
+
+void EventRecorder::Flush()
+{
+    if (!mBuffer.empty())
+        mOutput.write(&mBuffer[0], mBuffer.size());
+
+    mBuffer.clear();
+}
+
+void EventRecorder::WriteBytes(const void* data, size_t size)
+{
+    const char* bytes = static_cast<const char*>(data);
+    mBuffer.insert(mBuffer.end(), bytes, bytes + size);
+}
+
+template<typename V>
+void EventRecorder::Write(V value)
+{
+    WriteBytes(&value, sizeof(V));
+}
+
+void EventRecorder::WriteVector(Vector3 v)
+{
+    WriteBytes(v.GetComponents(), 3*sizeof(float));
+}
+
+void EventRecorder::WritePayload(IEvent* event)
+{
+    //the concrete class is known from the event type, see EventChannel.
+    switch (event->GetEventType())
+    {
+    case EV_KEY_PRESS:
+        {
+            KeyEvent* keyEvent = static_cast<KeyEvent*>(event);
+            Write<int>(keyEvent->Key());
+        }
+        break;
+    case EV_ACTIVE_CAMERA_CHANGED:
+        {
+            CameraChangedEvent* camEvent = static_cast<CameraChangedEvent*>(event);
+            Write<int>(camEvent->Id());
+        }
+        break;
+    case EV_CAMERA_MOVED:
+        {
+            CameraMovedEvent* camEvent = static_cast<CameraMovedEvent*>(event);
+            Write<bool>(camEvent->bIsRot);
+            Write<bool>(camEvent->bUseQuaternion);
+
+            if (!camEvent->bIsRot)
+            {
+                WriteVector(camEvent->Position());
+            }
+            else if (!camEvent->bUseQuaternion)
+            {
+                Write<float>(camEvent->RotAngle());
+                Write<int>(camEvent->RotAxis());
+            }
+            else
+            {
+                WriteBytes(camEvent->Rotation().GetComponents(), 4*sizeof(float));
+            }
+        }
+        break;
+    case EV_OBJECT_MOVED:
+        {
+            ObjectMovedEvent* moveEvent = static_cast<ObjectMovedEvent*>(event);
+            Write<uint>(moveEvent->ID());
+            Write<bool>(moveEvent->bUseQuaternion);
+            WriteVector(moveEvent->Position());
+
+            if (!moveEvent->bUseQuaternion)
+            {
+                Matrix3x3 attitude = moveEvent->AttitudeMatrix();
+
+                for (unsigned short i = 0; i < 3; i++)
+                    for (unsigned short j = 0; j < 3; j++)
+                        Write<float>(attitude(i, j));
+            }
+            else
+            {
+                WriteBytes(moveEvent->Rotation().GetComponents(), 4*sizeof(float));
+            }
+
+            Write<bool>(moveEvent->bHasPreviousState);
+
+            if (moveEvent->bHasPreviousState)
+            {
+                WriteVector(moveEvent->PreviousPosition());
+                Matrix3x3 attitude = moveEvent->PreviousAttitude();
+
+                for (unsigned short i = 0; i < 3; i++)
+                    for (unsigned short j = 0; j < 3; j++)
+                        Write<float>(attitude(i, j));
+            }
+
+            //soft body meshes go through their vertex stream, not the event: they are not recorded.
+            Write<bool>(moveEvent->bIsSoft);
+        }
+        break;
+    case EV_CONTACTS:
+        {
+            vector<ContactReport>& contacts = static_cast<ContactsEvent*>(event)->Contacts();
+            Write<uint>((uint)contacts.size());
+
+            for (size_t i = 0; i < contacts.size(); i++)
+            {
+                Write<uint>(contacts[i].bodyA);
+                Write<uint>(contacts[i].bodyB);
+                Write<unsigned char>((unsigned char)contacts[i].phase);
+                Write<uint>(contacts[i].numPoints);
+                Write<float>(contacts[i].impulse);
+                WriteVector(contacts[i].point);
+                WriteVector(contacts[i].normal);
+            }
+        }
+        break;
+    case EV_GAME_ENDED:
+        {
+            GameEndedEvent* endEvent = static_cast<GameEndedEvent*>(event);
+            Write<bool>(endEvent->GameIsWon());
+        }
+        break;
+    default:
+        //no payload (EV_START_GAME_REQUESTED, EV_QUIT_APPLICATION)
+        break;
+    }
+}
+
+bool EventRecorder::StartReplay(const std::string& fileName)
+{
+    StopReplay();
+
+    std::ifstream input(fileName.c_str(), std::ios::in | std::ios::binary);
+
+    if (!input.is_open())
+    {
+        string msg = "Event Recorder Error: Unable to open " + fileName;
+        LogManager::GetInstance()->LogMessage(msg.c_str());
+        return false;
+    }
+
+    input.seekg(0, std::ios::end);
+    size_t size = (size_t)input.tellg();
+    input.seekg(0, std::ios::beg);
+
+    mReplayData.resize(size);
+
+    if (size > 0)
+        input.read(&mReplayData[0], size);
+
+    mReplayPos = 0;
+
+    char magic[4];
+
+    if (!ReadBytes(magic, sizeof(magic)) || memcmp(magic, RECORDING_MAGIC, sizeof(magic)) != 0 ||
+        mReplayPos + sizeof(uint) > mReplayData.size() || Read<uint>() != RECORDING_VERSION)
+    {
+        string msg = "Event Recorder Error: " + fileName + " is not a valid event recording.";
+        LogManager::GetInstance()->LogMessage(msg.c_str());
+        mReplayData.clear();
+        return false;
+    }
+
+    bReplaying = true;
+
+    string msg = "Replaying events from " + fileName;
+    LogManager::GetInstance()->LogMessage(msg.c_str());
+
+    return true;
+}
+
+void EventRecorder::StopReplay()
+{
+    bReplaying = false;
+    mReplayData.clear();
+    mReplayPos = 0;
+}
+
+bool EventRecorder::NextReplayEvent(uint frame, EventPtr& event, bool& sent)
+{
+    while (bReplaying && mReplayPos + RECORD_HEADER_SIZE <= mReplayData.size())
+    {
+        uint recordFrame;
+        memcpy(&recordFrame, &mReplayData[mReplayPos], sizeof(uint));
+
+        if (recordFrame >= frame)
+            return false;
+
+        mReplayPos += sizeof(uint);
+
+        int typeIndex = Read<unsigned short>();
+        unsigned char flags = Read<unsigned char>();
+        Read<unsigned char>();
+        uint payloadSize = Read<uint>();
+        size_t payloadEnd = mReplayPos + payloadSize;
+
+        if (payloadEnd > mReplayData.size())
+            break;
+
+        IEvent* replayed = ReadPayload((eEventType)(EV_KEY_PRESS + typeIndex));
+
+        //always resynchronise on the size stored in the log.
+        mReplayPos = payloadEnd;
+
+        if (replayed == NULL)
+        {
+            mSkippedCount++;
+            continue;
+        }
+
+        event.reset(replayed);
+        sent = (flags & REC_SENT) != 0;
+
+        return true;
+    }
+
+    //truncated log: nothing else can be read.
+    if (mReplayPos + RECORD_HEADER_SIZE > mReplayData.size())
+        mReplayPos = mReplayData.size();
+
+    return false;
+}
+
+bool EventRecorder::ReadBytes(void* data, size_t size)
+{
+    if (mReplayPos + size > mReplayData.size())
+        return false;
+
+    memcpy(data, &mReplayData[mReplayPos], size);
+    mReplayPos += size;
+
+    return true;
+}
+
+template<typename V>
+V EventRecorder::Read()
+{
+    V value = V();
+    ReadBytes(&value, sizeof(V));
+    return value;
+}
+
+Vector3 EventRecorder::ReadVector()
+{
+    float v[3] = { 0.0f, 0.0f, 0.0f };
+    ReadBytes(v, sizeof(v));
+    return Vector3(v[0], v[1], v[2]);
+}
+
+IEvent* EventRecorder::ReadPayload(eEventType eventType)
+{
+    switch (eventType)
+    {
+    case EV_KEY_PRESS:
+        return new KeyEvent(Read<int>());
+    case EV_ACTIVE_CAMERA_CHANGED:
+        return new CameraChangedEvent(Read<int>());
+    case EV_CAMERA_MOVED:
+        {
+            bool isRot = Read<bool>();
+            bool useQuaternion = Read<bool>();
+
+            if (!isRot)
+                return new CameraMovedEvent(ReadVector());
+
+            if (!useQuaternion)
+            {
+                float angle = Read<float>();
+                eAxis axis = (eAxis)Read<int>();
+                return new CameraMovedEvent(angle, axis);
+            }
+
+            float q[4] = { 1.0f, 0.0f, 0.0f, 0.0f };
+            ReadBytes(q, sizeof(q));
+            return new CameraMovedEvent(Quaternion(q));
+        }
+    case EV_OBJECT_MOVED:
+        {
+            uint id = Read<uint>();
+            bool useQuaternion = Read<bool>();
+            Vector3 pos = ReadVector();
+            ObjectMovedEvent* moveEvent;
+
+            if (!useQuaternion)
+            {
+                Matrix3x3 attitude;
+
+                for (unsigned short i = 0; i < 3; i++)
+                    for (unsigned short j = 0; j < 3; j++)
+                        attitude(i, j) = Read<float>();
+
+                moveEvent = new ObjectMovedEvent(id, pos, attitude);
+            }
+            else
+            {
+                float q[4] = { 1.0f, 0.0f, 0.0f, 0.0f };
+                ReadBytes(q, sizeof(q));
+                moveEvent = new ObjectMovedEvent(id, pos, Quaternion(q));
+            }
+
+            if (Read<bool>())
+            {
+                Vector3 prevPos = ReadVector();
+                Matrix3x3 prevAttitude;
+
+                for (unsigned short i = 0; i < 3; i++)
+                    for (unsigned short j = 0; j < 3; j++)
+                        prevAttitude(i, j) = Read<float>();
+
+                moveEvent->SetPreviousState(prevPos, prevAttitude);
+            }
+
+            moveEvent->bIsSoft = Read<bool>();
+
+            return moveEvent;
+        }
+    case EV_CONTACTS:
+        {
+            //a damaged log must not make us allocate what isn't there.
+            const size_t recordSize = 3*sizeof(uint) + sizeof(unsigned char) + 7*sizeof(float);
+            uint count = Read<uint>();
+
+            if (count > (mReplayData.size() - mReplayPos) / recordSize)
+                return NULL;
+
+            ContactsEvent* contactsEvent = new ContactsEvent();
+            vector<ContactReport>& contacts = contactsEvent->Contacts();
+            contacts.resize(count);
+
+            for (size_t i = 0; i < contacts.size(); i++)
+            {
+                contacts[i].bodyA = Read<uint>();
+                contacts[i].bodyB = Read<uint>();
+                contacts[i].phase = (eContactPhase)Read<unsigned char>();
+                contacts[i].numPoints = Read<uint>();
+                contacts[i].impulse = Read<float>();
+                contacts[i].point = ReadVector();
+                contacts[i].normal = ReadVector();
+            }
+
+            return contactsEvent;
+        }
+    case EV_GAME_ENDED:
+        return new GameEndedEvent(Read<bool>());
+    case EV_START_GAME_REQUESTED:
+    case EV_QUIT_APPLICATION:
+        return new BaseEvent(eventType);
+    default:
+        return NULL;
+    }
+}
+
+}
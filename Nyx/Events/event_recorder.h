@@ -0,0 +1,96 @@
+/*
+
+Event Recorder
+
+*/
+
+#ifndef EVENTRECORDER_H
+#define EVENTRECORDER_H
+
+#include "events.h"
+
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace NYX {
+
+/*
+Records the events fed to the EventManager into a compact binary log, and plays them back.
+Log layout (little endian, as written by the host):
+    header:  char[4] "NYXR", uint version
+    records: uint frame, unsigned short event type index, unsigned char flags, unsigned char reserved,
+             uint payload size, payload
+Payloads are the event members, written field by field by the switch in WritePayload/ReadPayload:
+a new event class must be added there to be recorded (unknown types are skipped and counted).
+Recording can happen from any thread, since events can be queued from any thread. Replay
+belongs to the main thread.
+*/
+class EventRecorder
+{
+public:
+
+    enum eRecordFlags
+    {
+        REC_SENT = 0x01 //dispatched with SendEvent rather than queued
+    };
+
+    EventRecorder();
+    ~EventRecorder();
+
+    bool StartRecording(const std::string& fileName);
+    void StopRecording();
+    bool IsRecording();
+    void Record(const EventPtr& event, uint frame, bool sent);
+
+    //loads the whole log in memory.
+    bool StartReplay(const std::string& fileName);
+    void StopReplay();
+    bool IsReplaying();
+    //true once every recorded event has been handed back.
+    bool IsReplayFinished();
+    //returns, one at a time and in recording order, the events recorded before frame.
+    bool NextReplayEvent(uint frame, EventPtr& event, bool& sent);
+
+    uint GetRecordedCount();
+    uint GetSkippedCount();
+
+private:
+
+    static const uint FLUSH_SIZE = 64 * 1024;
+
+    void WriteBytes(const void* data, size_t size);
+    template<typename V> void Write(V value);
+    void WriteVector(Vector3 v);
+    void WritePayload(IEvent* event);
+
+    bool ReadBytes(void* data, size_t size);
+    template<typename V> V Read();
+    Vector3 ReadVector();
+    IEvent* ReadPayload(eEventType eventType);
+
+    void Flush();
+
+    std::mutex mMutex;
+    std::ofstream mOutput;
+    std::vector<char> mBuffer;
+    std::atomic<bool> bRecording; //read without the lock by the threads that post events
+    uint mRecordedCount;
+    uint mSkippedCount;
+
+    std::vector<char> mReplayData;
+    size_t mReplayPos;
+    std::atomic<bool> bReplaying;
+};
+
+inline bool EventRecorder::IsRecording() { return bRecording; }
+inline bool EventRecorder::IsReplaying() { return bReplaying; }
+inline bool EventRecorder::IsReplayFinished() { return bReplaying && mReplayPos >= mReplayData.size(); }
+inline uint EventRecorder::GetRecordedCount() { return mRecordedCount; }
+inline uint EventRecorder::GetSkippedCount() { return mSkippedCount; }
+
+}
+
+#endif // EVENTRECORDER_H
@@ -5,6 +5,7 @@ Events
 */
 
 #include "events.h"
+#include <mutex>
 #include <vector>
 
 using namespace std;
@@ -26,29 +27,31 @@ eEventType BaseEvent::GetEventType()
     return mEventType;
 }
 
-string BaseEvent::GetEventTypeStr()
+const char* GetEventTypeName(eEventType eventType)
 {
-    string ev_type_name;
-
-    switch (mEventType)
+    static const char* names[EV_EVENT_TYPE_COUNT] =
     {
-    case EV_KEY_PRESS:
-        ev_type_name = "KEY PRESSED";
-        break;
-    case EV_CAMERA_MOVED:
-        ev_type_name = "CAMERA MOVED";
-        break;
-    case EV_START_GAME_REQUESTED:
-        ev_type_name = "START GAME REQUESTED";
-        break;
-    case EV_GAME_ENDED:
-        ev_type_name = "GAME ENDED";
-    case EV_QUIT_APPLICATION:
-        ev_type_name = "QUIT GAME";
-        break;
-    }
+        "KEY PRESSED",
+        "CAMERA MOVED",
+        "ACTIVE CAMERA CHANGED",
+        "START GAME REQUESTED",
+        "GAME ENDED",
+        "QUIT GAME",
+        "OBJECT MOVED",
+        "CONTACTS"
+    };
+
+    int index = EventTypeIndex(eventType);
+
+    if (index < 0 || index >= EV_EVENT_TYPE_COUNT)
+        return "UNKNOWN EVENT";
+
+    return names[index];
+}
 
-    return ev_type_name;
+string BaseEvent::GetEventTypeStr()
+{
+    return GetEventTypeName(mEventType);
 }
 
 KeyEvent::KeyEvent(int whichKey) :
@@ -119,9 +122,9 @@ Quaternion CameraMovedEvent::Rotation()
 
 ObjectMovedEvent::ObjectMovedEvent(uint id, Vector3 pos, Matrix3x3 attitude) :
     BaseEvent(EV_OBJECT_MOVED),
-	mMesh(NULL),
 	bUseQuaternion(false),
-	bIsSoft(false)
+	bIsSoft(false),
+	bHasPreviousState(false)
 {
 	mObjectID = id;
 	mNewPosition = pos;
@@ -130,9 +133,9 @@ ObjectMovedEvent::ObjectMovedEvent(uint id, Vector3 pos, Matrix3x3 attitude) :
 
 ObjectMovedEvent::ObjectMovedEvent(uint id, Vector3 pos, Quaternion rot) :
     BaseEvent(EV_OBJECT_MOVED),
-	mMesh(NULL),
 	bUseQuaternion(true),
-	bIsSoft(false)
+	bIsSoft(false),
+	bHasPreviousState(false)
 {
 	mObjectID = id;
 	mNewPosition = pos;
@@ -141,13 +144,20 @@ ObjectMovedEvent::ObjectMovedEvent(uint id, Vector3 pos, Quaternion rot) :
 
 ObjectMovedEvent::~ObjectMovedEvent()
 {
-	delete mMesh;
+
 }
 
 uint ObjectMovedEvent::ID()
 {
 	return mObjectID;
 }
+
+bool ObjectMovedEvent::GetCoalescingKey(uint& key)
+{
+	//only the latest position of each object matters
+	key = mObjectID;
+	return true;
+}
  
 Vector3 ObjectMovedEvent::Position()
 {
@@ -159,20 +169,80 @@ Matrix3x3 ObjectMovedEvent::AttitudeMatrix()
 	return mAttitude;
 }
 
-void ObjectMovedEvent::AddSoftBodyMesh(float* mesh)
+Quaternion ObjectMovedEvent::Rotation()
 {
-	mMesh = mesh;
-	bIsSoft = true;
+	return mRot;
 }
 
-float* ObjectMovedEvent::GetMesh()
+void ObjectMovedEvent::SetPreviousState(Vector3 pos, Matrix3x3 attitude)
 {
-	return mMesh;
+	mPreviousPosition = pos;
+	mPreviousAttitude = attitude;
+	bHasPreviousState = true;
 }
 
-Quaternion ObjectMovedEvent::Rotation()
+Vector3 ObjectMovedEvent::PreviousPosition()
 {
-	return mRot;
+	return mPreviousPosition;
+}
+
+Matrix3x3 ObjectMovedEvent::PreviousAttitude()
+{
+	return mPreviousAttitude;
+}
+
+/*the contact lists of the events gone, with their storage. The physics engine hands a full list over at every
+  step (see DefaultPhysicsEngine::PublishSnapshot) and gets the one of the new event back in exchange, so once
+  there are a few spares, reporting contacts does not touch the heap anymore.*/
+struct SpareContactLists
+{
+    static const size_t MAX_SPARES = 8;
+
+    SpareContactLists() { mLists.reserve(MAX_SPARES); }
+
+    std::mutex mMutex;
+    vector< vector<ContactReport> > mLists;
+};
+
+static SpareContactLists& GetSpareContactLists()
+{
+    static SpareContactLists spares;
+    return spares;
+}
+
+ContactsEvent::ContactsEvent() :
+    BaseEvent(EV_CONTACTS)
+{
+    SpareContactLists& spares = GetSpareContactLists();
+    std::lock_guard<std::mutex> lock(spares.mMutex);
+
+    if (!spares.mLists.empty())
+    {
+        mContacts.swap(spares.mLists.back());
+        spares.mLists.pop_back();
+    }
+}
+
+ContactsEvent::~ContactsEvent()
+{
+    if (mContacts.capacity() == 0)
+        return;
+
+    mContacts.clear();
+
+    SpareContactLists& spares = GetSpareContactLists();
+    std::lock_guard<std::mutex> lock(spares.mMutex);
+
+    if (spares.mLists.size() < SpareContactLists::MAX_SPARES)
+    {
+        spares.mLists.push_back(vector<ContactReport>());
+        spares.mLists.back().swap(mContacts);
+    }
+}
+
+std::vector<ContactReport>& ContactsEvent::Contacts()
+{
+	return mContacts;
 }
 
 GameEndedEvent::GameEndedEvent(bool won) :
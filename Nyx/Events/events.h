@@ -11,9 +11,10 @@ Events
 #include <utility>
 #include <set>
 #include <map>
+#include <vector>
 
 #include "ievent.h"
-#include "events.h"
+#include "event_pool.h"
 #include "Math/constants.h"
 #include "Math/vector3.h"
 #include "Math/matrix3x3.h"
@@ -21,6 +22,11 @@ Events
 
 namespace NYX {
 
+//human-readable name of an event type. points to a static string: nothing is allocated.
+const char* GetEventTypeName(eEventType eventType);
+
+/*Concrete events expose their type as TYPE, which is what EventChannel<T> and
+  EventManager::Subscribe<T> rely on. Each event type must be raised by a single class.*/
 class BaseEvent : public IEvent
 {
 public:
@@ -37,10 +43,12 @@ protected:
 };
 
 
-class KeyEvent : public BaseEvent
+class KeyEvent : public BaseEvent, public PooledEvent<KeyEvent>
 {
 public:
 
+    static const eEventType TYPE = EV_KEY_PRESS;
+
     KeyEvent(int whichKey);
     virtual ~KeyEvent();
 
@@ -51,10 +59,12 @@ private:
     int mKey;
 };
 
-class CameraChangedEvent : public BaseEvent
+class CameraChangedEvent : public BaseEvent, public PooledEvent<CameraChangedEvent>
 {
 public:
 
+    static const eEventType TYPE = EV_ACTIVE_CAMERA_CHANGED;
+
 	CameraChangedEvent(int id) : 
 		BaseEvent(EV_ACTIVE_CAMERA_CHANGED),
 		mId(id)
@@ -69,10 +79,12 @@ private:
     int mId;
 };
 
-class CameraMovedEvent : public BaseEvent
+class CameraMovedEvent : public BaseEvent, public PooledEvent<CameraMovedEvent>
 {
 public:
 
+    static const eEventType TYPE = EV_CAMERA_MOVED;
+
     CameraMovedEvent(Vector3 pos);
 	CameraMovedEvent(float angle, eAxis axis);
 	CameraMovedEvent(Quaternion rot);
@@ -94,24 +106,30 @@ private:
     Vector3 mNewPosition;
 };
 
-class ObjectMovedEvent : public BaseEvent
+class ObjectMovedEvent : public BaseEvent, public PooledEvent<ObjectMovedEvent>
 {
 public:
 
+    static const eEventType TYPE = EV_OBJECT_MOVED;
+
     ObjectMovedEvent(uint id, Vector3 pos, Matrix3x3 attitude);
 	ObjectMovedEvent(uint id, Vector3 pos, Quaternion rot);
     virtual ~ObjectMovedEvent();
 
 	uint ID();
+	bool GetCoalescingKey(uint& key);
     Vector3 Position();
 	Matrix3x3 AttitudeMatrix();
 	Quaternion Rotation();
 
-	void AddSoftBodyMesh(float* mesh);
-	float* GetMesh();
+	//state before the last physics step, so that the scene can interpolate between the two.
+	void SetPreviousState(Vector3 pos, Matrix3x3 attitude);
+	Vector3 PreviousPosition();
+	Matrix3x3 PreviousAttitude();
 
 	bool bUseQuaternion;
-	bool bIsSoft;
+	bool bIsSoft; //a soft body that has written a new mesh to its vertex stream
+	bool bHasPreviousState;
 
 private:
 
@@ -119,12 +137,54 @@ private:
 	Quaternion mRot;
 	Matrix3x3 mAttitude;
     Vector3 mNewPosition;
-	float* mMesh;
+	Matrix3x3 mPreviousAttitude;
+	Vector3 mPreviousPosition;
+};
+
+enum eContactPhase
+{
+	CONTACT_BEGIN, //the bodies touched during the step
+	CONTACT_PERSIST, //they were touching already
+	CONTACT_END //they stopped touching
+};
+
+//a pair of bodies in contact at the end of a physics step.
+struct ContactReport
+{
+	uint bodyA; //ids, bodyA < bodyB
+	uint bodyB;
+	eContactPhase phase;
+	uint numPoints; //0 for CONTACT_END
+	float impulse; //applied by the step along the normal, over all the points
+	Vector3 point; //the one with the largest impulse, on bodyB
+	Vector3 normal; //at that point, from bodyB towards bodyA
 };
 
-class GameEndedEvent : public BaseEvent
+/*the contacts of one or more physics steps (see IPhysicsBody::SetContactReport), in a single event 
+  rather than one per pair: a busy scene has thousands of them.
+  The lists are recycled with their storage when the events go (see events.cpp).*/
+class ContactsEvent : public BaseEvent, public PooledEvent<ContactsEvent>
 {
 public:
+
+    static const eEventType TYPE = EV_CONTACTS;
+
+    ContactsEvent();
+    virtual ~ContactsEvent();
+
+	std::vector<ContactReport>& Contacts();
+
+private:
+
+	std::vector<ContactReport> mContacts;
+};
+
+class GameEndedEvent : public BaseEvent, public PooledEvent<GameEndedEvent>
+{
+public:
+
+    static const eEventType TYPE = EV_GAME_ENDED;
+
     GameEndedEvent(bool won);
     virtual ~GameEndedEvent();
 
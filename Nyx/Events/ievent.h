@@ -8,6 +8,9 @@ Event Iterfaces
 #define IEVENT_H
 
 #include <memory>
+#include <atomic>
+
+#include "Utils/intrusive_ptr.h"
 
 // interface list
 namespace NYX {
@@ -17,7 +20,9 @@ class IEventListener;
 
 // global typedefs
 
-typedef std::shared_ptr< IEvent > EventPtr;
+//events are intrusively reference counted (see IEvent::AddRef/Release) and allocated from
+//per-class pools (see event_pool.h): no control block and no heap traffic per event.
+typedef IntrusivePtr< IEvent > EventPtr;
 typedef std::shared_ptr< IEventListener > EventListenerPtr;
 
 //event types
@@ -29,16 +34,38 @@ enum eEventType
     EV_START_GAME_REQUESTED,
     EV_GAME_ENDED,
     EV_QUIT_APPLICATION,
-    EV_OBJECT_MOVED
+    EV_OBJECT_MOVED,
+    EV_CONTACTS,
+    EV_EVENT_TYPE_END //not an event, keep it last
 };
 
+const int EV_EVENT_TYPE_COUNT = EV_EVENT_TYPE_END - EV_KEY_PRESS;
+
+//zero-based index of an event type, for look up tables.
+inline int EventTypeIndex(eEventType eventType) { return eventType - EV_KEY_PRESS; }
+
 class NYX_EXPORT IEvent
 {
 public:
+    IEvent() : mRefCount(0) {}
+    IEvent(const IEvent&) : mRefCount(0) {}
     virtual ~IEvent() {}
     virtual eEventType GetEventType() = 0; //returns the event type ID
     virtual std::string GetEventTypeStr() = 0; //returns a human-readable string
     //with the event type ID name. mainly for debug purposes.
+
+    //events that describe a state (i.e. where an object is) rather than an action can be superseded
+    //by a newer event of the same type and key. returns false if the event can't be coalesced.
+    virtual bool GetCoalescingKey(uint& key) { return false; }
+
+    //used by EventPtr. events can be shared across threads, hence the atomic counter.
+    void AddRef() { mRefCount.fetch_add(1, std::memory_order_relaxed); }
+    void Release() { if (mRefCount.fetch_sub(1, std::memory_order_acq_rel) == 1) delete this; }
+
+private:
+    IEvent& operator= (const IEvent&);
+
+    std::atomic<int> mRefCount;
 };
 
 class NYX_EXPORT IEventListener
@@ -7,45 +7,98 @@
 #include "body.h"
 #include "Utils/log_manager.h"
 
+#include <cstring>
+
 using namespace std;
 
 namespace NYX {
 
-PhysicsBody::PhysicsBody(std::string name, uint id) :
+PhysicsBody::PhysicsBody(std::string name, uint id, CollisionShapeCachePtr shapeCache) :
+	mShapeCache(shapeCache),
 	mBulletCollisionShape(NULL),
-	mBulletConvexHull(NULL),
+	mBulletSharedShape(NULL),
 	mBulletMotionState(NULL),
+	mCookedHull(NULL),
+	mScale(1.0),
 	mMass(0.0),
 	mFriction(0.0),
 	mDamping(0.0),
 	mAngularDamping(0.0),
+	mContactReport(CR_NONE),
 	mIsInitialized(false),
 	mName(name),
 	mID(id),
 	mHasMesh(false)
 {
-    
+    mForce.SetComponents(0.0, 0.0, 0.0);
+	mFieldForce.setValue(0.f, 0.f, 0.f);
+	memset(mShapeDimensions, 0, sizeof(mShapeDimensions));
 
+	//nobody to share with: a cache of its own keeps the shape handling the same.
+	if (!mShapeCache)
+		mShapeCache.reset(new CollisionShapeCache());
 }
 
 PhysicsBody::~PhysicsBody()
 {
-	delete mBulletCollisionShape;
+	ReleaseCollisionShape();
 
 	mBulletMotionState = NULL;
-	mBulletCollisionShape = NULL;
 }
 
-void PhysicsBody::SetMesh(float* rawVertices, int totalVertices, int stride, int *indices)
+void PhysicsBody::SetMesh(float* rawVertices, int totalVertices, int stride, int *indices, int totalIndices)
+{
+	//only the positions go into the hull. stride is in bytes.
+	mHullPoints.resize(3*totalVertices);
+
+	for (int i = 0; i < totalVertices; i++)
+	{
+		float* vertex = reinterpret_cast<float*>(reinterpret_cast<char*>(rawVertices) + i*stride);
+		mHullPoints[3*i] = vertex[0];
+		mHullPoints[3*i + 1] = vertex[1];
+		mHullPoints[3*i + 2] = vertex[2];
+	}
+
+	//a mesh with some triangles missing can only be used whole.
+	if (indices != NULL && totalIndices % 3 == 0)
+		mHullTriangles.assign(indices, indices + totalIndices);
+	else
+		mHullTriangles.clear();
+
+	mHasMesh = totalVertices > 0;
+}
+
+void PhysicsBody::SetMeshHull(const MeshHullOptions& options, const std::string* cooked)
 {
-	mBulletConvexHull = new btConvexHullShape(rawVertices, totalVertices, stride);
-	if (mBulletConvexHull != NULL)
-		mHasMesh = true;
+	mHullOptions = options;
+	mCookedHull = cooked;
+}
+
+bool PhysicsBody::CookMeshHull(std::string& cooked)
+{
+	return mShapeCache->CookHull(mBulletSharedShape, cooked);
+}
+
+void PhysicsBody::SetTriangleMesh(const float* vertices, int numVertices, int stride, const int* indices, int numTriangles, 
+								const std::string* cooked)
+{
+	mTriangleMesh.vertices = vertices;
+	mTriangleMesh.indices = indices;
+	mTriangleMesh.numVertices = numVertices;
+	mTriangleMesh.stride = stride;
+	mTriangleMesh.numTriangles = numTriangles;
+	mTriangleMesh.cooked = cooked;
+}
+
+bool PhysicsBody::CookTriangleMesh(std::string& cooked)
+{
+	//the cache knows whether it is a triangle mesh.
+	return mShapeCache->CookTriangleMesh(mBulletSharedShape, cooked);
 }
 
 void PhysicsBody::SetCollisionShape(eCollisionShape collisionShape, void* dim) 
 { 
-	if (collisionShape != CS_MESH && dim == NULL)
+	if (collisionShape != CS_MESH && collisionShape != CS_TRIANGLE_MESH && dim == NULL)
 	{
 		LogManager::GetInstance()->LogMessage("Error! NULL pointer passed with collision shape other than CS_MESH!");
 		return;
@@ -55,47 +108,174 @@ void PhysicsBody::SetCollisionShape(eCollisionShape collisionShape, void* dim)
 		LogManager::GetInstance()->LogMessage("Error! Attempted to create a mesh collision shape without initializing mesh data first!");
 		return;
 	}
+	else if (collisionShape == CS_TRIANGLE_MESH && mTriangleMesh.vertices == NULL)
+	{
+		LogManager::GetInstance()->LogMessage("Error! Attempted to create a triangle mesh collision shape without setting the triangle mesh first!");
+		return;
+	}
 
 	mCollisionShape = collisionShape; 
 
 	switch (mCollisionShape)
 	{
 	case CS_PLANE:
-		mBulletCollisionShape = new btStaticPlaneShape(btVector3(static_cast<float*>(dim)[0],
-																static_cast<float*>(dim)[1],
-																static_cast<float*>(dim)[2]),
-														static_cast<float*>(dim)[3]);
+		memcpy(mShapeDimensions, dim, 4*sizeof(float));
 		break;
 	case CS_BOX:
-		mBulletCollisionShape = new btBoxShape(btVector3(static_cast<float*>(dim)[0],
-														static_cast<float*>(dim)[1],
-														static_cast<float*>(dim)[2]));
+		memcpy(mShapeDimensions, dim, 3*sizeof(float));
+		break;
+	case CS_SPHERE:
+		mShapeDimensions[0] = static_cast<float*>(dim)[0];
+		break;
+	default:
+		break;
+	}
+
+	CreateCollisionShape();
+}
+
+void PhysicsBody::SetScale(float scale)
+{
+	if (mIsInitialized)
+	{
+		LogManager::GetInstance()->LogMessage("Error! The scale of a body must be set before it is finalized!");
+		return;
+	}
+
+	mScale = scale;
+
+	if (mBulletCollisionShape != NULL)
+		CreateCollisionShape();
+}
+
+void PhysicsBody::CreateCollisionShape()
+{
+	//acquired before the current one is released: if it's the same, the cache keeps it.
+	btCollisionShape* sharedShape = NULL;
+	btCollisionShape* shape = NULL;
+
+	switch (mCollisionShape)
+	{
+	case CS_PLANE:
+		//infinite: nothing to scale.
+		sharedShape = mShapeCache->Acquire(CS_PLANE, mShapeDimensions);
+		shape = sharedShape;
 		break;
+	case CS_BOX:
 	case CS_SPHERE:
-		mBulletCollisionShape = new btSphereShape(static_cast<float*>(dim)[0]);
+		{
+			//the scale goes into the dimensions: bodies scaled the same way still share a shape.
+			float dim[3] = { mShapeDimensions[0]*mScale, mShapeDimensions[1]*mScale, mShapeDimensions[2]*mScale };
+			sharedShape = mShapeCache->Acquire(mCollisionShape, dim);
+			shape = sharedShape;
+		}
 		break;
 	case CS_MESH:
-		mBulletCollisionShape = mBulletConvexHull;
+		{
+			const int* triangles = mHullTriangles.empty() ? NULL : &mHullTriangles[0];
+			sharedShape = mShapeCache->AcquireHull(&mHullPoints[0], (int)mHullPoints.size()/3, triangles, (int)mHullTriangles.size()/3, 
+												   mHullOptions, mCookedHull);
+			mCookedHull = NULL;
+
+			//the hull is shared as it is, a scaled body wraps it (or each of its parts) in a shape of its own.
+			if (sharedShape == NULL || mScale == 1.0f)
+			{
+				shape = sharedShape;
+			}
+			else if (sharedShape->getShapeType() == COMPOUND_SHAPE_PROXYTYPE)
+			{
+				btCompoundShape* parts = static_cast<btCompoundShape*>(sharedShape);
+				btCompoundShape* scaled = new btCompoundShape();
+
+				//the parts are placed in the frame of the body: scaling each of them scales the whole.
+				for (int i = 0; i < parts->getNumChildShapes(); i++)
+					scaled->addChildShape(parts->getChildTransform(i), new btUniformScalingShape(static_cast<btConvexShape*>(parts->getChildShape(i)), mScale));
+
+				shape = scaled;
+			}
+			else
+			{
+				shape = new btUniformScalingShape(static_cast<btConvexShape*>(sharedShape), mScale);
+			}
+		}
+		break;
+	case CS_TRIANGLE_MESH:
+		{
+			btBvhTriangleMeshShape* triangleMesh = mShapeCache->AcquireTriangleMesh(mTriangleMesh.vertices, mTriangleMesh.numVertices,
+																				mTriangleMesh.stride, mTriangleMesh.indices, 
+																				mTriangleMesh.numTriangles, mTriangleMesh.cooked);
+			sharedShape = triangleMesh;
+			mTriangleMesh.cooked = NULL;
+
+			if (triangleMesh != NULL && mScale != 1.0f)
+				shape = new btScaledBvhTriangleMeshShape(triangleMesh, btVector3(mScale, mScale, mScale));
+			else
+				shape = triangleMesh;
+		}
 		break;
 	default:
 		break;
 	}
+
+	ReleaseCollisionShape();
+
+	mBulletSharedShape = sharedShape;
+	mBulletCollisionShape = shape;
+}
+
+void PhysicsBody::ReleaseCollisionShape()
+{
+	if (mBulletCollisionShape != mBulletSharedShape)
+	{
+		//the scaled parts of a decomposed hull are the body's as well.
+		if (mBulletCollisionShape->getShapeType() == COMPOUND_SHAPE_PROXYTYPE)
+		{
+			btCompoundShape* scaled = static_cast<btCompoundShape*>(mBulletCollisionShape);
+
+			for (int i = 0; i < scaled->getNumChildShapes(); i++)
+				delete scaled->getChildShape(i);
+		}
+
+		delete mBulletCollisionShape;
+	}
+
+	mShapeCache->Release(mBulletSharedShape);
+
+	mBulletCollisionShape = NULL;
+	mBulletSharedShape = NULL;
 }
 
 void PhysicsBody::SetMassAndInertia(float mass, Vector3 localInertia) 
 {
+	//soft bodies have no shape: Finilize spreads the mass over the nodes.
+	if (mBodyType == BDY_SOFT)
+	{
+		mMass = mass;
+		mIsDynamic = (mass != 0.f);
+		return;
+	}
+
 	if (mBulletCollisionShape == NULL)
 	{
 		LogManager::GetInstance()->LogMessage("Error! A Bullet collision shape must be initialized first!");
 		return;
 	}
 
+	if ((mCollisionShape == CS_PLANE || mCollisionShape == CS_TRIANGLE_MESH) && mass != 0.f)
+	{
+		LogManager::GetInstance()->LogMessage("Error! Planes and triangle meshes can only be static: the mass is set to 0.");
+		mass = 0.f;
+	}
+
 	mMass = mass;
 	mIsDynamic = (mass != 0.f);
 	mLocalInertia = localInertia;
 
-	mBulletInertia.setValue(mLocalInertia.X(), mLocalInertia.Y(), mLocalInertia.Z());
-	mBulletCollisionShape->calculateLocalInertia(mMass, mBulletInertia);
+	mBulletInertia.setValue(0.f, 0.f, 0.f);
+
+	//Bullet doesn't compute the inertia of concave shapes, and static bodies have none.
+	if (mIsDynamic)
+		mBulletCollisionShape->calculateLocalInertia(mMass, mBulletInertia);
 }
 
 void PhysicsBody::SetInitialState(Vector3 origin, Matrix3x3 transform) 
@@ -8,6 +8,7 @@ Generic Physics Body
 */
 
 #include "iphysics_engine.h"
+#include "collision_shape_cache.h"
 #include "btBulletDynamicsCommon.h"
 
 namespace NYX {
@@ -19,22 +20,47 @@ class PhysicsBody : public IPhysicsBody
 {
 public:
 
-    PhysicsBody(std::string name, uint id);
+    //bodies created with the same shape cache share their collision shapes. Without one, the body keeps its own.
+    PhysicsBody(std::string name, uint id, CollisionShapeCachePtr shapeCache = CollisionShapeCachePtr());
     ~PhysicsBody();
 
 	void SetCollisionShape(eCollisionShape collisionShape, void* dim = NULL);
+	void SetScale(float scale);
 	void SetMassAndInertia(float mass, Vector3 localInertia);
 	void SetInitialState(Vector3 origin, Matrix3x3 transform); //origin and initial transform
 	void SetVelocity(Vector3 velocity);
+	void SetForce(Vector3 force);
+	//the pull of the gravity field, set by the engine before every step.
+	void SetFieldForce(const btVector3& force);
 	void SetFriction(float friction);
 	void SetDamping(float damping, float angDamping);
-	virtual void SetMesh(float* rawVertices, int totalVertices, int stride, int* indices = NULL);
+	void SetContactReport(uint flags);
+	virtual void SetMesh(float* rawVertices, int totalVertices, int stride, int* indices = NULL, int totalIndices = 0);
+	/*how the mesh becomes the CS_MESH collision shape, before SetCollisionShape. MH_DECOMPOSED needs the indices
+	  passed to SetMesh. cooked: from CookMeshHull on an earlier load, read when the collision shape is created.*/
+	void SetMeshHull(const MeshHullOptions& options, const std::string* cooked = NULL);
+	//the reduced or decomposed hulls, serialized for SetMeshHull. false if they were read from cooked data.
+	bool CookMeshHull(std::string& cooked);
+	/*static level geometry, for CS_TRIANGLE_MESH. The vertices (stride in bytes, position first) and indices are
+	  used where they are, and must outlive the body. cooked: from CookTriangleMesh on an earlier load, read when
+	  the collision shape is created to skip building the BVH.*/
+	void SetTriangleMesh(const float* vertices, int numVertices, int stride, const int* indices, int numTriangles, 
+						const std::string* cooked = NULL);
+	//the BVH of the triangle mesh, serialized for SetTriangleMesh. false if it was read from cooked data.
+	bool CookTriangleMesh(std::string& cooked);
 
 	uint GetID();
 	std::string GetName();
 	ePhysicsBody BodyType();
 
 	eCollisionShape GetCollisionShape();
+	const float* GetShapeDimensions(); //as passed to SetCollisionShape
+	float GetScale();
+	float GetFriction();
+	float GetDamping();
+	float GetAngularDamping();
+	uint GetContactReport();
+	Vector3 GetForce();
 	Vector3 GetPosition();
 	Matrix3x3 GetTransform();
 	float GetMass();
@@ -43,25 +69,52 @@ public:
 	bool IsInitialized();
 	bool IsDynamic();
 
+	virtual bool IsActive() = 0;
 	virtual	void Finilize() = 0;
 	virtual void CalculateTotalForce() = 0;
 
 protected:
 
-	btCollisionShape* mBulletCollisionShape;
-	btConvexHullShape* mBulletConvexHull;
+	struct TriangleMesh
+	{
+		TriangleMesh() : vertices(NULL), indices(NULL), numVertices(0), stride(0), numTriangles(0), cooked(NULL) {}
+
+		const float* vertices;
+		const int* indices;
+		int numVertices;
+		int stride;
+		int numTriangles;
+		const std::string* cooked; //until the shape is created
+	};
+
+	void CreateCollisionShape();
+	void ReleaseCollisionShape();
+
+	CollisionShapeCachePtr mShapeCache;
+	btCollisionShape* mBulletCollisionShape; //the one the body uses: the shared shape, or its scaled wrapper
+	btCollisionShape* mBulletSharedShape; //from the shape cache
 	btDefaultMotionState* mBulletMotionState;
 	btTransform mBulletTransform;
 	btVector3 mBulletInertia;
 
 	eCollisionShape mCollisionShape;
+	float mShapeDimensions[4]; //as passed to SetCollisionShape
+	std::vector<float> mHullPoints; //mesh vertices (x, y, z), for CS_MESH
+	std::vector<int> mHullTriangles; //mesh indices, for CS_MESH decomposed
+	MeshHullOptions mHullOptions;
+	const std::string* mCookedHull; //until the shape is created
+	TriangleMesh mTriangleMesh; //for CS_TRIANGLE_MESH
+	float mScale;
 	float mMass;
 	float mFriction;
 	float mDamping;
 	float mAngularDamping;
+	uint mContactReport;
 	Vector3 mLocalInertia;
 	Vector3 mPosition;
 	Vector3 mVelocity;
+	Vector3 mForce;
+	btVector3 mFieldForce;
 	Matrix3x3 mTransform;
 
 	bool mIsDynamic;
@@ -77,6 +130,13 @@ inline std::string PhysicsBody::GetName() { return mName; }
 inline ePhysicsBody PhysicsBody::BodyType() { return mBodyType; }
 
 inline eCollisionShape PhysicsBody::GetCollisionShape() { return mCollisionShape; }
+inline const float* PhysicsBody::GetShapeDimensions() { return mShapeDimensions; }
+inline float PhysicsBody::GetScale() { return mScale; }
+inline float PhysicsBody::GetFriction() { return mFriction; }
+inline float PhysicsBody::GetDamping() { return mDamping; }
+inline float PhysicsBody::GetAngularDamping() { return mAngularDamping; }
+inline uint PhysicsBody::GetContactReport() { return mContactReport; }
+inline Vector3 PhysicsBody::GetForce() { return mForce; }
 inline Vector3 PhysicsBody::GetPosition() { return mPosition; }
 inline Matrix3x3 PhysicsBody::GetTransform() { return mTransform; }
 inline float PhysicsBody::GetMass() { return mMass; }
@@ -84,6 +144,9 @@ inline Vector3 PhysicsBody::GetLocalInertia() { return mLocalInertia; }
 inline bool PhysicsBody::IsInitialized() { return mIsInitialized; }
 inline bool PhysicsBody::IsDynamic() { return mIsDynamic; }
 inline bool PhysicsBody::HasMesh() { return mHasMesh; }
+inline void PhysicsBody::SetForce(Vector3 force) { mForce = force; }
+inline void PhysicsBody::SetFieldForce(const btVector3& force) { mFieldForce = force; }
+inline void PhysicsBody::SetContactReport(uint flags) { mContactReport = flags; }
 
 }
 
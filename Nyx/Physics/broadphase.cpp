@@ -0,0 +1,81 @@
+/*
+
+Broadphase
+
+*/
+
+#include "broadphase.h"
+#include "Utils/log_manager.h"
+
+// C4316: object allocated on the heap may not be aligned 16.
+// this waring is generated by the Bullet version 2.82. Nothing can be done, so disable it.
+#pragma warning(disable: 4316)
+
+using namespace std;
+using namespace std::chrono;
+
+namespace NYX {
+
+//the 16 bit axis sweep takes up to 32766 handles, but quantizes the bounds more coarsely: beyond this, 32 bit.
+static const uint AXIS_SWEEP_16_MAX_BODIES = 16384;
+
+BroadphaseProfile::BroadphaseProfile() :
+	bInStep(false),
+	mTime(0),
+	mPairs(0)
+{
+
+}
+
+uint BroadphaseProfile::TakeTime()
+{
+	return mTime.exchange(0);
+}
+
+uint BroadphaseProfile::GetPairCount()
+{
+	return mPairs.load();
+}
+
+void BroadphaseProfile::BeginStep()
+{
+	if (!bInStep.exchange(true))
+		mStepStart = steady_clock::now();
+}
+
+void BroadphaseProfile::EndStep(uint numPairs)
+{
+	mTime += (uint)duration_cast<microseconds>(steady_clock::now() - mStepStart).count();
+	mPairs = numPairs;
+	bInStep = false;
+}
+
+btBroadphaseInterface* CreateBroadphase(const BroadphaseOptions& options, BroadphaseProfile*& profile)
+{
+	Vector3 bounds[2] = { options.worldMin, options.worldMax };
+	btVector3 worldMin(bounds[0].X(), bounds[0].Y(), bounds[0].Z());
+	btVector3 worldMax(bounds[1].X(), bounds[1].Y(), bounds[1].Z());
+
+	if (options.type == BP_AXIS_SWEEP && (worldMax.x() <= worldMin.x() || worldMax.y() <= worldMin.y() || worldMax.z() <= worldMin.z()))
+	{
+		LogManager::GetInstance()->LogMessage("Error! The world bounds of the axis sweep broadphase are empty: using the dynamic AABB tree.");
+	}
+	else if (options.type == BP_AXIS_SWEEP && options.maxBodies <= AXIS_SWEEP_16_MAX_BODIES)
+	{
+		ProfiledBroadphase<btAxisSweep3>* broadphase = new ProfiledBroadphase<btAxisSweep3>(worldMin, worldMax, (unsigned short)options.maxBodies);
+		profile = broadphase;
+		return broadphase;
+	}
+	else if (options.type == BP_AXIS_SWEEP)
+	{
+		ProfiledBroadphase<bt32BitAxisSweep3>* broadphase = new ProfiledBroadphase<bt32BitAxisSweep3>(worldMin, worldMax, (unsigned int)options.maxBodies);
+		profile = broadphase;
+		return broadphase;
+	}
+
+	ProfiledBroadphase<btDbvtBroadphase>* broadphase = new ProfiledBroadphase<btDbvtBroadphase>();
+	profile = broadphase;
+	return broadphase;
+}
+
+}
@@ -0,0 +1,75 @@
+#ifndef BROADPHASE_H
+#define BROADPHASE_H
+
+/*
+
+Broadphase
+
+*/
+
+#include "iphysics_engine.h"
+#include "btBulletDynamicsCommon.h"
+
+#include <atomic>
+#include <chrono>
+
+namespace NYX {
+
+/*
+What the broadphase costs at every step: from the first bounding box update of the step (the world updates them
+all before it looks for pairs) to the end of the pair search. The narrowphase that follows is not included.
+*/
+class BroadphaseProfile
+{
+public:
+
+	BroadphaseProfile();
+	virtual ~BroadphaseProfile() {}
+
+	//microseconds spent since the last call.
+	uint TakeTime();
+	uint GetPairCount(); //overlapping pairs found by the latest step
+
+protected:
+
+	void BeginStep();
+	void EndStep(uint numPairs);
+
+private:
+
+	std::atomic<bool> bInStep; //between the first update and the pair search: Bullet may update the boxes in parallel
+	std::chrono::steady_clock::time_point mStepStart;
+	std::atomic<uint> mTime;
+	std::atomic<uint> mPairs;
+};
+
+//any Bullet broadphase, profiled.
+template <class Broadphase>
+class ProfiledBroadphase : public Broadphase, public BroadphaseProfile
+{
+public:
+
+	template <typename... Args>
+	ProfiledBroadphase(Args... args) : Broadphase(args...) {}
+
+	void setAabb(btBroadphaseProxy* proxy, const btVector3& aabbMin, const btVector3& aabbMax, btDispatcher* dispatcher)
+	{
+		BeginStep();
+		Broadphase::setAabb(proxy, aabbMin, aabbMax, dispatcher);
+	}
+
+	void calculateOverlappingPairs(btDispatcher* dispatcher)
+	{
+		//no box may have been updated at all.
+		BeginStep();
+		Broadphase::calculateOverlappingPairs(dispatcher);
+		EndStep((uint)this->getOverlappingPairCache()->getNumOverlappingPairs());
+	}
+};
+
+//the broadphase options asks for. profile is the same object.
+btBroadphaseInterface* CreateBroadphase(const BroadphaseOptions& options, BroadphaseProfile*& profile);
+
+}
+
+#endif // BROADPHASE_H
@@ -0,0 +1,86 @@
+/*
+
+Bullet Task Scheduler
+
+*/
+
+#include "bullet_task_scheduler.h"
+
+#include <mutex>
+
+namespace NYX {
+
+#if BT_THREADSAFE
+
+struct ParallelSumContext
+{
+    const btIParallelSumBody* body;
+    std::mutex mutex;
+    btScalar sum;
+};
+
+static void ParallelForRange(void* context, int begin, int end)
+{
+    static_cast<const btIParallelForBody*>(context)->forLoop(begin, end);
+}
+
+static void ParallelSumRange(void* context, int begin, int end)
+{
+    ParallelSumContext* sumContext = static_cast<ParallelSumContext*>(context);
+    btScalar partial = sumContext->body->sumLoop(begin, end);
+
+    std::lock_guard<std::mutex> lock(sumContext->mutex);
+    sumContext->sum += partial;
+}
+
+BulletTaskScheduler::BulletTaskScheduler(TaskScheduler* scheduler) :
+    btITaskScheduler("Nyx"),
+    mScheduler(scheduler)
+{
+
+}
+
+BulletTaskScheduler::~BulletTaskScheduler()
+{
+    mScheduler = NULL;
+}
+
+int BulletTaskScheduler::getMaxNumThreads() const
+{
+    int maxThreads = (int)mScheduler->GetMaxThreadCount();
+    return maxThreads < BT_MAX_THREAD_COUNT ? maxThreads : BT_MAX_THREAD_COUNT;
+}
+
+int BulletTaskScheduler::getNumThreads() const
+{
+    return (int)mScheduler->GetThreadCount();
+}
+
+void BulletTaskScheduler::setNumThreads(int numThreads)
+{
+    //Bullet keeps per-thread data for at most BT_MAX_THREAD_COUNT threads.
+    if (numThreads > BT_MAX_THREAD_COUNT)
+        numThreads = BT_MAX_THREAD_COUNT;
+
+    mScheduler->SetThreadCount(numThreads > 0 ? (uint)numThreads : 1);
+}
+
+void BulletTaskScheduler::parallelFor(int iBegin, int iEnd, int grainSize, const btIParallelForBody& body)
+{
+    mScheduler->ParallelFor(iBegin, iEnd, grainSize, ParallelForRange, const_cast<btIParallelForBody*>(&body));
+}
+
+btScalar BulletTaskScheduler::parallelSum(int iBegin, int iEnd, int grainSize, const btIParallelSumBody& body)
+{
+    ParallelSumContext context;
+    context.body = &body;
+    context.sum = btScalar(0);
+
+    mScheduler->ParallelFor(iBegin, iEnd, grainSize, ParallelSumRange, &context);
+
+    return context.sum;
+}
+
+#endif // BT_THREADSAFE
+
+}
@@ -0,0 +1,45 @@
+#ifndef BULLETTASKSCHEDULER_H
+#define BULLETTASKSCHEDULER_H
+
+/*
+ 
+ Bullet Task Scheduler
+ 
+ */
+
+#include "Utils/task_scheduler.h"
+
+#include "LinearMath/btThreads.h"
+
+namespace NYX {
+
+#if BT_THREADSAFE
+
+/*
+Runs Bullet's parallel loops (collision dispatch, island solving, integration) on the engine's
+TaskScheduler, so that physics and the rest of the engine share one pool of worker threads instead of
+each bringing its own. Bullet must be built with BT_THREADSAFE=1 for its multithreaded world to be safe.
+*/
+class BulletTaskScheduler : public btITaskScheduler
+{
+public:
+
+    BulletTaskScheduler(TaskScheduler* scheduler);
+    virtual ~BulletTaskScheduler();
+
+    virtual int getMaxNumThreads() const;
+    virtual int getNumThreads() const;
+    virtual void setNumThreads(int numThreads);
+    virtual void parallelFor(int iBegin, int iEnd, int grainSize, const btIParallelForBody& body);
+    virtual btScalar parallelSum(int iBegin, int iEnd, int grainSize, const btIParallelSumBody& body);
+
+private:
+
+    TaskScheduler* mScheduler;
+};
+
+#endif // BT_THREADSAFE
+
+}
+
+#endif // BULLETTASKSCHEDULER_H
@@ -0,0 +1,662 @@
+/*
+
+Collision Shape Cache
+
+*/
+
+#include "collision_shape_cache.h"
+#include "Utils/hash.h"
+#include "Utils/log_manager.h"
+
+#include <cstring>
+
+// C4316: object allocated on the heap may not be aligned 16.
+// this waring is generated by the Bullet version 2.82. Nothing can be done, so disable it.
+#pragma warning(disable: 4316)
+
+using namespace std;
+
+namespace NYX {
+
+static const char COOKED_MESH_MAGIC[4] = { 'N', 'Y', 'X', 'B' };
+static const uint COOKED_MESH_VERSION = 1;
+static const char COOKED_HULL_MAGIC[4] = { 'N', 'Y', 'X', 'H' };
+static const uint COOKED_HULL_VERSION = 1;
+
+//hulls are told apart by their options and points (and triangles, when decomposed), which follow.
+struct HullKey
+{
+	int hull;
+	uint maxVertices;
+	uint maxParts;
+	float margin;
+	int numPoints;
+	int numTriangles;
+};
+
+//triangle meshes are told apart by the data they point to, which is not copied.
+struct TriangleMeshKey
+{
+	const float* vertices;
+	const int* indices;
+	int numVertices;
+	int stride;
+	int numTriangles;
+};
+
+//what a cooked BVH is checked against before being used. The BVH follows, serialized by Bullet.
+struct CookedMeshHeader
+{
+	char magic[4];
+	uint version;
+	uint numVertices;
+	uint numTriangles;
+	uint geometryHash; //positions and indices
+	float aabbMin[3];
+	float aabbMax[3];
+	uint bvhSize;
+};
+
+//what cooked hulls are checked against. Each hull follows: its number of vertices, then x, y, z for each.
+struct CookedHullHeader
+{
+	char magic[4];
+	uint version;
+	HullKey key;
+	uint contentHash; //the key, points and triangles as the cache has them
+	uint numHulls;
+};
+
+CollisionShapeCache::CollisionShapeCache() :
+	mUsers(0),
+	mMemory(0)
+{
+
+}
+
+CollisionShapeCache::~CollisionShapeCache()
+{
+	for (ShapeIterator it = mShapes.begin(); it != mShapes.end(); ++it)
+		DeleteShape(*it);
+}
+
+void CollisionShapeCache::DeleteShape(CachedShape& cached)
+{
+	//a cooked BVH is not owned by its shape, nor are the hulls of a compound.
+	delete cached.shape;
+
+	for (size_t i = 0; i < cached.children.size(); i++)
+		delete cached.children[i];
+
+	delete cached.meshInterface;
+
+	if (cached.bvhBuffer != NULL)
+		btAlignedFree(cached.bvhBuffer);
+}
+
+btCollisionShape* CollisionShapeCache::Acquire(eCollisionShape collisionShape, const float* dim)
+{
+	uint size;
+
+	switch (collisionShape)
+	{
+	case CS_PLANE:
+		size = 4; //normal, constant
+		break;
+	case CS_BOX:
+		size = 3; //half extents
+		break;
+	case CS_SPHERE:
+		size = 1; //radius
+		break;
+	default:
+		LogManager::GetInstance()->LogMessage("Error! Mesh collision shapes are acquired from their vertices!");
+		return NULL;
+	}
+
+	size *= sizeof(float);
+
+	uint hash = GenerateHash(dim, size, (uint)collisionShape);
+
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	btCollisionShape* shape = Find(collisionShape, dim, size, hash);
+
+	if (shape != NULL)
+		return shape;
+
+	uint memory;
+
+	switch (collisionShape)
+	{
+	case CS_PLANE:
+		shape = new btStaticPlaneShape(btVector3(dim[0], dim[1], dim[2]), dim[3]);
+		memory = sizeof(btStaticPlaneShape);
+		break;
+	case CS_BOX:
+		shape = new btBoxShape(btVector3(dim[0], dim[1], dim[2]));
+		memory = sizeof(btBoxShape);
+		break;
+	default:
+		shape = new btSphereShape(dim[0]);
+		memory = sizeof(btSphereShape);
+		break;
+	}
+
+	Insert(collisionShape, dim, size, hash, shape, memory);
+
+	return shape;
+}
+
+btCollisionShape* CollisionShapeCache::BuildHullShape(const std::vector<HullPoints>& hulls, bool compound, float margin, uint& memory, 
+													 std::vector<btCollisionShape*>& children)
+{
+	btCompoundShape* compoundShape = compound ? new btCompoundShape() : NULL;
+	btCollisionShape* shape = compoundShape;
+
+	btTransform identity;
+	identity.setIdentity();
+
+	memory = compound ? sizeof(btCompoundShape) : 0;
+
+	for (size_t i = 0; i < hulls.size(); i++)
+	{
+		btConvexHullShape* hull = new btConvexHullShape();
+
+		for (int v = 0; v < hulls[i].size(); v++)
+			hull->addPoint(hulls[i][v], false);
+
+		hull->recalcLocalAabb();
+		hull->setMargin(margin);
+		memory += sizeof(btConvexHullShape) + hulls[i].size()*sizeof(btVector3);
+
+		//the hulls are where the mesh is: no offset.
+		if (compoundShape != NULL)
+		{
+			compoundShape->addChildShape(identity, hull);
+			children.push_back(hull);
+		}
+		else
+		{
+			shape = hull;
+		}
+	}
+
+	return shape;
+}
+
+//the hulls in cooked, if they were made for this key and content.
+static bool LoadCookedHulls(const std::string& cooked, const HullKey& key, uint contentHash, std::vector<HullPoints>& hulls)
+{
+	CookedHullHeader header;
+
+	if (cooked.size() < sizeof(header))
+		return false;
+
+	memcpy(&header, &cooked[0], sizeof(header));
+
+	if (memcmp(header.magic, COOKED_HULL_MAGIC, sizeof(header.magic)) != 0 || header.version != COOKED_HULL_VERSION ||
+		memcmp(&header.key, &key, sizeof(key)) != 0 || header.contentHash != contentHash || header.numHulls == 0)
+		return false;
+
+	size_t offset = sizeof(header);
+	hulls.resize(header.numHulls);
+
+	for (uint i = 0; i < header.numHulls; i++)
+	{
+		uint numVertices;
+
+		if (cooked.size() < offset + sizeof(numVertices))
+			return false;
+
+		memcpy(&numVertices, &cooked[offset], sizeof(numVertices));
+		offset += sizeof(numVertices);
+
+		if (numVertices == 0 || (cooked.size() - offset)/(3*sizeof(float)) < numVertices)
+			return false;
+
+		hulls[i].resize(numVertices);
+
+		for (uint v = 0; v < numVertices; v++, offset += 3*sizeof(float))
+		{
+			float vertex[3];
+			memcpy(vertex, &cooked[offset], sizeof(vertex));
+			hulls[i][v].setValue(vertex[0], vertex[1], vertex[2]);
+		}
+	}
+
+	return offset == cooked.size();
+}
+
+btCollisionShape* CollisionShapeCache::AcquireHull(const float* points, int numPoints, const int* indices, int numTriangles,
+												   const MeshHullOptions& options, const std::string* cooked)
+{
+	if (numPoints < 1)
+	{
+		LogManager::GetInstance()->LogMessage("Error! A convex hull needs at least one point!");
+		return NULL;
+	}
+
+	eMeshHull hullType = options.hull;
+
+	if (hullType == MH_DECOMPOSED && (indices == NULL || numTriangles < 1))
+	{
+		LogManager::GetInstance()->LogMessage("Error! A mesh can't be decomposed without its triangles: using a reduced hull.");
+		hullType = MH_REDUCED;
+	}
+
+	//only what the hull is built from goes in: equal hulls must have equal keys.
+	HullKey key;
+	memset(&key, 0, sizeof(key));
+	key.hull = (int)hullType;
+	key.numPoints = numPoints;
+
+	if (hullType != MH_FULL)
+	{
+		key.maxVertices = options.maxVertices;
+		key.margin = options.margin;
+	}
+
+	if (hullType == MH_DECOMPOSED)
+	{
+		key.maxParts = options.maxParts;
+		key.numTriangles = numTriangles;
+	}
+
+	uint pointsSize = 3*numPoints*sizeof(float);
+	uint indicesSize = 3*key.numTriangles*sizeof(int);
+
+	std::vector<char> content(sizeof(key) + pointsSize + indicesSize);
+	memcpy(&content[0], &key, sizeof(key));
+	memcpy(&content[sizeof(key)], points, pointsSize);
+
+	if (indicesSize > 0)
+		memcpy(&content[sizeof(key) + pointsSize], indices, indicesSize);
+
+	uint size = (uint)content.size();
+	uint hash = GenerateHash(&content[0], size, (uint)CS_MESH);
+
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	btCollisionShape* shape = Find(CS_MESH, &content[0], size, hash);
+
+	if (shape != NULL)
+		return shape;
+
+	uint memory = 0;
+	std::vector<btCollisionShape*> children;
+	bool fromCooked = false;
+
+	if (hullType != MH_FULL)
+	{
+		std::vector<HullPoints> hulls;
+
+		if (cooked != NULL)
+		{
+			fromCooked = LoadCookedHulls(*cooked, key, hash, hulls);
+
+			if (!fromCooked)
+				LogManager::GetInstance()->LogMessage("The cooked hulls don't match their mesh: building them again.");
+		}
+
+		if (!fromCooked)
+		{
+			std::vector<btVector3> vertices(numPoints);
+
+			for (int i = 0; i < numPoints; i++)
+				vertices[i].setValue(points[3*i], points[3*i + 1], points[3*i + 2]);
+
+			if (hullType == MH_REDUCED)
+			{
+				hulls.resize(1);
+
+				if (!BuildReducedHull(&vertices[0], numPoints, options.maxVertices, options.margin, hulls[0]))
+					hulls.clear();
+			}
+			else
+			{
+				DecomposeMesh(&vertices[0], numPoints, indices, numTriangles, options.maxParts, options.maxVertices, options.margin, hulls);
+			}
+		}
+
+		if (!hulls.empty())
+			shape = BuildHullShape(hulls, hullType == MH_DECOMPOSED, options.margin, memory, children);
+		else
+			LogManager::GetInstance()->LogMessage("Error! The mesh has no volume to build a reduced hull of: using the full hull.");
+	}
+
+	if (shape == NULL)
+	{
+		shape = new btConvexHullShape(points, numPoints, 3*sizeof(float));
+		memory = sizeof(btConvexHullShape) + numPoints*sizeof(btVector3);
+	}
+
+	//the points are kept twice: once in the hull, once to tell it apart from the others.
+	CachedShape& cached = Insert(CS_MESH, &content[0], size, hash, shape, memory + size);
+	cached.children = children;
+	cached.cooked = fromCooked;
+
+	return shape;
+}
+
+bool CollisionShapeCache::CookHull(btCollisionShape* shape, std::string& cooked)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	auto found = mShapesByPointer.find(shape);
+
+	if (found == mShapesByPointer.end() || found->second->type != CS_MESH || found->second->cooked)
+		return false;
+
+	CachedShape& cached = *found->second;
+
+	CookedHullHeader header;
+	memcpy(header.magic, COOKED_HULL_MAGIC, sizeof(header.magic));
+	header.version = COOKED_HULL_VERSION;
+	memcpy(&header.key, &cached.content[0], sizeof(header.key));
+	header.contentHash = GenerateHash(&cached.content[0], (int)cached.content.size(), (uint)CS_MESH);
+
+	//the full hull is quick to build: nothing to cook.
+	if (header.key.hull == MH_FULL)
+		return false;
+
+	std::vector<btConvexHullShape*> hulls;
+
+	if (cached.children.empty())
+	{
+		hulls.push_back(static_cast<btConvexHullShape*>(cached.shape));
+	}
+	else
+	{
+		for (size_t i = 0; i < cached.children.size(); i++)
+			hulls.push_back(static_cast<btConvexHullShape*>(cached.children[i]));
+	}
+
+	header.numHulls = (uint)hulls.size();
+
+	cooked.assign(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	for (size_t i = 0; i < hulls.size(); i++)
+	{
+		uint numVertices = (uint)hulls[i]->getNumPoints();
+		cooked.append(reinterpret_cast<const char*>(&numVertices), sizeof(numVertices));
+
+		for (uint v = 0; v < numVertices; v++)
+		{
+			const btVector3& point = hulls[i]->getUnscaledPoints()[v];
+			float vertex[3] = { point.x(), point.y(), point.z() };
+			cooked.append(reinterpret_cast<const char*>(vertex), sizeof(vertex));
+		}
+	}
+
+	return true;
+}
+
+static uint HashGeometry(const float* vertices, int numVertices, int stride, const int* indices, int numTriangles)
+{
+	uint hash = GenerateHash(indices, 3*numTriangles*sizeof(int), (uint)numVertices);
+	const char* vertex = reinterpret_cast<const char*>(vertices);
+
+	for (int i = 0; i < numVertices; i++, vertex += stride)
+		hash = GenerateHash(vertex, 3*sizeof(float), hash);
+
+	return hash;
+}
+
+//the BVH in cooked, if it was built for this mesh. It is deserialized in place, in buffer.
+static btOptimizedBvh* LoadCookedBvh(const std::string& cooked, const TriangleMeshKey& key, btStridingMeshInterface* meshInterface, void*& buffer)
+{
+	CookedMeshHeader header;
+
+	if (cooked.size() < sizeof(header))
+		return NULL;
+
+	memcpy(&header, &cooked[0], sizeof(header));
+
+	if (memcmp(header.magic, COOKED_MESH_MAGIC, sizeof(header.magic)) != 0 || header.version != COOKED_MESH_VERSION ||
+		header.numVertices != (uint)key.numVertices || header.numTriangles != (uint)key.numTriangles ||
+		header.bvhSize != cooked.size() - sizeof(header))
+		return NULL;
+
+	//much cheaper than building the BVH, and the mesh may have changed since it was cooked.
+	if (header.geometryHash != HashGeometry(key.vertices, key.numVertices, key.stride, key.indices, key.numTriangles))
+		return NULL;
+
+	//or Bullet would go through all the triangles to find it.
+	meshInterface->setPremadeAabb(btVector3(header.aabbMin[0], header.aabbMin[1], header.aabbMin[2]),
+								btVector3(header.aabbMax[0], header.aabbMax[1], header.aabbMax[2]));
+
+	buffer = btAlignedAlloc(header.bvhSize, 16);
+	memcpy(buffer, &cooked[sizeof(header)], header.bvhSize);
+
+	//the cast is the one Bullet's own loaders make: btOptimizedBvh adds nothing to the data of btQuantizedBvh.
+	btOptimizedBvh* bvh = (btOptimizedBvh*)btOptimizedBvh::deSerializeInPlace(buffer, header.bvhSize, false);
+
+	if (bvh == NULL)
+	{
+		btAlignedFree(buffer);
+		buffer = NULL;
+	}
+
+	return bvh;
+}
+
+btBvhTriangleMeshShape* CollisionShapeCache::AcquireTriangleMesh(const float* vertices, int numVertices, int stride, 
+																const int* indices, int numTriangles, const std::string* cooked)
+{
+	if (vertices == NULL || indices == NULL || numVertices < 3 || numTriangles < 1)
+	{
+		LogManager::GetInstance()->LogMessage("Error! A triangle mesh needs vertices and at least one triangle!");
+		return NULL;
+	}
+
+	TriangleMeshKey key;
+	memset(&key, 0, sizeof(key));
+	key.vertices = vertices;
+	key.indices = indices;
+	key.numVertices = numVertices;
+	key.stride = stride;
+	key.numTriangles = numTriangles;
+
+	uint hash = GenerateHash(&key, sizeof(key), (uint)CS_TRIANGLE_MESH);
+
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	btCollisionShape* shape = Find(CS_TRIANGLE_MESH, &key, sizeof(key), hash);
+
+	if (shape != NULL)
+		return static_cast<btBvhTriangleMeshShape*>(shape);
+
+	//Bullet reads the vertices and indices where they are.
+	btIndexedMesh mesh;
+	mesh.m_numTriangles = numTriangles;
+	mesh.m_triangleIndexBase = reinterpret_cast<const unsigned char*>(indices);
+	mesh.m_triangleIndexStride = 3*sizeof(int);
+	mesh.m_numVertices = numVertices;
+	mesh.m_vertexBase = reinterpret_cast<const unsigned char*>(vertices);
+	mesh.m_vertexStride = stride;
+	mesh.m_vertexType = PHY_FLOAT;
+
+	btTriangleIndexVertexArray* meshInterface = new btTriangleIndexVertexArray();
+	meshInterface->addIndexedMesh(mesh, PHY_INTEGER);
+
+	void* bvhBuffer = NULL;
+	btOptimizedBvh* bvh = NULL;
+
+	if (cooked != NULL)
+	{
+		bvh = LoadCookedBvh(*cooked, key, meshInterface, bvhBuffer);
+
+		if (bvh == NULL)
+			LogManager::GetInstance()->LogMessage("The cooked BVH doesn't match its triangle mesh: building it again.");
+	}
+
+	btBvhTriangleMeshShape* triangleMesh;
+
+	if (bvh != NULL)
+	{
+		triangleMesh = new btBvhTriangleMeshShape(meshInterface, true, false);
+		triangleMesh->setOptimizedBvh(bvh);
+	}
+	else
+	{
+		triangleMesh = new btBvhTriangleMeshShape(meshInterface, true);
+	}
+
+	uint memory = sizeof(btBvhTriangleMeshShape) + sizeof(btTriangleIndexVertexArray) + 
+				triangleMesh->getOptimizedBvh()->calculateSerializeBufferSize();
+
+	CachedShape& cached = Insert(CS_TRIANGLE_MESH, &key, sizeof(key), hash, triangleMesh, memory);
+	cached.meshInterface = meshInterface;
+	cached.bvhBuffer = bvhBuffer;
+	cached.cooked = bvh != NULL;
+
+	return triangleMesh;
+}
+
+bool CollisionShapeCache::CookTriangleMesh(btCollisionShape* shape, std::string& cooked)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	auto found = mShapesByPointer.find(shape);
+
+	if (found == mShapesByPointer.end() || found->second->type != CS_TRIANGLE_MESH || found->second->cooked)
+		return false;
+
+	btBvhTriangleMeshShape* triangleMesh = static_cast<btBvhTriangleMeshShape*>(found->second->shape);
+	btOptimizedBvh* bvh = triangleMesh->getOptimizedBvh();
+
+	TriangleMeshKey key;
+	memcpy(&key, &found->second->content[0], sizeof(key));
+
+	CookedMeshHeader header;
+	memcpy(header.magic, COOKED_MESH_MAGIC, sizeof(header.magic));
+	header.version = COOKED_MESH_VERSION;
+	header.numVertices = (uint)key.numVertices;
+	header.numTriangles = (uint)key.numTriangles;
+	header.geometryHash = HashGeometry(key.vertices, key.numVertices, key.stride, key.indices, key.numTriangles);
+
+	for (int i = 0; i < 3; i++)
+	{
+		header.aabbMin[i] = triangleMesh->getLocalAabbMin()[i];
+		header.aabbMax[i] = triangleMesh->getLocalAabbMax()[i];
+	}
+
+	header.bvhSize = bvh->calculateSerializeBufferSize();
+
+	//Bullet serializes to 16 byte aligned memory only.
+	void* buffer = btAlignedAlloc(header.bvhSize, 16);
+	bvh->serializeInPlace(buffer, header.bvhSize, false);
+
+	cooked.resize(sizeof(header) + header.bvhSize);
+	memcpy(&cooked[0], &header, sizeof(header));
+	memcpy(&cooked[sizeof(header)], buffer, header.bvhSize);
+
+	btAlignedFree(buffer);
+
+	return true;
+}
+
+btCollisionShape* CollisionShapeCache::Find(eCollisionShape collisionShape, const void* content, uint size, uint hash)
+{
+	auto range = mShapesByContent.equal_range(hash);
+
+	for (auto it = range.first; it != range.second; ++it)
+	{
+		CachedShape& cached = *it->second;
+
+		if (cached.type == collisionShape && cached.content.size() == size &&
+			memcmp(&cached.content[0], content, size) == 0)
+		{
+			cached.users++;
+			mUsers++;
+			return cached.shape;
+		}
+	}
+
+	return NULL;
+}
+
+CollisionShapeCache::CachedShape& CollisionShapeCache::Insert(eCollisionShape collisionShape, const void* content, uint size, uint hash, btCollisionShape* shape, uint memory)
+{
+	const char* bytes = static_cast<const char*>(content);
+
+	CachedShape cached;
+	cached.type = collisionShape;
+	cached.content.assign(bytes, bytes + size);
+	cached.shape = shape;
+	cached.meshInterface = NULL;
+	cached.bvhBuffer = NULL;
+	cached.cooked = false;
+	cached.users = 1;
+	cached.memory = memory;
+
+	ShapeIterator it = mShapes.insert(mShapes.end(), cached);
+	mShapesByContent.insert(std::make_pair(hash, it));
+	mShapesByPointer[shape] = it;
+
+	mUsers++;
+	mMemory += memory;
+
+	return *it;
+}
+
+void CollisionShapeCache::Release(btCollisionShape* shape)
+{
+	if (shape == NULL)
+		return;
+
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	auto found = mShapesByPointer.find(shape);
+
+	if (found == mShapesByPointer.end())
+	{
+		LogManager::GetInstance()->LogMessage("Error! Released a collision shape that doesn't belong to the shape cache!");
+		return;
+	}
+
+	ShapeIterator it = found->second;
+	mUsers--;
+
+	if (--it->users > 0)
+		return;
+
+	uint hash = GenerateHash(&it->content[0], (int)it->content.size(), (uint)it->type);
+	auto range = mShapesByContent.equal_range(hash);
+
+	for (auto entry = range.first; entry != range.second; ++entry)
+	{
+		if (entry->second == it)
+		{
+			mShapesByContent.erase(entry);
+			break;
+		}
+	}
+
+	mShapesByPointer.erase(found);
+	mMemory -= it->memory;
+
+	DeleteShape(*it);
+	mShapes.erase(it);
+}
+
+uint CollisionShapeCache::GetShapeCount()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return (uint)mShapes.size();
+}
+
+uint CollisionShapeCache::GetUserCount()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mUsers;
+}
+
+uint CollisionShapeCache::GetMemoryUsage()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mMemory;
+}
+
+}
@@ -0,0 +1,95 @@
+#ifndef COLLISIONSHAPECACHE_H
+#define COLLISIONSHAPECACHE_H
+
+/*
+
+Collision Shape Cache
+
+*/
+
+#include "iphysics_engine.h"
+#include "hull_builder.h"
+#include "btBulletDynamicsCommon.h"
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace NYX {
+
+class CollisionShapeCache;
+typedef std::shared_ptr<CollisionShapeCache> CollisionShapeCachePtr;
+
+/*
+A Bullet collision shape is never changed once built, and bodies only point to it: all the bodies with the
+same shape and dimensions can use a single one. The cache hands out shapes by content (type, dimensions or
+hull points and options, or the data of a triangle mesh), counts the bodies using each of them and deletes a shape when 
+the last one releases it.
+Shared shapes must not be modified, setLocalScaling included: see PhysicsBody::SetScale.
+*/
+class CollisionShapeCache
+{
+public:
+
+	CollisionShapeCache();
+	~CollisionShapeCache();
+
+	//dim as for IPhysicsBody::SetCollisionShape. Not for meshes.
+	btCollisionShape* Acquire(eCollisionShape collisionShape, const float* dim);
+	/*hull of numPoints points, 3 floats each, as options tells: a convex shape, or a compound one for MH_DECOMPOSED,
+	  which needs the triangles too (3 indices each). The reduced and decomposed hulls are read from cooked 
+	  (see CookHull) when given and made for the same points and options, otherwise they are built here.*/
+	btCollisionShape* AcquireHull(const float* points, int numPoints, const int* indices = NULL, int numTriangles = 0,
+								  const MeshHullOptions& options = MeshHullOptions(), const std::string* cooked = NULL);
+	//serializes the reduced or decomposed hulls, with what identifies their mesh. false if they came from cooked data.
+	bool CookHull(btCollisionShape* shape, std::string& cooked);
+	/*static triangle mesh over vertex (stride in bytes, position first) and index data that is used in place:
+	  it must outlive the shape. Bodies using the same data share the shape. The BVH is read from cooked 
+	  (see CookTriangleMesh) when given and built for the same mesh, otherwise it is built here.*/
+	btBvhTriangleMeshShape* AcquireTriangleMesh(const float* vertices, int numVertices, int stride, 
+												const int* indices, int numTriangles, const std::string* cooked = NULL);
+	//serializes the BVH of a triangle mesh, with what identifies its mesh. false if it came from cooked data.
+	bool CookTriangleMesh(btCollisionShape* shape, std::string& cooked);
+	void Release(btCollisionShape* shape);
+
+	uint GetShapeCount();
+	uint GetUserCount(); //bodies using the shapes
+	uint GetMemoryUsage(); //bytes: shapes, hull points and BVHs, not the triangle mesh data
+
+private:
+
+	struct CachedShape
+	{
+		eCollisionShape type;
+		std::vector<char> content; //what the shape is built from
+		btCollisionShape* shape;
+		btStridingMeshInterface* meshInterface; //triangle meshes only
+		void* bvhBuffer; //triangle meshes with a cooked BVH, which lives in here
+		std::vector<btCollisionShape*> children; //of a decomposed hull
+		bool cooked; //built from cooked data
+		uint users;
+		uint memory;
+	};
+
+	typedef std::list<CachedShape>::iterator ShapeIterator;
+
+	btCollisionShape* Find(eCollisionShape collisionShape, const void* content, uint size, uint hash);
+	CachedShape& Insert(eCollisionShape collisionShape, const void* content, uint size, uint hash, btCollisionShape* shape, uint memory);
+	static btCollisionShape* BuildHullShape(const std::vector<HullPoints>& hulls, bool compound, float margin, uint& memory, std::vector<btCollisionShape*>& children);
+	static void DeleteShape(CachedShape& cached);
+
+	std::mutex mMutex;
+
+	std::list<CachedShape> mShapes;
+	std::unordered_multimap<uint, ShapeIterator> mShapesByContent; //by content hash
+	std::unordered_map<btCollisionShape*, ShapeIterator> mShapesByPointer;
+
+	uint mUsers;
+	uint mMemory;
+};
+
+}
+
+#endif // COLLISIONSHAPECACHE_H
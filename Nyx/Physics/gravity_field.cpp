@@ -0,0 +1,407 @@
+/*
+
+Gravity Field
+
+*/
+
+#include "gravity_field.h"
+#include "Utils/task_scheduler.h"
+
+#include <cfloat>
+#include <algorithm>
+#include <cmath>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1) || defined(__SSE__)
+#define GRAVITY_SSE 1
+#include <xmmintrin.h>
+#endif
+
+using namespace std;
+
+namespace NYX {
+
+static const uint LEAF_SIZE = 16; //bodies
+static const uint MAX_DEPTH = 24; //below it, bodies (almost) in the same place stay together in a leaf
+static const uint STACK_SIZE = 7*MAX_DEPTH + 8; //nodes still to visit, walking depth first
+static const int GRAIN_SIZE = 4; //leaves per task
+
+GravityField::GravityField() :
+	mConstant(0.0f),
+	mOpeningAngle(0.7f),
+	mSoftening(0.0f),
+	mAccelerations(NULL)
+{
+
+}
+
+void GravityField::SetConstant(float constant)
+{
+	mConstant = constant;
+}
+
+void GravityField::SetOpeningAngle(float angle)
+{
+	mOpeningAngle = angle;
+}
+
+void GravityField::SetSoftening(float softening)
+{
+	mSoftening = softening;
+}
+
+void GravityField::Compute(const float* positions, const float* masses, uint numBodies, float* accelerations)
+{
+	if (numBodies == 0)
+		return;
+
+	float boxMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float boxMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+	for (uint i = 0; i < numBodies; i++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			boxMin[k] = min(boxMin[k], positions[3*i + k]);
+			boxMax[k] = max(boxMax[k], positions[3*i + k]);
+		}
+	}
+
+	Node root;
+	root.halfSize = 0.0f;
+
+	for (int k = 0; k < 3; k++)
+	{
+		root.centre[k] = 0.5f*(boxMin[k] + boxMax[k]);
+		root.halfSize = max(root.halfSize, 0.5f*(boxMax[k] - boxMin[k]));
+	}
+
+	//the bodies on the far sides must still be inside.
+	root.halfSize = root.halfSize*1.001f + FLT_MIN;
+	root.begin = 0;
+	root.end = numBodies;
+	root.firstChild = -1;
+	root.numChildren = 0;
+
+	mNodes.clear();
+	mNodes.push_back(root);
+
+	mOrder.resize(numBodies);
+	mScratch.resize(numBodies);
+
+	for (uint i = 0; i < numBodies; i++)
+		mOrder[i] = i;
+
+	SplitNode(0, positions, 0);
+	SortBodies(positions, masses, numBodies);
+
+	mLeaves.clear();
+
+	for (uint n = 0; n < mNodes.size(); n++)
+	{
+		if (mNodes[n].firstChild < 0)
+			mLeaves.push_back((int)n);
+	}
+
+	mAccelerations = accelerations;
+	TaskScheduler::GetInstance()->ParallelFor(0, (int)mLeaves.size(), GRAIN_SIZE, ComputeRange, this);
+	mAccelerations = NULL;
+}
+
+void GravityField::ComputeDirect(const float* positions, const float* masses, uint numBodies, float* accelerations)
+{
+	if (numBodies == 0)
+		return;
+
+	//a tree of a single leaf: every body pulls every other one.
+	Node root;
+	root.centre[0] = root.centre[1] = root.centre[2] = 0.0f;
+	root.halfSize = FLT_MAX;
+	root.begin = 0;
+	root.end = numBodies;
+	root.firstChild = -1;
+	root.numChildren = 0;
+
+	mNodes.assign(1, root);
+	mOrder.resize(numBodies);
+
+	for (uint i = 0; i < numBodies; i++)
+		mOrder[i] = i;
+
+	SortBodies(positions, masses, numBodies);
+
+	//the bodies are pulled a leaf size at a time, by all the others: these leaves are not in the tree.
+	mLeaves.clear();
+
+	for (uint begin = 0; begin < numBodies; begin += LEAF_SIZE)
+	{
+		root.begin = begin;
+		root.end = min(begin + LEAF_SIZE, numBodies);
+		mLeaves.push_back((int)mNodes.size());
+		mNodes.push_back(root);
+	}
+
+	mAccelerations = accelerations;
+	TaskScheduler::GetInstance()->ParallelFor(0, (int)mLeaves.size(), GRAIN_SIZE, ComputeRange, this);
+	mAccelerations = NULL;
+}
+
+static inline uint Octant(const float* p, const float* centre)
+{
+	return (p[0] >= centre[0] ? 1 : 0) | (p[1] >= centre[1] ? 2 : 0) | (p[2] >= centre[2] ? 4 : 0);
+}
+
+void GravityField::SplitNode(int node, const float* positions, uint depth)
+{
+	Node parent = mNodes[node];
+
+	if (parent.end - parent.begin <= LEAF_SIZE || depth >= MAX_DEPTH)
+		return;
+
+	//counting sort of the bodies into the octants, x in bit 0, y in bit 1, z in bit 2.
+	uint counts[8] = { 0 };
+
+	for (uint i = parent.begin; i < parent.end; i++)
+		counts[Octant(&positions[3*mOrder[i]], parent.centre)]++;
+
+	uint offsets[8];
+	uint offset = parent.begin;
+
+	for (uint octant = 0; octant < 8; octant++)
+	{
+		offsets[octant] = offset;
+		offset += counts[octant];
+	}
+
+	for (uint i = parent.begin; i < parent.end; i++)
+		mScratch[offsets[Octant(&positions[3*mOrder[i]], parent.centre)]++] = mOrder[i];
+
+	std::copy(mScratch.begin() + parent.begin, mScratch.begin() + parent.end, mOrder.begin() + parent.begin);
+
+	int firstChild = (int)mNodes.size();
+	float halfSize = 0.5f*parent.halfSize;
+	uint begin = parent.begin;
+
+	for (uint octant = 0; octant < 8; octant++)
+	{
+		if (counts[octant] == 0)
+			continue;
+
+		Node child;
+		child.centre[0] = parent.centre[0] + (octant & 1 ? halfSize : -halfSize);
+		child.centre[1] = parent.centre[1] + (octant & 2 ? halfSize : -halfSize);
+		child.centre[2] = parent.centre[2] + (octant & 4 ? halfSize : -halfSize);
+		child.halfSize = halfSize;
+		child.begin = begin;
+		child.end = begin + counts[octant];
+		child.firstChild = -1;
+		child.numChildren = 0;
+
+		mNodes.push_back(child);
+		begin = child.end;
+	}
+
+	int numChildren = (int)mNodes.size() - firstChild;
+	mNodes[node].firstChild = firstChild;
+	mNodes[node].numChildren = numChildren;
+
+	for (int i = 0; i < numChildren; i++)
+		SplitNode(firstChild + i, positions, depth + 1);
+}
+
+void GravityField::SortBodies(const float* positions, const float* masses, uint numBodies)
+{
+	mX.resize(numBodies);
+	mY.resize(numBodies);
+	mZ.resize(numBodies);
+	mMass.resize(numBodies);
+
+	for (uint i = 0; i < numBodies; i++)
+	{
+		uint body = mOrder[i];
+		mX[i] = positions[3*body];
+		mY[i] = positions[3*body + 1];
+		mZ[i] = positions[3*body + 2];
+		mMass[i] = masses[body];
+	}
+
+	//children come after their parents: summed from the last node back, each node is done before its parent.
+	for (int n = (int)mNodes.size() - 1; n >= 0; n--)
+	{
+		Node& node = mNodes[n];
+		double mass = 0.0, x = 0.0, y = 0.0, z = 0.0;
+
+		if (node.firstChild < 0)
+		{
+			for (uint i = node.begin; i < node.end; i++)
+			{
+				mass += mMass[i];
+				x += (double)mMass[i]*mX[i];
+				y += (double)mMass[i]*mY[i];
+				z += (double)mMass[i]*mZ[i];
+			}
+		}
+		else
+		{
+			for (int c = node.firstChild; c < node.firstChild + node.numChildren; c++)
+			{
+				const Node& child = mNodes[c];
+				mass += child.mass;
+				x += (double)child.mass*child.massCentre[0];
+				y += (double)child.mass*child.massCentre[1];
+				z += (double)child.mass*child.massCentre[2];
+			}
+		}
+
+		node.mass = (float)mass;
+
+		//no mass, no pull: the centre doesn't matter.
+		double scale = mass > 0.0 ? 1.0/mass : 0.0;
+		node.massCentre[0] = (float)(x*scale);
+		node.massCentre[1] = (float)(y*scale);
+		node.massCentre[2] = (float)(z*scale);
+	}
+}
+
+void GravityField::ComputeRange(void* context, int begin, int end)
+{
+	static_cast<GravityField*>(context)->AccelerateLeaves(begin, end);
+}
+
+void GravityField::AccelerateLeaves(int begin, int end)
+{
+	InteractionList list;
+
+	for (int leaf = begin; leaf < end; leaf++)
+		AccelerateLeaf(mLeaves[leaf], list);
+}
+
+//the pull of the masses [begin, end) of the arrays on a body at p, without G.
+static inline void PullByLeaf(const float* x, const float* y, const float* z, const float* mass, uint begin, uint end,
+							  const float p[3], float softening, float a[3])
+{
+	uint j = begin;
+
+#if GRAVITY_SSE
+	__m128 px = _mm_set1_ps(p[0]);
+	__m128 py = _mm_set1_ps(p[1]);
+	__m128 pz = _mm_set1_ps(p[2]);
+	__m128 soft = _mm_set1_ps(softening);
+	__m128 zero = _mm_setzero_ps();
+	__m128 one = _mm_set1_ps(1.0f);
+	__m128 ax = zero, ay = zero, az = zero;
+
+	for (; j + 4 <= end; j += 4)
+	{
+		__m128 dx = _mm_sub_ps(_mm_loadu_ps(x + j), px);
+		__m128 dy = _mm_sub_ps(_mm_loadu_ps(y + j), py);
+		__m128 dz = _mm_sub_ps(_mm_loadu_ps(z + j), pz);
+		__m128 r2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_add_ps(_mm_mul_ps(dz, dz), soft));
+
+		//the body itself, or one in the same place: no pull.
+		__m128 apart = _mm_cmpgt_ps(r2, zero);
+		__m128 inv = _mm_div_ps(one, _mm_sqrt_ps(r2));
+		__m128 f = _mm_and_ps(apart, _mm_mul_ps(_mm_loadu_ps(mass + j), _mm_mul_ps(inv, _mm_mul_ps(inv, inv))));
+
+		ax = _mm_add_ps(ax, _mm_mul_ps(dx, f));
+		ay = _mm_add_ps(ay, _mm_mul_ps(dy, f));
+		az = _mm_add_ps(az, _mm_mul_ps(dz, f));
+	}
+
+	float sum[4];
+	_mm_storeu_ps(sum, ax);
+	a[0] += (sum[0] + sum[1]) + (sum[2] + sum[3]);
+	_mm_storeu_ps(sum, ay);
+	a[1] += (sum[0] + sum[1]) + (sum[2] + sum[3]);
+	_mm_storeu_ps(sum, az);
+	a[2] += (sum[0] + sum[1]) + (sum[2] + sum[3]);
+#endif
+
+	for (; j < end; j++)
+	{
+		float dx = x[j] - p[0], dy = y[j] - p[1], dz = z[j] - p[2];
+		float r2 = dx*dx + dy*dy + dz*dz + softening;
+
+		if (r2 > 0.0f)
+		{
+			float inv = 1.0f / sqrtf(r2);
+			float f = mass[j]*inv*inv*inv;
+			a[0] += dx*f;
+			a[1] += dy*f;
+			a[2] += dz*f;
+		}
+	}
+}
+
+void GravityField::AccelerateLeaf(int leaf, InteractionList& list)
+{
+	const Node& target = mNodes[leaf];
+	float angle2 = mOpeningAngle*mOpeningAngle;
+
+	list.x.clear();
+	list.y.clear();
+	list.z.clear();
+	list.mass.clear();
+
+	//the walk is the same for all the bodies of the leaf: the masses that pull them are gathered once.
+	int stack[STACK_SIZE];
+	uint top = 0;
+	stack[top++] = 0;
+
+	while (top > 0)
+	{
+		const Node& node = mNodes[stack[--top]];
+
+		if (node.firstChild < 0)
+		{
+			list.x.insert(list.x.end(), mX.begin() + node.begin, mX.begin() + node.end);
+			list.y.insert(list.y.end(), mY.begin() + node.begin, mY.begin() + node.end);
+			list.z.insert(list.z.end(), mZ.begin() + node.begin, mZ.begin() + node.end);
+			list.mass.insert(list.mass.end(), mMass.begin() + node.begin, mMass.begin() + node.end);
+			continue;
+		}
+
+		//from the centre of mass to the nearest point of the leaf: the distance to its nearest body, at most.
+		float d2 = 0.0f;
+
+		for (int k = 0; k < 3; k++)
+		{
+			float d = fabsf(node.massCentre[k] - target.centre[k]) - target.halfSize;
+
+			if (d > 0.0f)
+				d2 += d*d;
+		}
+
+		float size = 2.0f*node.halfSize;
+
+		//a node with the leaf inside has d2 = 0: always opened.
+		if (size*size < angle2*d2)
+		{
+			list.x.push_back(node.massCentre[0]);
+			list.y.push_back(node.massCentre[1]);
+			list.z.push_back(node.massCentre[2]);
+			list.mass.push_back(node.mass);
+		}
+		else
+		{
+			for (int c = node.firstChild; c < node.firstChild + node.numChildren; c++)
+				stack[top++] = c;
+		}
+	}
+
+	uint count = (uint)list.mass.size();
+
+	for (uint slot = target.begin; slot < target.end; slot++)
+	{
+		float p[3] = { mX[slot], mY[slot], mZ[slot] };
+		float a[3] = { 0.0f, 0.0f, 0.0f };
+
+		PullByLeaf(&list.x[0], &list.y[0], &list.z[0], &list.mass[0], 0, count, p, mSoftening, a);
+
+		float* acceleration = &mAccelerations[3*mOrder[slot]];
+		acceleration[0] = mConstant*a[0];
+		acceleration[1] = mConstant*a[1];
+		acceleration[2] = mConstant*a[2];
+	}
+}
+
+}
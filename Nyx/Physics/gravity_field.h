@@ -0,0 +1,95 @@
+#ifndef GRAVITYFIELD_H
+#define GRAVITYFIELD_H
+
+/*
+
+Gravity Field
+
+*/
+
+#include <vector>
+
+namespace NYX {
+
+/*
+Mutual gravitational attraction of a set of bodies, with the Barnes-Hut method: the bodies are sorted
+into an octree, and a node far enough from a body pulls it as a single mass at its centre of mass.
+Building the tree and walking it for every body is O(N log N) instead of the O(N^2) of the direct sum.
+The tree is walked once per leaf rather than once per body, gathering the masses that pull all the bodies 
+of the leaf: the nodes far enough from it, and the bodies of the leaves that aren't. Each body of the leaf 
+then goes through that list 4 masses at a time. The leaves are spread over the TaskScheduler threads.
+*/
+class GravityField
+{
+public:
+
+	GravityField();
+
+	//G, in the units of the world. 0, the default, turns the field off.
+	void SetConstant(float constant);
+	/*a node pulls the bodies of a leaf as a whole when its size is below angle times its distance from the
+	  leaf (not from the body: 0.7 is about as accurate as the usual 0.5). 0 is the direct sum. default 0.7*/
+	void SetOpeningAngle(float angle);
+	//added to every distance (squared), so that close encounters don't fling the bodies apart. default 0
+	void SetSoftening(float softening);
+
+	/*accelerations of numBodies bodies, each pulled by all the others. positions and accelerations are x, y, z
+	  per body. A body with no mass is pulled but doesn't pull.*/
+	void Compute(const float* positions, const float* masses, uint numBodies, float* accelerations);
+	//the same by direct summation, to measure the error of Compute against.
+	void ComputeDirect(const float* positions, const float* masses, uint numBodies, float* accelerations);
+
+	float GetConstant();
+	bool IsEnabled();
+	uint GetNodeCount(); //of the last tree built
+
+private:
+
+	struct Node
+	{
+		float centre[3]; //of the cube
+		float halfSize;
+		float massCentre[3];
+		float mass;
+		uint begin; //bodies, in the sorted arrays
+		uint end;
+		int firstChild; //children are consecutive, -1 for a leaf
+		int numChildren;
+	};
+
+	//copies the bodies into the sorted arrays, in the order of mOrder, and sums the mass of every node.
+	void SortBodies(const float* positions, const float* masses, uint numBodies);
+	//sorts the bodies of a node into its octants, then does the same with each of them.
+	void SplitNode(int node, const float* positions, uint depth);
+	//the masses pulling the bodies of a leaf, one array per component.
+	struct InteractionList
+	{
+		std::vector<float> x, y, z, mass;
+	};
+
+	void AccelerateLeaves(int begin, int end);
+	void AccelerateLeaf(int leaf, InteractionList& list);
+
+	static void ComputeRange(void* context, int begin, int end);
+
+	float mConstant;
+	float mOpeningAngle;
+	float mSoftening;
+
+	std::vector<Node> mNodes;
+	std::vector<int> mLeaves; //the nodes whose bodies are pulled, all the leaves of the tree
+	std::vector<uint> mOrder; //body of each sorted slot
+	std::vector<uint> mScratch; //for sorting
+	//the bodies sorted by node, one array per component: a leaf is a contiguous range.
+	std::vector<float> mX, mY, mZ, mMass;
+
+	float* mAccelerations; //while computing
+};
+
+inline float GravityField::GetConstant() { return mConstant; }
+inline bool GravityField::IsEnabled() { return mConstant != 0.0f; }
+inline uint GravityField::GetNodeCount() { return (uint)mNodes.size(); }
+
+}
+
+#endif // GRAVITYFIELD_H
@@ -0,0 +1,321 @@
+/*
+
+Hull Builder
+
+*/
+
+#include "hull_builder.h"
+#include "LinearMath/btConvexHull.h"
+#include "LinearMath/btGeometryUtil.h"
+
+#include <cfloat>
+
+using namespace std;
+
+namespace NYX {
+
+//a part is split while it is more concave than this fraction of the size of the whole mesh.
+static const float DECOMPOSITION_CONCAVITY = 0.02f;
+//the hull a part's concavity is measured against: a bit smaller than the true one, and much quicker to build.
+static const uint CONCAVITY_HULL_VERTICES = 128;
+//hull vertices closer than this (squared) are the same vertex.
+static const float HULL_WELD_DISTANCE2 = 1e-10f;
+
+//outward face planes (normal, distance in w) of the hull from Bullet's hull library. Coplanar faces give one plane.
+static void GetHullPlanes(const HullResult& result, HullPoints& planes)
+{
+	btVector3 centre(0.f, 0.f, 0.f);
+
+	for (uint i = 0; i < result.mNumOutputVertices; i++)
+		centre += result.m_OutputVertices[i];
+
+	centre /= (btScalar)result.mNumOutputVertices;
+
+	for (uint face = 0; face < result.mNumFaces; face++)
+	{
+		const btVector3& a = result.m_OutputVertices[result.m_Indices[3*face]];
+		const btVector3& b = result.m_OutputVertices[result.m_Indices[3*face + 1]];
+		const btVector3& c = result.m_OutputVertices[result.m_Indices[3*face + 2]];
+
+		btVector3 normal = (b - a).cross(c - a);
+
+		if (normal.length2() < FLT_EPSILON)
+			continue;
+
+		normal.normalize();
+
+		//whatever the winding Bullet used.
+		if (normal.dot(centre - a) > 0.f)
+			normal *= -1.f;
+
+		normal[3] = -normal.dot(a);
+
+		bool known = false;
+
+		for (int i = 0; i < planes.size() && !known; i++)
+			known = planes[i].dot(normal) > 0.9999f && btFabs(planes[i][3] - normal[3]) < 1e-4f;
+
+		if (!known)
+			planes.push_back(normal);
+	}
+}
+
+static bool ComputeHull(const btVector3* points, int numPoints, uint maxVertices, HullResult& result)
+{
+	if (numPoints < 4)
+		return false;
+
+	HullDesc desc(QF_TRIANGLES, (uint)numPoints, points);
+	desc.mMaxVertices = maxVertices;
+
+	HullLibrary library;
+	return library.CreateConvexHull(desc, result) == QE_OK && result.mNumFaces > 0;
+}
+
+bool BuildReducedHull(const btVector3* points, int numPoints, uint maxVertices, float margin, HullPoints& hull)
+{
+	HullLibrary library;
+	HullResult result;
+
+	hull.clear();
+
+	if (!ComputeHull(points, numPoints, maxVertices, result))
+	{
+		library.ReleaseResult(result);
+		return false;
+	}
+
+	if (margin > 0.f)
+	{
+		HullPoints planes;
+		GetHullPlanes(result, planes);
+
+		for (int i = 0; i < planes.size(); i++)
+			planes[i][3] += margin;
+
+		HullPoints shrunk;
+		btGeometryUtil::getVerticesFromPlaneEquations(planes, shrunk);
+
+		//corners where more than 3 faces meet come out more than once.
+		for (int i = 0; i < shrunk.size(); i++)
+		{
+			bool known = false;
+
+			for (int j = 0; j < hull.size() && !known; j++)
+				known = hull[j].distance2(shrunk[i]) < HULL_WELD_DISTANCE2;
+
+			if (!known)
+				hull.push_back(shrunk[i]);
+		}
+
+		//a corner cut by the shrinking can leave more vertices than it had: back under the cap.
+		if ((uint)hull.size() > maxVertices)
+		{
+			HullResult capped;
+
+			if (ComputeHull(&hull[0], hull.size(), maxVertices, capped))
+			{
+				hull.clear();
+
+				for (uint i = 0; i < capped.mNumOutputVertices; i++)
+					hull.push_back(capped.m_OutputVertices[i]);
+			}
+
+			library.ReleaseResult(capped);
+		}
+	}
+
+	//thinner than twice the margin: better a hull a bit too large than none.
+	if (hull.size() < 4)
+	{
+		hull.clear();
+
+		for (uint i = 0; i < result.mNumOutputVertices; i++)
+			hull.push_back(result.m_OutputVertices[i]);
+	}
+
+	library.ReleaseResult(result);
+
+	return true;
+}
+
+struct MeshPart
+{
+	std::vector<int> triangles;
+	float concavity;
+};
+
+//the vertices used by the triangles of a part, once each. mark is as long as the vertices, and all -1 or older parts.
+static void GatherPartPoints(const btVector3* vertices, const int* indices, const MeshPart& part, int partId,
+							 std::vector<int>& mark, std::vector<btVector3>& points)
+{
+	points.clear();
+
+	for (size_t t = 0; t < part.triangles.size(); t++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			int index = indices[3*part.triangles[t] + k];
+
+			if (mark[index] != partId)
+			{
+				mark[index] = partId;
+				points.push_back(vertices[index]);
+			}
+		}
+	}
+}
+
+//how deep the part goes inside its own hull: at its vertices and at the centres of its triangles.
+static float MeasureConcavity(const btVector3* vertices, const int* indices, const MeshPart& part, const std::vector<btVector3>& points)
+{
+	HullLibrary library;
+	HullResult result;
+
+	//flat: as convex as it gets.
+	if (!ComputeHull(&points[0], (int)points.size(), CONCAVITY_HULL_VERTICES, result))
+	{
+		library.ReleaseResult(result);
+		return 0.f;
+	}
+
+	HullPoints planes;
+	GetHullPlanes(result, planes);
+	library.ReleaseResult(result);
+
+	float concavity = 0.f;
+	size_t numPoints = points.size();
+
+	for (size_t i = 0; i < numPoints + part.triangles.size(); i++)
+	{
+		btVector3 point;
+
+		if (i < numPoints)
+		{
+			point = points[i];
+		}
+		else
+		{
+			const int* triangle = &indices[3*part.triangles[i - numPoints]];
+			point = (vertices[triangle[0]] + vertices[triangle[1]] + vertices[triangle[2]]) / 3.f;
+		}
+
+		//distance to the nearest face.
+		float depth = FLT_MAX;
+
+		for (int p = 0; p < planes.size(); p++)
+			depth = btMin(depth, -(planes[p].dot(point) + planes[p][3]));
+
+		concavity = btMax(concavity, depth);
+	}
+
+	return concavity;
+}
+
+//at the middle of the longest side of the box around the centres of its triangles. false if they are all in the same place.
+static bool SplitPart(const btVector3* vertices, const int* indices, const MeshPart& part, MeshPart& first, MeshPart& second)
+{
+	std::vector<btVector3> centres(part.triangles.size());
+	btVector3 boxMin(FLT_MAX, FLT_MAX, FLT_MAX);
+	btVector3 boxMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+	for (size_t t = 0; t < part.triangles.size(); t++)
+	{
+		const int* triangle = &indices[3*part.triangles[t]];
+		centres[t] = (vertices[triangle[0]] + vertices[triangle[1]] + vertices[triangle[2]]) / 3.f;
+		boxMin.setMin(centres[t]);
+		boxMax.setMax(centres[t]);
+	}
+
+	btVector3 extent = boxMax - boxMin;
+	int axis = extent[0] > extent[1] ? (extent[0] > extent[2] ? 0 : 2) : (extent[1] > extent[2] ? 1 : 2);
+
+	if (extent[axis] <= FLT_EPSILON)
+		return false;
+
+	float middle = 0.5f*(boxMin[axis] + boxMax[axis]);
+
+	for (size_t t = 0; t < part.triangles.size(); t++)
+	{
+		if (centres[t][axis] < middle)
+			first.triangles.push_back(part.triangles[t]);
+		else
+			second.triangles.push_back(part.triangles[t]);
+	}
+
+	return !first.triangles.empty() && !second.triangles.empty();
+}
+
+void DecomposeMesh(const btVector3* vertices, int numVertices, const int* indices, int numTriangles,
+				   uint maxParts, uint maxVertices, float margin, std::vector<HullPoints>& hulls)
+{
+	hulls.clear();
+
+	if (numVertices < 4 || numTriangles < 1 || maxParts < 1)
+		return;
+
+	btVector3 meshMin(FLT_MAX, FLT_MAX, FLT_MAX);
+	btVector3 meshMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+	for (int i = 0; i < numVertices; i++)
+	{
+		meshMin.setMin(vertices[i]);
+		meshMax.setMax(vertices[i]);
+	}
+
+	float tolerance = DECOMPOSITION_CONCAVITY * meshMax.distance(meshMin);
+
+	std::vector<MeshPart> parts(1);
+	std::vector<int> mark(numVertices, -1);
+	std::vector<btVector3> points;
+	int partId = 0;
+
+	for (int t = 0; t < numTriangles; t++)
+		parts[0].triangles.push_back(t);
+
+	GatherPartPoints(vertices, indices, parts[0], partId++, mark, points);
+	parts[0].concavity = MeasureConcavity(vertices, indices, parts[0], points);
+
+	while (parts.size() < maxParts)
+	{
+		size_t worst = 0;
+
+		for (size_t i = 1; i < parts.size(); i++)
+		{
+			if (parts[i].concavity > parts[worst].concavity)
+				worst = i;
+		}
+
+		if (parts[worst].concavity <= tolerance)
+			break;
+
+		MeshPart first, second;
+
+		if (!SplitPart(vertices, indices, parts[worst], first, second))
+		{
+			//can't be split any further: leave it as it is.
+			parts[worst].concavity = 0.f;
+			continue;
+		}
+
+		GatherPartPoints(vertices, indices, first, partId++, mark, points);
+		first.concavity = MeasureConcavity(vertices, indices, first, points);
+		GatherPartPoints(vertices, indices, second, partId++, mark, points);
+		second.concavity = MeasureConcavity(vertices, indices, second, points);
+
+		parts[worst] = first;
+		parts.push_back(second);
+	}
+
+	for (size_t i = 0; i < parts.size(); i++)
+	{
+		HullPoints hull;
+		GatherPartPoints(vertices, indices, parts[i], partId++, mark, points);
+
+		//flat parts are covered by the hulls around them.
+		if (BuildReducedHull(&points[0], (int)points.size(), maxVertices, margin, hull))
+			hulls.push_back(hull);
+	}
+}
+
+}
@@ -0,0 +1,36 @@
+#ifndef HULLBUILDER_H
+#define HULLBUILDER_H
+
+/*
+
+Hull Builder
+
+*/
+
+#include "btBulletDynamicsCommon.h"
+
+#include <vector>
+
+namespace NYX {
+
+typedef btAlignedObjectArray<btVector3> HullPoints;
+
+/*
+Preprocessing of the meshes of dynamic bodies, for CollisionShapeCache::AcquireHull. It is slow enough
+to be cooked along with the model (see CollisionShapeCache::CookHull), and is run only when nothing was.
+*/
+
+/*convex hull of the points with at most maxVertices vertices (Bullet keeps the ones furthest out).
+  Its faces are then pulled in by margin: Bullet pushes the hull out by its collision margin, and the
+  shape ends up where the mesh is. false if the points have no volume.*/
+bool BuildReducedHull(const btVector3* points, int numPoints, uint maxVertices, float margin, HullPoints& hull);
+
+/*approximate convex decomposition of a concave mesh: the triangles are split along the longest side
+  of the most concave part until every part is close to convex or there are maxParts of them.
+  A part is as concave as the deepest of its triangles inside its hull. Each part becomes a reduced hull.*/
+void DecomposeMesh(const btVector3* vertices, int numVertices, const int* indices, int numTriangles,
+				   uint maxParts, uint maxVertices, float margin, std::vector<HullPoints>& hulls);
+
+}
+
+#endif // HULLBUILDER_H
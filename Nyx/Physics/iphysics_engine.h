@@ -27,7 +27,8 @@ typedef std::shared_ptr< IPhysicsEngine > PhysicsEnginePtr;
 enum ePhysicsWorld
 {
     PHYS_RIGID_ONLY,
-    PHYS_RIGID_AND_SOFT
+    PHYS_RIGID_AND_SOFT,
+    PHYS_RIGID_MT //rigid bodies only, collisions and solver spread over the TaskScheduler threads
 };
     
 enum ePhysicsBody
@@ -42,11 +43,135 @@ enum eCollisionShape
     CS_PLANE, //static objects only
     CS_BOX,
     CS_SPHERE,
-    CS_MESH
+    CS_MESH, //convex hull of the mesh vertices
+    CS_TRIANGLE_MESH //static objects only: level geometry, see PhysicsBody::SetTriangleMesh
+};
+
+//what a CS_MESH body collides as
+enum eMeshHull
+{
+    MH_FULL, //the hull of every vertex
+    MH_REDUCED, //a hull of a few vertices, shrunk by the collision margin
+    MH_DECOMPOSED //a compound of reduced hulls around the convex parts of the mesh: for concave meshes
+};
+
+//which contacts of a body the engine reports, see IPhysicsBody::SetContactReport. A pair is reported
+//when either body asks for its phase.
+enum eContactReport
+{
+	CR_NONE = 0,
+	CR_BEGIN = 0x1,
+	CR_PERSIST = 0x2,
+	CR_END = 0x4,
+	CR_ALL = CR_BEGIN | CR_PERSIST | CR_END
+};
+
+struct MeshHullOptions
+{
+	MeshHullOptions() :
+		hull(MH_FULL),
+		maxVertices(32),
+		maxParts(16),
+		margin(0.04f)
+	{}
+
+	eMeshHull hull;
+	uint maxVertices; //of each hull but the full one
+	uint maxParts; //MH_DECOMPOSED only
+	float margin; //Bullet's collision margin, outside the reduced hulls
+};
+
+//how the world finds the pairs of bodies whose bounding boxes overlap
+enum eBroadphase
+{
+	BP_DBVT, //dynamic AABB trees: no bounds, good for most worlds and for huge sparse ones
+	BP_AXIS_SWEEP //sweep and prune within fixed world bounds: for dense worlds where most bodies move little
+};
+
+struct BroadphaseOptions
+{
+	BroadphaseOptions() :
+		type(BP_DBVT),
+		worldMin(-1000.0f, -1000.0f, -1000.0f),
+		worldMax(1000.0f, 1000.0f, 1000.0f),
+		maxBodies(16384)
+	{}
+
+	eBroadphase type;
+	Vector3 worldMin; //axis sweep only: bodies outside the bounds are clamped to them, and collide poorly
+	Vector3 worldMax;
+	uint maxBodies; //axis sweep only: allocated up front. Beyond 16384, the 32 bit version is used
+};
+
+//what a PhysicsQuery looks for
+enum ePhysicsQuery
+{
+	QRY_RAY, //the first body on the segment from-to
+	QRY_SWEEP, //the first body hit by a sphere moving from-to
+	QRY_OVERLAP //the bodies touching a sphere centred on from
+};
+
+struct PhysicsQuery
+{
+	PhysicsQuery() : type(QRY_RAY), radius(0.0f) {}
+
+	ePhysicsQuery type;
+	Vector3 from;
+	Vector3 to; //rays and sweeps
+	float radius; //sweeps and overlaps
+};
+
+//one per query, in world coordinates.
+struct PhysicsQueryResult
+{
+	PhysicsQueryResult() : bHit(false), bodyID(0), numBodies(0), fraction(1.0f) {}
+
+	bool bHit;
+	uint bodyID; //the first body hit, or for overlaps the one furthest into the sphere
+	uint numBodies; //overlaps: how many bodies touch the sphere. 1 for a ray or sweep that hit
+	float fraction; //of the way from-to where the hit is. 0 for overlaps
+	Vector3 point; //on the surface of the body
+	Vector3 normal; //of that surface, towards the ray, the sweep or the centre of the overlap
 };
     
 // physics subsystem
 
+//profiling counters, refreshed by every IPhysicsEngine::Update (body counts and broadphase by StepSimulation too). times are in ms.
+struct PhysicsStats
+{
+	PhysicsStats() :
+		steps(0),
+		stepTime(0.0f),
+		mainThreadTime(0.0f),
+		overlapTime(0.0f),
+		broadphaseTime(0.0f),
+		droppedSnapshots(0),
+		activeBodies(0),
+		sleepingBodies(0),
+		publishedBodies(0),
+		collisionShapes(0),
+		collisionShapeUsers(0),
+		collisionShapeMemory(0),
+		reportedContacts(0),
+		broadphasePairs(0)
+	{}
+
+	uint steps; //simulation steps taken since the previous Update
+	float stepTime; //time spent stepping the world since the previous Update, on whichever thread
+	float mainThreadTime; //time the main thread spent inside Update
+	float overlapTime; //part of stepTime the physics thread ran while the main thread was outside Update, on the rest of its frame
+	float broadphaseTime; //part of stepTime spent updating the bounding boxes and finding the overlapping pairs
+	uint droppedSnapshots; //total body state snapshots replaced before the scene could read them
+	uint activeBodies; //dynamic bodies Bullet is simulating, in the latest snapshot
+	uint sleepingBodies; //dynamic bodies Bullet has deactivated
+	uint publishedBodies; //ObjectMovedEvents sent by the last Update or StepSimulation
+	uint collisionShapes; //shared by the bodies created with IPhysicsEngine::CreateBody
+	uint collisionShapeUsers; //bodies using them
+	uint collisionShapeMemory; //bytes
+	uint reportedContacts; //in the ContactsEvent sent by the last Update or StepSimulation
+	uint broadphasePairs; //overlapping bounding boxes found by the latest step
+};
+
 class NYX_EXPORT IPhysicsBody
 {
 public:
@@ -57,11 +182,19 @@ public:
 	virtual ePhysicsBody BodyType() = 0;
 
 	virtual void SetCollisionShape(eCollisionShape collisionShape, void* dim) = 0;
+	//uniform scale of the collision shape (not of planes), before Finilize.
+	virtual void SetScale(float scale) = 0;
 	virtual void SetMassAndInertia(float mass, Vector3 localInertia) = 0;
 	virtual void SetInitialState(Vector3 origin, Matrix3x3 transform) = 0; //origin and initial transform
 	virtual void SetVelocity(Vector3 velocity) = 0;
+	//constant force (world coordinates) applied at every step, until changed.
+	virtual void SetForce(Vector3 force) = 0;
 	virtual void SetFriction(float friction) = 0;
 	virtual void SetDamping(float damping, float angDamping) = 0;
+	/*eContactReport flags, before Finilize: the contacts of the body go out at every step in a single ContactsEvent 
+	  with those of all the other bodies. Bodies without flags (the default) cost nothing. Rigid bodies only: 
+	  Bullet keeps no contact manifolds for soft bodies.*/
+	virtual void SetContactReport(uint flags) = 0;
 	
 	virtual void Finilize() = 0;
 	virtual eCollisionShape GetCollisionShape() = 0;
@@ -71,6 +204,8 @@ public:
 	virtual Vector3 GetLocalInertia() = 0;
 	virtual bool IsInitialized() = 0;
 	virtual bool IsDynamic() = 0;
+	//false once Bullet has put the body (and its island) to sleep.
+	virtual bool IsActive() = 0;
 
 	virtual void CalculateTotalForce() = 0;
 };
@@ -88,6 +223,9 @@ public:
     virtual ~IPhysicsEngine() {}
 
 	virtual void InitPhysics(ePhysicsWorld ePhysics) = 0;
+	/*the broadphase of the world (DBVT by default). Before InitPhysics or before any body is added, and not
+	  while threaded: the bodies would have to be moved to the new one.*/
+	virtual void SetBroadphase(const BroadphaseOptions& options) = 0;
 
     /*Gravity is the only global force that is "visible" to the entire world, and is applied to every object.
 	  Every other force is applied per-object.
@@ -95,13 +233,68 @@ public:
 	  to "smuggle" other forces in by passing the total sum of all forces instead of just gravity. In this way,
 	  the total force will be applied to all objects.
 	  Note also that this works well only for a "flat" world, i.e. shooters, rpgs. For space sims, the gravity must
-	  be calculated and applied per object along with all other forces. 
+	  be calculated and applied per object along with all other forces: see SetGravityField.
 	*/
     virtual void SetGravity(Vector3 gravity) = 0;
+	/*mutual attraction of the dynamic rigid bodies, by their mass, added to their forces before every step
+	  (see GravityField). constant is G in the units of the world: 0, the default, turns it off. openingAngle
+	  trades accuracy for speed: 0 is the exact, O(N^2), sum.*/
+	virtual void SetGravityField(float constant, float openingAngle) = 0;
 
+	/*bodies created here share their collision shapes with every other body of the engine with the same 
+	  shape and dimensions (see CollisionShapeCache): use it for large numbers of similar bodies.*/
+	virtual PhysicsBodyPtr CreateBody(ePhysicsBody bodyType, std::string name, uint id) = 0;
 	virtual void AddBody(PhysicsBodyPtr body) = 0;
 
+	//simulation step (seconds), and the maximum number of steps a single Update can take to catch up
+	//with the frame time. Any time beyond that is dropped: the simulation slows down instead.
+	virtual void SetFixedTimeStep(float timeStep, uint maxSteps) = 0;
+	/*advances the simulation by frameTime (seconds, time elapsed since the last call) in fixed steps.
+	  Returns how far the simulation clock is between the state before and after the last step, in [0, 1),
+	  which the scene uses to interpolate the body transforms it renders (see ObjectMovedEvent).*/
+	virtual float Update(float frameTime) = 0;
+	//a single step of timeStep seconds. not available while the simulation runs on its own thread.
 	virtual void StepSimulation(float timeStep) = 0;
+
+	/*runs the simulation on a dedicated thread, at the fixed time step, rather than inside Update.
+	  Update then only picks up the latest body states, so the frame time becomes the longest of 
+	  rendering and physics instead of their sum. While threaded, AddBody, SetGravity, SetFixedTimeStep
+	  and the body commands below are queued and carried out by the physics thread before its next step.*/
+	virtual void SetThreaded(bool threaded) = 0;
+	virtual bool IsThreaded() = 0;
+	/*keeps the world simulating while its scene is off screen: the PhysicsWorldPool steps it every 1/rate s, in
+	  parallel with the other worlds and the main thread, and Update is not called. Nothing is published meanwhile
+	  (the scene on screen would get the body states) and the contacts are dropped. Brought back, the world sends
+	  the state of every dynamic body at once: the scene is up to date without stepping to catch up. Commands are
+	  queued in the background, as while threaded. A threaded world keeps running on its own thread anyway.*/
+	virtual void SetBackground(bool background, float rate) = 0;
+
+	//commands for bodies already added to the world, by id.
+	virtual void SetBodyVelocity(uint bodyID, Vector3 velocity) = 0;
+	virtual void SetBodyForce(uint bodyID, Vector3 force) = 0;
+
+	/*A body is published (see ObjectMovedEvent) only when its position or any row of its rotation has 
+	  changed by more than epsilon since its last publication, followed by one last event with no motion 
+	  when it comes to rest. Sleeping bodies are not even looked at. A negative epsilon publishes every 
+	  dynamic body at every step.*/
+	virtual void SetMotionEpsilon(float epsilon) = 0;
+
+	/*a batch of queries against the bodies in the world, spread over the TaskScheduler threads: one result per
+	  query, in the same order. Batch them: each call waits for the world to be between steps while threaded, and
+	  the world waits for the batch. Bodies whose AddBody is still queued are not in the world yet.*/
+	virtual void RunQueries(const PhysicsQuery* queries, uint numQueries, PhysicsQueryResult* results) = 0;
+
+	/*binary snapshot of the rigid bodies in the world: what each is made of (shape, mass, friction...) and its state
+	  (transform, velocities, activation) as Bullet serializes it. Soft bodies and bodies whose AddBody is still
+	  queued are not in it. It is only good for the same build: keep it as cooked data, not as an asset.*/
+	virtual void SaveWorld(std::string& snapshot) = 0;
+	/*puts the bodies of a snapshot back in one go. A body already in the world with the same id and name gets its
+	  saved state back (a rollback), any other is created and added, sharing its shape as with CreateBody (a fast load).
+	  Mesh bodies can't be created from the snapshot: add them first. Bodies that are not in the snapshot are left as
+	  they are. false if the data is not a snapshot from this build. Queued like AddBody while threaded.*/
+	virtual bool RestoreWorld(const std::string& snapshot) = 0;
+
+	virtual const PhysicsStats& GetStats() = 0;
 };
 
 };
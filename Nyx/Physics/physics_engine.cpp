@@ -5,22 +5,121 @@ Physics Engine, based on Bullet
 */
 
 #include "physics_engine.h"
+#include "physics_world_pool.h"
 #include "Utils/log_manager.h"
 #include "Events/event_manager.h"
 
+#include "BulletCollision/CollisionShapes/btTriangleShape.h"
+#include "BulletCollision/NarrowPhaseCollision/btGjkPairDetector.h"
+#include "BulletCollision/NarrowPhaseCollision/btGjkEpaPenetrationDepthSolver.h"
+#include "BulletCollision/NarrowPhaseCollision/btPointCollector.h"
+#include "BulletCollision/NarrowPhaseCollision/btVoronoiSimplexSolver.h"
+#include "LinearMath/btSerializer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <unordered_map>
+
 using namespace std;
+using namespace std::chrono;
 
 namespace NYX {
 
+//queries per task: a ray costs a few microseconds.
+static const int QUERY_GRAIN_SIZE = 64;
+
+//the steps a background world may take at once to keep up with the real time: beyond, it slows down.
+static const uint BACKGROUND_MAX_STEPS = 2;
+
+static const char WORLD_SNAPSHOT_MAGIC[4] = { 'N', 'Y', 'X', 'W' };
+static const uint WORLD_SNAPSHOT_VERSION = 1;
+
+#if BT_THREADSAFE
+//Bullet has one task scheduler for the whole process: the PHYS_RIGID_MT worlds share it, and the last one to go uninstalls it.
+static std::mutex sBulletSchedulerMutex;
+static BulletTaskScheduler* sBulletScheduler = NULL;
+static uint sBulletSchedulerUsers = 0;
+
+static BulletTaskScheduler* AcquireBulletScheduler()
+{
+	std::lock_guard<std::mutex> lock(sBulletSchedulerMutex);
+
+	if (sBulletSchedulerUsers++ == 0)
+	{
+		sBulletScheduler = new BulletTaskScheduler(TaskScheduler::GetInstance());
+		btSetTaskScheduler(sBulletScheduler);
+	}
+
+	return sBulletScheduler;
+}
+
+static void ReleaseBulletScheduler()
+{
+	std::lock_guard<std::mutex> lock(sBulletSchedulerMutex);
+
+	if (--sBulletSchedulerUsers > 0)
+		return;
+
+	//someone else may have installed a scheduler of their own since: leave it.
+	if (btGetTaskScheduler() == sBulletScheduler)
+		btSetTaskScheduler(btGetSequentialTaskScheduler());
+
+	delete sBulletScheduler;
+	sBulletScheduler = NULL;
+}
+#endif
+
+//what a world snapshot is checked against before it is queued. Its bodies follow.
+struct WorldSnapshotHeader
+{
+	char magic[4];
+	uint version;
+	uint stateSize; //sizeof(btRigidBodyData): tells single and double precision builds of Bullet apart
+	uint numBodies;
+};
+
+//what a body in a world snapshot is made of. Its name follows, then its state as Bullet serializes it.
+struct SnapshotBody
+{
+	uint id;
+	uint nameLength;
+	int collisionShape;
+	float dimensions[4];
+	float scale;
+	float mass;
+	float localInertia[3];
+	float friction;
+	float damping;
+	float angularDamping;
+	uint contactReport;
+	float force[3];
+};
+
 DefaultPhysicsEngine::DefaultPhysicsEngine() :
+	mShapeCache(new CollisionShapeCache()),
 	mBulletCollisionConfig(NULL),
 	mBulletCollisionDispatcher(NULL),
 	mBulletBroadphase(NULL),
+	mBroadphaseProfile(NULL),
 	mBulletConstraintSolver(NULL),
+	mBulletConstraintSolverMt(NULL),
+	mBulletTaskScheduler(NULL),
 	mBulletDynamicsWorld(NULL),
 	mBulletSoftBodySolver(NULL),
 	mBulletCollisionFunc(NULL),
-	mMaxSubSteps(10)
+	mFixedTimeStep(1.0f/60.0f, 5),
+	mMotionEpsilon(1e-4f),
+	mReportingBodies(0),
+	mFrontSnapshot(0),
+	mBackSnapshot(1),
+	mReadySnapshot(2),
+	bThreadRunning(false),
+	bThreaded(false),
+	bBackground(false),
+	mThreadSteps(0),
+	mThreadStepTime(0),
+	mDroppedSnapshots(0)
 {
     
 
@@ -28,6 +127,12 @@ DefaultPhysicsEngine::DefaultPhysicsEngine() :
 
 DefaultPhysicsEngine::~DefaultPhysicsEngine()
 {
+	//the world can't go while the physics thread or the pool are using it.
+	SetThreaded(false);
+
+	if (bBackground)
+		PhysicsWorldPool::GetInstance()->RemoveWorld(this);
+
 	//delete bullet rigid bodies, our rigid bodies will be deleted with their list.
     for (int i = mBulletDynamicsWorld->getNumCollisionObjects()-1; i>=0; i--)
 	{
@@ -45,6 +150,7 @@ DefaultPhysicsEngine::~DefaultPhysicsEngine()
 	delete mBulletDynamicsWorld;
 	//delete solver
 	delete mBulletConstraintSolver;
+	delete mBulletConstraintSolverMt;
 	//delete broadphase
 	delete mBulletBroadphase;
 	//delete dispatcher
@@ -57,6 +163,10 @@ DefaultPhysicsEngine::~DefaultPhysicsEngine()
 		delete mBulletSoftBodySolver;
 		delete mBulletCollisionFunc;
 	}
+#if BT_THREADSAFE
+	if (mBulletTaskScheduler != NULL)
+		ReleaseBulletScheduler();
+#endif
 }
 
 void DefaultPhysicsEngine::InitPhysics(ePhysicsWorld ePhysics)
@@ -68,8 +178,8 @@ void DefaultPhysicsEngine::InitPhysics(ePhysicsWorld ePhysics)
 	case PHYS_RIGID_ONLY:
 		mBulletCollisionConfig = new btDefaultCollisionConfiguration();
 		mBulletCollisionDispatcher = new btCollisionDispatcher(mBulletCollisionConfig);
-		mBulletBroadphase = new btDbvtBroadphase();
-		//the default constraint solver. No multithreading.
+		mBulletBroadphase = CreateBroadphase(mBroadphaseOptions, mBroadphaseProfile);
+		//the default constraint solver. No multithreading (see PHYS_RIGID_MT).
 		mBulletConstraintSolver = new btSequentialImpulseConstraintSolver();
 
 		mBulletDynamicsWorld = new btDiscreteDynamicsWorld(mBulletCollisionDispatcher,
@@ -81,7 +191,7 @@ void DefaultPhysicsEngine::InitPhysics(ePhysicsWorld ePhysics)
 		mBulletCollisionConfig = new btSoftBodyRigidBodyCollisionConfiguration();
 		mBulletCollisionDispatcher = new btCollisionDispatcher(mBulletCollisionConfig);
 		mBulletSoftWorldInfo.m_dispatcher = mBulletCollisionDispatcher;
-		mBulletBroadphase = new btDbvtBroadphase();
+		mBulletBroadphase = CreateBroadphase(mBroadphaseOptions, mBroadphaseProfile);
 		mBulletSoftWorldInfo.m_broadphase = mBulletBroadphase;
 		mBulletConstraintSolver = new btSequentialImpulseConstraintSolver();
 		mBulletSoftBodySolver = new btDefaultSoftBodySolver();
@@ -91,15 +201,83 @@ void DefaultPhysicsEngine::InitPhysics(ePhysicsWorld ePhysics)
 															mBulletCollisionConfig,
 															mBulletSoftBodySolver);
 		break;
+	case PHYS_RIGID_MT:
+#if BT_THREADSAFE
+		{
+			//Bullet's worker threads are the engine's: see BulletTaskScheduler.
+			mBulletTaskScheduler = AcquireBulletScheduler();
+
+			//every thread draws contact manifolds and algorithms from the same pools: make room for large scenes.
+			btDefaultCollisionConstructionInfo collisionInfo;
+			collisionInfo.m_defaultMaxPersistentManifoldPoolSize = 80000;
+			collisionInfo.m_defaultMaxCollisionAlgorithmPoolSize = 80000;
+
+			mBulletCollisionConfig = new btDefaultCollisionConfiguration(collisionInfo);
+			mBulletCollisionDispatcher = new btCollisionDispatcherMt(mBulletCollisionConfig, 40);
+			mBulletBroadphase = CreateBroadphase(mBroadphaseOptions, mBroadphaseProfile);
+			//one solver per thread, each working on different islands.
+			mBulletConstraintSolver = new btConstraintSolverPoolMt(BT_MAX_THREAD_COUNT);
+			mBulletConstraintSolverMt = new btSequentialImpulseConstraintSolverMt();
+
+			mBulletDynamicsWorld = new btDiscreteDynamicsWorldMt(mBulletCollisionDispatcher,
+																mBulletBroadphase,
+																static_cast<btConstraintSolverPoolMt*>(mBulletConstraintSolver),
+																mBulletConstraintSolverMt,
+																mBulletCollisionConfig);
+		}
+#else
+		LogManager::GetInstance()->LogMessage("Bullet was built without BT_THREADSAFE: using the single threaded rigid body world.");
+		InitPhysics(PHYS_RIGID_ONLY);
+#endif
+		break;
 	default:
 		break;
 	}
 }
 
+void DefaultPhysicsEngine::SetBroadphase(const BroadphaseOptions& options)
+{
+	if (bThreaded || !mBodyList.empty())
+	{
+		LogManager::GetInstance()->LogMessage("Error! The broadphase can only be changed before any body is added, and not while physics runs on its own thread.");
+		return;
+	}
+
+	mBroadphaseOptions = options;
+
+	//not initialized yet: InitPhysics creates it.
+	if (mBulletDynamicsWorld == NULL)
+		return;
+
+	btBroadphaseInterface* broadphase = CreateBroadphase(mBroadphaseOptions, mBroadphaseProfile);
+	mBulletDynamicsWorld->setBroadphase(broadphase);
+	if (mWorldType == PHYS_RIGID_AND_SOFT)
+		mBulletSoftWorldInfo.m_broadphase = broadphase;
+
+	delete mBulletBroadphase;
+	mBulletBroadphase = broadphase;
+}
+
 void DefaultPhysicsEngine::SetGravity(Vector3 gravity)
 {
-	btVector3 bulletGravity(gravity.X(), gravity.Y(), gravity.Z());
-	mBulletDynamicsWorld->setGravity(bulletGravity);
+	PhysicsCommand command;
+	command.type = PHYS_CMD_SET_GRAVITY;
+	command.vector = gravity;
+	SubmitCommand(command);
+}
+
+PhysicsBodyPtr DefaultPhysicsEngine::CreateBody(ePhysicsBody bodyType, std::string name, uint id)
+{
+	switch (bodyType)
+	{
+	case BDY_RIGID:
+		return PhysicsBodyPtr(new RigidBody(name, id, mShapeCache));
+	case BDY_SOFT:
+		//soft bodies collide with their own nodes: they have no shape to share.
+		return PhysicsBodyPtr(new SoftBody(name, id, mBulletSoftWorldInfo));
+	default:
+		return PhysicsBodyPtr();
+	}
 }
 
 void DefaultPhysicsEngine::AddBody(PhysicsBodyPtr body)
@@ -109,26 +287,367 @@ void DefaultPhysicsEngine::AddBody(PhysicsBodyPtr body)
 		LogManager::GetInstance()->LogMessage("Error! RigidBody was not initialized properly!");
 		return;
 	}
-	
-	mBodyList.push_back(body);
 
-	switch (body->BodyType())
+	PhysicsCommand command;
+	command.type = PHYS_CMD_ADD_BODY;
+	command.body = body;
+	SubmitCommand(command);
+}
+
+void DefaultPhysicsEngine::SetBodyVelocity(uint bodyID, Vector3 velocity)
+{
+	PhysicsCommand command;
+	command.type = PHYS_CMD_SET_VELOCITY;
+	command.bodyID = bodyID;
+	command.vector = velocity;
+	SubmitCommand(command);
+}
+
+void DefaultPhysicsEngine::SetBodyForce(uint bodyID, Vector3 force)
+{
+	PhysicsCommand command;
+	command.type = PHYS_CMD_SET_FORCE;
+	command.bodyID = bodyID;
+	command.vector = force;
+	SubmitCommand(command);
+}
+
+void DefaultPhysicsEngine::SubmitCommand(PhysicsCommand& command)
+{
+	if (bThreaded || bBackground)
 	{
-	case BDY_RIGID:
-		AddRigidBody(body);
+		std::lock_guard<std::mutex> lock(mCommandMutex);
+		mCommands.push_back(command);
+	}
+	else
+	{
+		ExecuteCommand(command);
+	}
+}
+
+void DefaultPhysicsEngine::ExecuteQueuedCommands()
+{
+	{
+		std::lock_guard<std::mutex> lock(mCommandMutex);
+		mExecutingCommands.swap(mCommands);
+	}
+
+	for (uint i = 0; i < mExecutingCommands.size(); i++)
+		ExecuteCommand(mExecutingCommands[i]);
+
+	mExecutingCommands.clear();
+}
+
+void DefaultPhysicsEngine::ExecuteCommand(PhysicsCommand& command)
+{
+	switch (command.type)
+	{
+	case PHYS_CMD_ADD_BODY:
+		//the axis sweep allocates its handles up front, and has no room for more.
+		if (mBroadphaseOptions.type == BP_AXIS_SWEEP && (uint)mBulletDynamicsWorld->getNumCollisionObjects() >= mBroadphaseOptions.maxBodies)
+		{
+			LogManager::GetInstance()->LogMessage("Error! The broadphase is full: body " + command.body->GetName() + " was not added. Raise its max bodies.");
+			break;
+		}
+
+		mBodyList.push_back(command.body);
+
+		switch (command.body->BodyType())
+		{
+		case BDY_RIGID:
+			AddRigidBody(command.body);
+			break;
+		case BDY_SOFT:
+			AddSoftBody(command.body);
+			break;
+		default:
+			break;
+		}
 		break;
-	case BDY_SOFT:
-		AddSoftBody(body);
+	case PHYS_CMD_SET_GRAVITY:
+		mBulletDynamicsWorld->setGravity(btVector3(command.vector.X(), command.vector.Y(), command.vector.Z()));
+		break;
+	case PHYS_CMD_SET_GRAVITY_FIELD:
+		mGravityField.SetConstant(command.gravityConstant);
+		mGravityField.SetOpeningAngle(command.openingAngle);
+
+		//the forces of the last step would stay on.
+		if (!mGravityField.IsEnabled())
+		{
+			for (uint i = 0; i < mBodyList.size(); i++)
+				dynamic_cast<PhysicsBody*>(mBodyList[i].get())->SetFieldForce(btVector3(0.f, 0.f, 0.f));
+		}
+		break;
+	case PHYS_CMD_SET_TIME_STEP:
+		mFixedTimeStep.Configure(command.timeStep, command.maxSteps);
+		break;
+	case PHYS_CMD_SET_VELOCITY:
+		{
+			PhysicsBody* body = FindBody(command.bodyID);
+
+			if (body == NULL)
+				break;
+
+			btVector3 velocity(command.vector.X(), command.vector.Y(), command.vector.Z());
+			body->SetVelocity(command.vector);
+
+			if (body->BodyType() == BDY_RIGID)
+			{
+				btRigidBody* rigidBody = dynamic_cast<RigidBody*>(body)->GetBulletRigidBody();
+				rigidBody->setLinearVelocity(velocity);
+				rigidBody->activate();
+			}
+			else
+			{
+				dynamic_cast<SoftBody*>(body)->GetBulletSoftBody()->setVelocity(velocity);
+			}
+		}
+		break;
+	case PHYS_CMD_SET_FORCE:
+		{
+			PhysicsBody* body = FindBody(command.bodyID);
+
+			if (body != NULL)
+				body->SetForce(command.vector);
+		}
+		break;
+	case PHYS_CMD_SET_MOTION_EPSILON:
+		mMotionEpsilon = command.epsilon;
+		break;
+	case PHYS_CMD_RESTORE_WORLD:
+		ApplyWorldSnapshot(*command.snapshot);
 		break;
 	default:
 		break;
 	}
 }
 
+PhysicsBody* DefaultPhysicsEngine::FindBody(uint bodyID)
+{
+	for (uint i = 0; i < mBodyList.size(); i++)
+		if (mBodyList[i]->GetID() == bodyID)
+			return dynamic_cast<PhysicsBody*>(mBodyList[i].get());
+
+	return NULL;
+}
+
+void DefaultPhysicsEngine::SaveWorld(std::string& snapshot)
+{
+	//the physics thread changes the bodies and the world only while it holds it.
+	std::lock_guard<std::mutex> lock(mWorldMutex);
+
+	WorldSnapshotHeader header;
+	memcpy(header.magic, WORLD_SNAPSHOT_MAGIC, sizeof(header.magic));
+	header.version = WORLD_SNAPSHOT_VERSION;
+	header.stateSize = sizeof(btRigidBodyData);
+	header.numBodies = 0;
+
+	snapshot.assign(reinterpret_cast<const char*>(&header), sizeof(header));
+	snapshot.reserve(sizeof(header) + mBodyList.size()*(sizeof(SnapshotBody) + sizeof(btRigidBodyData) + 16));
+
+	//only for the pointers Bullet writes along with the state, which are not read back.
+	btDefaultSerializer serializer;
+	btRigidBodyData state;
+
+	for (uint i = 0; i < mBodyList.size(); i++)
+	{
+		if (mBodyList[i]->BodyType() != BDY_RIGID)
+			continue;
+
+		RigidBody* body = dynamic_cast<RigidBody*>(mBodyList[i].get());
+		std::string name = body->GetName();
+		Vector3 inertia = body->GetLocalInertia();
+		Vector3 force = body->GetForce();
+
+		SnapshotBody record;
+		record.id = body->GetID();
+		record.nameLength = (uint)name.size();
+		record.collisionShape = (int)body->GetCollisionShape();
+		memcpy(record.dimensions, body->GetShapeDimensions(), sizeof(record.dimensions));
+		record.scale = body->GetScale();
+		record.mass = body->GetMass();
+		record.localInertia[0] = inertia.X();
+		record.localInertia[1] = inertia.Y();
+		record.localInertia[2] = inertia.Z();
+		record.friction = body->GetFriction();
+		record.damping = body->GetDamping();
+		record.angularDamping = body->GetAngularDamping();
+		record.contactReport = body->GetContactReport();
+		record.force[0] = force.X();
+		record.force[1] = force.Y();
+		record.force[2] = force.Z();
+
+		body->GetBulletRigidBody()->serialize(&state, &serializer);
+
+		snapshot.append(reinterpret_cast<const char*>(&record), sizeof(record));
+		snapshot.append(name);
+		snapshot.append(reinterpret_cast<const char*>(&state), sizeof(state));
+		header.numBodies++;
+	}
+
+	memcpy(&snapshot[0], &header, sizeof(header));
+}
+
+bool DefaultPhysicsEngine::RestoreWorld(const std::string& snapshot)
+{
+	WorldSnapshotHeader header;
+
+	if (snapshot.size() >= sizeof(header))
+		memcpy(&header, &snapshot[0], sizeof(header));
+
+	if (snapshot.size() < sizeof(header) || memcmp(header.magic, WORLD_SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 ||
+		header.version != WORLD_SNAPSHOT_VERSION || header.stateSize != sizeof(btRigidBodyData))
+	{
+		LogManager::GetInstance()->LogMessage("Error! Not a world snapshot, or not from this build: nothing was restored.");
+		return false;
+	}
+
+	PhysicsCommand command;
+	command.type = PHYS_CMD_RESTORE_WORLD;
+	command.snapshot.reset(new std::string(snapshot));
+	SubmitCommand(command);
+
+	return true;
+}
+
+void DefaultPhysicsEngine::ApplyWorldSnapshot(const std::string& snapshot)
+{
+	WorldSnapshotHeader header;
+	memcpy(&header, &snapshot[0], sizeof(header));
+
+	//a body of the snapshot is the body of the world with its id and name, whatever its place in the list.
+	std::unordered_multimap<uint, uint> bodiesByID;
+	bodiesByID.reserve(mBodyList.size());
+
+	for (uint i = 0; i < mBodyList.size(); i++)
+	{
+		if (mBodyList[i]->BodyType() == BDY_RIGID)
+			bodiesByID.insert(std::make_pair(mBodyList[i]->GetID(), i));
+	}
+
+	//bodies may share an id and a name: each is matched once.
+	std::vector<bool> matched(mBodyList.size(), false);
+	size_t offset = sizeof(header);
+	uint missing = 0;
+
+	Matrix3x3 identity;
+	identity.LoadIdentity();
+
+	for (uint i = 0; i < header.numBodies; i++)
+	{
+		SnapshotBody record;
+		btRigidBodyData state;
+
+		if (snapshot.size() - offset < sizeof(record))
+			break;
+
+		memcpy(&record, &snapshot[offset], sizeof(record));
+		offset += sizeof(record);
+
+		if (snapshot.size() - offset < record.nameLength + sizeof(state))
+			break;
+
+		std::string name(&snapshot[offset], record.nameLength);
+		offset += record.nameLength;
+		memcpy(&state, &snapshot[offset], sizeof(state));
+		offset += sizeof(state);
+
+		int index = -1;
+		auto range = bodiesByID.equal_range(record.id);
+
+		for (auto it = range.first; it != range.second && index < 0; ++it)
+		{
+			if (!matched[it->second] && mBodyList[it->second]->GetName() == name)
+				index = (int)it->second;
+		}
+
+		if (index < 0)
+		{
+			eCollisionShape shape = (eCollisionShape)record.collisionShape;
+
+			//a mesh is in its model, not in the snapshot.
+			if (shape != CS_PLANE && shape != CS_BOX && shape != CS_SPHERE)
+			{
+				missing++;
+				continue;
+			}
+
+			PhysicsCommand command;
+			command.type = PHYS_CMD_ADD_BODY;
+			command.body = CreateBody(BDY_RIGID, name, record.id);
+			command.body->SetScale(record.scale);
+			command.body->SetCollisionShape(shape, record.dimensions);
+			command.body->SetMassAndInertia(record.mass, Vector3(record.localInertia[0], record.localInertia[1], record.localInertia[2]));
+			command.body->SetFriction(record.friction);
+			command.body->SetDamping(record.damping, record.angularDamping);
+			command.body->SetContactReport(record.contactReport);
+			//where it really is comes with its state.
+			command.body->SetInitialState(Vector3(0.0, 0.0, 0.0), identity);
+			command.body->Finilize();
+
+			//a full broadphase turns it away.
+			size_t numBodies = mBodyList.size();
+			ExecuteCommand(command);
+
+			if (mBodyList.size() == numBodies)
+			{
+				missing++;
+				continue;
+			}
+
+			index = (int)mBodyList.size() - 1;
+			matched.push_back(false);
+		}
+
+		matched[index] = true;
+
+		mBodyList[index]->SetForce(Vector3(record.force[0], record.force[1], record.force[2]));
+		RestoreBodyState((uint)index, state);
+	}
+
+	if (offset != snapshot.size())
+		LogManager::GetInstance()->LogMessage("Error! The world snapshot is truncated: the bodies after the last whole one were not restored.");
+
+	if (missing > 0)
+		LogManager::GetInstance()->LogMessage("Error! " + to_string(missing) + " bodies of the world snapshot were not restored: mesh bodies must be in the world before restoring it, and the broadphase must have room for the others.");
+}
+
+void DefaultPhysicsEngine::RestoreBodyState(uint index, const btRigidBodyData& state)
+{
+	btRigidBody* rigidBody = dynamic_cast<RigidBody*>(mBodyList[index].get())->GetBulletRigidBody();
+
+	btTransform transform;
+	btVector3 linearVelocity, angularVelocity;
+	transform.deSerialize(state.m_collisionObjectData.m_worldTransform);
+	linearVelocity.deSerialize(state.m_linearVelocity);
+	angularVelocity.deSerialize(state.m_angularVelocity);
+
+	//the velocities first: Bullet interpolates with them from the new transform.
+	rigidBody->setLinearVelocity(linearVelocity);
+	rigidBody->setAngularVelocity(angularVelocity);
+	rigidBody->setCenterOfMassTransform(transform);
+	rigidBody->getMotionState()->setWorldTransform(transform);
+	rigidBody->clearForces();
+	rigidBody->forceActivationState(state.m_collisionObjectData.m_activationState1);
+	rigidBody->setDeactivationTime(state.m_collisionObjectData.m_deactivationTime);
+
+	//sleeping bodies keep their old place in the broadphase otherwise.
+	mBulletDynamicsWorld->updateSingleAabb(rigidBody);
+
+	//a jump, not a motion: shown as it is at the next snapshot, asleep or not.
+	mPreviousTransforms.resize(mBodyList.size());
+	mPublishStates.resize(mBodyList.size());
+	mPreviousTransforms[index] = transform;
+	mPublishStates[index].bForcePublish = true;
+}
+
 void DefaultPhysicsEngine::AddRigidBody(PhysicsBodyPtr body)
 {
 	RigidBody* rigidBody = dynamic_cast<RigidBody*>(body.get());
 	mBulletDynamicsWorld->addRigidBody(rigidBody->GetBulletRigidBody());
+
+	if (rigidBody->GetBulletRigidBody()->getUserIndex2() != CR_NONE)
+		mReportingBodies++;
 }
 
 void DefaultPhysicsEngine::AddSoftBody(PhysicsBodyPtr body)
@@ -145,75 +664,982 @@ void DefaultPhysicsEngine::AddSoftBody(PhysicsBodyPtr body)
 	softWorld->addSoftBody(softBody->GetBulletSoftBody());
 }
 
-void DefaultPhysicsEngine::StepSimulation(float timeStep)
+void DefaultPhysicsEngine::SetGravityField(float constant, float openingAngle)
+{
+	PhysicsCommand command;
+	command.type = PHYS_CMD_SET_GRAVITY_FIELD;
+	command.gravityConstant = constant;
+	command.openingAngle = openingAngle;
+	SubmitCommand(command);
+}
+
+void DefaultPhysicsEngine::SetMotionEpsilon(float epsilon)
 {
-	EventManager* pEventMng = EventManager::GetInstance();
+	PhysicsCommand command;
+	command.type = PHYS_CMD_SET_MOTION_EPSILON;
+	command.epsilon = epsilon;
+	SubmitCommand(command);
+}
 
-	//update total force for all objects
-	for (uint i = 0; i < mBodyList.size(); i++)
-		mBodyList[i]->CalculateTotalForce();
+void DefaultPhysicsEngine::SetFixedTimeStep(float timeStep, uint maxSteps)
+{
+	PhysicsCommand command;
+	command.type = PHYS_CMD_SET_TIME_STEP;
+	command.timeStep = timeStep;
+	command.maxSteps = maxSteps;
+	SubmitCommand(command);
+}
 
-	mBulletDynamicsWorld->stepSimulation(timeStep,mMaxSubSteps);
+//milliseconds two time intervals have in common.
+static float CommonTime(const std::pair<steady_clock::time_point, steady_clock::time_point>& a, 
+						const std::pair<steady_clock::time_point, steady_clock::time_point>& b)
+{
+	steady_clock::time_point from = std::max(a.first, b.first);
+	steady_clock::time_point to = std::min(a.second, b.second);
 
-	//create and send events, dynamic boies only
-	/*Note that positions and rotations are in absolute coordinates (i.e. not relative to any parent 
-	  the associated scene node might have). 
-	  Bullet is not aware of scene nodes parenting associations, so everything must be exchanged in absolute (world) 
-	  coordinates.
-	*/
-	for (uint i = 0; i < mBodyList.size(); i++)
-	{
-		if (!mBodyList[i]->IsDynamic())
-			continue;
+	return (to > from) ? duration<float, milli>(to - from).count() : 0.0f;
+}
 
-		btTransform trans;
-		float* mesh = nullptr; //used for soft bodies only
+float DefaultPhysicsEngine::Update(float frameTime)
+{
+	//the pool steps it.
+	if (bBackground)
+		return 1.0f;
+
+	steady_clock::time_point start = steady_clock::now();
+
+	float interpolation;
+
+	if (bThreaded)
+	{
+		//pick up the latest snapshot, if the physics thread has completed one since the last frame.
+		mStats.publishedBodies = 0;
+		mStats.reportedContacts = 0;
 
-		switch (mBodyList[i]->BodyType())
+		if (mReadySnapshot.load() & SNAPSHOT_NEW)
 		{
-		case BDY_RIGID:
-			{
-				RigidBody* rigidBody = dynamic_cast<RigidBody*>(mBodyList[i].get());
-				rigidBody->GetBulletRigidBody()->getMotionState()->getWorldTransform(trans);
-			}
-			break;
-		case BDY_SOFT:
+			mFrontSnapshot = mReadySnapshot.exchange(mFrontSnapshot) & ~SNAPSHOT_NEW;
+
+			//may include those of a step whose snapshot isn't ready yet: a step ahead of the body states at most.
 			{
-				SoftBody* softBody = dynamic_cast<SoftBody*>(mBodyList[i].get());
-				trans = softBody->GetBulletSoftBody()->getWorldTransform();
-				mesh = softBody->GetUpdatedMesh();
+				std::lock_guard<std::mutex> lock(mContactMutex);
+				mPublishedContacts.swap(mThreadContacts);
 			}
-			break;
-		default:
-			break;
+
+			PublishSnapshot(mSnapshots[mFrontSnapshot], mPublishedContacts);
+			mStats.publishedBodies = (uint)mSnapshots[mFrontSnapshot].bodies.size();
 		}
 
-		Vector3 pos(trans.getOrigin().getX(), 
-					trans.getOrigin().getY(),
-					trans.getOrigin().getZ());
-		Matrix3x3 attitude;
-		btMatrix3x3 bAttitude = trans.getBasis();
-		btVector3 row = bAttitude.getRow(0);
-		attitude(0,0) = row.getX(); attitude(0,1) = row.getY(); attitude(0,2) = row.getZ();
-		row = bAttitude.getRow(1);
-		attitude(1,0) = row.getX(); attitude(1,1) = row.getY(); attitude(1,2) = row.getZ();
-		row = bAttitude.getRow(2);
-		attitude(2,0) = row.getX(); attitude(2,1) = row.getY(); attitude(2,2) = row.getZ();
+		//the simulation runs in real time: the scene renders one step behind it,
+		//blending the last two states by the time elapsed since the last step.
+		PhysicsSnapshot& front = mSnapshots[mFrontSnapshot];
+		interpolation = 1.0f;
+
+		if (front.timeStep > 0.0f)
+		{
+			interpolation = duration<float>(start - front.time).count() / front.timeStep;
+
+			if (interpolation > 1.0f)
+				interpolation = 1.0f;
+		}
+
+		uint stepTime = mThreadStepTime.exchange(0);
+
+		mStats.steps = mThreadSteps.exchange(0);
+		mStats.stepTime = (float)stepTime / 1000.0f;
+
+		//what the physics thread did since the last frame, less the time the main thread spent in here.
+		{
+			std::lock_guard<std::mutex> lock(mStepIntervalMutex);
+			mStepIntervals.swap(mThreadStepIntervals);
+		}
 
-		EventPtr event(new ObjectMovedEvent(mBodyList[i]->GetID(), pos, attitude));
+		TimeInterval thisUpdate(start, steady_clock::now());
+		mStats.overlapTime = 0.0f;
 
-		if (mBodyList[i]->BodyType() == BDY_SOFT)
+		for (uint i = 0; i < mStepIntervals.size(); i++)
 		{
-			ObjectMovedEvent* objEv = dynamic_cast<ObjectMovedEvent*>(event.get());
-			objEv->AddSoftBodyMesh(mesh);
+			TimeInterval& busy = mStepIntervals[i];
+			mStats.overlapTime += duration<float, milli>(busy.second - busy.first).count() - CommonTime(busy, mLastUpdate) - CommonTime(busy, thisUpdate);
 		}
 
-		pEventMng->QueueEvent(event);
+		mStepIntervals.clear();
+		mStats.overlapTime = std::min(mStats.overlapTime, mStats.stepTime); //stepTime is summed in whole microseconds
 	}
+	else
+	{
+		//the cost of a frame is bounded by the maximum number of steps, whatever the frame time.
+		uint steps = mFixedTimeStep.Advance(frameTime);
 
-	if (mWorldType == PHYS_RIGID_AND_SOFT)
-		mBulletSoftWorldInfo.m_sparsesdf.GarbageCollect();
-}
+		mStats.publishedBodies = 0;
+		mStats.reportedContacts = 0;
+
+		if (steps > 0)
+		{
+			for (uint i = 0; i < steps; i++)
+			{
+				//the scene interpolates between the states before and after the last step.
+				if (i == steps - 1)
+					SavePreviousStates();
+
+				StepWorld(mFixedTimeStep.GetTimeStep());
+			}
+
+			CaptureSnapshot(mSnapshots[mFrontSnapshot]);
+			PublishSnapshot(mSnapshots[mFrontSnapshot], mContacts);
+			mStats.publishedBodies = (uint)mSnapshots[mFrontSnapshot].bodies.size();
+		}
+
+		interpolation = mFixedTimeStep.GetInterpolation();
+
+		mStats.steps = steps;
+		mStats.stepTime = duration<float, milli>(steady_clock::now() - start).count();
+		mStats.overlapTime = 0.0f;
+	}
 
+	mLastUpdate = TimeInterval(start, steady_clock::now());
+	mStats.mainThreadTime = duration<float, milli>(mLastUpdate.second - start).count();
+	mStats.droppedSnapshots = mDroppedSnapshots.load();
+	UpdateBodyStats();
+	UpdateBroadphaseStats();
+
+	return interpolation;
 }
 
+void DefaultPhysicsEngine::StepSimulation(float timeStep)
+{
+	if (bThreaded || bBackground)
+	{
+		LogManager::GetInstance()->LogMessage("Error! StepSimulation is not available while physics runs on its own thread or in the background.");
+		return;
+	}
+
+	SavePreviousStates();
+	StepWorld(timeStep);
+	CaptureSnapshot(mSnapshots[mFrontSnapshot]);
+	PublishSnapshot(mSnapshots[mFrontSnapshot], mContacts);
+
+	mStats.publishedBodies = (uint)mSnapshots[mFrontSnapshot].bodies.size();
+	UpdateBodyStats();
+	UpdateBroadphaseStats();
+}
+
+void DefaultPhysicsEngine::UpdateBodyStats()
+{
+	mStats.activeBodies = mSnapshots[mFrontSnapshot].activeBodies;
+	mStats.sleepingBodies = mSnapshots[mFrontSnapshot].sleepingBodies;
+	mStats.collisionShapes = mShapeCache->GetShapeCount();
+	mStats.collisionShapeUsers = mShapeCache->GetUserCount();
+	mStats.collisionShapeMemory = mShapeCache->GetMemoryUsage();
+}
+
+void DefaultPhysicsEngine::UpdateBroadphaseStats()
+{
+	if (mBroadphaseProfile == NULL)
+		return;
+
+	//the profile adds up the steps of the physics thread too, until taken.
+	mStats.broadphaseTime = (float)mBroadphaseProfile->TakeTime() / 1000.0f;
+	mStats.broadphasePairs = mBroadphaseProfile->GetPairCount();
+}
+
+void DefaultPhysicsEngine::SetThreaded(bool threaded)
+{
+	if (threaded == bThreaded)
+		return;
+
+	if (threaded && bBackground)
+	{
+		LogManager::GetInstance()->LogMessage("Error! A world in the background can't run on its own thread.");
+		return;
+	}
+
+	if (threaded)
+	{
+		bThreaded = true;
+		bThreadRunning = true;
+		mThread = std::thread(&DefaultPhysicsEngine::PhysicsThread, this);
+	}
+	else
+	{
+		bThreadRunning = false;
+		mThread.join();
+		bThreaded = false;
+
+		//the world belongs to the main thread again.
+		ExecuteQueuedCommands();
+
+		//contacts the main thread hasn't taken yet go out with the next step.
+		mContacts.insert(mContacts.begin(), mThreadContacts.begin(), mThreadContacts.end());
+		mThreadContacts.clear();
+	}
+}
+
+void DefaultPhysicsEngine::SetBackground(bool background, float rate)
+{
+	if (background == bBackground || bThreaded)
+		return;
+
+	PhysicsWorldPool* pool = PhysicsWorldPool::GetInstance();
+
+	if (pool == NULL)
+	{
+		LogManager::GetInstance()->LogMessage("Error! There is no PhysicsWorldPool: the world stops while in the background.");
+		return;
+	}
+
+	if (background)
+	{
+		if (rate <= 0.0f)
+		{
+			LogManager::GetInstance()->LogMessage("Error! The background rate must be positive.");
+			return;
+		}
+
+		//the steps are as much longer as they are fewer: the world keeps up with the real time.
+		mBackgroundTimeStep.Configure(1.0f / rate, BACKGROUND_MAX_STEPS);
+		bBackground = true;
+		pool->AddWorld(this, rate);
+		return;
+	}
+
+	pool->RemoveWorld(this);
+	bBackground = false;
+
+	//the world belongs to the main thread again.
+	ExecuteQueuedCommands();
+
+	if (mBroadphaseProfile != NULL)
+		mBroadphaseProfile->TakeTime();
+
+	//every dynamic body where it is now, with no motion to blend from: asleep or not, the scene last saw it
+	//before the world went in the background.
+	mPreviousTransforms.resize(mBodyList.size());
+	mPublishStates.resize(mBodyList.size());
+
+	for (uint i = 0; i < mBodyList.size(); i++)
+	{
+		if (!mBodyList[i]->IsDynamic())
+			continue;
+
+		GetBodyTransform(i, mPreviousTransforms[i]);
+		mPublishStates[i].bForcePublish = true;
+	}
+
+	CaptureSnapshot(mSnapshots[mFrontSnapshot]);
+	PublishSnapshot(mSnapshots[mFrontSnapshot], mContacts);
+}
+
+void DefaultPhysicsEngine::StepBackground(float elapsed)
+{
+	{
+		std::lock_guard<std::mutex> lock(mWorldMutex);
+		ExecuteQueuedCommands();
+	}
+
+	uint steps = mBackgroundTimeStep.Advance(elapsed);
+
+	//one step at a time: queries waiting for the world get in between.
+	for (uint i = 0; i < steps; i++)
+	{
+		std::lock_guard<std::mutex> lock(mWorldMutex);
+		StepWorld(mBackgroundTimeStep.GetTimeStep());
+	}
+
+	//nobody to report them to.
+	mContacts.clear();
+}
+
+void DefaultPhysicsEngine::PhysicsThread()
+{
+	steady_clock::time_point last = steady_clock::now();
+
+	while (bThreadRunning)
+	{
+		steady_clock::time_point start = steady_clock::now();
+		float frameTime = duration<float>(start - last).count();
+		last = start;
+
+		{
+			std::lock_guard<std::mutex> lock(mWorldMutex);
+			ExecuteQueuedCommands();
+		}
+
+		uint steps = mFixedTimeStep.Advance(frameTime);
+
+		//one step at a time: queries waiting for the world get in between.
+		for (uint i = 0; i < steps; i++)
+		{
+			std::lock_guard<std::mutex> lock(mWorldMutex);
+
+			if (i == steps - 1)
+				SavePreviousStates();
+
+			StepWorld(mFixedTimeStep.GetTimeStep());
+		}
+
+		if (steps > 0)
+		{
+			PhysicsSnapshot& back = mSnapshots[mBackSnapshot];
+			CaptureSnapshot(back);
+
+			if (!mContacts.empty())
+			{
+				std::lock_guard<std::mutex> lock(mContactMutex);
+				mThreadContacts.insert(mThreadContacts.end(), mContacts.begin(), mContacts.end());
+				mContacts.clear();
+			}
+
+			back.time = steady_clock::now();
+			back.timeStep = mFixedTimeStep.GetTimeStep();
+
+			uint previous = mReadySnapshot.exchange(mBackSnapshot | SNAPSHOT_NEW);
+
+			mBackSnapshot = previous & ~SNAPSHOT_NEW;
+
+			//the main thread never saw the one we get back.
+			if (previous & SNAPSHOT_NEW)
+			{
+				mDroppedSnapshots++;
+				RepublishSnapshot(mSnapshots[mBackSnapshot]);
+			}
+		}
+
+		steady_clock::time_point end = steady_clock::now();
+		mThreadSteps += steps;
+		mThreadStepTime += (uint)duration_cast<microseconds>(end - start).count();
+
+		{
+			std::lock_guard<std::mutex> lock(mStepIntervalMutex);
+			mThreadStepIntervals.push_back(TimeInterval(start, end));
+		}
+
+		//sleep until the next step is due.
+		float wait = (1.0f - mFixedTimeStep.GetInterpolation()) * mFixedTimeStep.GetTimeStep() - duration<float>(end - start).count();
+
+		if (wait > 0.0f)
+			std::this_thread::sleep_for(duration<float>(wait));
+	}
+}
+
+void DefaultPhysicsEngine::StepWorld(float timeStep)
+{
+	if (mGravityField.IsEnabled())
+		ApplyGravityField();
+
+	//update total force for all objects
+	for (uint i = 0; i < mBodyList.size(); i++)
+		mBodyList[i]->CalculateTotalForce();
+
+	//no sub-steps: exactly one step of timeStep. Bullet's own interpolation is not used.
+	mBulletDynamicsWorld->stepSimulation(timeStep, 0);
+
+	if (mReportingBodies > 0)
+		GatherContacts();
+
+	if (mWorldType == PHYS_RIGID_AND_SOFT)
+		mBulletSoftWorldInfo.m_sparsesdf.GarbageCollect();
+}
+
+void DefaultPhysicsEngine::ApplyGravityField()
+{
+	mFieldBodies.clear();
+	mFieldPositions.clear();
+	mFieldMasses.clear();
+
+	//static bodies have no mass in Bullet: they don't pull, nor are they pulled.
+	for (uint i = 0; i < mBodyList.size(); i++)
+	{
+		if (mBodyList[i]->BodyType() != BDY_RIGID || !mBodyList[i]->IsDynamic())
+			continue;
+
+		const btVector3& position = dynamic_cast<RigidBody*>(mBodyList[i].get())->GetBulletRigidBody()->getCenterOfMassPosition();
+
+		mFieldBodies.push_back(i);
+		mFieldPositions.push_back(position.x());
+		mFieldPositions.push_back(position.y());
+		mFieldPositions.push_back(position.z());
+		mFieldMasses.push_back(mBodyList[i]->GetMass());
+	}
+
+	uint numBodies = (uint)mFieldBodies.size();
+
+	if (numBodies == 0)
+		return;
+
+	mFieldAccelerations.resize(3*numBodies);
+	mGravityField.Compute(&mFieldPositions[0], &mFieldMasses[0], numBodies, &mFieldAccelerations[0]);
+
+	for (uint i = 0; i < numBodies; i++)
+	{
+		btVector3 acceleration(mFieldAccelerations[3*i], mFieldAccelerations[3*i + 1], mFieldAccelerations[3*i + 2]);
+		dynamic_cast<PhysicsBody*>(mBodyList[mFieldBodies[i]].get())->SetFieldForce(acceleration * mFieldMasses[i]);
+	}
+}
+
+//a body keeps its collision object, and its address, for as long as the world lives.
+static bool ComparePairs(const ContactPair& a, const ContactPair& b)
+{
+	std::less<const btCollisionObject*> less;
+
+	if (a.objects[0] != b.objects[0])
+		return less(a.objects[0], b.objects[0]);
+
+	return less(a.objects[1], b.objects[1]);
+}
+
+static bool SamePair(const ContactPair& a, const ContactPair& b)
+{
+	return a.objects[0] == b.objects[0] && a.objects[1] == b.objects[1];
+}
+
+void DefaultPhysicsEngine::GatherContacts()
+{
+	btDispatcher* dispatcher = mBulletDynamicsWorld->getDispatcher();
+	mStepPairs.clear();
+
+	for (int i = 0; i < dispatcher->getNumManifolds(); i++)
+	{
+		btPersistentManifold* manifold = dispatcher->getManifoldByIndexInternal(i);
+		const btCollisionObject* objectA = manifold->getBody0();
+		const btCollisionObject* objectB = manifold->getBody1();
+		uint flags = (uint)(objectA->getUserIndex2() | objectB->getUserIndex2());
+
+		if (flags == CR_NONE || manifold->getNumContacts() == 0)
+			continue;
+
+		//the lower id first, whichever way round Bullet has them.
+		bool swapped = objectA->getUserIndex() > objectB->getUserIndex();
+
+		if (swapped)
+			std::swap(objectA, objectB);
+
+		ContactPair pair;
+		pair.report.bodyA = (uint)objectA->getUserIndex();
+		pair.report.bodyB = (uint)objectB->getUserIndex();
+		pair.report.numPoints = 0;
+		pair.report.impulse = 0.0f;
+		pair.objects[0] = std::less<const btCollisionObject*>()(objectA, objectB) ? objectA : objectB;
+		pair.objects[1] = pair.objects[0] == objectA ? objectB : objectA;
+		pair.flags = flags;
+		pair.bActive = objectA->isActive() || objectB->isActive();
+		pair.maxImpulse = -1.0f;
+
+		for (int j = 0; j < manifold->getNumContacts(); j++)
+		{
+			const btManifoldPoint& point = manifold->getContactPoint(j);
+
+			//Bullet keeps the points until they are some way apart: only those touching count.
+			if (point.getDistance() > 0.0f)
+				continue;
+
+			pair.report.numPoints++;
+			pair.report.impulse += point.getAppliedImpulse();
+
+			if (point.getAppliedImpulse() > pair.maxImpulse)
+			{
+				//Bullet's normal is on its second body, towards the first.
+				const btVector3& position = swapped ? point.getPositionWorldOnA() : point.getPositionWorldOnB();
+				btVector3 normal = swapped ? -point.m_normalWorldOnB : point.m_normalWorldOnB;
+
+				pair.maxImpulse = point.getAppliedImpulse();
+				pair.report.point.SetComponents(position.x(), position.y(), position.z());
+				pair.report.normal.SetComponents(normal.x(), normal.y(), normal.z());
+			}
+		}
+
+		if (pair.report.numPoints > 0)
+			mStepPairs.push_back(pair);
+	}
+
+	//compounds have a manifold per child: one pair for all of them.
+	std::sort(mStepPairs.begin(), mStepPairs.end(), ComparePairs);
+
+	size_t numPairs = 0;
+
+	for (size_t i = 0; i < mStepPairs.size(); i++)
+	{
+		if (numPairs > 0 && SamePair(mStepPairs[numPairs - 1], mStepPairs[i]))
+		{
+			ContactPair& pair = mStepPairs[numPairs - 1];
+			pair.report.numPoints += mStepPairs[i].report.numPoints;
+			pair.report.impulse += mStepPairs[i].report.impulse;
+
+			if (mStepPairs[i].maxImpulse > pair.maxImpulse)
+			{
+				pair.maxImpulse = mStepPairs[i].maxImpulse;
+				pair.report.point = mStepPairs[i].report.point;
+				pair.report.normal = mStepPairs[i].report.normal;
+			}
+		}
+		else
+		{
+			mStepPairs[numPairs++] = mStepPairs[i];
+		}
+	}
+
+	mStepPairs.resize(numPairs);
+
+	//both lists are sorted: walk them side by side.
+	size_t current = 0;
+	size_t previous = 0;
+
+	while (current < mStepPairs.size() || previous < mContactPairs.size())
+	{
+		if (previous == mContactPairs.size() || (current < mStepPairs.size() && ComparePairs(mStepPairs[current], mContactPairs[previous])))
+		{
+			ReportContact(mStepPairs[current++], CONTACT_BEGIN);
+		}
+		else if (current == mStepPairs.size() || ComparePairs(mContactPairs[previous], mStepPairs[current]))
+		{
+			ReportContact(mContactPairs[previous++], CONTACT_END);
+		}
+		else
+		{
+			//a sleeping pair has nothing new to say until it wakes up.
+			if (mStepPairs[current].bActive)
+				ReportContact(mStepPairs[current], CONTACT_PERSIST);
+
+			current++;
+			previous++;
+		}
+	}
+
+	mContactPairs.swap(mStepPairs);
+}
+
+void DefaultPhysicsEngine::ReportContact(const ContactPair& pair, eContactPhase phase)
+{
+	//eContactReport has a bit per phase.
+	if ((pair.flags & (1 << phase)) == 0)
+		return;
+
+	mContacts.push_back(pair.report);
+
+	ContactReport& contact = mContacts.back();
+	contact.phase = phase;
+
+	if (phase == CONTACT_END)
+	{
+		contact.numPoints = 0;
+		contact.impulse = 0.0f;
+	}
+}
+
+void DefaultPhysicsEngine::GetBodyTransform(uint index, btTransform& trans)
+{
+	switch (mBodyList[index]->BodyType())
+	{
+	case BDY_RIGID:
+		{
+			RigidBody* rigidBody = dynamic_cast<RigidBody*>(mBodyList[index].get());
+			rigidBody->GetBulletRigidBody()->getMotionState()->getWorldTransform(trans);
+		}
+		break;
+	case BDY_SOFT:
+		{
+			SoftBody* softBody = dynamic_cast<SoftBody*>(mBodyList[index].get());
+			trans = softBody->GetBulletSoftBody()->getWorldTransform();
+		}
+		break;
+	default:
+		trans.setIdentity();
+		break;
+	}
+}
+
+void DefaultPhysicsEngine::SavePreviousStates()
+{
+	mPreviousTransforms.resize(mBodyList.size());
+
+	//a sleeping body hasn't moved since it was last active: its previous state is still good.
+	for (uint i = 0; i < mBodyList.size(); i++)
+	{
+		if (mBodyList[i]->IsDynamic() && mBodyList[i]->IsActive())
+			GetBodyTransform(i, mPreviousTransforms[i]);
+	}
+}
+
+static void ConvertTransform(const btTransform& trans, Vector3& pos, Matrix3x3& attitude)
+{
+	pos.SetComponents(trans.getOrigin().getX(), 
+					trans.getOrigin().getY(),
+					trans.getOrigin().getZ());
+
+	const btMatrix3x3& bAttitude = trans.getBasis();
+	btVector3 row = bAttitude.getRow(0);
+	attitude(0,0) = row.getX(); attitude(0,1) = row.getY(); attitude(0,2) = row.getZ();
+	row = bAttitude.getRow(1);
+	attitude(1,0) = row.getX(); attitude(1,1) = row.getY(); attitude(1,2) = row.getZ();
+	row = bAttitude.getRow(2);
+	attitude(2,0) = row.getX(); attitude(2,1) = row.getY(); attitude(2,2) = row.getZ();
+}
+
+static bool HasMoved(const btTransform& from, const btTransform& to, float epsilon)
+{
+	if (epsilon < 0.0f)
+		return true;
+
+	float epsilon2 = epsilon*epsilon;
+
+	if ((to.getOrigin() - from.getOrigin()).length2() > epsilon2)
+		return true;
+
+	for (int i = 0; i < 3; i++)
+	{
+		if ((to.getBasis()[i] - from.getBasis()[i]).length2() > epsilon2)
+			return true;
+	}
+
+	return false;
+}
+
+void DefaultPhysicsEngine::CaptureSnapshot(PhysicsSnapshot& snapshot)
+{
+	snapshot.bodies.clear();
+	snapshot.activeBodies = 0;
+	snapshot.sleepingBodies = 0;
+
+	mPublishStates.resize(mBodyList.size());
+
+	/*Note that positions and rotations are in absolute coordinates (i.e. not relative to any parent 
+	  the associated scene node might have). 
+	  Bullet is not aware of scene nodes parenting associations, so everything must be exchanged in absolute (world) 
+	  coordinates.
+	*/
+	for (uint i = 0; i < mBodyList.size(); i++)
+	{
+		if (!mBodyList[i]->IsDynamic())
+			continue;
+
+		BodyPublishState& published = mPublishStates[i];
+		bool active = mBodyList[i]->IsActive();
+
+		if (active)
+			snapshot.activeBodies++;
+		else
+			snapshot.sleepingBodies++;
+
+		//asleep and already shown at rest: the body can't have moved.
+		if (!active && published.bAtRest && !published.bForcePublish)
+			continue;
+
+		btTransform trans;
+		GetBodyTransform(i, trans);
+
+		bool moved = !published.bPublished || HasMoved(published.transform, trans, mMotionEpsilon);
+		bool meshUpdated = false;
+
+		if (mBodyList[i]->BodyType() == BDY_SOFT && active)
+		{
+			//straight into the memory the scene node draws from: nothing to carry in the event.
+			SoftBody* softBody = dynamic_cast<SoftBody*>(mBodyList[i].get());
+			meshUpdated = softBody->WriteVertexStream();
+		}
+
+		if (!moved && !meshUpdated && published.bAtRest && !published.bForcePublish)
+			continue;
+
+		BodySnapshot body;
+		body.id = mBodyList[i]->GetID();
+		body.index = i;
+		body.meshUpdated = meshUpdated;
+		ConvertTransform(trans, body.position, body.attitude);
+
+		if (moved)
+		{
+			ConvertTransform(mPreviousTransforms[i], body.previousPosition, body.previousAttitude);
+			published.bAtRest = false;
+		}
+		else
+		{
+			//come to rest: one last state with no motion in it, so that the scene stops blending.
+			body.previousPosition = body.position;
+			body.previousAttitude = body.attitude;
+			published.bAtRest = true;
+		}
+
+		published.transform = trans;
+		published.bPublished = true;
+		published.bForcePublish = false;
+
+		snapshot.bodies.push_back(body);
+	}
+}
+
+void DefaultPhysicsEngine::RepublishSnapshot(PhysicsSnapshot& snapshot)
+{
+	for (uint i = 0; i < snapshot.bodies.size(); i++)
+		mPublishStates[snapshot.bodies[i].index].bForcePublish = true;
+}
+
+void DefaultPhysicsEngine::PublishSnapshot(PhysicsSnapshot& snapshot, std::vector<ContactReport>& contacts)
+{
+	//one event per dynamic body: post them in batches rather than one by one.
+	EventBatch events;
+
+	for (uint i = 0; i < snapshot.bodies.size(); i++)
+	{
+		BodySnapshot& body = snapshot.bodies[i];
+
+		ObjectMovedEvent* objEv = new ObjectMovedEvent(body.id, body.position, body.attitude);
+		EventPtr event(objEv);
+
+		objEv->SetPreviousState(body.previousPosition, body.previousAttitude);
+
+		objEv->bIsSoft = body.meshUpdated;
+
+		events.Add(event);
+	}
+
+	mStats.reportedContacts = (uint)contacts.size();
+
+	if (!contacts.empty())
+	{
+		//handed over rather than copied.
+		ContactsEvent* contactsEvent = new ContactsEvent();
+		contactsEvent->Contacts().swap(contacts);
+		events.Add(EventPtr(contactsEvent));
+	}
+
+	events.Flush();
+}
+
+void DefaultPhysicsEngine::RunQueries(const PhysicsQuery* queries, uint numQueries, PhysicsQueryResult* results)
+{
+	if (numQueries == 0)
+		return;
+
+	std::lock_guard<std::mutex> lock(mWorldMutex);
+
+	QueryBatch batch;
+	batch.engine = this;
+	batch.queries = queries;
+	batch.results = results;
+
+#if BT_THREADSAFE
+	TaskScheduler::GetInstance()->ParallelFor(0, (int)numQueries, QUERY_GRAIN_SIZE, RunQueryRange, &batch);
+#else
+	//the broadphase ray test keeps its stack in the broadphase, one per thread only when Bullet is thread safe.
+	RunQueryRange(&batch, 0, (int)numQueries);
+#endif
+}
+
+void DefaultPhysicsEngine::RunQueryRange(void* context, int begin, int end)
+{
+	QueryBatch* batch = static_cast<QueryBatch*>(context);
+
+	for (int i = begin; i < end; i++)
+	{
+		const PhysicsQuery& query = batch->queries[i];
+		PhysicsQueryResult& result = batch->results[i];
+
+		result = PhysicsQueryResult();
+
+		switch (query.type)
+		{
+		case QRY_RAY:
+			batch->engine->RunRay(query, result);
+			break;
+		case QRY_SWEEP:
+			batch->engine->RunSweep(query, result);
+			break;
+		case QRY_OVERLAP:
+			batch->engine->RunOverlap(query, result);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+static btVector3 ToBullet(Vector3 vector)
+{
+	return btVector3(vector.X(), vector.Y(), vector.Z());
+}
+
+static void SetQueryHit(PhysicsQueryResult& result, const btCollisionObject* object, float fraction, const btVector3& point, const btVector3& normal)
+{
+	result.bHit = true;
+	result.bodyID = (uint)object->getUserIndex();
+	result.numBodies = 1;
+	result.fraction = fraction;
+	result.point.SetComponents(point.x(), point.y(), point.z());
+	result.normal.SetComponents(normal.x(), normal.y(), normal.z());
+}
+
+void DefaultPhysicsEngine::RunRay(const PhysicsQuery& query, PhysicsQueryResult& result)
+{
+	btVector3 from = ToBullet(query.from);
+	btVector3 to = ToBullet(query.to);
+
+	btCollisionWorld::ClosestRayResultCallback callback(from, to);
+	mBulletDynamicsWorld->rayTest(from, to, callback);
+
+	if (callback.hasHit())
+		SetQueryHit(result, callback.m_collisionObject, callback.m_closestHitFraction, callback.m_hitPointWorld, callback.m_hitNormalWorld);
+}
+
+void DefaultPhysicsEngine::RunSweep(const PhysicsQuery& query, PhysicsQueryResult& result)
+{
+	btVector3 from = ToBullet(query.from);
+	btVector3 to = ToBullet(query.to);
+
+	btSphereShape sphere(query.radius);
+	btTransform start(btMatrix3x3::getIdentity(), from);
+	btTransform end(btMatrix3x3::getIdentity(), to);
+
+	btCollisionWorld::ClosestConvexResultCallback callback(from, to);
+	mBulletDynamicsWorld->convexSweepTest(&sphere, start, end, callback);
+
+	if (callback.hasHit())
+		SetQueryHit(result, callback.m_hitCollisionObject, callback.m_closestHitFraction, callback.m_hitPointWorld, callback.m_hitNormalWorld);
+}
+
+//the bodies whose bounding boxes overlap the one of the sphere.
+struct OverlapCandidates : public btBroadphaseAabbCallback
+{
+	bool process(const btBroadphaseProxy* proxy)
+	{
+		objects.push_back(static_cast<const btCollisionObject*>(proxy->m_clientObject));
+		return true;
+	}
+
+	btAlignedObjectArray<const btCollisionObject*> objects;
+};
+
+//where the sphere comes closest to a body.
+struct SphereContact
+{
+	SphereContact() : distance(BT_LARGE_FLOAT) {}
+
+	float distance; //between the surfaces, negative when they overlap
+	btVector3 point; //on the body
+	btVector3 normal; //towards the sphere
+};
+
+//by GJK, margins included: the sphere is a point with its radius as margin.
+static void ConvexContact(const btSphereShape& sphere, const btTransform& sphereTransform, const btConvexShape* shape, 
+						  const btTransform& transform, SphereContact& contact)
+{
+	btVoronoiSimplexSolver simplexSolver;
+	btGjkEpaPenetrationDepthSolver depthSolver;
+	btGjkPairDetector detector(&sphere, shape, &simplexSolver, &depthSolver);
+
+	btDiscreteCollisionDetectorInterface::ClosestPointInput input;
+	input.m_transformA = sphereTransform;
+	input.m_transformB = transform;
+
+	btPointCollector output;
+	detector.getClosestPoints(input, output, NULL);
+
+	if (output.m_hasResult && output.m_distance < contact.distance)
+	{
+		contact.distance = output.m_distance;
+		contact.point = output.m_pointInWorld;
+		contact.normal = output.m_normalOnBInWorld;
+	}
+}
+
+//the triangles of a concave shape near the sphere, each tested as a convex shape of its own.
+struct SphereTriangleCallback : public btTriangleCallback
+{
+	SphereTriangleCallback(const btSphereShape& sphere, const btTransform& sphereTransform, const btTransform& transform, SphereContact& contact) :
+		mSphere(sphere), mSphereTransform(sphereTransform), mTransform(transform), mContact(contact) {}
+
+	void processTriangle(btVector3* triangle, int partId, int triangleIndex)
+	{
+		btTriangleShape shape(triangle[0], triangle[1], triangle[2]);
+		shape.setMargin(0.0f);
+		ConvexContact(mSphere, mSphereTransform, &shape, mTransform, mContact);
+	}
+
+	const btSphereShape& mSphere;
+	const btTransform& mSphereTransform;
+	const btTransform& mTransform;
+	SphereContact& mContact;
+};
+
+static void ShapeContact(const btSphereShape& sphere, const btTransform& sphereTransform, const btCollisionShape* shape, 
+						 const btTransform& transform, SphereContact& contact)
+{
+	if (shape->isConvex())
+	{
+		ConvexContact(sphere, sphereTransform, static_cast<const btConvexShape*>(shape), transform, contact);
+	}
+	else if (shape->isCompound())
+	{
+		const btCompoundShape* compound = static_cast<const btCompoundShape*>(shape);
+
+		for (int i = 0; i < compound->getNumChildShapes(); i++)
+			ShapeContact(sphere, sphereTransform, compound->getChildShape(i), transform * compound->getChildTransform(i), contact);
+	}
+	else if (shape->isConcave())
+	{
+		//planes and triangle meshes hand out the triangles in a box, in their own space.
+		btVector3 centre = transform.invXform(sphereTransform.getOrigin());
+		btVector3 extent(sphere.getRadius(), sphere.getRadius(), sphere.getRadius());
+
+		SphereTriangleCallback callback(sphere, sphereTransform, transform, contact);
+		static_cast<const btConcaveShape*>(shape)->processAllTriangles(&callback, centre - extent, centre + extent);
+	}
+}
+
+void DefaultPhysicsEngine::RunOverlap(const PhysicsQuery& query, PhysicsQueryResult& result)
+{
+	btVector3 centre = ToBullet(query.from);
+	btVector3 extent(query.radius, query.radius, query.radius);
+
+	OverlapCandidates candidates;
+	mBulletBroadphase->aabbTest(centre - extent, centre + extent, candidates);
+
+	btSphereShape sphere(query.radius);
+	btTransform sphereTransform(btMatrix3x3::getIdentity(), centre);
+
+	SphereContact deepest;
+	const btCollisionObject* deepestObject = NULL;
+	uint numBodies = 0;
+
+	for (int i = 0; i < candidates.objects.size(); i++)
+	{
+		const btCollisionObject* object = candidates.objects[i];
+		SphereContact contact;
+
+		if (object->getInternalType() == btCollisionObject::CO_SOFT_BODY)
+		{
+			//their nodes move every step: go by the bounding box.
+			btVector3 boxMin, boxMax;
+			object->getCollisionShape()->getAabb(object->getWorldTransform(), boxMin, boxMax);
+
+			contact.point = centre;
+			contact.point.setMax(boxMin);
+			contact.point.setMin(boxMax);
+			contact.normal = centre - contact.point;
+			contact.distance = contact.normal.length() - query.radius;
+			contact.normal = contact.normal.length2() > SIMD_EPSILON ? contact.normal.normalized() : btVector3(0.0f, 1.0f, 0.0f);
+		}
+		else
+		{
+			ShapeContact(sphere, sphereTransform, object->getCollisionShape(), object->getWorldTransform(), contact);
+		}
+
+		if (contact.distance > 0.0f)
+			continue;
+
+		numBodies++;
+
+		if (contact.distance < deepest.distance)
+		{
+			deepest = contact;
+			deepestObject = object;
+		}
+	}
+
+	if (deepestObject != NULL)
+	{
+		SetQueryHit(result, deepestObject, 0.0f, deepest.point, deepest.normal);
+		result.numBodies = numBodies;
+	}
+}
+
+}
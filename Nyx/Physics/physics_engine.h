@@ -10,6 +10,10 @@
 #include "iphysics_engine.h"
 #include "rigid_body.h"
 #include "soft_body.h"
+#include "gravity_field.h"
+#include "broadphase.h"
+#include "Events/events.h"
+#include "Utils/fixed_timestep.h"
 
 #include "btBulletDynamicsCommon.h"
 
@@ -21,9 +25,93 @@
 //default cpu soft body solver. see bullet/multithreaded for GPGPU soft body solvers. 
 #include "BulletSoftBody/btDefaultSoftBodySolver.h"
 
+#include "bullet_task_scheduler.h"
+
+#if BT_THREADSAFE
+#include "BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h"
+#include "BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h"
+#include "BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolverMt.h"
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 namespace NYX {
+
+enum ePhysicsCommand
+{
+	PHYS_CMD_ADD_BODY,
+	PHYS_CMD_SET_GRAVITY,
+	PHYS_CMD_SET_GRAVITY_FIELD,
+	PHYS_CMD_SET_TIME_STEP,
+	PHYS_CMD_SET_VELOCITY,
+	PHYS_CMD_SET_FORCE,
+	PHYS_CMD_SET_MOTION_EPSILON,
+	PHYS_CMD_RESTORE_WORLD
+};
+
+//a change to the world requested by the main thread, see DefaultPhysicsEngine::SetThreaded.
+struct PhysicsCommand
+{
+	ePhysicsCommand type;
+	PhysicsBodyPtr body; //PHYS_CMD_ADD_BODY
+	uint bodyID;
+	Vector3 vector; //gravity, velocity or force
+	float timeStep;
+	uint maxSteps;
+	float epsilon;
+	float gravityConstant; //gravity field
+	float openingAngle;
+	std::shared_ptr<std::string> snapshot; //PHYS_CMD_RESTORE_WORLD, checked already
+};
+
+//state of one dynamic body at the end of a physics frame.
+struct BodySnapshot
+{
+	uint id;
+	uint index; //in the engine body list
+	Vector3 position;
+	Matrix3x3 attitude;
+	Vector3 previousPosition; //before the last step
+	Matrix3x3 previousAttitude;
+	bool meshUpdated; //soft bodies only: a new mesh was written to the body's vertex stream
+};
+
+struct PhysicsSnapshot
+{
+	PhysicsSnapshot() : timeStep(0.0f), activeBodies(0), sleepingBodies(0) {}
+
+	std::vector<BodySnapshot> bodies; //only those that moved, see IPhysicsEngine::SetMotionEpsilon
+	std::chrono::steady_clock::time_point time; //when the last step was completed
+	float timeStep;
+	uint activeBodies;
+	uint sleepingBodies;
+};
+
+//two bodies touching at the end of a step, at least one of them with contact report flags.
+struct ContactPair
+{
+	const btCollisionObject* objects[2]; //in address order, as ids need not be unique: pairs are sorted by them
+	uint flags; //eContactReport of either body
+	bool bActive; //either body is awake
+	float maxImpulse; //of a single point
+	ContactReport report;
+};
+
+//what the scene was last told about a dynamic body.
+struct BodyPublishState
+{
+	BodyPublishState() : bPublished(false), bAtRest(false), bForcePublish(false) {}
+
+	btTransform transform; //as last published
+	bool bPublished;
+	bool bAtRest; //the last publication had no motion in it: nothing more to say until the body moves
+	bool bForcePublish; //the last publication was in a snapshot the scene never read
+};
+
 /*
 Physics Engine
 */
@@ -35,11 +123,31 @@ public:
     ~DefaultPhysicsEngine();
 
 	void InitPhysics(ePhysicsWorld ePhysics);
+	void SetBroadphase(const BroadphaseOptions& options);
     void SetGravity(Vector3 gravity);
+	void SetGravityField(float constant, float openingAngle = 0.7f);
+	PhysicsBodyPtr CreateBody(ePhysicsBody bodyType, std::string name, uint id);
 	void AddBody(PhysicsBodyPtr rigidBody);
+	void SetFixedTimeStep(float timeStep, uint maxSteps); //default 1/60 s, 5 steps
+	float Update(float frameTime);
 	void StepSimulation(float timeStep);
 
-	void SetMaxSubSteps(int stepNo); //default 10
+	void SetThreaded(bool threaded);
+	bool IsThreaded();
+	void SetBackground(bool background, float rate);
+	//a step of the background world, by the PhysicsWorldPool: elapsed is the real time since the last one.
+	void StepBackground(float elapsed);
+
+	void SetBodyVelocity(uint bodyID, Vector3 velocity);
+	void SetBodyForce(uint bodyID, Vector3 force);
+	void SetMotionEpsilon(float epsilon); //default 1e-4
+
+	void RunQueries(const PhysicsQuery* queries, uint numQueries, PhysicsQueryResult* results);
+
+	void SaveWorld(std::string& snapshot);
+	bool RestoreWorld(const std::string& snapshot);
+
+	const PhysicsStats& GetStats();
 
 	void SetSoftWorldInfo(float air_density, float water_density, float water_offset, Vector3 water_normal);
 	btSoftBodyWorldInfo GetSoftWorldInfo();
@@ -49,11 +157,16 @@ private:
 	ePhysicsWorld mWorldType;
 
 	std::vector<PhysicsBodyPtr> mBodyList;
+	CollisionShapeCachePtr mShapeCache; //shared with the bodies from CreateBody, which may outlive the engine
 
 	btDefaultCollisionConfiguration* mBulletCollisionConfig;
 	btCollisionDispatcher* mBulletCollisionDispatcher;
 	btBroadphaseInterface* mBulletBroadphase;
-	btConstraintSolver* mBulletConstraintSolver; //default, no multithreading
+	BroadphaseOptions mBroadphaseOptions;
+	BroadphaseProfile* mBroadphaseProfile; //mBulletBroadphase, profiled
+	btConstraintSolver* mBulletConstraintSolver; //a pool of solvers in PHYS_RIGID_MT
+	btConstraintSolver* mBulletConstraintSolverMt; //PHYS_RIGID_MT only, for the large islands
+	btITaskScheduler* mBulletTaskScheduler; //PHYS_RIGID_MT only, shared by all such worlds
 
 	btDynamicsWorld* mBulletDynamicsWorld;
 	btSoftBodyWorldInfo mBulletSoftWorldInfo;
@@ -63,13 +176,119 @@ private:
 	btAlignedObjectArray<btSoftSoftCollisionAlgorithm*> mBulletSoftSoftAlgorithms;
 	btAlignedObjectArray<btSoftRigidCollisionAlgorithm*> mBulletSoftRigidAlgorithms;
 
-	int mMaxSubSteps;
+	FixedTimeStep mFixedTimeStep;
+	//dynamic bodies transforms before the last step, indexed as mBodyList.
+	std::vector<btTransform> mPreviousTransforms;
+	std::vector<BodyPublishState> mPublishStates; //indexed as mBodyList
+	float mMotionEpsilon;
+
+	GravityField mGravityField;
+	std::vector<uint> mFieldBodies; //in mBodyList, of the bodies in the field at this step
+	std::vector<float> mFieldPositions; //x, y, z per body in the field
+	std::vector<float> mFieldMasses;
+	std::vector<float> mFieldAccelerations;
+
+	uint mReportingBodies; //with contact report flags: no manifold is looked at without any
+	std::vector<ContactPair> mContactPairs; //of the last step, sorted
+	std::vector<ContactPair> mStepPairs; //of the step being gathered
+	std::vector<ContactReport> mContacts; //reported since the last snapshot, by the thread stepping the world
 
 	void AddRigidBody(PhysicsBodyPtr body);
 	void AddSoftBody(PhysicsBodyPtr body);
+
+	void StepWorld(float timeStep);
+	/*finds the pairs in contact in Bullet's manifolds, and reports those that started, went on or stopped
+	  touching since the previous step, as their flags ask.*/
+	void GatherContacts();
+	void ReportContact(const ContactPair& pair, eContactPhase phase);
+	//sets the force of the gravity field on every dynamic rigid body.
+	void ApplyGravityField();
+	void GetBodyTransform(uint index, btTransform& trans);
+	void SavePreviousStates();
+	//copies the previous and current state of each dynamic body that moved since it was last published.
+	void CaptureSnapshot(PhysicsSnapshot& snapshot);
+	//the bodies in a snapshot that was dropped are published again by the next one.
+	void RepublishSnapshot(PhysicsSnapshot& snapshot);
+	//sends an ObjectMovedEvent per body in the snapshot, and the contacts as one ContactsEvent, which takes them.
+	void PublishSnapshot(PhysicsSnapshot& snapshot, std::vector<ContactReport>& contacts);
+
+	//runs the command now, or queues it for the physics thread.
+	void SubmitCommand(PhysicsCommand& command);
+	void ExecuteCommand(PhysicsCommand& command);
+	void ExecuteQueuedCommands();
+	PhysicsBody* FindBody(uint bodyID);
+
+	//the PHYS_CMD_RESTORE_WORLD command.
+	void ApplyWorldSnapshot(const std::string& snapshot);
+	//puts a rigid body of mBodyList back in the state Bullet serialized.
+	void RestoreBodyState(uint index, const btRigidBodyData& state);
+
+	void PhysicsThread();
+
+	//a RunQueries call, split across the threads.
+	struct QueryBatch
+	{
+		DefaultPhysicsEngine* engine;
+		const PhysicsQuery* queries;
+		PhysicsQueryResult* results;
+	};
+
+	static void RunQueryRange(void* context, int begin, int end);
+	void RunRay(const PhysicsQuery& query, PhysicsQueryResult& result);
+	void RunSweep(const PhysicsQuery& query, PhysicsQueryResult& result);
+	void RunOverlap(const PhysicsQuery& query, PhysicsQueryResult& result);
+
+	//held by the physics thread while it changes the world, and by RunQueries while it reads it.
+	std::mutex mWorldMutex;
+
+	/*Triple buffering: the physics thread fills the back snapshot while the main thread reads the front one.
+	  A finished snapshot is swapped with the ready one, and the main thread swaps the ready one with the front
+	  when it is newer: neither thread ever waits for the other, and a snapshot is never written while it is read.
+	  Indices are swapped atomically, with SNAPSHOT_NEW flagging a ready snapshot not yet picked up. */
+	static const uint SNAPSHOT_NEW = 0x4;
+
+	PhysicsSnapshot mSnapshots[3];
+	uint mFrontSnapshot; //main thread
+	uint mBackSnapshot; //physics thread
+	std::atomic<uint> mReadySnapshot;
+
+	std::thread mThread;
+	std::atomic<bool> bThreadRunning;
+	bool bThreaded;
+	bool bBackground;
+	FixedTimeStep mBackgroundTimeStep; //the PhysicsWorldPool thread
+
+	std::mutex mCommandMutex;
+	std::vector<PhysicsCommand> mCommands;
+	std::vector<PhysicsCommand> mExecutingCommands; //physics thread
+
+	/*contacts don't go through the snapshots: those are dropped when the main thread falls behind, and contacts
+	  can't be. The physics thread hands them over after each snapshot, the main thread takes them all at Update.*/
+	std::mutex mContactMutex;
+	std::vector<ContactReport> mThreadContacts;
+	std::vector<ContactReport> mPublishedContacts; //main thread
+
+	//accumulated by the physics thread, collected by Update.
+	std::atomic<uint> mThreadSteps;
+	std::atomic<uint> mThreadStepTime; //microseconds
+	std::atomic<uint> mDroppedSnapshots;
+
+	/*when the physics thread was busy, taken by Update and matched against the calls to Update: the rest
+	  of the time it ran in parallel with the main thread's frame (see PhysicsStats::overlapTime).*/
+	typedef std::pair<std::chrono::steady_clock::time_point, std::chrono::steady_clock::time_point> TimeInterval;
+	std::mutex mStepIntervalMutex;
+	std::vector<TimeInterval> mThreadStepIntervals;
+	std::vector<TimeInterval> mStepIntervals; //main thread
+	TimeInterval mLastUpdate; //main thread
+
+	void UpdateBodyStats();
+	void UpdateBroadphaseStats();
+
+	PhysicsStats mStats;
 };
 
-inline void DefaultPhysicsEngine::SetMaxSubSteps(int stepNo) { mMaxSubSteps = stepNo; }
+inline bool DefaultPhysicsEngine::IsThreaded() { return bThreaded; }
+inline const PhysicsStats& DefaultPhysicsEngine::GetStats() { return mStats; }
 inline btSoftBodyWorldInfo DefaultPhysicsEngine::GetSoftWorldInfo() { return mBulletSoftWorldInfo; }
 inline void DefaultPhysicsEngine::SetSoftWorldInfo(float air_density, float water_density, float water_offset, Vector3 water_normal)
 {
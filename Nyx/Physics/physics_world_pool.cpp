@@ -0,0 +1,141 @@
+/*
+
+Physics World Pool
+
+*/
+
+#include "physics_world_pool.h"
+#include "physics_engine.h"
+#include "Utils/task_scheduler.h"
+
+using namespace std::chrono;
+
+namespace NYX {
+
+PhysicsWorldPool::PhysicsWorldPool(uint numThreads) :
+	bStopping(false)
+{
+	if (numThreads == 0)
+		numThreads = 1;
+
+	for (uint i = 0; i < numThreads; i++)
+		mWorkers.push_back(std::thread(&PhysicsWorldPool::WorkerThread, this));
+}
+
+PhysicsWorldPool::~PhysicsWorldPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		bStopping = true;
+	}
+
+	mWakeUp.notify_all();
+
+	for (uint i = 0; i < mWorkers.size(); i++)
+		mWorkers[i].join();
+}
+
+void PhysicsWorldPool::AddWorld(DefaultPhysicsEngine* world, float rate)
+{
+	PoolWorld poolWorld;
+	poolWorld.world = world;
+	poolWorld.interval = duration_cast<steady_clock::duration>(duration<float>(1.0f / rate));
+	poolWorld.lastStep = steady_clock::now();
+	poolWorld.due = poolWorld.lastStep + poolWorld.interval;
+	poolWorld.bBusy = false;
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mWorlds.push_back(poolWorld);
+	}
+
+	mWakeUp.notify_all();
+}
+
+void PhysicsWorldPool::RemoveWorld(DefaultPhysicsEngine* world)
+{
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+
+		for (uint i = 0; i < mWorlds.size(); i++)
+		{
+			if (mWorlds[i].world != world)
+				continue;
+
+			//let the step under way finish: the world may be changed or deleted right after.
+			while (mWorlds[i].bBusy)
+				mWakeUp.wait(lock);
+
+			//the vector doesn't change while the world is busy: only this call removes it.
+			mWorlds.erase(mWorlds.begin() + i);
+			break;
+		}
+	}
+
+	mWakeUp.notify_all();
+}
+
+uint PhysicsWorldPool::GetWorldCount()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return (uint)mWorlds.size();
+}
+
+void PhysicsWorldPool::WorkerThread()
+{
+	TaskScheduler::SetInlineThread();
+
+	std::unique_lock<std::mutex> lock(mMutex);
+
+	while (!bStopping)
+	{
+		//the world that has been due the longest.
+		int next = -1;
+
+		for (uint i = 0; i < mWorlds.size(); i++)
+		{
+			if (!mWorlds[i].bBusy && (next < 0 || mWorlds[i].due < mWorlds[next].due))
+				next = (int)i;
+		}
+
+		if (next < 0)
+		{
+			mWakeUp.wait(lock);
+			continue;
+		}
+
+		steady_clock::time_point now = steady_clock::now();
+		PoolWorld& poolWorld = mWorlds[next];
+
+		if (poolWorld.due > now)
+		{
+			mWakeUp.wait_until(lock, poolWorld.due);
+			continue;
+		}
+
+		DefaultPhysicsEngine* world = poolWorld.world;
+		float elapsed = duration<float>(now - poolWorld.lastStep).count();
+
+		poolWorld.bBusy = true;
+		poolWorld.lastStep = now;
+		poolWorld.due += poolWorld.interval;
+
+		//fallen behind: the world drops the time it can't make up, the pool doesn't try either.
+		if (poolWorld.due < now)
+			poolWorld.due = now + poolWorld.interval;
+
+		lock.unlock();
+		world->StepBackground(elapsed);
+		lock.lock();
+
+		for (uint i = 0; i < mWorlds.size(); i++)
+		{
+			if (mWorlds[i].world == world)
+				mWorlds[i].bBusy = false;
+		}
+
+		mWakeUp.notify_all();
+	}
+}
+
+}
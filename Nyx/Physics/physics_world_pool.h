@@ -0,0 +1,64 @@
+/*
+
+Physics World Pool
+
+*/
+
+#ifndef PHYSICS_WORLD_POOL_H
+#define PHYSICS_WORLD_POOL_H
+
+#include "singleton.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace NYX {
+
+class DefaultPhysicsEngine;
+
+/*
+Worker threads stepping the worlds of the scenes that are not on screen (see IPhysicsEngine::SetBackground),
+each at its own reduced rate. A world is stepped by one worker at a time, whichever is free when it is due:
+the worlds run in parallel with each other and with the main thread.
+The workers run the loops the worlds give the TaskScheduler inline: its threads belong to the main thread.
+*/
+class NYX_EXPORT PhysicsWorldPool : public SingletonClass<PhysicsWorldPool>
+{
+public:
+
+	PhysicsWorldPool(uint numThreads = 2);
+	~PhysicsWorldPool();
+
+	//steps the world every 1/rate s of real time, until removed.
+	void AddWorld(DefaultPhysicsEngine* world, float rate);
+	//returns once the world is not being stepped anymore.
+	void RemoveWorld(DefaultPhysicsEngine* world);
+	uint GetWorldCount();
+
+private:
+
+	struct PoolWorld
+	{
+		DefaultPhysicsEngine* world;
+		std::chrono::steady_clock::duration interval;
+		std::chrono::steady_clock::time_point due;
+		std::chrono::steady_clock::time_point lastStep;
+		bool bBusy; //a worker is stepping it
+	};
+
+	void WorkerThread();
+
+	std::vector<std::thread> mWorkers;
+
+	std::mutex mMutex;
+	std::condition_variable mWakeUp; //a world was added, removed or stepped
+	std::vector<PoolWorld> mWorlds;
+	bool bStopping;
+};
+
+}
+
+#endif // PHYSICS_WORLD_POOL_H
@@ -15,8 +15,8 @@ using namespace std;
 
 namespace NYX {
 
-RigidBody::RigidBody(std::string name, uint id) :
-	PhysicsBody(name, id),
+RigidBody::RigidBody(std::string name, uint id, CollisionShapeCachePtr shapeCache) :
+	PhysicsBody(name, id, shapeCache),
 	mBulletRigidBody(NULL)
 {
 	mBodyType = BDY_RIGID;
@@ -41,12 +41,24 @@ void RigidBody::Finilize()
 
 	mBulletRigidBody->setDamping(mDamping, mAngularDamping);
 
+	//what the queries report, see IPhysicsEngine::RunQueries.
+	mBulletRigidBody->setUserIndex((int)mID);
+	//read from the contact manifolds by the engine after every step. Bullet's default is -1.
+	mBulletRigidBody->setUserIndex2((int)mContactReport);
+
 	mIsInitialized = true;
 }
 
 void RigidBody::CalculateTotalForce()
 {
-	//mBulletRigidBody->applyForce(btVector3(0.21, 0.0, 0.0), btVector3(0.1, 0.0, 0.2));
+	//bullet clears the forces after every step.
+	btVector3 force = btVector3(mForce.X(), mForce.Y(), mForce.Z()) + mFieldForce;
+
+	if (force.x() != 0.0f || force.y() != 0.0f || force.z() != 0.0f)
+	{
+		mBulletRigidBody->applyCentralForce(force);
+		mBulletRigidBody->activate();
+	}
 }
 
 }
@@ -18,12 +18,13 @@ class RigidBody : public PhysicsBody
 {
 public:
 
-    RigidBody(std::string name, uint id);
+    RigidBody(std::string name, uint id, CollisionShapeCachePtr shapeCache = CollisionShapeCachePtr());
     ~RigidBody();
 
 	void Finilize();
 
 	btRigidBody* GetBulletRigidBody();
+	bool IsActive();
 
 	void CalculateTotalForce();
 
@@ -33,6 +34,7 @@ private:
 };
 
 inline btRigidBody* RigidBody::GetBulletRigidBody() { return mBulletRigidBody; }
+inline bool RigidBody::IsActive() { return mBulletRigidBody->isActive(); }
 
 }
 
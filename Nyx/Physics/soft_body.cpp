@@ -7,6 +7,9 @@ A Soft Body
 #include "soft_body.h"
 #include "Utils/log_manager.h"
 
+#include <map>
+#include <array>
+
 using namespace std;
 
 namespace NYX {
@@ -26,11 +29,12 @@ SoftBody::~SoftBody()
     mBulletSoftBody = NULL;
 }
 
-void SoftBody::SetMesh(float* rawVertices, int totalVertices, int stride, int* indices)
+void SoftBody::SetMesh(float* rawVertices, int totalVertices, int stride, int* indices, int totalIndices)
 {
 	mMeshInfo.vertices = rawVertices;
 	mMeshInfo.indices = indices;
 	mMeshInfo.totalVertices = totalVertices;
+	mMeshInfo.totalIndices = totalIndices;
 	mMeshInfo.stride = stride;
 	mHasMesh = true;
 }
@@ -43,15 +47,51 @@ void SoftBody::SetMaterialInfo(float kLST, float kAST, float kVST, float density
 	mMaterialInfo.density = density;
 }
 
+void SoftBody::SetConfigurationOptions(int iterations, float kdf)
+{
+	mIterations = iterations;
+	mKDF = kdf;
+}
+
 void SoftBody::Finilize()
 {
-	if (!mHasMesh || mMeshInfo.indices == NULL)
+	if (!mHasMesh || mMeshInfo.indices == NULL || mMeshInfo.totalIndices < 3)
 	{
 		LogManager::GetInstance()->LogMessage("Error! Cannot initialize Bullet soft body without a mesh!");
 		return;
 	}
 
-	mBulletSoftBody = btSoftBodyHelpers::CreateFromTriMesh(mBulletSoftWorldInfo, mMeshInfo.vertices, mMeshInfo.indices, mMeshInfo.totalVertices/3);
+	/*Rendered meshes split vertices along texture and normal seams: welding them by position gives
+	  one node per point of the surface, so that the body doesn't tear along the seams.
+	  mVertexToNode maps the rendered vertices back to the nodes when writing the deformed mesh.
+	*/
+	std::map<std::array<float, 3>, int> welded;
+	std::vector<float> nodes;
+	std::vector<int> triangles(mMeshInfo.totalIndices);
+
+	mVertexToNode.resize(mMeshInfo.totalVertices);
+
+	for (int i = 0; i < mMeshInfo.totalVertices; i++)
+	{
+		const float* pos = (const float*)((const char*)mMeshInfo.vertices + i*mMeshInfo.stride);
+		std::array<float, 3> key = {{ pos[0], pos[1], pos[2] }};
+
+		auto node = welded.find(key);
+
+		if (node == welded.end())
+		{
+			node = welded.insert(std::make_pair(key, (int)nodes.size()/3)).first;
+			nodes.insert(nodes.end(), key.begin(), key.end());
+		}
+
+		mVertexToNode[i] = node->second;
+	}
+
+	for (int i = 0; i < mMeshInfo.totalIndices; i++)
+		triangles[i] = mVertexToNode[mMeshInfo.indices[i]];
+
+	mBulletSoftBody = btSoftBodyHelpers::CreateFromTriMesh(mBulletSoftWorldInfo, &nodes[0], &triangles[0], mMeshInfo.totalIndices/3);
+	mMeshInfo.Reset();
 	
 	mBulletSoftBody->setTotalMass(mMass, true);
 
@@ -79,65 +119,65 @@ void SoftBody::Finilize()
 
 	mBulletSoftBody->randomizeConstraints();
 
+	mBulletSoftBody->setUserIndex((int)mID);
+
 	mIsInitialized = true;
 }
 
 void SoftBody::CalculateTotalForce()
 {
-	//mBulletRigidBody->applyForce(btVector3(0.21, 0.0, 0.0), btVector3(0.1, 0.0, 0.2));
+	//applied to every node.
+	if (mForce.X() != 0.0f || mForce.Y() != 0.0f || mForce.Z() != 0.0f)
+		mBulletSoftBody->addForce(btVector3(mForce.X(), mForce.Y(), mForce.Z()));
 }
 
-float* SoftBody::GetUpdatedMesh()
+void SoftBody::SetVertexStream(VertexStreamPtr stream)
 {
-	int triangles =  mBulletSoftBody->m_faces.size();
-	int numVertex = triangles*3;
-	int size = numVertex*6; //3 position + 3 normal
-	float* mesh = new float[size];
-	int triangle_stride = 6*3;
+	if (stream && stream->GetVertexCount() != mVertexToNode.size())
+	{
+		LogManager::GetInstance()->LogMessage("Error! Soft body vertex stream doesn't match the body mesh!");
+		return;
+	}
+
+	mVertexStream = stream;
+}
+
+bool SoftBody::WriteVertexStream()
+{
+	if (!mVertexStream || !mIsInitialized)
+		return false;
 
-	btVector3 pos;
-	btVector3 norm;
+	float* vertices = mVertexStream->BeginWrite();
 
-	for (int i = 0; i < triangles; i++)
+	//the reader is still using both regions
+	if (vertices == NULL)
+		return false;
+
+	//the scene node places the mesh with the body transform: take it out of the node positions.
+	btTransform toBody = mBulletSoftBody->getWorldTransform().inverse();
+	const btMatrix3x3& rotation = toBody.getBasis();
+
+	uint stride = mVertexStream->GetStride();
+	btSoftBody::Node* nodes = &mBulletSoftBody->m_nodes[0];
+
+	for (uint i = 0; i < mVertexToNode.size(); i++)
 	{
-		//mBulletSoftBody->m_faces[i].m_normal; //per-triangle normal
-		//vertex 1
-		pos = mBulletSoftBody->m_faces[i].m_n[0]->m_x; //position
-		norm = mBulletSoftBody->m_faces[i].m_n[0]->m_n;  //per-vertex normal
-		
-		mesh[i*triangle_stride + 0] = pos.x();
-		mesh[i*triangle_stride + 1] = pos.y();
-		mesh[i*triangle_stride + 2] = pos.z();
-		mesh[i*triangle_stride + 3] = norm.x();
-		mesh[i*triangle_stride + 4] = norm.y();
-		mesh[i*triangle_stride + 5] = norm.z();
-
-		//vertex 2
-		pos = mBulletSoftBody->m_faces[i].m_n[1]->m_x; //position
-		norm = mBulletSoftBody->m_faces[i].m_n[1]->m_n;
-
-		mesh[i*triangle_stride + 6*1 + 0] = pos.x();
-		mesh[i*triangle_stride + 6*1 + 1] = pos.y();
-		mesh[i*triangle_stride + 6*1 + 2] = pos.z();
-		mesh[i*triangle_stride + 6*1 + 3] = norm.x();
-		mesh[i*triangle_stride + 6*1 + 4] = norm.y();
-		mesh[i*triangle_stride + 6*1 + 5] = norm.z();
-
-		//vertex 3
-		pos = mBulletSoftBody->m_faces[i].m_n[2]->m_x; //position
-		norm = mBulletSoftBody->m_faces[i].m_n[2]->m_n;
-
-		mesh[i*triangle_stride + 6*2 + 0] = pos.x();
-		mesh[i*triangle_stride + 6*2 + 1] = pos.y();
-		mesh[i*triangle_stride + 6*2 + 2] = pos.z();
-		mesh[i*triangle_stride + 6*2 + 3] = norm.x();
-		mesh[i*triangle_stride + 6*2 + 4] = norm.y();
-		mesh[i*triangle_stride + 6*2 + 5] = norm.z();
+		const btSoftBody::Node& node = nodes[mVertexToNode[i]];
+		btVector3 pos = toBody(node.m_x);
+		btVector3 norm = rotation * node.m_n;
+
+		float* vertex = vertices + i*stride;
+		vertex[0] = pos.x();
+		vertex[1] = pos.y();
+		vertex[2] = pos.z();
+		vertex[3] = norm.x();
+		vertex[4] = norm.y();
+		vertex[5] = norm.z();
 	}
 
-	return mesh;
-}
+	mVertexStream->EndWrite();
 
+	return true;
 }
 
-
+}
@@ -8,6 +8,7 @@
  */
 
 #include "body.h"
+#include "Utils/vertex_stream.h"
 #include "btBulletDynamicsCommon.h"
 #include "BulletSoftBody/btSoftBody.h"
 #include "BulletSoftBody/btSoftBodyHelpers.h"
@@ -26,6 +27,7 @@ class SoftBody : public PhysicsBody
 			vertices(NULL),
 			indices(NULL),
 			totalVertices(0),
+			totalIndices(0),
 			stride(0)
 		{}
 		~MeshInfo() {
@@ -36,12 +38,14 @@ class SoftBody : public PhysicsBody
 			vertices = NULL;
 			indices = NULL;
 			totalVertices = 0;
+			totalIndices = 0;
 			stride = 0;
 		}
 
-		float* vertices; //groups of x,y,z coordinates
-		int* indices;
+		float* vertices; //x,y,z coordinates first, every stride bytes
+		int* indices; //triangles
 		int totalVertices;
+		int totalIndices;
 		int stride;
 
 	}mMeshInfo;
@@ -66,16 +70,22 @@ public:
     SoftBody(std::string name, uint id, btSoftBodyWorldInfo& softWorldInfo);
     ~SoftBody();
 
-	void SetMesh(float* rawVertices, int totalVertices, int stride, int* indices = NULL);
+	//vertices as they are rendered: those with the same position become one Bullet node.
+	void SetMesh(float* rawVertices, int totalVertices, int stride, int* indices = NULL, int totalIndices = 0);
 	void SetMaterialInfo(float kLST, float kAST, float kVST, float density);
 	void SetConfigurationOptions(int iterations, float kdf);
 
 	void Finilize();
 
 	btSoftBody* GetBulletSoftBody();
+	bool IsActive();
 
 	void CalculateTotalForce();
-	float* GetUpdatedMesh(); //vertex position and normals only
+
+	//the deformed vertices are written straight into the stream, one vertex per vertex passed to SetMesh,
+	//position followed by normal, in the body's frame. Returns false if the update was skipped.
+	void SetVertexStream(VertexStreamPtr stream);
+	bool WriteVertexStream();
 
 private:
 
@@ -84,9 +94,13 @@ private:
 
 	int mIterations;
 	float mKDF; //dynamic friction coefficient
+
+	std::vector<int> mVertexToNode; //Bullet node of each vertex passed to SetMesh
+	VertexStreamPtr mVertexStream;
 };
 
 inline btSoftBody* SoftBody::GetBulletSoftBody() { return mBulletSoftBody; }
+inline bool SoftBody::IsActive() { return mBulletSoftBody->isActive(); }
 }
 
 #endif // SOFTBODY_H
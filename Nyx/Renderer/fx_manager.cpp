@@ -34,16 +34,58 @@ FXManager::~FXManager()
 		clReleaseKernel((*it).second);
 	}
 
-	clReleaseCommandQueue(mCommandQueue);
-	clReleaseContext(mCLContext);
+	if (mCommandQueue)
+		clReleaseCommandQueue(mCommandQueue);
+	if (mCLContext)
+		clReleaseContext(mCLContext);
 }
 
-void FXManager::Initialize(SDL_Window *win, SDL_SysWMinfo winInfo, IRenderer* renderer)
+bool FXManager::Initialize(SDL_Window *win, SDL_SysWMinfo winInfo, IRenderer* renderer)
 {
     mRenderer = renderer;
-    
+
+	if (!selectDevice())
+		return false;
+	
 	//init CL context from GL context
-	cl_uint platform_count;
+    mCLContext = mRenderer->InitialiseCLContextFromGLContext( &mCLDevice, mCLPlatform, mCPUDevice, mLastError );
+
+	if (!checkError(mLastError, "Error! Failed to share the GL context with OpenCL: particles run on the CPU."))
+		return false;
+
+	mCommandQueue = clCreateCommandQueueWithProperties(mCLContext, mCLDevice, 0, &mLastError);
+	
+	if (!checkError(mLastError, "Error! Failed to create the OpenCL command queue: particles run on the CPU."))
+		return false;
+
+	initGLEvents();
+
+	bCLAvailable = true;
+	return true;
+}
+
+bool FXManager::InitializeCompute()
+{
+	if (!selectDevice())
+		return false;
+
+	mCLContext = clCreateContext(NULL, 1, &mCLDevice, NULL, NULL, &mLastError);
+
+	if (!checkError(mLastError, "Error! Failed to create an OpenCL context."))
+		return false;
+
+	mCommandQueue = clCreateCommandQueueWithProperties(mCLContext, mCLDevice, 0, &mLastError);
+
+	if (!checkError(mLastError, "Error! Failed to create the OpenCL command queue."))
+		return false;
+
+	bCLAvailable = true;
+	return true;
+}
+
+bool FXManager::selectDevice()
+{
+	cl_uint platform_count = 0;
 	cl_platform_id platforms[MAX_CL_DEVICES];
 	cl_device_id devices[MAX_CL_DEVICES];
 	cl_uint dev_count = 0;
@@ -52,7 +94,9 @@ void FXManager::Initialize(SDL_Window *win, SDL_SysWMinfo winInfo, IRenderer* re
 	std::vector<Device> cpu_devices;
 	
 	mLastError = clGetPlatformIDs(MAX_CL_DEVICES, platforms, &platform_count);
-	checkError(mLastError, "Error getting platform IDs");
+	
+	if (!checkError(mLastError, "Error! No OpenCL platform found: particles run on the CPU."))
+		return false;
 
 	for (int i = 0; i < int(platform_count); i++)
 	{
@@ -87,8 +131,8 @@ void FXManager::Initialize(SDL_Window *win, SDL_SysWMinfo winInfo, IRenderer* re
 	
 	if (gpu_devices.empty() && cpu_devices.empty())
 	{
-		LogManager::GetInstance()->LogMessage("Error! No devices found. Terminating Program.");
-		exit(-1);
+		LogManager::GetInstance()->LogMessage("Error! No OpenCL devices found: particles run on the CPU.");
+		return false;
 	}
 	
 
@@ -113,34 +157,63 @@ void FXManager::Initialize(SDL_Window *win, SDL_SysWMinfo winInfo, IRenderer* re
 	}
 	
 	//fall back to CPU if no suitable GPU was found
-	// grab the first CPU, unlikely there will be more than one
+	// grab the first CPU, unlikely there will be more than one. Without any, the first GPU.
 	if (!foundNvidiaGPU)
 	{
-		mCLPlatform = cpu_devices.front().first;
-		mCLDevice = cpu_devices.front().second;
+		Device device = cpu_devices.empty() ? gpu_devices.front() : cpu_devices.front();
+		mCLPlatform = device.first;
+		mCLDevice = device.second;
 	}
 
+	mCPUDevice = cpu_devices.empty() ? cl_device_id() : cpu_devices.front().second;
+
 	LogManager::GetInstance()->LogMessage("*** Selected CL Device ****");
 	dumpDeviceInfo(mCLDevice);
 	LogManager::GetInstance()->LogMessage("*******");
-	
-	cl_device_id cpu_fallback = cpu_devices.empty() ? cl_device_id() : cpu_devices.front().second;
-    mCLContext = mRenderer->InitialiseCLContextFromGLContext( &mCLDevice, mCLPlatform, cpu_fallback, mLastError );
 
-	mCommandQueue = clCreateCommandQueueWithProperties(mCLContext, mCLDevice, 0, &mLastError);
-	checkError(mLastError, "Error generating command queue.");
+	return true;
 }
 
-void FXManager::checkError(cl_int error_code, string message)
+cl_event FXManager::CreateEventFromGLSync(cl_GLsync sync)
+{
+	if (mCreateEventFromGLsync == nullptr || sync == nullptr)
+		return NULL;
+
+	cl_int error;
+	cl_event event = mCreateEventFromGLsync(mCLContext, sync, &error);
+
+	return (error == CL_SUCCESS) ? event : NULL;
+}
+
+void FXManager::initGLEvents()
+{
+	size_t size = 0;
+	clGetDeviceInfo(mCLDevice, CL_DEVICE_EXTENSIONS, 0, NULL, &size);
+
+	std::vector<char> extensions(size + 1, '\0');
+	clGetDeviceInfo(mCLDevice, CL_DEVICE_EXTENSIONS, size, &extensions[0], NULL);
+
+	if (std::string(&extensions[0]).find("cl_khr_gl_event") != std::string::npos)
+		mCreateEventFromGLsync = (CreateEventFromGLsyncProc)clGetExtensionFunctionAddressForPlatform(mCLPlatform, "clCreateEventFromGLsyncKHR");
+
+	if (mCreateEventFromGLsync)
+		LogManager::GetInstance()->LogMessage("OpenCL: cl_khr_gl_event, the particle buffers are synchronized on the device.");
+	else
+		LogManager::GetInstance()->LogMessage("OpenCL: no cl_khr_gl_event, the particle buffers are synchronized on the CPU.");
+}
+
+bool FXManager::checkError(cl_int error_code, string message)
 {
 	if (error_code != CL_SUCCESS)
 	{
 		string msg = message + "\n";
 		msg += "Code: ";
-		msg += error_code;
+		msg += std::to_string(error_code);
 		LogManager::GetInstance()->LogMessage(msg);
-		exit(error_code);
+		return false;
 	}
+
+	return true;
 }
 
 void FXManager::displayBuildLog(cl_program program, cl_device_id device)
@@ -274,21 +347,30 @@ cl_program FXManager::CreateProgram(std::string programName)
 	if (mCompiledPrograms.find(programName) != mCompiledPrograms.end())
 		return mCompiledPrograms[programName];
 
+	if (!bCLAvailable)
+		return NULL;
+
 	char *src = ResourceCache::GetInstance()->RequestSourceCode(programName);
 	size_t src_size = strlen(src);
 
 	cl_program program = clCreateProgramWithSource(mCLContext, 1, (const char**)&src, &src_size, &mLastError);
-	checkError(mLastError, "Failed to create program.");
+	delete src;
+
+	if (!checkError(mLastError, "Error! Failed to create program " + programName + "."))
+		return NULL;
 
 	mLastError = clBuildProgram(program, 1, &mCLDevice, NULL, NULL, NULL);
 	// Shows the log
 	displayBuildLog(program, mCLDevice);
-	checkError(mLastError, "Failed to compile program.");
+	
+	if (!checkError(mLastError, "Error! Failed to compile program " + programName + "."))
+	{
+		clReleaseProgram(program);
+		return NULL;
+	}
 
 	mCompiledPrograms[programName] = program;
 
-	delete src;
-
 	return program;
 }
 
@@ -309,6 +391,9 @@ cl_kernel FXManager::GetKernel(std::string programName, std::string kernelName)
 		{
 			program = mCompiledPrograms[programName];
 		}
+
+		if (program == NULL)
+			return NULL;
 		
 		kernel = clCreateKernel(program, kernelName.c_str(), &mLastError);
 		if (mLastError == 0)
@@ -321,7 +406,7 @@ cl_kernel FXManager::GetKernel(std::string programName, std::string kernelName)
 			return kernel;
 		else
 		{
-			checkError(mLastError, "Failed to create kernel.");
+			checkError(mLastError, "Error! Failed to create kernel " + kernelName + ".");
 			return NULL;
 		}
 	}
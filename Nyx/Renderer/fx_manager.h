@@ -36,11 +36,21 @@ public:
 	FXManager();
     ~FXManager();
 
-	void Initialize(SDL_Window *win, SDL_SysWMinfo winInfo, IRenderer* renderer);
+	/*an OpenCL context shared with the GL one of the window. Without a device to share it with, false: the particles
+	  then run on the CPU (see CPUParticleKernel).*/
+	bool Initialize(SDL_Window *win, SDL_SysWMinfo winInfo, IRenderer* renderer);
+	//a context of its own, for kernels on plain buffers without a window.
+	bool InitializeCompute();
+	bool IsCLAvailable();
 	cl_context GetCLContext();
 	cl_command_queue GetCommandQueue();
 	cl_program CreateProgram(std::string programName);
 	cl_kernel GetKernel(std::string programName, std::string kernelName);
+	/*cl_khr_gl_event: acquiring and releasing the GL buffers orders the CL commands after the GL ones and the GL
+	  commands after the CL ones on the device, without waiting for either on the CPU.*/
+	bool HasGLEvents();
+	//a CL event that completes with the GL fence, to wait for in the CL queue. NULL without cl_khr_gl_event.
+	cl_event CreateEventFromGLSync(cl_GLsync sync);
 
 private:
 
@@ -50,18 +60,28 @@ private:
 	cl_context mCLContext = nullptr;
 	cl_command_queue mCommandQueue = nullptr;
 	cl_device_id mCLDevice = nullptr;
+	cl_device_id mCPUDevice = nullptr; //tried when the GL context can't be shared with mCLDevice
 
 	std::map<std::string, cl_program> mCompiledPrograms;
 	std::map<std::string, cl_kernel> mKernels;
 
-	void checkError(cl_int error_code, std::string message);
+	bool bCLAvailable = false;
+
+	typedef cl_event (CL_API_CALL *CreateEventFromGLsyncProc)(cl_context context, cl_GLsync sync, cl_int* errcode_ret);
+	CreateEventFromGLsyncProc mCreateEventFromGLsync = nullptr;
+
+	bool selectDevice();
+	bool checkError(cl_int error_code, std::string message);
+	void initGLEvents();
 	void displayBuildLog(cl_program program, cl_device_id device);
 	void dumpPlatformInfo(cl_platform_id platform);
 	void dumpDeviceInfo(cl_device_id device);
 };
 
+inline bool FXManager::IsCLAvailable() { return bCLAvailable; }
 inline cl_context FXManager::GetCLContext() { return mCLContext; }
 inline cl_command_queue FXManager::GetCommandQueue() { return mCommandQueue; }
+inline bool FXManager::HasGLEvents() { return mCreateEventFromGLsync != nullptr; }
 
 }
 
@@ -17,7 +17,8 @@ namespace NYX {
 	enum eRenderer
 	{
 		OPENGL = 0x1,
-		D3D
+		D3D,
+		HEADLESS //no window and nothing drawn, see NullRenderer
 	};
 
 
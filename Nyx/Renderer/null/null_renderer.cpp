@@ -0,0 +1,282 @@
+/*
+
+ Null Renderer Backend
+
+ */
+
+#include "null_renderer.h"
+#include "shader_utils.h"
+#include "log_manager.h"
+
+#include <cassert>
+#include <cstring>
+
+namespace NYX {
+
+// the uniforms are declared in the effect file: no need to compile it to know them.
+class NullShaderHelper : public ShaderHelper
+{
+public:
+
+    NullShaderHelper(const string& shader_name) :
+        ShaderHelper(shader_name)
+    {}
+
+    bool LoadEffectFromFile(std::string shader_file)            { return ParseShaderFile(shader_file); }
+};
+
+NullRenderer::NullRenderer() :
+	mActiveEffect(nullptr),
+	mTextureStackDepth(0)
+{
+	mCurrentViewport.width = 0;
+	mCurrentViewport.height = 0;
+	mCurrentViewport.x = 0;
+	mCurrentViewport.y = 0;
+
+	LogManager::GetInstance()->LogMessage("Headless: nothing will be drawn.");
+}
+
+NullRenderer::~NullRenderer()
+{
+	for (EffectsMap::iterator fx_it = mEffects.begin(); fx_it != mEffects.end(); ++fx_it )
+	{
+		delete (*fx_it).second;
+	}
+
+	mActiveEffect = nullptr;
+}
+
+void NullRenderer::SetViewport(int x, int y, int w, int h)
+{
+	mCurrentViewport.width = w;
+	mCurrentViewport.height = h;
+	mCurrentViewport.x = x;
+	mCurrentViewport.y = y;
+}
+
+void NullRenderer::GetViewport(int &x, int &y, int &w, int &h)
+{
+	x = mCurrentViewport.x;
+	y = mCurrentViewport.y;
+	w = mCurrentViewport.width;
+	h = mCurrentViewport.height;
+}
+
+cl_context NullRenderer::InitialiseCLContextFromGLContext( cl_device_id *device_id, cl_platform_id platfrom_id, cl_device_id cpu_fallback, int& error_code )
+{
+	error_code = -1;
+	return nullptr;
+}
+
+VertexBuffer* NullRenderer::CreateVertexBuffer( void )
+{
+	return new NullVertexBuffer();
+}
+
+IndexBuffer* NullRenderer::CreateIndexBuffer( void )
+{
+	return new NullIndexBuffer();
+}
+
+VertexArrayObject* NullRenderer::CreateVertexArrayObject( void )
+{
+	return new NullVertexArrayObject();
+}
+
+RenderBuffer* NullRenderer::CreateRenderBuffer( void )
+{
+	return new NullRenderBuffer();
+}
+
+// ----------------
+// Textures
+// ----------------
+
+Texture* NullRenderer::CreateTexture( void )
+{
+	return new NullTexture();
+}
+
+void NullRenderer::BindTexture( Texture* texture )
+{
+	texture->Bind();
+
+	mTextureStackDepth++;
+}
+
+void NullRenderer::UnbindAllTextures()
+{
+	mTextureStackDepth = 0;
+}
+
+int NullRenderer::GetActiveTexStackDepth()
+{
+	return mTextureStackDepth;
+}
+
+// ----------------
+
+Effect* NullRenderer::CreateShaderProgram(std::string shaderName)
+{
+	EffectsMap::iterator fx_it = mEffects.find(shaderName);
+
+	if (fx_it != mEffects.end())
+		return (*fx_it).second;
+
+	NullEffect *fx = new NullEffect(shaderName);
+
+	if (!fx->LoadEffectFromFile(shaderName))
+	{
+		delete fx;
+		return 0;
+	}
+
+	mEffects[shaderName] = fx;
+
+	return fx;
+}
+
+std::list<ShaderUniform>& NullRenderer::GetShaderUniforms(void)
+{
+	assert(mActiveEffect);
+
+	return mActiveEffect->GetShaderUniforms();
+}
+
+void NullRenderer::UseShader(Effect* shader)
+{
+	if (shader == nullptr)
+	{
+		if (mActiveEffect)
+			mActiveEffect->End();
+
+		mActiveEffect = nullptr;
+		return;
+	}
+
+	mActiveEffect = shader;
+
+	mActiveEffect->Begin();
+}
+
+// ----------------
+// Resources
+// ----------------
+
+bool NullEffect::LoadEffectFromFile(std::string shaderName)
+{
+	NullShaderHelper shaderHelper(shaderName);
+
+	if (!shaderHelper.LoadEffectFromFile(shaderName + ".shader"))
+		return false;
+
+	mShaderUniforms = std::move(shaderHelper.GetShaderUniforms());
+
+	return true;
+}
+
+void NullTexture::Create( uint width, uint height, TextureFormat format_in, const ubyte* pixels, bool mipmapped, uint msaa_samples )
+{
+	mTextureInfo.width = width;
+	mTextureInfo.height = height;
+	mTextureInfo.format = format_in;
+	mTextureInfo.is_mipmapped = mipmapped;
+	mTextureInfo.msaa_samples = msaa_samples;
+	mTextureInfo.IsCubeMap = false;
+}
+
+void NullTexture::BeginCubeMap( void )
+{
+	mTextureInfo.IsCubeMap = true;
+	mTextureInfo.msaa_samples = 0;
+	mTextureInfo.is_mipmapped = false;
+}
+
+void NullTexture::AddCubeMapFace(uint face, uint width, uint height, ubyte* pixels)
+{
+	mTextureInfo.width = width;
+	mTextureInfo.height = height;
+	mTextureInfo.format = TextureFormat::RGBA8;
+}
+
+void NullVertexBuffer::Create( size_t vertex_size, uint number_of_vertices, void* vertex_buffer )
+{
+	size_t mem_size = vertex_size * number_of_vertices;
+
+	mData.assign((mem_size + sizeof(float) - 1) / sizeof(float), 0.0f);
+
+	if ( vertex_buffer && mem_size > 0 )
+		memcpy(&mData[0], vertex_buffer, mem_size);
+}
+
+int NullVertexBuffer::CreateCLBufferFromThis( cl_context ctx )
+{
+	return -1; //nothing on a device to share
+}
+
+float* NullVertexBuffer::Lock( void )
+{
+	return mData.empty() ? nullptr : &mData[0];
+}
+
+int NullVertexBuffer::LockCL( cl_command_queue queue )
+{
+	return -1;
+}
+
+int NullVertexBuffer::UnlockCL( cl_command_queue queue, cl_event* released )
+{
+	if ( released )
+		*released = nullptr;
+
+	return -1;
+}
+
+int NullVertexBuffer::UpdateCLBuffer( cl_command_queue queue, size_t size, void* src )
+{
+	return -1;
+}
+
+void NullIndexBuffer::Create( size_t index_size, uint number_of_indices, void* index_buffer )
+{
+	size_t mem_size = index_size * number_of_indices;
+
+	mData.assign((mem_size + sizeof(float) - 1) / sizeof(float), 0.0f);
+
+	if ( index_buffer && mem_size > 0 )
+		memcpy(&mData[0], index_buffer, mem_size);
+}
+
+float* NullIndexBuffer::Lock()
+{
+	return mData.empty() ? nullptr : &mData[0];
+}
+
+void NullRenderBuffer::Create( StorageType storage, uint width, uint height, bool has_stencil, uint msaa )
+{
+	mRenderBufferInfo.width = width;
+	mRenderBufferInfo.height = height;
+	mRenderBufferInfo.has_stencil = has_stencil;
+	mRenderBufferInfo.storage_type = storage;
+	mRenderBufferInfo.msaa = msaa;
+	mRenderBufferInfo.is_multisampled = (storage == StorageType::MULTISAMPLE_STORAGE && msaa > 0);
+
+	// the color and depth are there to be bound, as they would be on a GPU.
+	NullTexture* color = new NullTexture();
+	color->Create(width, height, Texture::TextureFormat::RGBA8, nullptr);
+	mColorTexture = color;
+
+	NullTexture* depth = new NullTexture();
+	depth->Create(width, height, has_stencil ? Texture::TextureFormat::DEPTH_STENCIL : Texture::TextureFormat::DEPTH, nullptr);
+	mDepthStencilTexture = depth;
+
+	mPixels.assign(width * height * 4, 0);
+}
+
+const ubyte* NullRenderBuffer::ReadPixels( void ) const
+{
+	return mPixels.empty() ? nullptr : &mPixels[0];
+}
+
+}
@@ -0,0 +1,228 @@
+/*
+
+ Null Renderer Backend
+
+ */
+
+#ifndef NULLRENDERER_H
+#define NULLRENDERER_H
+
+#include "irenderer.h"
+#include "effect.h"
+#include "texture.h"
+#include "vertex_buffer.h"
+#include "index_buffer.h"
+#include "vertex_array_object.h"
+#include "render_buffer.h"
+
+#include <map>
+#include <vector>
+
+namespace NYX {
+
+/*
+The HEADLESS backend: no window, no GPU. The scenes are set up and updated as usual, and their draws go
+nowhere. Buffers keep their data in memory, so that the nodes writing to them (soft bodies, particles on
+the CPU) do the same work as on screen; shaders are parsed for their uniforms but not compiled.
+For replays on machines without a display (see EventManager::StartReplay).
+*/
+class NYX_EXPORT NullRenderer : public IRenderer
+{
+public:
+
+    NullRenderer();
+    ~NullRenderer();
+
+    void SetViewport(int x, int y, int w, int h) override;
+    void GetViewport(int &x, int &y, int &w, int &h) override;
+    void ClearScreen(float *clearColor = NULL) override {}
+    void SwapBuffers( void ) override {}
+    void EnableDepthTest( void ) override {}
+    void DisableDepthTest( void ) override {}
+    void EnableMSAA( void  ) override {}
+    void DisableMSAA( void ) override {}
+    void EnableCulling( void ) override {}
+    void DisableCulling( void ) override {}
+    void CullFrontFace( void ) override {}
+    void CullBackFace( void ) override {}
+    void SetFrontFaceToCCW( void ) override {}
+    void SetFrontFaceToCW( void ) override {}
+    void EnableAlphaBlending( void ) override {}
+    void DisableAlphaBlending( void ) override {}
+    void EnableMaxAlphaBlending( void ) override {}
+
+    //there is no GL context to share with OpenCL.
+    cl_context InitialiseCLContextFromGLContext( cl_device_id *device_id, cl_platform_id platfrom_id, cl_device_id cpu_fallback, int& error_code ) override;
+
+    void SetActiveCamera(Matrix4x4 &viewMatrix, Matrix4x4 &projectionMatrix,
+                         float clipNear, float clipFar, float fov) override {}
+
+    Texture* CreateTexture( void ) override;
+    void BindTexture(Texture* texture) override;
+    void UnbindAllTextures() override;
+    int GetActiveTexStackDepth() override;
+
+    Effect* CreateShaderProgram(std::string shaderName) override;
+    std::list<ShaderUniform>& GetShaderUniforms(void) override;
+    void LoadShaderUniforms( void ) override {}
+    void UseShader(Effect* shader) override;
+
+    VertexBuffer* CreateVertexBuffer( void ) override;
+    IndexBuffer* CreateIndexBuffer( void ) override;
+    VertexArrayObject* CreateVertexArrayObject( void ) override;
+    RenderBuffer* CreateRenderBuffer( void ) override;
+
+    void BeginScene( void ) override {}
+    void EndScene( void ) override {}
+
+private:
+
+    typedef std::map<std::string, Effect*> EffectsMap;
+
+    struct Viewport
+    {
+        int width;
+        int height;
+        int x;
+        int y;
+    }mCurrentViewport;
+
+    EffectsMap mEffects;
+    Effect *mActiveEffect;
+
+    uint mTextureStackDepth;
+};
+
+// the resources of the null backend, created by NullRenderer only.
+
+class NYX_EXPORT NullEffect : public Effect
+{
+    friend class NullRenderer;
+
+public:
+
+    virtual bool LoadEffectFromFile(std::string shaderName) override;
+    virtual void LoadUniforms( void ) override {}
+    virtual void Begin( void ) override {}
+    virtual void End( void ) override {}
+
+protected:
+
+    NullEffect(std::string name) : Effect(name) {}
+};
+
+class NYX_EXPORT NullTexture : public Texture
+{
+    friend class NullRenderer;
+    friend class NullRenderBuffer;
+
+public:
+
+    virtual void Create( uint width, uint height, TextureFormat format_in, const ubyte* pixels, bool mipmapped = false, uint msaa_samples = 0 ) override;
+    virtual void Update( const ubyte* pixels ) override {}
+    virtual void BeginCubeMap( void ) override;
+    virtual void AddCubeMapFace(uint face, uint width, uint height, ubyte* pixels) override;
+    virtual void EndCubeMap( void ) override {}
+    virtual void Bind( void ) override {}
+    virtual void Unbind( void ) override {}
+
+protected:
+
+    NullTexture( void ) = default;
+};
+
+class NullVertexBuffer : public VertexBuffer
+{
+    friend class NullRenderer;
+
+public:
+
+    virtual void Create( size_t vertex_size, uint number_of_vertices, void* vertex_buffer = nullptr ) override;
+    // not supported: the callers fall back on Create and Lock.
+    virtual float* CreatePersistent( size_t vertex_size, uint number_of_vertices, uint regions, void* vertex_buffer ) override { return nullptr; }
+    virtual int CreateCLBufferFromThis( cl_context ctx ) override;
+    virtual void Bind( void ) override {}
+    virtual void Unbind( void ) override {}
+    virtual float* Lock( void ) override;
+    virtual void Unlock( void ) override {}
+    virtual int LockCL( cl_command_queue queue ) override;
+    virtual int UnlockCL( cl_command_queue queue, cl_event* released = nullptr ) override;
+    virtual int UpdateCLBuffer( cl_command_queue queue, size_t size, void* src ) override;
+    virtual void Draw( IRenderer::E_POLYGON_TYPE poly_type, uint polygon_count, uint start_index = 0, bool has_indices = true ) override {}
+    virtual void FenceRegion( uint region ) override {}
+    virtual bool IsRegionBusy( uint region ) override { return false; }
+
+protected:
+
+    NullVertexBuffer( void ) = default;
+
+protected:
+
+    std::vector<float> mData;
+};
+
+class NullIndexBuffer : public IndexBuffer
+{
+    friend class NullRenderer;
+
+public:
+
+    virtual void Create( size_t index_size, uint number_of_indices, void* index_buffer = nullptr ) override;
+    virtual void Bind( void ) override {}
+    virtual void Unbind( void ) override {}
+    virtual float* Lock() override;
+    virtual void Unlock() override {}
+
+protected:
+
+    NullIndexBuffer( void ) = default;
+
+protected:
+
+    std::vector<float> mData;
+};
+
+class NullVertexArrayObject : public VertexArrayObject
+{
+    friend class NullRenderer;
+
+public:
+
+    virtual void Create( void ) override {}
+    virtual void Bind( void ) override {}
+    virtual void Unbind( void ) override {}
+    virtual void EnableVertexAttribute( Effect* effect, std::string attrib_name, size_t attrib_size, size_t vertex_size, size_t offset ) override {}
+    virtual void DisableAllAttributes( void ) override {}
+
+protected:
+
+    NullVertexArrayObject( void ) = default;
+};
+
+class NYX_EXPORT NullRenderBuffer : public RenderBuffer
+{
+    friend class NullRenderer;
+
+public:
+
+    virtual void Create( StorageType storage, uint width, uint height, bool has_stencil = true, uint msaa = 0 ) override;
+    virtual void Bind( void ) override {}
+    virtual void Unbind( void ) override {}
+    virtual void Blit( void ) override {}
+    virtual const Texture* CopyToTexture( void ) override                 { return mColorTexture; }
+    // the pixels of a frame nothing was drawn to: all black.
+    virtual const ubyte* ReadPixels( void ) const override;
+    virtual void ReleasePixels( void ) const override {}
+
+protected:
+
+    NullRenderBuffer( void ) = default;
+
+protected:
+
+    std::vector<ubyte> mPixels;
+};
+
+}
+
+#endif // NULLRENDERER_H
@@ -184,8 +184,8 @@ cl_context GLRenderer::InitialiseCLContextFromGLContext( cl_device_id *device_id
     }
     
 #else
-    LogManager::GetInstance()->LogMessage("OpenCL: Platform Not Supported.");
-    exit(-1);
+    LogManager::GetInstance()->LogMessage("OpenCL: sharing the GL context is not supported on this platform.");
+    error_code = CL_INVALID_OPERATION;
 #endif
     
     return clContext;
@@ -15,6 +15,7 @@
 
 #include "gl_vertex_buffer.h"
 #include "gl_utils.h"
+#include "fx_manager.h"
 
 namespace NYX {
     
@@ -23,6 +24,19 @@ namespace NYX {
         if ( mSharedCLBuffer )
             clReleaseMemObject(mSharedCLBuffer);
         
+        for ( uint i = 0; i < MAX_REGIONS; i++ )
+        {
+            if ( mRegionFences[i] )
+                glDeleteSync(mRegionFences[i]);
+        }
+        
+        if ( mPersistentData )
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, mGLid);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+        
         glDeleteBuffers(1, &mGLid);
     }
     
@@ -47,6 +61,37 @@ namespace NYX {
         CheckGLError();
     }
     
+    float* GLVertexBuffer::CreatePersistent( size_t vertex_size, uint number_of_vertices, uint regions, void* vertex_buffer )
+    {
+        // the context is 4.1 core: persistent mapping needs 4.4 or the extension
+        if ( regions == 0 || regions > MAX_REGIONS ||
+             !( glewIsSupported("GL_VERSION_4_4") || glewIsSupported("GL_ARB_buffer_storage") ) )
+        {
+            return nullptr;
+        }
+        
+        size_t region_size = vertex_size*number_of_vertices;
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        
+        glGenBuffers(1, &mGLid);
+        glBindBuffer(GL_ARRAY_BUFFER, mGLid);
+        glBufferStorage(GL_ARRAY_BUFFER, region_size*regions, nullptr, flags);
+        
+        mPersistentData = (float*)glMapBufferRange(GL_ARRAY_BUFFER, 0, region_size*regions, flags);
+        
+        if ( mPersistentData && vertex_buffer )
+        {
+            for ( uint i = 0; i < regions; i++ )
+                memcpy((char*)mPersistentData + i*region_size, vertex_buffer, region_size);
+        }
+        
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        
+        CheckGLError();
+        
+        return mPersistentData;
+    }
+    
     int GLVertexBuffer::CreateCLBufferFromThis( cl_context ctx )
     {
         int error_code = 0;
@@ -86,13 +131,31 @@ namespace NYX {
     
     int GLVertexBuffer::LockCL( cl_command_queue queue )
     {
-        cl_int error = clEnqueueAcquireGLObjects(queue, 1, &mSharedCLBuffer, 0, NULL, NULL);
+        // the queue waits for the draws with cl_khr_gl_event, the CPU without it.
+        GLsync drawn = mRegionFences[0];
+        cl_event gl_done = drawn ? FXManager::GetInstance()->CreateEventFromGLSync((cl_GLsync)drawn) : NULL;
+        
+        if ( drawn && !gl_done )
+        {
+            GLenum status;
+            
+            do
+            {
+                status = glClientWaitSync(drawn, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000); // ns
+            } while ( status == GL_TIMEOUT_EXPIRED );
+        }
+        
+        cl_int error = clEnqueueAcquireGLObjects(queue, 1, &mSharedCLBuffer, gl_done ? 1 : 0, gl_done ? &gl_done : NULL, NULL);
+        
+        if ( gl_done )
+            clReleaseEvent(gl_done);
+        
         return error;
     }
     
-    int GLVertexBuffer::UnlockCL( cl_command_queue queue )
+    int GLVertexBuffer::UnlockCL( cl_command_queue queue, cl_event* released )
     {
-        cl_int error = clEnqueueReleaseGLObjects(queue, 1, &mSharedCLBuffer, 0, NULL, NULL);
+        cl_int error = clEnqueueReleaseGLObjects(queue, 1, &mSharedCLBuffer, 0, NULL, released);
         return error;
     }
     
@@ -104,6 +167,8 @@ namespace NYX {
     
     void GLVertexBuffer::Draw( IRenderer::E_POLYGON_TYPE poly_type, uint polygon_count, uint start_index, bool has_indices )
     {
+        start_index += mBaseVertex;
+        
         if ( has_indices )
         {
             switch (poly_type)
@@ -135,13 +200,13 @@ namespace NYX {
             switch (poly_type)
             {
                 case IRenderer::E_POINT:
-                    glDrawArrays(GL_POINTS, 0, polygon_count);
+                    glDrawArrays(GL_POINTS, start_index, polygon_count);
                     break;
                 case IRenderer::E_TRIANGLE:
-                    glDrawArrays(GL_TRIANGLES, 0, polygon_count); //this is the number of vertices
+                    glDrawArrays(GL_TRIANGLES, start_index, polygon_count); //this is the number of vertices
                     break;
                 case IRenderer::E_TRIANGLE_STRIP:
-                    glDrawArrays(GL_TRIANGLE_STRIP, 0, polygon_count);
+                    glDrawArrays(GL_TRIANGLE_STRIP, start_index, polygon_count);
                     break;
                 default:
                     break;
@@ -152,4 +217,33 @@ namespace NYX {
         
     }
     
+    void GLVertexBuffer::FenceRegion( uint region )
+    {
+        if ( region >= MAX_REGIONS )
+            return;
+        
+        if ( mRegionFences[region] )
+            glDeleteSync(mRegionFences[region]);
+        
+        mRegionFences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    
+    bool GLVertexBuffer::IsRegionBusy( uint region )
+    {
+        if ( region >= MAX_REGIONS || !mRegionFences[region] )
+            return false;
+        
+        // just a poll, never waits
+        GLenum status = glClientWaitSync(mRegionFences[region], 0, 0);
+        
+        if ( status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED )
+        {
+            glDeleteSync(mRegionFences[region]);
+            mRegionFences[region] = nullptr;
+            return false;
+        }
+        
+        return true;
+    }
+    
 }
\ No newline at end of file
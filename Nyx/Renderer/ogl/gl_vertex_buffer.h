@@ -10,6 +10,9 @@
 
 #include "vertex_buffer.h"
 
+// forward declare GL fences
+typedef struct __GLsync *GLsync;
+
 namespace NYX {
     
     // Required Classes
@@ -25,15 +28,18 @@ namespace NYX {
         virtual ~GLVertexBuffer( void );
         
         virtual void Create( size_t vertex_size, uint number_of_vertices, void* vertex_buffer = nullptr ) override;
+        virtual float* CreatePersistent( size_t vertex_size, uint number_of_vertices, uint regions, void* vertex_buffer ) override;
         virtual int CreateCLBufferFromThis( cl_context ctx ) override;
         virtual void Bind( void ) override;
         virtual void Unbind( void ) override;
         virtual float* Lock( void ) override;
         virtual void Unlock( void ) override;
         virtual int LockCL( cl_command_queue queue ) override;
-        virtual int UnlockCL( cl_command_queue queue ) override;
+        virtual int UnlockCL( cl_command_queue queue, cl_event* released = nullptr ) override;
         virtual int UpdateCLBuffer( cl_command_queue queue, size_t size, void* src ) override;
         virtual void Draw( IRenderer::E_POLYGON_TYPE poly_type, uint polygon_count, uint start_index = 0, bool has_indices = true ) override;
+        virtual void FenceRegion( uint region ) override;
+        virtual bool IsRegionBusy( uint region ) override;
         
     protected:
         GLVertexBuffer( void ) = default;
@@ -42,6 +48,11 @@ namespace NYX {
         
         uint mGLid = 0;
         
+        // persistent mapping
+        static const uint MAX_REGIONS = 3;
+        float* mPersistentData = nullptr;
+        GLsync mRegionFences[MAX_REGIONS] = {};
+        
     };
     
 }
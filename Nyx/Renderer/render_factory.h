@@ -7,6 +7,7 @@ Render Factory
 #define RENDERFACTORY_H
 
 #include "ogl/gl_renderer.h"
+#include "null/null_renderer.h"
 #if !PLATFORM_MAC && !DISABLE_D3D
 #include "d3d/d3d_renderer.h"
 #endif
@@ -24,6 +25,10 @@ namespace NYX {
 	{
 		IRenderer *ren = NULL;
 
+		//the one backend without a window, on every platform.
+		if (backend == HEADLESS)
+			return new NullRenderer();
+
 #if defined(__WIN32__) && !DISABLE_D3D
 		switch (backend)
 		{
@@ -18,6 +18,7 @@ namespace NYX {
     typedef struct _cl_context *        cl_context;
     typedef struct _cl_mem *            cl_mem;
     typedef struct _cl_command_queue *  cl_command_queue;
+    typedef struct _cl_event *          cl_event;
     
     class VertexBuffer
     {
@@ -25,23 +26,35 @@ namespace NYX {
         virtual ~VertexBuffer( void ) {}
         
         virtual void Create( size_t vertex_size, uint number_of_vertices, void* vertex_buffer = nullptr ) = 0;
+        // immutable storage for regions copies of the vertices, each initialised with vertex_buffer, mapped for as long as the buffer lives.
+        // returns the mapped memory, or nullptr if the renderer does not support it (use Create and Lock instead).
+        virtual float* CreatePersistent( size_t vertex_size, uint number_of_vertices, uint regions, void* vertex_buffer ) = 0;
         virtual int CreateCLBufferFromThis( cl_context ctx ) = 0;
         virtual void Bind( void ) = 0;
         virtual void Unbind( void ) = 0;
         virtual float* Lock( void ) = 0;
         virtual void Unlock( void ) = 0;
+        // once the GPU is done drawing from region 0 (see FenceRegion)
         virtual int LockCL( cl_command_queue queue ) = 0;
-        virtual int UnlockCL( cl_command_queue queue ) = 0;
+        // released: completes when the CL commands on the buffer have, if not null
+        virtual int UnlockCL( cl_command_queue queue, cl_event* released = nullptr ) = 0;
         virtual int UpdateCLBuffer( cl_command_queue queue, size_t size, void* src ) = 0;
         virtual void Draw( IRenderer::E_POLYGON_TYPE poly_type, uint polygon_count, uint start_index = 0, bool has_indices = true ) = 0;
+        // persistent buffers: marks the point after which the GPU is done drawing from a region. The whole of any other buffer is region 0.
+        virtual void FenceRegion( uint region ) = 0;
+        virtual bool IsRegionBusy( uint region ) = 0;
         
         cl_mem* GetSharedCLBuffer( void )            { return &mSharedCLBuffer; }
+        // added to start_index by Draw, to draw from a region of a persistent buffer
+        void SetBaseVertex( uint base_vertex )       { mBaseVertex = base_vertex; }
         
     protected:
         VertexBuffer( void ) = default;
         
         // OpenCL buffer
         cl_mem mSharedCLBuffer = nullptr;
+        
+        uint mBaseVertex = 0;
     };
     
 }
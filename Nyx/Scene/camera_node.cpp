@@ -11,39 +11,21 @@ Camera Node
 
 namespace NYX {
 
-bool CameraNode::CameraListener::ProcessEvent(EventPtr event)
+void CameraNode::OnCameraMoved(CameraMovedEvent& event)
 {
-	 eEventType evT = event->GetEventType();
-
-    //each listeners is already registered only to events of interest,
-    //there should be no need to check if the incoming event is valid.
-
-    CameraMovedEvent *cam_event = NULL;
-
-    switch (evT)
-    {
-    case EV_CAMERA_MOVED:
-		//Don't move this camera if it's not active!
-		if (!mParent->IsActive())
-			return false;
-
-		cam_event = dynamic_cast<CameraMovedEvent*>(event.get());
-		if (!cam_event->bIsRot)
-			mParent->TranslateCamera(cam_event->Position());
+	//Don't move this camera if it's not active!
+	if (!mIsActive)
+		return;
+
+	if (!event.bIsRot)
+		TranslateCamera(event.Position());
+	else
+	{
+		if (!event.bUseQuaternion)
+			RotateCamera(event.RotAngle(), event.RotAxis());
 		else
-		{
-			if (!cam_event->bUseQuaternion)
-				mParent->RotateCamera(cam_event->RotAngle(), cam_event->RotAxis());
-			else
-				mParent->RotateCamera(cam_event->Rotation());
-		}
-        break;
-    default:
-        return false;
-        break;
-    }
-
-    return true;
+			RotateCamera(event.Rotation());
+	}
 }
 
 CameraNode::CameraNode(SceneNode *parent, IRenderer *renderer, std::string name) :
@@ -51,13 +33,12 @@ CameraNode::CameraNode(SceneNode *parent, IRenderer *renderer, std::string name)
 {
 	//override the default value
 	bUseLookAt = true;
-	mEventListener = EventListenerPtr( new CameraListener(mName + " - Evt Listener", this) );
-	EventManager::GetInstance()->RegisterListener(EV_CAMERA_MOVED, mEventListener);
+	mCameraMovedSubscription = EventManager::GetInstance()->Subscribe<CameraMovedEvent, CameraNode, &CameraNode::OnCameraMoved>(this, GetSubscriptionGroup());
 }
 
 CameraNode::~CameraNode()
 {
-	EventManager::GetInstance()->UnregisterListener(mEventListener);
+	mCameraMovedSubscription.Reset();
 }
 
 void CameraNode::ComputeViewMatrix()
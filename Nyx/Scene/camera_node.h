@@ -19,21 +19,6 @@ class Frustum;
 
 class NYX_EXPORT CameraNode : public SceneNode
 {
-	class CameraListener : public BaseEventListener
-    {
-		CameraNode *mParent;
-
-    public:
-        CameraListener(string name, CameraNode *parent) : 
-			BaseEventListener(name),
-			mParent(parent)
-		{}
-		virtual ~CameraListener() {}
-
-        virtual bool ProcessEvent(EventPtr event);
-
-    };
-
 public:
 
     CameraNode(SceneNode *parent, IRenderer *renderer, std::string name);
@@ -61,7 +46,10 @@ protected:
 	//Matrix4x4 mModelMatrix; // ==mTransformMatrix
 	Matrix4x4 mViewMatrix;
 	bool mIsActive;
-	EventListenerPtr mEventListener;
+
+	void OnCameraMoved(CameraMovedEvent& event);
+
+	EventSubscription mCameraMovedSubscription;
 };
 
 }
@@ -13,80 +13,18 @@
 
 namespace NYX {
 
-bool ModelNode::ModelListener::ProcessEvent(EventPtr event)
-{
-	eEventType evT = event->GetEventType();
-
-    //each listeners is already registered only to events of interest,
-    //there should be no need to check if the incoming event is valid.
-
-    switch (evT)
-    {
-    case EV_OBJECT_MOVED:
-	{
-		ObjectMovedEvent* move_event = dynamic_cast<ObjectMovedEvent*>(event.get());
-		
-		// ignore event if it's not related to this scenenode. 
-		if (move_event->ID() != mParent->GetID())
-			return false;
-
-		mParent->SetAbsolutePosition(move_event->Position());
-
-		if (!move_event->bUseQuaternion)
-		{
-			mParent->SetWorldAttitude(move_event->AttitudeMatrix());
-		}
-		else
-		{
-			//mParent->SetWorldAttitude(move_event->Rotation().GetMatrix());
-		}
-		  
-		if (move_event->bIsSoft)
-		{
-			ModelNode *modelParent = (ModelNode*)mParent;
-			float *gl_mesh = modelParent->mVertexBuffer->Lock();
-			float *mesh = move_event->GetMesh();
-			
-			//updated vertices positions and normals with the deformed information from bullet
-			int stride = sizeof(Vertex);
-			for (int i = 0; i < modelParent->mModel->getNumberOfVertices(); i++)
-			{
-				//position
-				gl_mesh[i*stride + 0] = mesh[i*6 + 0];
-				gl_mesh[i*stride + 1] = mesh[i*6 + 1];
-				gl_mesh[i*stride + 2] = mesh[i*6 + 2];
-				//normal
-				gl_mesh[i*stride + 3] = mesh[i*6 + 3];
-				gl_mesh[i*stride + 4] = mesh[i*6 + 4];
-				gl_mesh[i*stride + 5] = mesh[i*6 + 5];
-			}
-
-			modelParent->mVertexBuffer->Unlock();
-			mesh = NULL;
-			gl_mesh = NULL;
-		}
-	}
-		break;
-    default:
-        return false;
-        break;
-    }
-
-    return true;
-}
-
 ModelNode::ModelNode(SceneNode *parent, IRenderer *renderer, std::string name) :
 	SceneNode(parent, renderer, name)
 {
-	//override scenenode listener
-	EventManager::GetInstance()->UnregisterListener(mEventListener);
-	mEventListener.reset();
-	mEventListener = EventListenerPtr( new ModelListener(mName + " - Evt Listener", this) );
-	EventManager::GetInstance()->RegisterListener(EV_OBJECT_MOVED, mEventListener);
+
 }
 
 ModelNode::~ModelNode()
 {
+	//a soft body may still be writing to the vertex buffer.
+	if (mVertexStream)
+		mVertexStream->Close();
+
 	delete mVertexBuffer;
 	delete mIndexBuffer;
 }
@@ -97,6 +35,7 @@ void ModelNode::AssignModel(std::string modelName)
 	ModelPtr model = mhndl->GetModel();
 
 	mModel = model;
+	mModelName = modelName;
     if ( scale_factor > 0.0f )
     {
         float offset[4] = {0.0,0.0,0.0,0.0};
@@ -118,7 +57,11 @@ void ModelNode::BuildChildren()
     mVertexBuffer = mRenderer->CreateVertexBuffer();
     mIndexBuffer = mRenderer->CreateIndexBuffer();
     
-    mVertexBuffer->Create( mModel->getVertexSize(), mModel->getNumberOfVertices(), (void*)mModel->getVertexBuffer() );
+    if ( bDeformable )
+        CreateVertexStream();
+    else
+        mVertexBuffer->Create( mModel->getVertexSize(), mModel->getNumberOfVertices(), (void*)mModel->getVertexBuffer() );
+    
     mIndexBuffer->Create( mModel->getIndexSize(), mModel->getNumberOfIndices(), (void*)mModel->getIndexBuffer() );
 
     mVertexBuffer->Bind();
@@ -151,11 +94,81 @@ void ModelNode::BuildChildren()
 
 }
 
+void ModelNode::CreateVertexStream()
+{
+	uint numVertices = mModel->getNumberOfVertices();
+	uint stride = mModel->getVertexSize() / sizeof(float);
+	float* regions[VertexStream::MAX_REGIONS];
+
+	//one copy of the vertices per region, drawn from in place.
+	float* data = mVertexBuffer->CreatePersistent( mModel->getVertexSize(), numVertices, VertexStream::MAX_REGIONS, (void*)mModel->getVertexBuffer() );
+	bPersistentStream = (data != nullptr);
+
+	if (!bPersistentStream)
+	{
+		//the regions live in memory, and the latest one is copied into a plain buffer.
+		mVertexBuffer->Create( mModel->getVertexSize(), numVertices, (void*)mModel->getVertexBuffer() );
+
+		mStreamData.resize(VertexStream::MAX_REGIONS * numVertices * stride);
+		data = &mStreamData[0];
+
+		for (uint i = 0; i < VertexStream::MAX_REGIONS; i++)
+			memcpy(data + i*numVertices*stride, mModel->getVertexBuffer(), numVertices*mModel->getVertexSize());
+	}
+
+	for (uint i = 0; i < VertexStream::MAX_REGIONS; i++)
+		regions[i] = data + i*numVertices*stride;
+
+	mVertexStream = VertexStreamPtr(new VertexStream());
+	mVertexStream->SetRegions(regions, VertexStream::MAX_REGIONS, numVertices, stride);
+	mShownRegion = 0;
+
+	//nothing is drawn from the memory regions.
+	if (!bPersistentStream)
+		mVertexStream->Release(0);
+}
+
+void ModelNode::UpdateVertexStream()
+{
+	for (uint i = 0; i < VertexStream::MAX_REGIONS; i++)
+	{
+		if ((mRetiredRegions & (1 << i)) && !mVertexBuffer->IsRegionBusy(i))
+		{
+			mVertexStream->Release(i);
+			mRetiredRegions &= ~(1 << i);
+		}
+	}
+
+	int region = mVertexStream->AcquireLatest();
+
+	if (region < 0)
+		return;
+
+	if (bPersistentStream)
+	{
+		//the previous region is released once the frames drawing from it are done.
+		mRetiredRegions |= 1 << mShownRegion;
+		mShownRegion = region;
+		mVertexBuffer->SetBaseVertex(region * mVertexStream->GetVertexCount());
+	}
+	else
+	{
+		float* gl_mesh = mVertexBuffer->Lock();
+		memcpy(gl_mesh, mVertexStream->GetRegion(region), mVertexStream->GetVertexCount()*mModel->getVertexSize());
+		mVertexBuffer->Unlock();
+
+		mVertexStream->Release(region);
+	}
+}
+
 void ModelNode::ProcessNode()
 {
 	UpdateState(bIsDynamic);
 	RootNode* root = GetRootNode();
 
+	if (mVertexStream)
+		UpdateVertexStream();
+
 	//not sure if this transform matrix is built correctly for the model stack.
 	root->mModelViewStack.PushMatrix(mTransformMatrix.Transpose());
 	
@@ -164,6 +177,10 @@ void ModelNode::ProcessNode()
 		for (std::list<SceneNodePtr>::iterator it = mChildren.begin(); it != mChildren.end(); ++it)
 				(*it)->ProcessNode();
 
+	//the GPU is done with the region when the commands issued so far are.
+	if (mVertexStream && bPersistentStream)
+		mVertexBuffer->FenceRegion(mShownRegion);
+
 	root->mModelViewStack.PopMatrix();
 }
 
@@ -9,6 +9,7 @@
 
 #include "scene_node.h"
 #include "model.h"
+#include "Utils/vertex_stream.h"
 
 namespace NYX {
 
@@ -19,40 +20,50 @@ class VertexArrayObject;
     
 class NYX_EXPORT ModelNode : public SceneNode
 {
-	class ModelListener : public SceneNode::NodeListener
-    {
-    public:
-        ModelListener(string name, SceneNode *parent) : 
-			SceneNode::NodeListener(name, parent)
-		{}
-		virtual ~ModelListener() {}
-
-        virtual bool ProcessEvent(EventPtr event);
-    };
-
-	friend class ModelListener;
-
 public:
 
     ModelNode(SceneNode *parent, IRenderer *renderer, std::string name);
     ~ModelNode();
 
+	//for soft bodies: the vertices are streamed in by the physics. Must be set before AssignModel.
+	void SetDeformable(bool deformable);
 	void AssignModel(std::string modelName);
     void SetScaleFactor( float scale );
 
+	ModelPtr GetModel();
+	std::string GetModelName();
+	//positions and normals of the model vertices, NULL unless deformable.
+	VertexStreamPtr GetVertexStream();
+
 	virtual void ProcessNode();
 
 protected:
 
 	void BuildChildren();
+	void CreateVertexStream();
+	//picks up the latest vertices and releases the regions the GPU is done with.
+	void UpdateVertexStream();
 
 	ModelPtr mModel;
+	std::string mModelName;
     float scale_factor = 0.0f;
     VertexBuffer* mVertexBuffer = nullptr;
     IndexBuffer* mIndexBuffer = nullptr;
     VertexArrayObject* mVertexArrayObject = nullptr;
+
+	bool bDeformable = false;
+	VertexStreamPtr mVertexStream;
+	bool bPersistentStream = false; //the stream regions are the vertex buffer itself
+	std::vector<float> mStreamData; //otherwise, they are copied into the vertex buffer from here
+	int mShownRegion = 0;
+	uint mRetiredRegions = 0; //one bit per region drawn from by frames the GPU may not have finished
 };
 
+inline void ModelNode::SetDeformable(bool deformable) { bDeformable = deformable; }
+inline ModelPtr ModelNode::GetModel() { return mModel; }
+inline std::string ModelNode::GetModelName() { return mModelName; }
+inline VertexStreamPtr ModelNode::GetVertexStream() { return mVertexStream; }
+
 }
 
 #endif // MODELNODE_H
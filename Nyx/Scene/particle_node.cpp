@@ -24,12 +24,12 @@ ParticleNode::~ParticleNode()
 
 }
 
-void ParticleNode::InitializeFX(std::string programName, std::string kernelName, uint size, std::string materialName) 
+void ParticleNode::InitializeFX(std::string programName, std::string kernelName, uint size, std::string materialName, eParticleLayout layout) 
 { 
 	RootNode* root = GetRootNode();
 	std::string shaderName;
 	Effect* prog = nullptr;
-	mFX.Initialize(programName, kernelName, size, materialName, shaderName, &prog);
+	mFX.Initialize(programName, kernelName, size, materialName, shaderName, &prog, layout);
 	root->AddShaderProgram(shaderName, prog);
 }
 
@@ -62,7 +62,10 @@ void ParticleNode::ProcessNode()
 
 		mRenderer->LoadShaderUniforms();
 
-        mFX.GetVertexBuffer()->Draw( IRenderer::E_POINT, mFX.ParticleCount(), 0, false );
+        mFX.GetVertexBuffer()->Draw( IRenderer::E_POINT, mFX.LiveCount(), 0, false );
+        
+        //the kernels copy a step to it again once the GPU is done with it.
+        mFX.GetVertexBuffer()->FenceRegion(0);
         
         mFX.GetVertexBuffer()->Unbind();
         mFX.GetVAO()->Unbind();
@@ -22,7 +22,9 @@ public:
     ~ParticleNode();
 
 	void UseScriptParticleGeneration(std::string source, std::string funcName);
-	void InitializeFX(std::string programName, std::string kernelName, uint size, std::string materialName);
+	void UseEmitter(const ParticleEmitter& emitter);
+	void UseCloudEmitter(const ParticleEmitter& emitter);
+	void InitializeFX(std::string programName, std::string kernelName, uint size, std::string materialName, eParticleLayout layout = PARTICLE_LAYOUT_AOS);
 	virtual void ProcessNode();
 
 protected:
@@ -31,6 +33,8 @@ protected:
 };
 
 inline void ParticleNode::UseScriptParticleGeneration(std::string source, std::string funcName) { mFX.UseScriptParticleGeneration(source, funcName); }
+inline void ParticleNode::UseEmitter(const ParticleEmitter& emitter) { mFX.UseEmitter(emitter); }
+inline void ParticleNode::UseCloudEmitter(const ParticleEmitter& emitter) { mFX.UseCloudEmitter(emitter); }
 
 }
 
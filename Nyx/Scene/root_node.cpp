@@ -13,44 +13,25 @@ using namespace std;
 
 namespace NYX {
 
-bool RootNode::RootListener::ProcessEvent(EventPtr event)
+void RootNode::OnCameraChanged(CameraChangedEvent& event)
 {
-	 eEventType evT = event->GetEventType();
-
-    //each listeners is already registered only to events of interest,
-    //there should be no need to check if the incoming event is valid.
-
-    switch (evT)
-    {
-    case EV_ACTIVE_CAMERA_CHANGED:
+	for (list<CameraNode*>::iterator it = mCameras.begin(); it != mCameras.end(); ++it)
+	{
+		if (event.Id() == (*it)->GetID())
 		{
-		  CameraChangedEvent* cam_event = dynamic_cast<CameraChangedEvent*>(event.get());
-		
-		  for (list<CameraNode*>::iterator it = mParent->mCameras.begin();
-			  it !=  mParent->mCameras.end(); ++it)
-		  {
-			  if (cam_event->Id() == (*it)->GetID())
-			  {
-				  (*it)->SetActive(true);
-				  mParent->SetActiveCamera(*it, (*it)->GetViewMatrix());
-				  mParent->mProjectionStack.UpdatedBottom((*it)->mFrustum.GetProjectionMatrix());
-			  }
-			  else
-				  (*it)->SetActive(false);
-		  }
+			(*it)->SetActive(true);
+			SetActiveCamera(*it, (*it)->GetViewMatrix());
+			mProjectionStack.UpdatedBottom((*it)->mFrustum.GetProjectionMatrix());
 		}
-		break;
-    default:
-        return false;
-        break;
-    }
-
-    return true;
+		else
+			(*it)->SetActive(false);
+	}
 }
 
 RootNode::RootNode(IRenderer *renderer, std::string name) :
 	SceneNode(NULL, renderer, name),
 	mAnimationRefreshRate(20),
+	mPhysicsInterpolation(1.0f),
 	bHasSkyBox(false)
 {
 	mAbsolutePosition.SetComponents(0.0, 0.0, 0.0);
@@ -58,12 +39,15 @@ RootNode::RootNode(IRenderer *renderer, std::string name) :
 	mToWorld.LoadIdentity();	
 	mToParent.LoadIdentity();
 	mInitialised = false;
-	mEventListener = EventListenerPtr( new RootListener(mName + " - Evt Listener", this) );
-	EventManager::GetInstance()->RegisterListener(EV_ACTIVE_CAMERA_CHANGED, mEventListener);
+	mCameraChangedSubscription = EventManager::GetInstance()->Subscribe<CameraChangedEvent, RootNode, &RootNode::OnCameraChanged>(this, GetSubscriptionGroup());
 }
 
 RootNode::~RootNode() 
 {
+	//drop the subscriptions of the whole scene graph in one go, rather than node by node
+	//while the children are destroyed.
+	EventManager::GetInstance()->UnsubscribeGroup(GetSubscriptionGroup());
+
 	mActiveCamera = NULL;
 	for(map<uint, LightNode*>::iterator lights = mLights.begin(); 
 		lights != mLights.end(); ++lights)
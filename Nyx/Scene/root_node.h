@@ -46,22 +46,6 @@ private:
 
 class NYX_EXPORT RootNode : public SceneNode
 {
-	class RootListener : public BaseEventListener
-    {
-		RootNode *mParent;
-
-    public:
-        RootListener(string name, RootNode *parent) : 
-			BaseEventListener(name),
-			mParent(parent)
-		{}
-		virtual ~RootListener() {}
-
-        virtual bool ProcessEvent(EventPtr event);
-    };
-
-	friend class RootListener;
-
 public:
 
 	RootNode(IRenderer *renderer, std::string name = "Root");
@@ -73,6 +57,9 @@ public:
 	void SetAnimationRefreshRate(uint rate);
 	uint GetAnimationRefreshRate(); //returns ms
 	float GetAnimationRefreshRateS(); //returns s
+	//how far the physics clock is between the last two simulated states, in [0, 1]. see IPhysicsEngine::Update
+	void SetPhysicsInterpolation(float alpha);
+	float GetPhysicsInterpolation();
 	virtual void ProcessNode();
 	void SetActiveCamera(CameraNode* camera, const Matrix4x4& viewMatrix);
 	void AddCamera(CameraNode* camera);
@@ -118,14 +105,17 @@ private:
 	std::map<uint, MeshPtr> mMeshCache; //change it to store models?
 	std::map<std::string, uint> mTextureCache;
 	std::map<std::string, Effect*> mShaderCache;
-	EventListenerPtr mEventListener;
 	bool mInitialised;
 	bool mUpdateAnimation;
 	uint mAnimationRefreshRate; //default 20 ms. shuold always match the top level animation refresh rate (game.h)
+	float mPhysicsInterpolation; //default 1: render the latest physics state
 	SceneNodePtr mSkyBox;
 	bool bHasSkyBox;
 
 	void InitScene();
+	void OnCameraChanged(CameraChangedEvent& event);
+
+	EventSubscription mCameraChangedSubscription;
 };
 
 typedef std::shared_ptr<RootNode> RootNodePtr;
@@ -190,6 +180,8 @@ inline bool RootNode::GetAnimationUpdateState() { return mUpdateAnimation; }
 inline void RootNode::SetAnimationRefreshRate(uint rate) { mAnimationRefreshRate = rate; }
 inline uint RootNode::GetAnimationRefreshRate() { return mAnimationRefreshRate; }
 inline float RootNode::GetAnimationRefreshRateS() { return (float)mAnimationRefreshRate/1000.0f; }
+inline void RootNode::SetPhysicsInterpolation(float alpha) { mPhysicsInterpolation = alpha; }
+inline float RootNode::GetPhysicsInterpolation() { return mPhysicsInterpolation; }
 
 inline Vector3 RootNode::GetCameraTarget() { return mActiveCamera->GetLookAt(); }
 inline void RootNode::AddLight(LightNode* light) { mLights[light->GetID()] = light; }
@@ -22,7 +22,10 @@ SceneNode::SceneNode(SceneNode *parent, IRenderer *renderer, std::string name) :
     bHasTarget(false),
     bIsDynamic(false),
     mTarget(NULL),
-    bScriptAnimated(false)
+    bScriptAnimated(false),
+    bHasPhysicsState(false),
+    bPhysicsAtRest(false),
+    bPhysicsStateChanged(false)
 {
     mToWorld.LoadIdentity();
     mToParent.LoadIdentity();
@@ -37,12 +40,14 @@ SceneNode::SceneNode(SceneNode *parent, IRenderer *renderer, std::string name) :
         mID = GenerateHash( name.c_str(), name.length() );
     }
     
-    mEventListener = EventListenerPtr( new NodeListener(mName + " - Evt Listener", this) );
-    EventManager::GetInstance()->RegisterListener(EV_OBJECT_MOVED, mEventListener);
+    mObjectMovedSubscription = EventManager::GetInstance()->Subscribe<ObjectMovedEvent, SceneNode, &SceneNode::OnObjectMoved>(this, GetSubscriptionGroup());
 }
     
 SceneNode::~SceneNode()
 {
+    //unsubscribe before the node is gone. no-op if the scene root already dropped the whole group.
+    mObjectMovedSubscription.Reset();
+
     mParent = NULL;
         
     for (list<SceneNodePtr>::iterator it = mChildren.begin(); it != mChildren.end(); ++it)
@@ -57,42 +62,87 @@ SceneNode::~SceneNode()
     //resetting the usage count of shared_ptr automatically.
 }
 
-bool SceneNode::NodeListener::ProcessEvent(EventPtr event)
+void SceneNode::OnObjectMoved(ObjectMovedEvent& event)
 {
-	eEventType evT = event->GetEventType();
+	// ignore event if it's not related to this scenenode. 
+	if (event.ID() != mID)
+		return;
 
-    //each listeners is already registered only to events of interest,
-    //there should be no need to check if the incoming event is valid.
+	SetPhysicsState(event);
+}
 
-    switch (evT)
-    {
-    case EV_OBJECT_MOVED:
+void SceneNode::SetPhysicsState(ObjectMovedEvent& event)
+{
+	if (event.bUseQuaternion)
 	{
-		ObjectMovedEvent* move_event = dynamic_cast<ObjectMovedEvent*>(event.get());
-		
-		// ignore event if it's not related to this scenenode. 
-		if (move_event->ID() != mParent->GetID())
-			return false;
+		//SetWorldAttitude(event.Rotation().GetMatrix());
+		SetAbsolutePosition(event.Position());
+		return;
+	}
 
-		mParent->SetAbsolutePosition(move_event->Position());
+	mPhysicsPosition[1] = event.Position();
+	mPhysicsAttitude[1] = event.AttitudeMatrix();
 
-		if (!move_event->bUseQuaternion)
-		{
-			mParent->SetWorldAttitude(move_event->AttitudeMatrix());
-		}
-		else
-		{
-			//mParent->SetWorldAttitude(move_event->Rotation().GetMatrix());
-		}
-		  
+	if (event.bHasPreviousState)
+	{
+		mPhysicsPosition[0] = event.PreviousPosition();
+		mPhysicsAttitude[0] = event.PreviousAttitude();
 	}
-		break;
-    default:
-        return false;
-        break;
-    }
+	else
+	{
+		mPhysicsPosition[0] = mPhysicsPosition[1];
+		mPhysicsAttitude[0] = mPhysicsAttitude[1];
+	}
+
+	bHasPhysicsState = true;
+	bPhysicsStateChanged = true;
+	//the physics engine sends a state with no motion in it when a body settles, then nothing until it moves.
+	bPhysicsAtRest = (mPhysicsPosition[0] == mPhysicsPosition[1]) && (mPhysicsAttitude[0] == mPhysicsAttitude[1]);
+
+	//until the next frame is drawn, the node is where the simulation left it.
+	SetAbsolutePosition(mPhysicsPosition[1]);
+	SetWorldAttitude(mPhysicsAttitude[1]);
+}
+
+void SceneNode::ApplyPhysicsState(float alpha)
+{
+	if (alpha >= 1.0f)
+	{
+		SetAbsolutePosition(mPhysicsPosition[1]);
+		SetWorldAttitude(mPhysicsAttitude[1]);
+		return;
+	}
+
+	SetAbsolutePosition(mPhysicsPosition[0] + (mPhysicsPosition[1] - mPhysicsPosition[0]) * alpha);
+
+	//blend the rows, then make them orthonormal again. 
+	//close enough to a proper slerp for the small rotations of a single physics step.
+	Matrix3x3 blend = mPhysicsAttitude[0] + (mPhysicsAttitude[1] - mPhysicsAttitude[0]) * alpha;
+	Vector3 x = blend.GetRow(0).UnitVector();
+	Vector3 z = x.Cross(blend.GetRow(1)).UnitVector();
+	Vector3 y = z.Cross(x);
+
+	Matrix3x3 attitude;
+
+	for (unsigned short j = 0; j < 3; j++)
+	{
+		attitude(0, j) = x(j);
+		attitude(1, j) = y(j);
+		attitude(2, j) = z(j);
+	}
+
+	SetWorldAttitude(attitude);
+}
+
+SceneNode* SceneNode::GetSubscriptionGroup()
+{
+	//can't use GetRootNode() here: it is called by constructors, before the root node is fully built.
+	SceneNode *group = this;
+
+	while (group->mParent)
+		group = group->mParent;
 
-    return true;
+	return group;
 }
 
 RootNode* SceneNode::GetRootNode()
@@ -233,6 +283,15 @@ void SceneNode::BuildTransformFromLookAt(bool useAbsolutePosition)
 
 void SceneNode::UpdateState(bool useAbsolutePosition)
 {
+	if (bHasPhysicsState)
+	{
+		//a body at rest right under the scene root (which doesn't move) is still where the last update put it.
+		if (bPhysicsAtRest && !bPhysicsStateChanged && mParent->GetParentNode() == NULL)
+			return;
+
+		ApplyPhysicsState(GetRootNode()->GetPhysicsInterpolation());
+		bPhysicsStateChanged = false;
+	}
 		
 	//might be that the parent position/rotation has changed,in which case the children would not be aware of it.
 	//update position
@@ -33,25 +33,6 @@ enum eSceneNode
 
 class NYX_EXPORT SceneNode
 {
-protected:
-
-	class NodeListener : public BaseEventListener
-    {
-	protected:
-		SceneNode *mParent;
-
-    public:
-        NodeListener(string name, SceneNode *parent) : 
-			BaseEventListener(name),
-			mParent(parent)
-		{}
-		virtual ~NodeListener() {}
-
-        virtual bool ProcessEvent(EventPtr event);
-    };
-
-	friend class NodeListener;
-
 public:
 
     SceneNode(SceneNode *parent, IRenderer *renderer, std::string name);
@@ -113,7 +94,25 @@ public:
 
 protected:
 
-	EventListenerPtr mEventListener;
+	//typed event handler, subscribed by the constructor.
+	virtual void OnObjectMoved(ObjectMovedEvent& event);
+
+	//subscriptions are tagged with the scene root they belong to, see RootNode::~RootNode.
+	SceneNode* GetSubscriptionGroup();
+
+	/*physics bodies are simulated at a fixed rate, independent from the frame rate. The node keeps the
+	  states before and after the last physics step, and renders a blend of the two (see RootNode::GetPhysicsInterpolation)
+	  so that motion stays smooth when the two rates don't match. */
+	void SetPhysicsState(ObjectMovedEvent& event);
+	void ApplyPhysicsState(float alpha);
+
+	bool bHasPhysicsState;
+	bool bPhysicsAtRest; //previous and current state are the same
+	bool bPhysicsStateChanged; //since the last UpdateState
+	Vector3 mPhysicsPosition[2]; //previous, current
+	Matrix3x3 mPhysicsAttitude[2];
+
+	EventSubscription mObjectMovedSubscription;
 
 	eSceneNode mNodeType;
 	std::string mName;
@@ -193,14 +192,14 @@ inline void SceneNode::SetRelativePosition(Vector3 position) {
 inline void SceneNode::SetWorldAttitude(Matrix3x3 rotation)
 {
 	mToWorld = rotation;
-	//need to add inverse method to Matrix3x3
-	//mToParent = mToWorld * mParent->GetWorldAttitude().Inverse();
+	//rotation matrices are orthonormal: the inverse is the transpose. Without a parent, the world is the parent.
+	mToParent = mParent ? mToWorld * mParent->GetWorldAttitude().Transpose() : mToWorld;
 }
 
 inline void SceneNode::SetAbsolutePosition(Vector3 position)
 {
 	mAbsolutePosition = position;
-	mRelativePosition = mAbsolutePosition - mParent->GetAbsolutePosition();
+	mRelativePosition = mParent ? mAbsolutePosition - mParent->GetAbsolutePosition() : mAbsolutePosition;
 }
 
 inline Vector3& SceneNode::GetLookAt() {return mLookAt;}
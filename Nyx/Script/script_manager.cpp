@@ -16,6 +16,14 @@ using namespace LuaPlus;
 
 namespace NYX {
 
+// numbers per query and per result in the PhysicsQuery tables
+static const int QUERY_STRIDE = 8;
+static const int QUERY_RESULT_STRIDE = 9;
+// physics snapshots are stored under their name with it, as the scene looks for them
+static const std::string COOKED_WORLD_EXTENSION = ".physics";
+// metatable of the buffers from MakeBuffer, the only userdata SetFloats accepts
+static const char* SCRIPT_BUFFER_METATABLE = "NYX.ScriptBuffer";
+
 ScriptManager::ScriptManager()  :
 	mLuaState(true) //init standard library
 {
@@ -47,6 +55,17 @@ bool ScriptManager::Init()
 	LuaObject globals = mLuaState->GetGlobals();
 	globals.Register("LOG", *this, &ScriptManager::ScriptMessageCallback);
 
+	globals.Register("PhysicsQuery", *this, &ScriptManager::PhysicsQueryCallback);
+	globals.SetInteger("QRY_RAY", QRY_RAY);
+	globals.SetInteger("QRY_SWEEP", QRY_SWEEP);
+	globals.SetInteger("QRY_OVERLAP", QRY_OVERLAP);
+	globals.Register("SetFloats", *this, &ScriptManager::SetFloatsCallback);
+	//scripts can't read or replace it.
+	LuaObject bufferMetaTableObj = mLuaState->NewMetatable(SCRIPT_BUFFER_METATABLE);
+	bufferMetaTableObj.SetBoolean("__metatable", false);
+	globals.Register("SavePhysicsSnapshot", *this, &ScriptManager::SavePhysicsSnapshotCallback);
+	globals.Register("RestorePhysicsSnapshot", *this, &ScriptManager::RestorePhysicsSnapshotCallback);
+
     return true;
 
 }
@@ -96,6 +115,28 @@ void ScriptManager::MakeTable(LuaObject &obj)
 	obj.AssignNewTable(mLuaState);
 }
 
+void ScriptManager::MakeBuffer(ScriptBuffer* buffer, LuaObject &obj)
+{
+	lua_State* state = mLuaState->GetCState();
+
+	//a copy, so that ReleaseBuffer can take it back from a script that kept it.
+	ScriptBuffer* userdata = (ScriptBuffer*)lua_newuserdata(state, sizeof(ScriptBuffer));
+	*userdata = *buffer;
+	luaL_setmetatable(state, SCRIPT_BUFFER_METATABLE);
+
+	obj = LuaObject(state, true);
+}
+
+void ScriptManager::ReleaseBuffer(LuaObject &obj)
+{
+	if (!obj.IsUserdata())
+		return;
+
+	ScriptBuffer* userdata = (ScriptBuffer*)obj.GetUserdata();
+	userdata->data = nullptr;
+	userdata->count = 0;
+}
+
 bool ScriptManager::RunScript(std::string fileName) 
 {
 	char* src = ResourceCache::GetInstance()->RequestSourceCode(fileName);
@@ -196,6 +237,143 @@ int ScriptManager::ScriptMessageCallback(LuaState* state)
 	return 0;
 }
 
+void ScriptManager::SetPhysicsEngine(PhysicsEnginePtr physicsEngine)
+{
+	mPhysicsEngine = physicsEngine;
+}
+
+int ScriptManager::PhysicsQueryCallback(LuaState* state)
+{
+	LuaStack args(state);
+	PhysicsEnginePtr physicsEngine = mPhysicsEngine.lock();
+
+	if (!physicsEngine)
+	{
+		LogManager::GetInstance()->LogMessage("Error! PhysicsQuery: there is no physics world to query.");
+		return 0;
+	}
+
+	LuaObject queries = args[1];
+	int count = args[2].GetInteger();
+	LuaObject results = args[3];
+
+	if (!queries.IsTable() || !results.IsTable())
+	{
+		LogManager::GetInstance()->LogMessage("Error! PhysicsQuery expects a table of queries, their number and a table for the results.");
+		return 0;
+	}
+
+	if (count <= 0)
+		return 0;
+
+	mQueries.resize(count);
+	mQueryResults.resize(count);
+
+	for (int i = 0; i < count; i++)
+	{
+		PhysicsQuery& query = mQueries[i];
+		int base = i*QUERY_STRIDE;
+
+		query.type = (ePhysicsQuery)queries[base].GetInteger();
+		query.from.SetComponents(queries[base + 1].GetFloat(), queries[base + 2].GetFloat(), queries[base + 3].GetFloat());
+		query.to.SetComponents(queries[base + 4].GetFloat(), queries[base + 5].GetFloat(), queries[base + 6].GetFloat());
+		query.radius = queries[base + 7].GetFloat();
+	}
+
+	physicsEngine->RunQueries(&mQueries[0], (uint)count, &mQueryResults[0]);
+
+	for (int i = 0; i < count; i++)
+	{
+		PhysicsQueryResult& result = mQueryResults[i];
+		int base = i*QUERY_RESULT_STRIDE;
+
+		results.SetNumber(base, result.numBodies);
+		results.SetNumber(base + 1, result.bodyID);
+		results.SetNumber(base + 2, result.fraction);
+		results.SetNumber(base + 3, result.point.X());
+		results.SetNumber(base + 4, result.point.Y());
+		results.SetNumber(base + 5, result.point.Z());
+		results.SetNumber(base + 6, result.normal.X());
+		results.SetNumber(base + 7, result.normal.Y());
+		results.SetNumber(base + 8, result.normal.Z());
+	}
+
+	return 0;
+}
+
+int ScriptManager::SetFloatsCallback(LuaState* state)
+{
+	LuaStack args(state);
+	//raises a script error for anything but a buffer from MakeBuffer.
+	ScriptBuffer* buffer = (ScriptBuffer*)state->CheckUData(1, SCRIPT_BUFFER_METATABLE);
+	int index = args[2].GetInteger();
+
+	if (!buffer->data || index < 0 || (uint)index >= buffer->count)
+	{
+		LogManager::GetInstance()->LogMessage("Error! SetFloats expects a buffer and an index within it.");
+		return 0;
+	}
+
+	float* element = buffer->data + (size_t)index*buffer->stride;
+
+	for (uint k = 0; k < buffer->stride; k++)
+		element[k] = args[3 + k].GetFloat();
+
+	return 0;
+}
+
+int ScriptManager::SavePhysicsSnapshotCallback(LuaState* state)
+{
+	LuaStack args(state);
+	PhysicsEnginePtr physicsEngine = mPhysicsEngine.lock();
+
+	if (!physicsEngine || !args[1].IsString())
+	{
+		LogManager::GetInstance()->LogMessage("Error! SavePhysicsSnapshot expects a name, and a physics world to save.");
+		return 0;
+	}
+
+	string name = args[1].GetString();
+	string& snapshot = mPhysicsSnapshots[name];
+
+	physicsEngine->SaveWorld(snapshot);
+	ResourceCache::GetInstance()->StoreCookedData(name + COOKED_WORLD_EXTENSION, snapshot);
+
+	return 0;
+}
+
+int ScriptManager::RestorePhysicsSnapshotCallback(LuaState* state)
+{
+	LuaStack args(state);
+	PhysicsEnginePtr physicsEngine = mPhysicsEngine.lock();
+
+	if (!physicsEngine || !args[1].IsString())
+	{
+		LogManager::GetInstance()->LogMessage("Error! RestorePhysicsSnapshot expects a name, and a physics world to restore.");
+		return 0;
+	}
+
+	string name = args[1].GetString();
+	auto found = mPhysicsSnapshots.find(name);
+
+	if (found != mPhysicsSnapshots.end())
+	{
+		physicsEngine->RestoreWorld(found->second);
+	}
+	else
+	{
+		// saved on an earlier run
+		string snapshot;
+
+		if (ResourceCache::GetInstance()->RequestCookedData(name + COOKED_WORLD_EXTENSION, snapshot))
+			physicsEngine->RestoreWorld(mPhysicsSnapshots[name] = snapshot);
+		else
+			LogManager::GetInstance()->LogMessage("Error! RestorePhysicsSnapshot: there is no physics snapshot " + name + ".");
+	}
+
+	return 0;
+}
+
 void ScriptManager::Print(LuaObject message)
 {
 	if (message.IsString())
@@ -9,11 +9,24 @@ Script Manager (LUA)
 
 #include "LuaPlus.h"
 #include "singleton.h"
+#include "Physics/iphysics_engine.h"
 
 #include <list>
+#include <map>
+#include <memory>
 #include <set>
+#include <vector>
 
 namespace NYX {
+
+// count elements of stride floats each, for a script to fill in: see ScriptManager::MakeBuffer.
+struct ScriptBuffer
+{
+	float* data;
+	uint count;
+	uint stride;
+};
+
 /*
 Script manager
 */
@@ -34,6 +47,11 @@ public:
 	bool RegisterLuaFunctions(std::string fileName, std::list<std::string> funcNames);
 	LuaPlus::LuaObject GetLuaFunction(std::string funcName);
 	void MakeTable(LuaPlus::LuaObject &obj);
+	// buffer as an argument for a script function, which fills it in with SetFloats rather than returning a table.
+	// the script can only use it while the function runs: ReleaseBuffer once it has returned.
+	void MakeBuffer(ScriptBuffer* buffer, LuaPlus::LuaObject &obj);
+	// detaches a buffer from MakeBuffer from its data. SetFloats on it fails from then on.
+	void ReleaseBuffer(LuaPlus::LuaObject &obj);
 
     // Directly execute a pre-built function, assumes no inputs or outputs
     bool ExecuteFunction(std::string funcName);
@@ -46,6 +64,9 @@ public:
     // Batch execute queued functions.
     void ProcessQueuedFunctions();
 
+    // the world scripts run their PhysicsQuery calls against. The scripts don't keep it alive.
+    void SetPhysicsEngine(PhysicsEnginePtr physicsEngine);
+
 private:
 
 	// List of functions awaiting execution. Newly queued functions are stored in a back (inactive) queue
@@ -58,6 +79,21 @@ private:
 
 	void Print(LuaPlus::LuaObject message);
 
+    // PhysicsQuery(queries, count, results): count queries in a single IPhysicsEngine::RunQueries, rather than
+    // one call into the host per ray. Both tables are flat and start at 0. queries has 8 numbers per query:
+    // type (QRY_RAY, QRY_SWEEP or QRY_OVERLAP), from x, y, z, to x, y, z, radius. results, which the script
+    // can keep and pass again, gets 9 per query: bodies hit (0 for a miss), body id, fraction, point x, y, z,
+    // normal x, y, z. registered as a global function.
+    int PhysicsQueryCallback(LuaPlus::LuaState *state);
+    // SetFloats(buffer, index, ...): the stride numbers after the index to the element at it (from 0) of a buffer
+    // from MakeBuffer. registered as a global function.
+    int SetFloatsCallback(LuaPlus::LuaState *state);
+    // SavePhysicsSnapshot(name): IPhysicsEngine::SaveWorld, kept under name for RestorePhysicsSnapshot and stored
+    // as cooked data, which a scene with a "snapshot" of that name in its physics block loads from on the next run.
+    // RestorePhysicsSnapshot(name): rolls the world back to it. registered as global functions.
+    int SavePhysicsSnapshotCallback(LuaPlus::LuaState *state);
+    int RestorePhysicsSnapshotCallback(LuaPlus::LuaState *state);
+
     // swap the current active and inactive process queues;
     inline void SwapQueues();
     // determines which is the inactive queue (where newly queued functions are stored)
@@ -71,6 +107,11 @@ private:
     float mMaxProcessingTime; // maximum time allowed for queue processing in each loop
 
 	std::set<std::string> mRegisteredLuaFunctions;
+
+	std::weak_ptr<IPhysicsEngine> mPhysicsEngine;
+	std::vector<PhysicsQuery> mQueries; // reused by every PhysicsQuery call
+	std::vector<PhysicsQueryResult> mQueryResults;
+	std::map<std::string, std::string> mPhysicsSnapshots; // by name
 };
 
 
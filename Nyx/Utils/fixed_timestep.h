@@ -0,0 +1,95 @@
+/*
+
+Fixed Time Step
+
+*/
+
+#ifndef FIXED_TIMESTEP_H
+#define FIXED_TIMESTEP_H
+
+namespace NYX {
+
+/*
+Accumulator turning variable frame times into a whole number of fixed simulation steps.
+The time left over after the last step is kept for the next frame, and its ratio to the step
+(GetInterpolation) tells the renderer how far it is between the last two simulated states.
+At most maxSteps are taken per call: when a frame takes too long (debugger, loading, a slow
+machine) the simulation slows down instead of spending ever longer catching up.
+*/
+class FixedTimeStep
+{
+public:
+
+    //timeStep in seconds.
+    FixedTimeStep(float timeStep = 1.0f/60.0f, uint maxSteps = 5);
+
+    void Configure(float timeStep, uint maxSteps);
+    //adds frameTime (seconds) and returns the number of steps due now.
+    uint Advance(float frameTime);
+    //leftover time as a fraction of the step, in [0, 1).
+    float GetInterpolation();
+
+    float GetTimeStep();
+    uint GetMaxSteps();
+    //total simulation time given up because of the maxSteps limit.
+    float GetDroppedTime();
+
+private:
+
+    float mTimeStep;
+    uint mMaxSteps;
+    float mAccumulator;
+    float mDroppedTime;
+};
+
+inline FixedTimeStep::FixedTimeStep(float timeStep, uint maxSteps) :
+    mAccumulator(0.0f),
+    mDroppedTime(0.0f)
+{
+    Configure(timeStep, maxSteps);
+}
+
+inline void FixedTimeStep::Configure(float timeStep, uint maxSteps)
+{
+    mTimeStep = (timeStep > 0.0f) ? timeStep : 1.0f/60.0f;
+    mMaxSteps = (maxSteps > 0) ? maxSteps : 1;
+}
+
+inline uint FixedTimeStep::Advance(float frameTime)
+{
+    if (frameTime > 0.0f)
+        mAccumulator += frameTime;
+
+    uint steps = (uint)(mAccumulator / mTimeStep);
+
+    if (steps > mMaxSteps)
+    {
+        //keep the fraction of a step, drop the rest.
+        float excess = (float)(steps - mMaxSteps) * mTimeStep;
+        mAccumulator -= excess;
+        mDroppedTime += excess;
+        steps = mMaxSteps;
+    }
+
+    mAccumulator -= (float)steps * mTimeStep;
+
+    //rounding
+    if (mAccumulator < 0.0f)
+        mAccumulator = 0.0f;
+
+    return steps;
+}
+
+inline float FixedTimeStep::GetInterpolation()
+{
+    float alpha = mAccumulator / mTimeStep;
+    return (alpha < 1.0f) ? alpha : 1.0f;
+}
+
+inline float FixedTimeStep::GetTimeStep() { return mTimeStep; }
+inline uint FixedTimeStep::GetMaxSteps() { return mMaxSteps; }
+inline float FixedTimeStep::GetDroppedTime() { return mDroppedTime; }
+
+}
+
+#endif // FIXED_TIMESTEP_H
@@ -0,0 +1,72 @@
+/*
+
+Intrusive Pointer
+
+*/
+
+#ifndef INTRUSIVE_PTR_H
+#define INTRUSIVE_PTR_H
+
+#include <cstddef>
+
+namespace NYX {
+
+/*
+Reference counted smart pointer for classes that carry their own counter.
+T must provide AddRef() and Release(), Release() being responsible for destroying the object
+once the count drops to zero.
+The interface mirrors the subset of std::shared_ptr used across the engine, so it can be used
+as a drop-in replacement, but it needs no separate control block: creating a pointer from a raw
+one costs a single increment and no allocation.
+*/
+template<typename T>
+class IntrusivePtr
+{
+public:
+
+    IntrusivePtr() : mPtr(nullptr) {}
+    IntrusivePtr(std::nullptr_t) : mPtr(nullptr) {}
+    explicit IntrusivePtr(T* ptr) : mPtr(ptr) { if (mPtr) mPtr->AddRef(); }
+    IntrusivePtr(const IntrusivePtr& source) : mPtr(source.mPtr) { if (mPtr) mPtr->AddRef(); }
+    IntrusivePtr(IntrusivePtr&& source) : mPtr(source.mPtr) { source.mPtr = nullptr; }
+
+    template<typename U>
+    IntrusivePtr(const IntrusivePtr<U>& source) : mPtr(source.get()) { if (mPtr) mPtr->AddRef(); }
+
+    ~IntrusivePtr() { if (mPtr) mPtr->Release(); }
+
+    IntrusivePtr& operator= (const IntrusivePtr& source)
+    {
+        IntrusivePtr(source).swap(*this);
+        return *this;
+    }
+
+    IntrusivePtr& operator= (IntrusivePtr&& source)
+    {
+        IntrusivePtr(static_cast<IntrusivePtr&&>(source)).swap(*this);
+        return *this;
+    }
+
+    void reset() { IntrusivePtr().swap(*this); }
+    void reset(T* ptr) { IntrusivePtr(ptr).swap(*this); }
+    void swap(IntrusivePtr& other) { T* tmp = mPtr; mPtr = other.mPtr; other.mPtr = tmp; }
+
+    T* get() const { return mPtr; }
+    T& operator* () const { return *mPtr; }
+    T* operator-> () const { return mPtr; }
+    explicit operator bool () const { return mPtr != nullptr; }
+
+private:
+
+    T* mPtr;
+};
+
+template<typename T, typename U>
+inline bool operator== (const IntrusivePtr<T>& a, const IntrusivePtr<U>& b) { return a.get() == b.get(); }
+
+template<typename T, typename U>
+inline bool operator!= (const IntrusivePtr<T>& a, const IntrusivePtr<U>& b) { return a.get() != b.get(); }
+
+}
+
+#endif // INTRUSIVE_PTR_H
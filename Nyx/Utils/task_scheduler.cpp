@@ -0,0 +1,186 @@
+/*
+
+Task Scheduler
+
+*/
+
+#include "task_scheduler.h"
+#include "log_manager.h"
+
+namespace NYX {
+
+//set on the threads running a chunk, to run nested loops inline.
+static thread_local bool tInsideLoop = false;
+
+//how long an idle worker polls for the next loop before sleeping.
+static const uint SPIN_COUNT = 2000;
+
+TaskScheduler::TaskScheduler(uint numThreads) :
+    mJobGeneration(0),
+    mBusyWorkers(0),
+    bStopping(false),
+    mFunction(NULL),
+    mContext(NULL),
+    mNextIndex(0),
+    mEndIndex(0),
+    mGrainSize(1)
+{
+    if (numThreads == 0)
+        numThreads = GetMaxThreadCount();
+
+    StartWorkers(numThreads - 1);
+}
+
+TaskScheduler::~TaskScheduler()
+{
+    StopWorkers();
+}
+
+uint TaskScheduler::GetMaxThreadCount()
+{
+    uint hardwareThreads = std::thread::hardware_concurrency();
+    return hardwareThreads > 0 ? hardwareThreads : 1;
+}
+
+void TaskScheduler::SetThreadCount(uint numThreads)
+{
+    if (numThreads == 0)
+        numThreads = GetMaxThreadCount();
+
+    //not while a loop is running on the workers.
+    std::lock_guard<std::mutex> issue(mIssueMutex);
+
+    if (numThreads == GetThreadCount())
+        return;
+
+    StopWorkers();
+    StartWorkers(numThreads - 1);
+
+    string msg = "Task scheduler running on " + to_string(numThreads) + " threads.";
+    LogManager::GetInstance()->LogMessage(msg.c_str());
+}
+
+void TaskScheduler::SetInlineThread()
+{
+    //never cleared: only the threads running chunks clear it, and this one runs its loops inline.
+    tInsideLoop = true;
+}
+
+void TaskScheduler::StartWorkers(uint numWorkers)
+{
+    bStopping = false;
+
+    //the workers wait for the loops issued after this point, even if they start late.
+    uint generation = mJobGeneration.load();
+
+    for (uint i = 0; i < numWorkers; i++)
+        mWorkers.push_back(std::thread(&TaskScheduler::WorkerThread, this, generation));
+}
+
+void TaskScheduler::StopWorkers()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        bStopping = true;
+        mJobGeneration++;
+    }
+
+    mWakeUp.notify_all();
+
+    for (uint i = 0; i < mWorkers.size(); i++)
+        mWorkers[i].join();
+
+    mWorkers.clear();
+}
+
+void TaskScheduler::ParallelFor(int begin, int end, int grainSize, RangeFunction func, void* context)
+{
+    if (begin >= end)
+        return;
+
+    if (grainSize < 1)
+        grainSize = 1;
+
+    //not worth waking anybody up.
+    if (tInsideLoop || end - begin <= grainSize)
+    {
+        func(context, begin, end);
+        return;
+    }
+
+    //another thread's loop has the workers: this one runs on its own thread rather than wait for them.
+    std::unique_lock<std::mutex> issue(mIssueMutex, std::try_to_lock);
+
+    if (!issue.owns_lock() || mWorkers.empty())
+    {
+        func(context, begin, end);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        mFunction = func;
+        mContext = context;
+        mEndIndex = end;
+        mGrainSize = grainSize;
+        mNextIndex = begin;
+        mBusyWorkers = (uint)mWorkers.size();
+        mJobGeneration++;
+    }
+
+    mWakeUp.notify_all();
+
+    RunChunks();
+
+    //the loop is over when every worker has given up on it: only then the next one can be set up.
+    while (mBusyWorkers.load() > 0)
+        std::this_thread::yield();
+}
+
+void TaskScheduler::RunChunks()
+{
+    tInsideLoop = true;
+
+    int begin;
+
+    while ((begin = mNextIndex.fetch_add(mGrainSize)) < mEndIndex)
+    {
+        int end = begin + mGrainSize;
+        mFunction(mContext, begin, end < mEndIndex ? end : mEndIndex);
+    }
+
+    tInsideLoop = false;
+}
+
+void TaskScheduler::WorkerThread(uint lastGeneration)
+{
+    while (true)
+    {
+        //short loops come in bursts: poll for a while before going to sleep.
+        for (uint i = 0; i < SPIN_COUNT && mJobGeneration.load() == lastGeneration; i++)
+            std::this_thread::yield();
+
+        if (mJobGeneration.load() == lastGeneration)
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mWakeUp.wait(lock, [&]{ return mJobGeneration.load() != lastGeneration; });
+        }
+
+        {
+            //the loop parameters are written under the lock.
+            std::lock_guard<std::mutex> lock(mMutex);
+
+            lastGeneration = mJobGeneration.load();
+
+            if (bStopping)
+                return;
+        }
+
+        RunChunks();
+
+        mBusyWorkers--;
+    }
+}
+
+}
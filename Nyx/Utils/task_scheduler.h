@@ -0,0 +1,77 @@
+/*
+
+Task Scheduler
+
+*/
+
+#ifndef TASKSCHEDULER_H
+#define TASKSCHEDULER_H
+
+#include "singleton.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace NYX {
+
+/*
+Pool of worker threads for data-parallel loops: ParallelFor splits a range in chunks and runs them
+on the workers and on the calling thread, returning once they are all done.
+Loops are short and frequent (Bullet issues several per simulation step), so idle workers spin for
+a little while before going to sleep: waking a sleeping thread costs more than most chunks.
+One loop runs on the workers at a time: a ParallelFor issued while another thread's loop is running
+(say the physics thread's, while the main thread steps the particles) runs inline on the thread that
+issued it, as does one issued from inside a chunk.
+*/
+class NYX_EXPORT TaskScheduler : public SingletonClass<TaskScheduler>
+{
+public:
+
+    typedef void (*RangeFunction)(void* context, int begin, int end);
+
+    //numThreads includes the calling thread. 0 means one per hardware thread.
+    TaskScheduler(uint numThreads = 0);
+    ~TaskScheduler();
+
+    void SetThreadCount(uint numThreads);
+    uint GetThreadCount();
+    uint GetMaxThreadCount();
+
+    //runs func over [begin, end) in chunks of grainSize elements at most.
+    void ParallelFor(int begin, int end, int grainSize, RangeFunction func, void* context);
+    /*the loops the calling thread issues run on it alone from now on: for threads of their own (see
+      PhysicsWorldPool), that would otherwise issue loops while another thread does.*/
+    static void SetInlineThread();
+
+private:
+
+    void StartWorkers(uint numWorkers);
+    void StopWorkers();
+    void WorkerThread(uint lastGeneration);
+    void RunChunks();
+
+    std::vector<std::thread> mWorkers;
+
+    std::mutex mMutex;
+    std::mutex mIssueMutex; //held by the thread whose loop the workers run
+    std::condition_variable mWakeUp;
+    std::atomic<uint> mJobGeneration; //bumped for every new loop
+    std::atomic<uint> mBusyWorkers; //workers still on the current loop
+    bool bStopping;
+
+    //current loop
+    RangeFunction mFunction;
+    void* mContext;
+    std::atomic<int> mNextIndex;
+    int mEndIndex;
+    int mGrainSize;
+};
+
+inline uint TaskScheduler::GetThreadCount() { return (uint)mWorkers.size() + 1; }
+
+}
+
+#endif // TASKSCHEDULER_H
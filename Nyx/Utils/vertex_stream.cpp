@@ -0,0 +1,106 @@
+/*
+
+Vertex Stream
+
+*/
+
+#include "vertex_stream.h"
+
+#include <thread>
+
+namespace NYX {
+
+VertexStream::VertexStream() :
+    mNumRegions(0),
+    mNumVertices(0),
+    mStride(0),
+    mState(STREAM_CLOSED),
+    mWriteRegion(0)
+{
+    for (uint i = 0; i < MAX_REGIONS; i++)
+        mRegions[i] = NULL;
+}
+
+void VertexStream::SetRegions(float** regions, uint numRegions, uint numVertices, uint stride)
+{
+    mNumRegions = (numRegions < MAX_REGIONS) ? numRegions : MAX_REGIONS;
+
+    for (uint i = 0; i < mNumRegions; i++)
+        mRegions[i] = regions[i];
+
+    mNumVertices = numVertices;
+    mStride = stride;
+
+    //all regions start with the same data: region 0 counts as published, and the reader is showing it.
+    mState = STREAM_HELD;
+}
+
+void VertexStream::Close()
+{
+    mState.fetch_or(STREAM_CLOSED);
+
+    while (mState.load() & STREAM_WRITING)
+        std::this_thread::yield();
+}
+
+float* VertexStream::BeginWrite()
+{
+    uint state = mState.load();
+    uint target;
+
+    do
+    {
+        if (state & (STREAM_CLOSED | STREAM_WRITING))
+            return NULL;
+
+        //not in use by the reader, and not the one it would pick up next.
+        for (target = 0; target < mNumRegions; target++)
+        {
+            if (target != (state & STREAM_PUBLISHED) && !(state & (STREAM_HELD << target)))
+                break;
+        }
+
+        if (target == mNumRegions)
+            return NULL;
+
+    } while (!mState.compare_exchange_weak(state, state | STREAM_WRITING));
+
+    mWriteRegion = target;
+
+    return mRegions[target];
+}
+
+void VertexStream::EndWrite()
+{
+    uint state = mState.load();
+    uint published;
+
+    do
+    {
+        published = (state & ~(STREAM_PUBLISHED | STREAM_WRITING)) | STREAM_NEW_DATA | mWriteRegion;
+    } while (!mState.compare_exchange_weak(state, published));
+}
+
+int VertexStream::AcquireLatest()
+{
+    uint state = mState.load();
+    uint region;
+
+    do
+    {
+        if (!(state & STREAM_NEW_DATA))
+            return -1;
+
+        region = state & STREAM_PUBLISHED;
+    } while (!mState.compare_exchange_weak(state, (state & ~STREAM_NEW_DATA) | (STREAM_HELD << region)));
+
+    return (int)region;
+}
+
+void VertexStream::Release(int region)
+{
+    if (region >= 0)
+        mState.fetch_and(~(STREAM_HELD << region));
+}
+
+}
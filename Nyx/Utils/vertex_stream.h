@@ -0,0 +1,78 @@
+/*
+
+Vertex Stream
+
+*/
+
+#ifndef VERTEXSTREAM_H
+#define VERTEXSTREAM_H
+
+#include <atomic>
+#include <memory>
+
+namespace NYX {
+
+/*
+Multi-buffered vertex data written by one thread (e.g. physics, for deformable bodies) and read by
+another (the renderer), without copies in between. The memory is not owned by the stream: it can be a
+persistently mapped vertex buffer, in which case the writer fills the very memory the GPU draws from.
+The reader holds the regions it is using (including the ones the GPU may still be drawing from) until
+it releases them. The writer fills a region that is neither held nor the last one published, so with
+three regions the reader always gets the latest data, even when the writer runs several times per frame.
+With two, or when the GPU is behind, there may be no such region: the update is skipped, and the reader
+keeps showing the previous one.
+*/
+class NYX_EXPORT VertexStream
+{
+public:
+
+    VertexStream();
+
+    static const uint MAX_REGIONS = 3;
+
+    //numRegions regions of numVertices vertices, each vertex stride floats long.
+    //the reader starts out holding region 0.
+    void SetRegions(float** regions, uint numRegions, uint numVertices, uint stride);
+    //after this no more writes are started, and those in progress are finished.
+    void Close();
+
+    //writer: NULL if there is no free region (skip this update).
+    float* BeginWrite();
+    void EndWrite();
+
+    //reader: the region published last, held until released. -1 if nothing new was published.
+    int AcquireLatest();
+    void Release(int region);
+
+    float* GetRegion(int region);
+    uint GetVertexCount();
+    uint GetStride();
+
+private:
+
+    enum {
+        STREAM_PUBLISHED = 0x3, //index of the region published last
+        STREAM_NEW_DATA = 0x4, //published and not acquired yet
+        STREAM_HELD = 0x8, //one bit per region: 0x8, 0x10, 0x20
+        STREAM_WRITING = 0x40,
+        STREAM_CLOSED = 0x80
+    };
+
+    float* mRegions[MAX_REGIONS];
+    uint mNumRegions;
+    uint mNumVertices;
+    uint mStride;
+
+    std::atomic<uint> mState;
+    uint mWriteRegion; //only touched by the writer
+};
+
+typedef std::shared_ptr< VertexStream > VertexStreamPtr;
+
+inline float* VertexStream::GetRegion(int region) { return mRegions[region]; }
+inline uint VertexStream::GetVertexCount() { return mNumVertices; }
+inline uint VertexStream::GetStride() { return mStride; }
+
+}
+
+#endif // VERTEXSTREAM_H
@@ -23,6 +23,8 @@ Application::Application(char* argv0, std::string logFileName) :
 		pLogger( new LogManager(logFileName) ),
         pResourceCache( new ResourceCache() ),
 		pEventMng( new EventManager() ),
+		pTaskScheduler( new TaskScheduler() ),
+		pPhysicsWorldPool( new PhysicsWorldPool() ),
 		pScriptManager( new ScriptManager() ),
 		mLogFile(logFileName),
 		pArgv0(argv0),
@@ -37,14 +39,19 @@ Application::~Application()
 	pResourceCache.reset();
 	pWindow.reset();
 	pScriptManager.reset();
+	pPhysicsWorldPool.reset();
+	pTaskScheduler.reset();
 	pEventMng.reset();
 	pLogger.reset();
 }
 
-void Application::Initialise( string config_file )
+void Application::Initialise( string config_file, bool headless )
 {
     LoadConfig( config_file );
     
+    if ( headless )
+        mWindowProps.backend = NYX::HEADLESS;
+    
     CreateGameWindow(mWindowProps.title, mWindowProps.width, mWindowProps.height, mWindowProps.depth, mWindowProps.backend );
 }
     
@@ -82,6 +89,15 @@ void Application::Run( void )
     SDL_Event ui_event;
     mLoopStartTime = mCurTime = SDL_GetTicks();
     
+    //no window to take input from: the scene runs until it stops the application (e.g. at the end of a replay).
+    if ( mWindowProps.backend == NYX::HEADLESS )
+    {
+        while ( bIsRunning )
+            pWindow->GetActiveState()->GetScene()->Update();
+        
+        return;
+    }
+    
     //main loop
     while ( bIsRunning )
     {
@@ -207,6 +223,14 @@ void Application::LoadConfig( std::string file_name )
     {
         mWindowProps.backend = NYX::D3D;
     }
+    
+    // the worker threads of the task scheduler, shared by every scene: one per hardware thread by default
+    auto threads = config_source.find("worker threads");
+    
+    if ( threads != config_source.end() )
+    {
+        pTaskScheduler->SetThreadCount( threads->get<uint>() );
+    }
 }
 
 }
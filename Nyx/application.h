@@ -15,6 +15,8 @@ Application Class
 #include "Cache/resource_cache.h"
 #include "Events/event_manager.h"
 #include "Script/script_manager.h"
+#include "Utils/task_scheduler.h"
+#include "Physics/physics_world_pool.h"
 
 namespace NYX {
 
@@ -23,6 +25,8 @@ typedef std::shared_ptr< NYX::FileManager > FileManagerPtr;
 typedef std::shared_ptr< NYX::LogManager > LoggerPtr;
 typedef std::shared_ptr< NYX::EventManager > EventManagerPtr;
 typedef std::shared_ptr< NYX::ScriptManager > ScriptManagerPtr;
+typedef std::shared_ptr< NYX::TaskScheduler > TaskSchedulerPtr;
+typedef std::shared_ptr< NYX::PhysicsWorldPool > PhysicsWorldPoolPtr;
 typedef std::shared_ptr< NYX::Window > WindowPtr;
 typedef std::shared_ptr< NYX::ResourceCache > CachePtr;
 
@@ -37,7 +41,8 @@ public:
 	virtual ~Application();
 
 	void RegisterCacheSearchPath(std::string mountPoint, std::string path);
-    void Initialise( std::string config_file );
+    //headless: no window and nothing drawn, whatever the config asks for. The scenes are updated as usual.
+    void Initialise( std::string config_file, bool headless = false );
 	void ShowWindow(bool show);
 	void SetAnimationRefreshRate(uint rate); //in ms
     void Run( void );
@@ -72,6 +77,8 @@ protected:
     FileManagerPtr pFileManager;
 	LoggerPtr pLogger;
 	EventManagerPtr pEventMng;
+	TaskSchedulerPtr pTaskScheduler;
+	PhysicsWorldPoolPtr pPhysicsWorldPool;
 	ScriptManagerPtr pScriptManager;
 	WindowPtr pWindow;
 	CachePtr pResourceCache;
@@ -0,0 +1,526 @@
+/*
+
+CPU Particle Kernel
+
+*/
+
+#include "particle_cpu.h"
+#include "Utils/task_scheduler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1) || defined(__SSE__)
+#define PARTICLE_SSE 1
+#include <xmmintrin.h>
+#endif
+
+namespace NYX {
+
+//as in the kernel: gravity following the GL coordinate system, no wind.
+static const float ACCELERATION[3] = { 0.0f, -1.1f, 0.0f };
+
+static const float TWO_PI = 6.28318531f;
+
+static const int GRAIN_SIZE = 4096; //particles per task: a multiple of 4, so that every range but the last is whole vectors
+
+//of a GenerateParticles under way
+struct ParticleCloud
+{
+	const ParticleEmitter* emitter;
+	float* particles;
+};
+
+size_t ParticleBufferSize(eParticleLayout layout, uint count)
+{
+	return (layout == PARTICLE_LAYOUT_SOA ? 8 : CPUParticleKernel::PARTICLE_FLOATS)*sizeof(float)*count;
+}
+
+void PackParticles(const float* particles, uint count, eParticleLayout layout, float* buffer)
+{
+	if (layout == PARTICLE_LAYOUT_AOS)
+	{
+		memcpy(buffer, particles, ParticleBufferSize(layout, count));
+		return;
+	}
+
+	float* velocities = buffer + 4*count;
+
+	for (uint i = 0; i < count; i++, particles += CPUParticleKernel::PARTICLE_FLOATS)
+	{
+		buffer[4*i] = particles[0];
+		buffer[4*i + 1] = particles[1];
+		buffer[4*i + 2] = particles[2];
+		buffer[4*i + 3] = 1.0f;
+
+		velocities[4*i] = particles[3];
+		velocities[4*i + 1] = particles[4];
+		velocities[4*i + 2] = particles[5];
+		velocities[4*i + 3] = particles[6];
+	}
+}
+
+void UnpackParticles(const float* buffer, uint count, eParticleLayout layout, float* particles)
+{
+	if (layout == PARTICLE_LAYOUT_AOS)
+	{
+		memcpy(particles, buffer, ParticleBufferSize(layout, count));
+		return;
+	}
+
+	const float* velocities = buffer + 4*count;
+
+	for (uint i = 0; i < count; i++, particles += CPUParticleKernel::PARTICLE_FLOATS)
+	{
+		for (uint k = 0; k < 3; k++)
+		{
+			particles[k] = buffer[4*i + k];
+			particles[3 + k] = velocities[4*i + k];
+		}
+
+		particles[6] = velocities[4*i + 3];
+	}
+}
+
+//a 32 bit integer hash with good avalanche (lowbias32): the same in particle_emitter.cl.
+static uint HashParticle(uint x)
+{
+	x ^= x >> 16;
+	x *= 0x7feb352dU;
+	x ^= x >> 15;
+	x *= 0x846ca68bU;
+	x ^= x >> 16;
+	return x;
+}
+
+//uniform in [0, 1): 24 bits of the hash of the particle and the value drawn for it.
+static float ParticleRandom(uint seed, uint n, uint stream)
+{
+	return (float)(HashParticle(HashParticle(n ^ seed) + stream) >> 8)*(1.0f / 16777216.0f);
+}
+
+ParticleEmitter::ParticleEmitter() :
+	shape(EMITTER_BOX),
+	velocity(VELOCITY_BOX),
+	coneAngle(0.0f),
+	speedMin(0.0f),
+	speedMax(0.0f),
+	lifeMin(0.0f),
+	lifeMax(10.0f),
+	rate(1000.0f),
+	seed(5)
+{
+	//the fountain of particle_fountain.lua
+	float fountain[5][3] = { { 0.0f, -5.0f, 0.0f }, { 0.25f, 0.0f, 0.25f }, { -0.2f, 1.2f, -0.2f }, { 0.2f, 4.7f, 0.2f }, { 0.0f, -1.1f, 0.0f } };
+
+	for (uint k = 0; k < 3; k++)
+	{
+		position[k] = fountain[0][k];
+		extent[k] = fountain[1][k];
+		velocityMin[k] = fountain[2][k];
+		velocityMax[k] = fountain[3][k];
+		acceleration[k] = fountain[4][k];
+		direction[k] = (k == 1) ? 1.0f : 0.0f;
+	}
+}
+
+uint ParticleEmitter::EmissionCount(float deltaT, float& carry) const
+{
+	carry += rate*deltaT;
+
+	uint count = (uint)carry;
+	carry -= (float)count;
+
+	return count;
+}
+
+void ParticleEmitter::Emit(uint n, float* particle) const
+{
+	if (shape == EMITTER_SPHERE)
+	{
+		float radius = extent[0]*cbrtf(ParticleRandom(seed, n, 0));
+		float z = 2.0f*ParticleRandom(seed, n, 1) - 1.0f;
+		float phi = TWO_PI*ParticleRandom(seed, n, 2);
+		float xy = sqrtf(fmaxf(1.0f - z*z, 0.0f));
+
+		particle[0] = position[0] + radius*(xy*cosf(phi));
+		particle[1] = position[1] + radius*(xy*sinf(phi));
+		particle[2] = position[2] + radius*z;
+	}
+	else
+	{
+		for (uint k = 0; k < 3; k++)
+			particle[k] = position[k] + extent[k]*(2.0f*ParticleRandom(seed, n, k) - 1.0f);
+	}
+
+	if (velocity == VELOCITY_CONE)
+	{
+		//uniform over the cap of the unit sphere around the axis, then scaled.
+		float axis[3], side[3], up[3], cosAngle;
+		Cone(axis, cosAngle);
+
+		//any vector not along the axis, crossed with it: the same in the kernel.
+		float other[3] = { 0.0f, 0.0f, 0.0f };
+		other[fabsf(axis[0]) < 0.9f ? 0 : 1] = 1.0f;
+
+		side[0] = other[1]*axis[2] - other[2]*axis[1];
+		side[1] = other[2]*axis[0] - other[0]*axis[2];
+		side[2] = other[0]*axis[1] - other[1]*axis[0];
+
+		float length = sqrtf(side[0]*side[0] + side[1]*side[1] + side[2]*side[2]);
+
+		for (uint k = 0; k < 3; k++)
+			side[k] /= length;
+
+		up[0] = axis[1]*side[2] - axis[2]*side[1];
+		up[1] = axis[2]*side[0] - axis[0]*side[2];
+		up[2] = axis[0]*side[1] - axis[1]*side[0];
+
+		float z = 1.0f - ParticleRandom(seed, n, 3)*(1.0f - cosAngle);
+		float phi = TWO_PI*ParticleRandom(seed, n, 4);
+		float speed = speedMin + (speedMax - speedMin)*ParticleRandom(seed, n, 5);
+		float xy = sqrtf(fmaxf(1.0f - z*z, 0.0f));
+		float x = xy*cosf(phi);
+		float y = xy*sinf(phi);
+
+		for (uint k = 0; k < 3; k++)
+			particle[3 + k] = speed*(side[k]*x + up[k]*y + axis[k]*z);
+	}
+	else
+	{
+		for (uint k = 0; k < 3; k++)
+			particle[3 + k] = velocityMin[k] + (velocityMax[k] - velocityMin[k])*ParticleRandom(seed, n, 3 + k);
+	}
+
+	particle[6] = lifeMin + (lifeMax - lifeMin)*ParticleRandom(seed, n, 6);
+}
+
+void ParticleEmitter::Cone(float* axis, float& cosAngle) const
+{
+	float length = sqrtf(direction[0]*direction[0] + direction[1]*direction[1] + direction[2]*direction[2]);
+
+	for (uint k = 0; k < 3; k++)
+		axis[k] = (length > 0.0f) ? direction[k] / length : (k == 1 ? 1.0f : 0.0f);
+
+	cosAngle = cosf(coneAngle);
+}
+
+static void GenerateRange(void* context, int begin, int end)
+{
+	ParticleCloud* cloud = static_cast<ParticleCloud*>(context);
+
+	for (int n = begin; n < end; n++)
+		cloud->emitter->Emit((uint)n, cloud->particles + n*CPUParticleKernel::PARTICLE_FLOATS);
+}
+
+void GenerateParticles(const ParticleEmitter& emitter, uint count, float* particles)
+{
+	ParticleCloud cloud = { &emitter, particles };
+	TaskScheduler::GetInstance()->ParallelFor(0, (int)count, GRAIN_SIZE, GenerateRange, &cloud);
+}
+
+#if PARTICLE_SSE
+//four particles, one component per register, to the vertices in the layout.
+static void StoreParticles(float* vertices, uint count, uint i, eParticleLayout layout, const __m128* next)
+{
+	if (layout == PARTICLE_LAYOUT_SOA)
+	{
+		//x y z w of four particles to four float4s: a 4x4 transpose per stream.
+		__m128 position[4] = { next[0], next[1], next[2], _mm_set1_ps(1.0f) };
+		__m128 velocity[4] = { next[3], next[4], next[5], next[6] };
+
+		_MM_TRANSPOSE4_PS(position[0], position[1], position[2], position[3]);
+		_MM_TRANSPOSE4_PS(velocity[0], velocity[1], velocity[2], velocity[3]);
+
+		for (uint j = 0; j < 4; j++)
+		{
+			_mm_storeu_ps(vertices + 4*(i + j), position[j]);
+			_mm_storeu_ps(vertices + 4*(count + i + j), velocity[j]);
+		}
+
+		return;
+	}
+
+	float lanes[CPUParticleKernel::PARTICLE_FLOATS][4];
+
+	for (uint c = 0; c < CPUParticleKernel::PARTICLE_FLOATS; c++)
+		_mm_storeu_ps(lanes[c], next[c]);
+
+	float* vertex = vertices + i*CPUParticleKernel::PARTICLE_FLOATS;
+
+	for (uint j = 0; j < 4; j++, vertex += CPUParticleKernel::PARTICLE_FLOATS)
+	{
+		for (uint c = 0; c < CPUParticleKernel::PARTICLE_FLOATS; c++)
+			vertex[c] = lanes[c][j];
+	}
+}
+#endif
+
+CPUParticleKernel::CPUParticleKernel() :
+	mCount(0),
+	mLiveCount(0),
+	mLayout(PARTICLE_LAYOUT_AOS),
+	bEmitter(false),
+	mEmitted(0),
+	mEmitCarry(0.0f),
+	mDeltaT(0.0f),
+	mVertices(NULL)
+{
+	memcpy(mAcceleration, ACCELERATION, sizeof(mAcceleration));
+}
+
+void CPUParticleKernel::Initialize(const float* particles, uint count, eParticleLayout layout)
+{
+	mCount = count;
+	mLiveCount = count;
+	mLayout = layout;
+	bEmitter = false;
+	memcpy(mAcceleration, ACCELERATION, sizeof(mAcceleration));
+
+	for (uint c = 0; c < COMPONENTS; c++)
+	{
+		mState[c].resize(count);
+		mInitialState[c].resize(count);
+
+		for (uint i = 0; i < count; i++)
+			mState[c][i] = particles[i*PARTICLE_FLOATS + c];
+
+		mInitialState[c] = mState[c];
+	}
+}
+
+void CPUParticleKernel::InitializeEmitter(const ParticleEmitter& emitter, uint count, eParticleLayout layout)
+{
+	mCount = count;
+	mLiveCount = 0;
+	mLayout = layout;
+	bEmitter = true;
+	mEmitter = emitter;
+	mEmitted = 0;
+	mEmitCarry = 0.0f;
+	memcpy(mAcceleration, emitter.acceleration, sizeof(mAcceleration));
+
+	for (uint c = 0; c < COMPONENTS; c++)
+	{
+		mState[c].resize(count);
+		mInitialState[c].clear();
+	}
+}
+
+void CPUParticleKernel::Execute(float deltaT, float* vertices)
+{
+	TaskScheduler* scheduler = TaskScheduler::GetInstance();
+
+	mDeltaT = deltaT;
+	mVertices = vertices;
+
+	if (!bEmitter)
+	{
+		scheduler->ParallelFor(0, (int)mCount, GRAIN_SIZE, ExecuteRange, this);
+		return;
+	}
+
+	//move, drop the particles whose life is over, add the new ones after the live ones, then the vertices.
+	scheduler->ParallelFor(0, (int)mLiveCount, GRAIN_SIZE, ExecuteRange, this);
+	Compact();
+
+	uint emitted = mEmitter.EmissionCount(deltaT, mEmitCarry);
+	uint room = std::min(emitted, mCount - mLiveCount);
+
+	scheduler->ParallelFor(0, (int)room, GRAIN_SIZE, EmitRange, this);
+
+	mLiveCount += room;
+	mEmitted += emitted;
+
+	scheduler->ParallelFor(0, (int)mLiveCount, GRAIN_SIZE, WriteRange, this);
+}
+
+void CPUParticleKernel::ExecuteRange(void* context, int begin, int end)
+{
+	static_cast<CPUParticleKernel*>(context)->ExecuteParticles((uint)begin, (uint)end);
+}
+
+void CPUParticleKernel::EmitRange(void* context, int begin, int end)
+{
+	static_cast<CPUParticleKernel*>(context)->EmitParticles((uint)begin, (uint)end);
+}
+
+void CPUParticleKernel::WriteRange(void* context, int begin, int end)
+{
+	static_cast<CPUParticleKernel*>(context)->WriteParticles((uint)begin, (uint)end);
+}
+
+void CPUParticleKernel::ExecuteParticles(uint begin, uint end)
+{
+	float dt = mDeltaT;
+	float* s[COMPONENTS];
+	const float* s0[COMPONENTS];
+
+	//with an emitter there is nothing to go back to: every particle moves, Compact drops the ones past their life.
+	for (uint c = 0; c < COMPONENTS; c++)
+	{
+		s[c] = mState[c].data();
+		s0[c] = bEmitter ? s[c] : mInitialState[c].data();
+	}
+
+	//the terms of the kernel, worked out in the same order.
+	float drift[3], kick[3];
+
+	for (uint k = 0; k < 3; k++)
+	{
+		drift[k] = 0.5f*mAcceleration[k]*(dt*dt);
+		kick[k] = mAcceleration[k]*dt;
+	}
+
+	uint i = begin;
+
+#if PARTICLE_SSE
+	__m128 vdt = _mm_set1_ps(dt);
+	__m128 zero = _mm_setzero_ps();
+	__m128 vdrift[3], vkick[3];
+
+	for (uint k = 0; k < 3; k++)
+	{
+		vdrift[k] = _mm_set1_ps(drift[k]);
+		vkick[k] = _mm_set1_ps(kick[k]);
+	}
+
+	for (; i + 4 <= end; i += 4)
+	{
+		__m128 life = _mm_loadu_ps(s[LIFE] + i);
+		//alive particles move on, the others start over from their initial state.
+		__m128 alive = bEmitter ? _mm_cmpeq_ps(zero, zero) : _mm_cmpge_ps(life, zero);
+		__m128 next[COMPONENTS];
+
+		for (uint k = 0; k < 3; k++)
+		{
+			__m128 p = _mm_loadu_ps(s[PX + k] + i);
+			__m128 v = _mm_loadu_ps(s[VX + k] + i);
+
+			p = _mm_add_ps(_mm_add_ps(p, _mm_mul_ps(v, vdt)), vdrift[k]);
+			v = _mm_add_ps(v, vkick[k]);
+
+			next[PX + k] = _mm_or_ps(_mm_and_ps(alive, p), _mm_andnot_ps(alive, _mm_loadu_ps(s0[PX + k] + i)));
+			next[VX + k] = _mm_or_ps(_mm_and_ps(alive, v), _mm_andnot_ps(alive, _mm_loadu_ps(s0[VX + k] + i)));
+		}
+
+		next[LIFE] = _mm_or_ps(_mm_and_ps(alive, _mm_sub_ps(life, vdt)), _mm_andnot_ps(alive, _mm_loadu_ps(s0[LIFE] + i)));
+
+		for (uint c = 0; c < COMPONENTS; c++)
+			_mm_storeu_ps(s[c] + i, next[c]);
+
+		if (!bEmitter)
+			StoreParticles(mVertices, mCount, i, mLayout, next);
+	}
+#endif
+
+	for (; i < end; i++)
+	{
+		if (bEmitter || s[LIFE][i] >= 0.0f)
+		{
+			for (uint k = 0; k < 3; k++)
+			{
+				s[PX + k][i] = s[PX + k][i] + s[VX + k][i]*dt + drift[k];
+				s[VX + k][i] = s[VX + k][i] + kick[k];
+			}
+
+			s[LIFE][i] -= dt;
+		}
+		else
+		{
+			for (uint c = 0; c < COMPONENTS; c++)
+				s[c][i] = s0[c][i];
+		}
+
+		if (!bEmitter)
+			WriteParticle(i);
+	}
+}
+
+void CPUParticleKernel::EmitParticles(uint begin, uint end)
+{
+	float particle[PARTICLE_FLOATS];
+
+	for (uint i = begin; i < end; i++)
+	{
+		mEmitter.Emit(mEmitted + i, particle);
+
+		for (uint c = 0; c < COMPONENTS; c++)
+			mState[c][mLiveCount + i] = particle[c];
+	}
+}
+
+void CPUParticleKernel::WriteParticles(uint begin, uint end)
+{
+	uint i = begin;
+
+#if PARTICLE_SSE
+	for (; i + 4 <= end; i += 4)
+	{
+		__m128 next[COMPONENTS];
+
+		for (uint c = 0; c < COMPONENTS; c++)
+			next[c] = _mm_loadu_ps(mState[c].data() + i);
+
+		StoreParticles(mVertices, mCount, i, mLayout, next);
+	}
+#endif
+
+	for (; i < end; i++)
+		WriteParticle(i);
+}
+
+void CPUParticleKernel::WriteParticle(uint i)
+{
+	if (mLayout == PARTICLE_LAYOUT_SOA)
+	{
+		float* position = mVertices + 4*i;
+		float* velocity = mVertices + 4*(mCount + i);
+
+		for (uint k = 0; k < 3; k++)
+		{
+			position[k] = mState[PX + k][i];
+			velocity[k] = mState[VX + k][i];
+		}
+
+		position[3] = 1.0f;
+		velocity[3] = mState[LIFE][i];
+	}
+	else
+	{
+		float* vertex = mVertices + i*PARTICLE_FLOATS;
+
+		for (uint c = 0; c < COMPONENTS; c++)
+			vertex[c] = mState[c][i];
+	}
+}
+
+//on one thread: the particles move towards the start of the buffer, a range could overwrite one not yet read.
+void CPUParticleKernel::Compact()
+{
+	float* s[COMPONENTS];
+
+	for (uint c = 0; c < COMPONENTS; c++)
+		s[c] = mState[c].data();
+
+	uint live = 0;
+
+	for (uint i = 0; i < mLiveCount; i++)
+	{
+		if (s[LIFE][i] < 0.0f)
+			continue;
+
+		if (live != i)
+		{
+			for (uint c = 0; c < COMPONENTS; c++)
+				s[c][live] = s[c][i];
+		}
+
+		live++;
+	}
+
+	mLiveCount = live;
+}
+
+}
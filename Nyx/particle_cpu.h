@@ -0,0 +1,152 @@
+/*
+
+CPU Particle Kernel
+
+*/
+
+#ifndef PARTICLE_CPU_H
+#define PARTICLE_CPU_H
+
+#include <vector>
+
+namespace NYX {
+
+/*
+How the particles sit in their vertex buffer (and in the OpenCL buffers of the kernels):
+AOS: 7 floats per particle, position, velocity and life (see Particle).
+SOA: a stream of float4 positions (w is 1) followed by one of float4 velocities, with the life in w.
+Every particle is 16 byte aligned in both streams, so the kernels load and store whole float4s.
+*/
+enum eParticleLayout
+{
+	PARTICLE_LAYOUT_AOS,
+	PARTICLE_LAYOUT_SOA
+};
+
+//the size in bytes of count particles in the layout.
+NYX_EXPORT size_t ParticleBufferSize(eParticleLayout layout, uint count);
+//count particles, 7 floats each, into a buffer of ParticleBufferSize bytes in the layout.
+NYX_EXPORT void PackParticles(const float* particles, uint count, eParticleLayout layout, float* buffer);
+//back to 7 floats each.
+NYX_EXPORT void UnpackParticles(const float* buffer, uint count, eParticleLayout layout, float* particles);
+
+enum eEmitterShape
+{
+	EMITTER_BOX, //anywhere within position +- extent
+	EMITTER_SPHERE //anywhere within extent[0] of position
+};
+
+enum eVelocityShape
+{
+	VELOCITY_BOX, //anywhere between velocityMin and velocityMax
+	VELOCITY_CONE //within coneAngle of direction, speedMin to speedMax long
+};
+
+/*
+Where, how fast and for how long new particles come out, at rate particles per second. Every value is drawn
+uniformly in its range from a counter based generator: the n-th particle of an emitter with a given seed is
+the same on every device (particle_emitter.cl draws it the same way).
+*/
+struct NYX_EXPORT ParticleEmitter
+{
+	ParticleEmitter();
+
+	//the particles to emit in a step of deltaT: carry keeps the fraction of a particle left from the steps before.
+	uint EmissionCount(float deltaT, float& carry) const;
+	//the n-th particle, as 7 floats.
+	void Emit(uint n, float* particle) const;
+	//direction as a unit vector and the cosine of coneAngle, as particle_emitter.cl takes them.
+	void Cone(float* axis, float& cosAngle) const;
+
+	eEmitterShape shape;
+	float position[3];
+	float extent[3];
+	float velocityMin[3];
+	float velocityMax[3];
+	eVelocityShape velocity;
+	float direction[3];
+	float coneAngle; //rad, from direction to the side of the cone
+	float speedMin;
+	float speedMax;
+	float lifeMin; //s
+	float lifeMax;
+	float rate;
+	float acceleration[3];
+	uint seed;
+};
+
+//the first count particles of the emitter, 7 floats each, drawn across the TaskScheduler threads: a cloud to start from.
+NYX_EXPORT void GenerateParticles(const ParticleEmitter& emitter, uint count, float* particles);
+
+/*
+The particle fountain kernel (gl_particle_rain, Resources/FXKernels/particle_fountain.cl) on the CPU, for when
+there is no OpenCL device sharing the GL buffers: same integration, same reset to the initial state once a
+particle's life is over. The particles are kept as a structure of arrays, integrated four at a time with SSE,
+over ranges spread across the TaskScheduler threads, and written back in the layout of the vertex buffer.
+With an emitter it runs the kernels of particle_emitter.cl instead: the particles whose life is over are
+dropped, the live ones packed at the start of the buffer, and the new ones added after them.
+*/
+class NYX_EXPORT CPUParticleKernel
+{
+public:
+
+	//the floats of a particle in the vertex buffer: position, velocity, life (see Particle).
+	static const uint PARTICLE_FLOATS = 7;
+
+	CPUParticleKernel();
+
+	//count particles, 7 floats each. Also the state each one goes back to once its life is over.
+	void Initialize(const float* particles, uint count, eParticleLayout layout = PARTICLE_LAYOUT_AOS);
+	//room for count particles, none of them live yet.
+	void InitializeEmitter(const ParticleEmitter& emitter, uint count, eParticleLayout layout = PARTICLE_LAYOUT_SOA);
+	//one step of deltaT seconds. The new state goes to vertices, in the layout given to Initialize.
+	void Execute(float deltaT, float* vertices);
+	uint GetCount();
+	//the particles at the start of the vertex buffer that are alive: all of them without an emitter.
+	uint GetLiveCount();
+	eParticleLayout GetLayout();
+
+private:
+
+	enum eComponent
+	{
+		PX, PY, PZ,
+		VX, VY, VZ,
+		LIFE,
+		COMPONENTS
+	};
+
+	static void ExecuteRange(void* context, int begin, int end);
+	static void EmitRange(void* context, int begin, int end);
+	static void WriteRange(void* context, int begin, int end);
+	void ExecuteParticles(uint begin, uint end);
+	void EmitParticles(uint begin, uint end);
+	void WriteParticles(uint begin, uint end);
+	void WriteParticle(uint i);
+	void Compact();
+
+	uint mCount;
+	uint mLiveCount;
+	eParticleLayout mLayout;
+	float mAcceleration[3];
+	std::vector<float> mState[COMPONENTS];
+	std::vector<float> mInitialState[COMPONENTS];
+
+	//emission
+	bool bEmitter;
+	ParticleEmitter mEmitter;
+	uint mEmitted; //the particles drawn from the emitter so far
+	float mEmitCarry;
+
+	//of the Execute under way
+	float mDeltaT;
+	float* mVertices;
+};
+
+inline uint CPUParticleKernel::GetCount() { return mCount; }
+inline uint CPUParticleKernel::GetLiveCount() { return mLiveCount; }
+inline eParticleLayout CPUParticleKernel::GetLayout() { return mLayout; }
+
+}
+
+#endif // PARTICLE_CPU_H
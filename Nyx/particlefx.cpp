@@ -12,65 +12,180 @@ Particle Effect
 
 #include "Renderer/ogl/gl_vertex_buffer.h"
 
+#include <algorithm>
+#include <chrono>
+
 using namespace LuaPlus;
+using namespace std::chrono;
 
 namespace NYX {
 
+static const std::string EMITTER_PROGRAM = "particle_emitter.cl";
+
+enum eEmitterKernel
+{
+	EMITTER_UPDATE,
+	EMITTER_FIND_HOLES,
+	EMITTER_COMPACT,
+	EMITTER_EMIT,
+	EMITTER_KERNELS
+};
+
+static const char* EMITTER_KERNEL_NAMES[EMITTER_KERNELS] = { "particle_update", "particle_find_holes", "particle_compact", "particle_emit" };
+
 ParticleFX::~ParticleFX()
 {
-    clReleaseMemObject(mBuffer0);
-    delete mVertexBuffer;
-    delete mVertexArray;
+    //the last step may still be on its way to a vertex buffer.
+    if (bPending)
+        clFinish(FXManager::GetInstance()->GetCommandQueue());
+    
+    //the read writes into mLiveValue.
+    if (mLiveRead)
+        ReadLiveCount();
+    if (mState)
+        clReleaseMemObject(mState);
+    if (mBuffer0)
+        clReleaseMemObject(mBuffer0);
+    if (mCounters)
+        clReleaseMemObject(mCounters);
+    if (mHoles)
+        clReleaseMemObject(mHoles);
+    
+    for (uint i = 0; i < VERTEX_BUFFERS; i++)
+    {
+        if (mCopied[i])
+            clReleaseEvent(mCopied[i]);
+        delete mVertexBuffers[i];
+        delete mVertexArrays[i];
+    }
 }
     
-void ParticleFX::Initialize(string programName, string kernelName, uint size, string materialName, string &shaderName, Effect** prog)
+void ParticleFX::Initialize(string programName, string kernelName, uint size, string materialName, string &shaderName, Effect** prog, eParticleLayout layout)
 {
+	if (bEmitter)
+	{
+		programName = EMITTER_PROGRAM;
+		kernelName = EMITTER_KERNEL_NAMES[EMITTER_EMIT];
+		layout = PARTICLE_LAYOUT_SOA;
+	}
+
 	mCLProgramName = programName;
 	mCLKernelName = kernelName;
 	mParticleCount = size;
+	mLiveCount = bEmitter ? 0 : size;
+	mLayout = layout;
 
 	//load material
 	ResourcePtr res = ResourceCache::GetInstance()->RequestResource(materialName, RES_MATERIAL);
 	mMaterial = dynamic_cast<MaterialResource*>(res.get())->GetMaterial();
 
-	mCLProgram = FXManager::GetInstance()->CreateProgram(programName);
-	mCLKernel = FXManager::GetInstance()->GetKernel(programName, kernelName);
+	if (FXManager::GetInstance()->IsCLAvailable())
+	{
+		mCLProgram = FXManager::GetInstance()->CreateProgram(programName);
+		mCLKernel = FXManager::GetInstance()->GetKernel(programName, kernelName);
+
+		for (uint i = 0; bEmitter && i < EMITTER_KERNELS; i++)
+		{
+			if (FXManager::GetInstance()->GetKernel(programName, EMITTER_KERNEL_NAMES[i]) == nullptr)
+				mCLKernel = nullptr;
+		}
+	}
+
+	bCPU = (mCLKernel == nullptr);
 
 	shaderName = mMaterial->GetShaderName();
 	*prog = mRenderer->CreateShaderProgram(shaderName);
 	mMaterial->SetShaderProg(*prog);
 
-    mVertexBuffer = mRenderer->CreateVertexBuffer();
-    mVertexBuffer->Create( sizeof(Particle), mParticleCount );
-    mVertexArray = mRenderer->CreateVertexArrayObject();
-    mVertexArray->Create();
+    //the CPU writes to the buffer it draws from.
+    uint buffers = bCPU ? 1 : VERTEX_BUFFERS;
     
-    mVertexBuffer->Bind();
-    mVertexArray->Bind();
-    
-    mVertexArray->EnableVertexAttribute(*prog, "vVertex", 3, sizeof(float)*7, (sizeof(float)*0));
-    mVertexArray->EnableVertexAttribute(*prog, "vVelocity", 4, sizeof(float)*7, (sizeof(float)*3));
-   
-    mVertexArray->Unbind();
-    mVertexBuffer->Unbind();
+    for (uint i = 0; i < buffers; i++)
+    {
+        mVertexBuffers[i] = mRenderer->CreateVertexBuffer();
+        mVertexBuffers[i]->Create( ParticleBufferSize(mLayout, 1), mParticleCount );
+        mVertexArrays[i] = mRenderer->CreateVertexArrayObject();
+        mVertexArrays[i]->Create();
+        
+        mVertexBuffers[i]->Bind();
+        mVertexArrays[i]->Bind();
+        
+        if ( mLayout == PARTICLE_LAYOUT_SOA )
+        {
+            //the positions stream, then the velocities one: vVelocity.w is still the life.
+            mVertexArrays[i]->EnableVertexAttribute(*prog, "vVertex", 3, sizeof(float)*4, 0);
+            mVertexArrays[i]->EnableVertexAttribute(*prog, "vVelocity", 4, sizeof(float)*4, sizeof(float)*4*mParticleCount);
+        }
+        else
+        {
+            mVertexArrays[i]->EnableVertexAttribute(*prog, "vVertex", 3, sizeof(float)*7, (sizeof(float)*0));
+            mVertexArrays[i]->EnableVertexAttribute(*prog, "vVelocity", 4, sizeof(float)*7, (sizeof(float)*3));
+        }
+       
+        mVertexArrays[i]->Unbind();
+        mVertexBuffers[i]->Unbind();
+    }
 
 	cl_context ctx = FXManager::GetInstance()->GetCLContext();
 	cl_command_queue queue = FXManager::GetInstance()->GetCommandQueue();
 	cl_int err;
 
-    err = mVertexBuffer->CreateCLBufferFromThis(ctx);
-    
-	if (err != 0)
-		LogManager::GetInstance()->LogMessage("Error! Failed to create CL buffer from GL VBO.");
+	for (uint i = 0; !bCPU && i < VERTEX_BUFFERS; i++)
+	{
+		err = mVertexBuffers[i]->CreateCLBufferFromThis(ctx);
 
-	mBuffer0 = clCreateBuffer(ctx, CL_MEM_READ_ONLY, sizeof(Particle)*mParticleCount, NULL, &err); //we still need to load the buffer!
+		if (err != 0)
+		{
+			LogManager::GetInstance()->LogMessage("Error! Failed to create CL buffer from GL VBO.");
+			bCPU = true;
+		}
+	}
 
-	if (err != 0)
-		LogManager::GetInstance()->LogMessage("Error! Failed to create CL buffer.");
+	//the kernels step the particles in a buffer of their own, then copy them to a vertex buffer.
+	if (!bCPU)
+	{
+		mState = clCreateBuffer(ctx, CL_MEM_READ_WRITE, ParticleBufferSize(mLayout, mParticleCount), NULL, &err);
 
-	GenerateParticleCloud(queue);
+		if (err != 0)
+		{
+			LogManager::GetInstance()->LogMessage("Error! Failed to create CL buffer.");
+			mState = nullptr;
+			bCPU = true;
+		}
+	}
 
-	err = clFinish(queue);
+	if (!bCPU && bEmitter)
+	{
+		cl_int holesErr;
+		mCounters = clCreateBuffer(ctx, CL_MEM_READ_WRITE, sizeof(cl_int)*4, NULL, &err);
+		mHoles = clCreateBuffer(ctx, CL_MEM_READ_WRITE, sizeof(cl_int)*mParticleCount, NULL, &holesErr);
+
+		if (err != 0 || holesErr != 0)
+		{
+			LogManager::GetInstance()->LogMessage("Error! Failed to create CL buffer.");
+			bCPU = true;
+		}
+	}
+	else if (!bCPU)
+	{
+		mBuffer0 = clCreateBuffer(ctx, CL_MEM_READ_ONLY, ParticleBufferSize(mLayout, mParticleCount), NULL, &err); //we still need to load the buffer!
+
+		if (err != 0)
+		{
+			LogManager::GetInstance()->LogMessage("Error! Failed to create CL buffer.");
+			mBuffer0 = nullptr;
+			bCPU = true;
+		}
+	}
+
+	if (bCPU)
+		LogManager::GetInstance()->LogMessage("Particle effect " + mCLKernelName + " runs on the CPU.");
+
+	//an emitter starts with no particles: nothing to upload.
+	if (bEmitter && bCPU)
+		mCPUKernel.InitializeEmitter(mEmitter, mParticleCount, mLayout);
+	else if (!bEmitter)
+		GenerateParticleCloud(queue);
 }
 
 void ParticleFX::UseScriptParticleGeneration(string source, string funcName)
@@ -83,72 +198,337 @@ void ParticleFX::UseScriptParticleGeneration(string source, string funcName)
 	bScriptCloudGeneration = true;
 }
 
+void ParticleFX::UseEmitter(const ParticleEmitter& emitter)
+{
+	mEmitter = emitter;
+	bEmitter = true;
+}
+
+void ParticleFX::UseCloudEmitter(const ParticleEmitter& emitter)
+{
+	mCloudEmitter = emitter;
+	bCloudEmitter = true;
+}
+
+bool RunParticleScript(std::string funcName, uint count, float* particles)
+{
+	ScriptManager *pScript = ScriptManager::GetInstance();
+	
+	LuaObject func_object = pScript->GetLuaFunction(funcName);
+
+	if (!func_object.IsFunction())
+	{
+		LogManager::GetInstance()->LogMessage("Error! " + funcName + " is not a script function to generate particles with.");
+		return false;
+	}
+
+	LuaFunction<LuaObject> GenParticles( func_object );
+
+	ScriptBuffer buffer = { particles, count, CPUParticleKernel::PARTICLE_FLOATS };
+	LuaObject buffer_object;
+	pScript->MakeBuffer(&buffer, buffer_object);
+
+	LuaObject cloud = GenParticles(count, buffer_object);
+	pScript->ReleaseBuffer(buffer_object);
+	
+	//filled in with SetFloats.
+	if (!cloud.IsTable())
+		return true;
+	
+	//a table of 7 numbers per particle, as the scripts used to return: a Lua lookup for every one of them.
+	for (uint i = 0; i < count*CPUParticleKernel::PARTICLE_FLOATS; i++)
+		particles[i] = cloud[i].GetFloat();
+
+	return true;
+}
+
 void ParticleFX::GenerateParticleCloud(cl_command_queue &queue)
 {
 	Particle* particles = new Particle[mParticleCount];
 	
-	if (bScriptCloudGeneration)
-	{
-		ScriptManager *pScript = ScriptManager::GetInstance();
-		
-        LuaObject func_object = pScript->GetLuaFunction(mScriptFunctionName);
-		LuaFunction<LuaObject> GenParticles( func_object );
-
-		LuaObject cloud = GenParticles(mParticleCount);
-		
-		if (!cloud.IsTable())
-			return;
-		
-		for (uint i = 0; i < mParticleCount; i++)
-		{
-			particles[i].position[0] = cloud[i*7].GetFloat();
-			particles[i].position[1] = cloud[i*7 + 1].GetFloat();
-			particles[i].position[2] = cloud[i*7 + 2].GetFloat();
+	if (bCloudEmitter)
+	{
+		GenerateParticles(mCloudEmitter, mParticleCount, &particles[0].position[0]);
+	}
+	else if (bScriptCloudGeneration && !RunParticleScript(mScriptFunctionName, mParticleCount, &particles[0].position[0]))
+	{
+		delete [] particles;
+		return;
+	}
 
-			particles[i].velocity[0] = cloud[i*7 + 3].GetFloat();
-			particles[i].velocity[1] = cloud[i*7 + 4].GetFloat();
-			particles[i].velocity[2] = cloud[i*7 + 5].GetFloat();
+	size_t bufferSize = ParticleBufferSize(mLayout, mParticleCount);
+	float* packed = new float[bufferSize / sizeof(float)];
+	PackParticles(&particles[0].position[0], mParticleCount, mLayout, packed);
 
-			particles[i].life = cloud[i*7 + 6].GetFloat(); // s
-		}
+	//the first buffer drawn starts from the cloud, the kernels from a copy of their own.
+	float* vertices = mVertexBuffers[0]->Lock();
 
-	}
+	if (vertices)
+		memcpy(vertices, packed, bufferSize);
 
-	//populate buffers
-    cl_int error = mVertexBuffer->LockCL(queue);
-    error |= mVertexBuffer->UpdateCLBuffer(queue, sizeof(Particle)*mParticleCount, particles);
-    error |= mVertexBuffer->UnlockCL(queue);
-    
-	error |= clEnqueueWriteBuffer(queue, mBuffer0, CL_TRUE, 0, sizeof(Particle)*mParticleCount, particles, 0, NULL, NULL);
+	mVertexBuffers[0]->Unlock();
 
-	if (error != 0)
+	cl_int error = 0;
+
+	//the kernels keep the initial state too.
+	if (bCPU)
+	{
+		mCPUKernel.Initialize(&particles[0].position[0], mParticleCount, mLayout);
+	}
+	else
+	{
+		error = clEnqueueWriteBuffer(queue, mState, CL_TRUE, 0, bufferSize, packed, 0, NULL, NULL);
+		error |= clEnqueueWriteBuffer(queue, mBuffer0, CL_TRUE, 0, bufferSize, packed, 0, NULL, NULL);
+	}
+
+	if (vertices == nullptr || error != 0)
 		LogManager::GetInstance()->LogMessage("Error! Failed to populate FX buffers!");
 
+	delete [] packed;
 	delete [] particles;
 }
 
 void ParticleFX::ExecuteKernel(float timeStep)
 {
-	//cl_context ctx = FXManager::GetInstance()->GetCLContext();
+	steady_clock::time_point start = steady_clock::now();
+
+	if (bCPU)
+	{
+		//mapping the buffer waits for the draws from it.
+		float* vertices = mVertexBuffers[0]->Lock();
+		mWaitTime = duration<float, std::milli>(steady_clock::now() - start).count();
+
+		if (vertices)
+			mCPUKernel.Execute(timeStep, vertices);
+
+		mVertexBuffers[0]->Unlock();
+		mLiveCount = mCPUKernel.GetLiveCount();
+		return;
+	}
+
+	//the step started by the last call is drawn while this one runs.
+	if (bPending)
+		SwapBuffers();
+
+	mWaitTime = duration<float, std::milli>(steady_clock::now() - start).count();
+
+	cl_int error = EnqueueStep(timeStep, 1 - mFront);
+
+	if (error != 0)
+		LogManager::GetInstance()->LogMessage("Error! Failed to run particle effect " + mCLKernelName + ": " + std::to_string(error));
+}
+
+void ParticleFX::SwapBuffers()
+{
+	uint back = 1 - mFront;
+	cl_int error = 0;
+
+	//with cl_khr_gl_event the draws wait for the copy on the device.
+	if (!FXManager::GetInstance()->HasGLEvents())
+		error = clWaitForEvents(1, &mCopied[back]);
+
+	error |= ReadLiveCount();
+
+	if (error != 0)
+		LogManager::GetInstance()->LogMessage("Error! Failed to wait for particle effect " + mCLKernelName + ": " + std::to_string(error));
+
+	clReleaseEvent(mCopied[back]);
+	mCopied[back] = nullptr;
+	mFront = back;
+	bPending = false;
+}
+
+cl_int ParticleFX::ReadLiveCount()
+{
+	if (!mLiveRead)
+		return 0;
+
+	cl_int error = clWaitForEvents(1, &mLiveRead);
+	clReleaseEvent(mLiveRead);
+	mLiveRead = nullptr;
+
+	if (error == 0)
+		mLiveCount = std::min((uint)mLiveValue, mParticleCount);
+
+	return error;
+}
+
+cl_int ParticleFX::EnqueueStep(float timeStep, uint target)
+{
 	cl_command_queue queue = FXManager::GetInstance()->GetCommandQueue();
-	cl_int error;
+	cl_mem vertices = *mVertexBuffers[target]->GetSharedCLBuffer();
+	cl_int error = 0;
 
-    error = mVertexBuffer->LockCL(queue);
+	//the particles that can be alive after the step: all of them without an emitter.
+	uint count = mParticleCount;
 
-	error = clSetKernelArg(mCLKernel, 0, sizeof(cl_mem), mVertexBuffer->GetSharedCLBuffer());
-	error |= clSetKernelArg(mCLKernel, 1, sizeof(cl_mem), &mBuffer0);
-	error |= clSetKernelArg(mCLKernel, 2, sizeof(float), &timeStep);
-	error |= clSetKernelArg(mCLKernel, 3, sizeof(int), &mParticleCount);
+	if (bEmitter)
+	{
+		//normally read by SwapBuffers, but a step that failed to give back its vertex buffer is not swapped in.
+		error = ReadLiveCount();
 
-	const size_t local_ws = 100;
-	const size_t total_ws = mParticleCount; 
+		uint emitted = mEmitter.EmissionCount(timeStep, mEmitCarry);
+		error |= EnqueueEmitterKernels(mState, mCounters, mHoles, mParticleCount, mEmitter, timeStep, mEmitted, emitted, mLiveCount, &mLiveValue, &mLiveRead);
 
-	error = clEnqueueNDRangeKernel(queue, mCLKernel, 1, NULL, &total_ws, &local_ws, 0, NULL, NULL);
+		count = std::min(mLiveCount + emitted, mParticleCount);
+		mEmitted += emitted;
+	}
+	else
+	{
+		error = clSetKernelArg(mCLKernel, 0, sizeof(cl_mem), &mState);
+		error |= clSetKernelArg(mCLKernel, 1, sizeof(cl_mem), &mBuffer0);
+		error |= clSetKernelArg(mCLKernel, 2, sizeof(float), &timeStep);
+		error |= clSetKernelArg(mCLKernel, 3, sizeof(int), &mParticleCount);
 
-    error = mVertexBuffer->UnlockCL(queue);
+		//the kernels check their index against the count: the last work group can run past it.
+		const size_t local_ws = 100;
+		const size_t total_ws = ((mParticleCount + local_ws - 1) / local_ws)*local_ws; 
 
-	error = clFinish(queue);
+		error |= clEnqueueNDRangeKernel(queue, mCLKernel, 1, NULL, &total_ws, &local_ws, 0, NULL, NULL);
+	}
+
+	//without cl_khr_gl_event, the CPU waits for the draws from the target here.
+	steady_clock::time_point start = steady_clock::now();
+	error |= mVertexBuffers[target]->LockCL(queue);
+	mWaitTime += duration<float, std::milli>(steady_clock::now() - start).count();
+
+	if (bEmitter && count > 0)
+	{
+		//the live particles only: the start of the positions stream and of the velocities one.
+		size_t liveSize = ParticleBufferSize(mLayout, count);
+		size_t velocities = ParticleBufferSize(mLayout, mParticleCount) / 2;
+
+		error |= clEnqueueCopyBuffer(queue, mState, vertices, 0, 0, liveSize / 2, 0, NULL, NULL);
+		error |= clEnqueueCopyBuffer(queue, mState, vertices, velocities, velocities, liveSize / 2, 0, NULL, NULL);
+	}
+	else if (!bEmitter)
+	{
+		error |= clEnqueueCopyBuffer(queue, mState, vertices, 0, 0, ParticleBufferSize(mLayout, mParticleCount), 0, NULL, NULL);
+	}
+
+	if (mCopied[target])
+		clReleaseEvent(mCopied[target]);
+
+	mCopied[target] = nullptr;
+	error |= mVertexBuffers[target]->UnlockCL(queue, &mCopied[target]);
+
+	//on its way to the device without waiting for it: the next call swaps it in.
+	error |= clFlush(queue);
+	bPending = (mCopied[target] != nullptr);
+
+	return error;
+}
+
+cl_int ExecuteEmitterKernels(cl_mem particles, cl_mem counters, cl_mem holes, uint count, const ParticleEmitter& emitter, 
+							 float timeStep, uint first, uint emitted, uint& live)
+{
+	cl_int liveValue = 0;
+	cl_event liveRead = NULL;
+	cl_int error = EnqueueEmitterKernels(particles, counters, holes, count, emitter, timeStep, first, emitted, live, &liveValue, &liveRead);
+
+	if (liveRead)
+	{
+		error |= clWaitForEvents(1, &liveRead);
+		clReleaseEvent(liveRead);
+	}
+
+	if (error == 0)
+		live = std::min((uint)liveValue, count);
+
+	return error;
 }
 
+cl_int EnqueueEmitterKernels(cl_mem particles, cl_mem counters, cl_mem holes, uint count, const ParticleEmitter& emitter, 
+							 float timeStep, uint first, uint emitted, uint live, cl_int* liveOut, cl_event* liveRead)
+{
+	FXManager* fxManager = FXManager::GetInstance();
+	cl_command_queue queue = fxManager->GetCommandQueue();
+	cl_kernel kernels[EMITTER_KERNELS];
+	cl_int error = 0;
+
+	for (uint i = 0; i < EMITTER_KERNELS; i++)
+	{
+		kernels[i] = fxManager->GetKernel(EMITTER_PROGRAM, EMITTER_KERNEL_NAMES[i]);
+
+		if (kernels[i] == nullptr)
+			return CL_INVALID_KERNEL;
+	}
+
+	const size_t local_ws = 100;
+	int num = (int)count;
+	int liveCount = (int)live;
+	int emitCount = (int)emitted;
+	size_t live_ws = ((live + local_ws - 1) / local_ws)*local_ws;
+	size_t emit_ws = ((emitted + local_ws - 1) / local_ws)*local_ws;
+	const cl_int zero = 0;
+
+	cl_float4 acceleration = { { emitter.acceleration[0], emitter.acceleration[1], emitter.acceleration[2], 0.0f } };
+	cl_float4 position = { { emitter.position[0], emitter.position[1], emitter.position[2], 0.0f } };
+	cl_float4 extent = { { emitter.extent[0], emitter.extent[1], emitter.extent[2], 0.0f } };
+	cl_float4 velocityMin = { { emitter.velocityMin[0], emitter.velocityMin[1], emitter.velocityMin[2], 0.0f } };
+	cl_float4 velocityMax = { { emitter.velocityMax[0], emitter.velocityMax[1], emitter.velocityMax[2], 0.0f } };
+	cl_float2 life = { { emitter.lifeMin, emitter.lifeMax } };
+	cl_int shape = (cl_int)emitter.shape;
+	cl_uint seed = emitter.seed;
+	cl_int velocityShape = (cl_int)emitter.velocity;
+	cl_float4 cone;
+	cl_float2 speed = { { emitter.speedMin, emitter.speedMax } };
+	emitter.Cone(cone.s, cone.s[3]);
+
+	error |= clEnqueueFillBuffer(queue, counters, &zero, sizeof(zero), 0, sizeof(cl_int)*4, 0, NULL, NULL);
+
+	if (liveCount > 0)
+	{
+		cl_kernel update = kernels[EMITTER_UPDATE];
+		error |= clSetKernelArg(update, 0, sizeof(cl_mem), &particles);
+		error |= clSetKernelArg(update, 1, sizeof(cl_mem), &counters);
+		error |= clSetKernelArg(update, 2, sizeof(cl_float4), &acceleration);
+		error |= clSetKernelArg(update, 3, sizeof(float), &timeStep);
+		error |= clSetKernelArg(update, 4, sizeof(int), &num);
+		error |= clSetKernelArg(update, 5, sizeof(int), &liveCount);
+		error |= clEnqueueNDRangeKernel(queue, update, 1, NULL, &live_ws, &local_ws, 0, NULL, NULL);
+
+		cl_kernel findHoles = kernels[EMITTER_FIND_HOLES];
+		error |= clSetKernelArg(findHoles, 0, sizeof(cl_mem), &particles);
+		error |= clSetKernelArg(findHoles, 1, sizeof(cl_mem), &counters);
+		error |= clSetKernelArg(findHoles, 2, sizeof(cl_mem), &holes);
+		error |= clSetKernelArg(findHoles, 3, sizeof(int), &num);
+		error |= clEnqueueNDRangeKernel(queue, findHoles, 1, NULL, &live_ws, &local_ws, 0, NULL, NULL);
+
+		cl_kernel compact = kernels[EMITTER_COMPACT];
+		error |= clSetKernelArg(compact, 0, sizeof(cl_mem), &particles);
+		error |= clSetKernelArg(compact, 1, sizeof(cl_mem), &counters);
+		error |= clSetKernelArg(compact, 2, sizeof(cl_mem), &holes);
+		error |= clSetKernelArg(compact, 3, sizeof(int), &num);
+		error |= clSetKernelArg(compact, 4, sizeof(int), &liveCount);
+		error |= clEnqueueNDRangeKernel(queue, compact, 1, NULL, &live_ws, &local_ws, 0, NULL, NULL);
+	}
+
+	if (emitCount > 0)
+	{
+		cl_kernel emit = kernels[EMITTER_EMIT];
+		error |= clSetKernelArg(emit, 0, sizeof(cl_mem), &particles);
+		error |= clSetKernelArg(emit, 1, sizeof(cl_mem), &counters);
+		error |= clSetKernelArg(emit, 2, sizeof(int), &num);
+		error |= clSetKernelArg(emit, 3, sizeof(cl_int), &shape);
+		error |= clSetKernelArg(emit, 4, sizeof(cl_float4), &position);
+		error |= clSetKernelArg(emit, 5, sizeof(cl_float4), &extent);
+		error |= clSetKernelArg(emit, 6, sizeof(cl_float4), &velocityMin);
+		error |= clSetKernelArg(emit, 7, sizeof(cl_float4), &velocityMax);
+		error |= clSetKernelArg(emit, 8, sizeof(cl_float2), &life);
+		error |= clSetKernelArg(emit, 9, sizeof(cl_uint), &seed);
+		error |= clSetKernelArg(emit, 10, sizeof(cl_uint), &first);
+		error |= clSetKernelArg(emit, 11, sizeof(int), &emitCount);
+		error |= clSetKernelArg(emit, 12, sizeof(cl_int), &velocityShape);
+		error |= clSetKernelArg(emit, 13, sizeof(cl_float4), &cone);
+		error |= clSetKernelArg(emit, 14, sizeof(cl_float2), &speed);
+		error |= clEnqueueNDRangeKernel(queue, emit, 1, NULL, &emit_ws, &local_ws, 0, NULL, NULL);
+	}
+
+	//the draw count: what survived the step plus what was emitted, up to the room there is.
+	error |= clEnqueueReadBuffer(queue, counters, CL_FALSE, 0, sizeof(cl_int), liveOut, 0, NULL, liveRead);
+
+	return error;
 }
 
+}
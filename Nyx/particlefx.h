@@ -11,6 +11,7 @@ Particle Effect
 #include "irenderer.h"
 #include "material.h"
 #include "Script/script_manager.h"
+#include "particle_cpu.h"
 
 namespace NYX {
 
@@ -35,6 +36,25 @@ struct NYX_EXPORT Particle
 	float life;
 };
 
+/*
+A step of the kernels of particle_emitter.cl on particles, a buffer of count particles in the SOA layout with the 
+first live ones alive: they move, the ones whose life is over go, and emitted new ones from the first-th of
+the emitter on join them, as room allows. live is then the particles alive. counters and holes are buffers of 
+4 and count ints. Returns the first OpenCL error.
+*/
+NYX_EXPORT cl_int ExecuteEmitterKernels(cl_mem particles, cl_mem counters, cl_mem holes, uint count, const ParticleEmitter& emitter, 
+										float timeStep, uint first, uint emitted, uint& live);
+//the same step, without waiting for it: liveRead completes once the particles alive are in *liveOut, which can be more than count.
+NYX_EXPORT cl_int EnqueueEmitterKernels(cl_mem particles, cl_mem counters, cl_mem holes, uint count, const ParticleEmitter& emitter, 
+										float timeStep, uint first, uint emitted, uint live, cl_int* liveOut, cl_event* liveRead);
+
+/*
+count particles, 7 floats each, from a script function registered with the ScriptManager: it gets the count and a 
+buffer to fill in with SetFloats(particles, i, x, y, z, vx, vy, vz, life), i from 0. A script that returns a table of
+7 numbers per particle instead still works, much slower.
+*/
+NYX_EXPORT bool RunParticleScript(std::string funcName, uint count, float* particles);
+
 class NYX_EXPORT ParticleFX 
 {
 
@@ -43,19 +63,53 @@ public:
 	ParticleFX(IRenderer* renderer) :
 		mRenderer(renderer),
 		mParticleCount(0),
+		mLayout(PARTICLE_LAYOUT_AOS),
+		mCLProgram(nullptr),
+		mCLKernel(nullptr),
+		mState(nullptr),
+		mBuffer0(nullptr),
+		mFront(0),
+		bPending(false),
+		mWaitTime(0.0f),
+		bEmitter(false),
+		mLiveCount(0),
+		mEmitted(0),
+		mEmitCarry(0.0f),
+		mCounters(nullptr),
+		mHoles(nullptr),
+		mLiveRead(nullptr),
+		mLiveValue(0),
+		bCPU(false),
+		bCloudEmitter(false),
 		bScriptCloudGeneration(false)
 	{ }
     
     ~ParticleFX();
 
 	uint ParticleCount(); 
+	//the particles to draw, at the start of the vertex buffer: with an emitter, the live ones.
+	uint LiveCount();
+	eParticleLayout GetLayout();
+	//the effect runs on the CPU when OpenCL can't run its kernel.
+	bool IsCPU();
+	//ms the CPU waited for OpenCL or GL in the last ExecuteKernel.
+	float GetWaitTime();
 	MaterialPtr GetMaterial();
-    VertexBuffer* GetVertexBuffer()                 { return mVertexBuffer; }
+	//the buffer to draw, while the kernels fill the other one. Fence region 0 of it once drawn.
+    VertexBuffer* GetVertexBuffer()                 { return mVertexBuffers[mFront]; }
     VertexArrayObject* GetVAO();
 
-	void Initialize(std::string programName, std::string kernelName, uint size, std::string materialName, std::string &shaderName, Effect **prog);
+	//the kernel has to work on the layout: gl_particle_rain on PARTICLE_LAYOUT_AOS, gl_particle_rain_soa on PARTICLE_LAYOUT_SOA.
+	//with an emitter, the program and kernel are those of particle_emitter.cl and the layout PARTICLE_LAYOUT_SOA.
+	void Initialize(std::string programName, std::string kernelName, uint size, std::string materialName, std::string &shaderName, Effect **prog,
+					eParticleLayout layout = PARTICLE_LAYOUT_AOS);
+	//with OpenCL, starts the step and swaps in the one before: what is drawn is a step behind.
 	void ExecuteKernel(float timeStep);
     void UseScriptParticleGeneration(std::string source, std::string funcName);
+	//particles emitted by the kernels as they go, instead of a cloud that starts over. Before Initialize.
+	void UseEmitter(const ParticleEmitter& emitter);
+	//the cloud that starts over drawn from an emitter, on the CPU threads, instead of from a script: its rate is not used.
+	void UseCloudEmitter(const ParticleEmitter& emitter);
 
 protected:
 
@@ -63,26 +117,62 @@ protected:
 	MaterialPtr mMaterial;
 
 	uint mParticleCount;
+	eParticleLayout mLayout;
 
-    VertexArrayObject* mVertexArray = nullptr;
-    VertexBuffer* mVertexBuffer = nullptr;
+    //one to draw and one for the kernels to copy the next step to. The CPU only uses the first.
+    static const uint VERTEX_BUFFERS = 2;
+    VertexArrayObject* mVertexArrays[VERTEX_BUFFERS] = {};
+    VertexBuffer* mVertexBuffers[VERTEX_BUFFERS] = {};
     
 	std::string mCLProgramName;
 	std::string mCLKernelName;
 	cl_program mCLProgram;
     cl_kernel mCLKernel;
+	cl_mem mState; //the particles the kernels work on
 	cl_mem mBuffer0; //initial state to reset to. 
 
+	uint mFront; //the vertex buffer drawn
+	cl_event mCopied[VERTEX_BUFFERS] = {}; //once the step is in the vertex buffer
+	bool bPending; //a step on its way to the other vertex buffer
+	float mWaitTime;
+
+	//emission
+	bool bEmitter;
+	ParticleEmitter mEmitter;
+	uint mLiveCount;
+	uint mEmitted; //the particles drawn from the emitter so far
+	float mEmitCarry;
+	cl_mem mCounters; //see particle_emitter.cl
+	cl_mem mHoles; //an index per particle: 4 bytes, where a copy of the initial state took 32
+	cl_event mLiveRead;
+	cl_int mLiveValue; //the particles alive after the pending step, once mLiveRead completes
+
+	//without OpenCL
+	bool bCPU;
+	CPUParticleKernel mCPUKernel;
+
+	//a cloud from an emitter
+	bool bCloudEmitter;
+	ParticleEmitter mCloudEmitter;
+
 	//script integration
 	bool bScriptCloudGeneration;
     std::string mScriptFunctionName;
 
 	virtual void GenerateParticleCloud(cl_command_queue &queue);
+	void SwapBuffers();
+	//waits for the live count read by the last emitter step, if any, and releases its event.
+	cl_int ReadLiveCount();
+	cl_int EnqueueStep(float timeStep, uint target);
 };
 
 inline MaterialPtr ParticleFX::GetMaterial() { return mMaterial; }
 inline uint ParticleFX::ParticleCount() { return mParticleCount; }
-inline VertexArrayObject* ParticleFX::GetVAO() { return mVertexArray; }
+inline uint ParticleFX::LiveCount() { return mLiveCount; }
+inline bool ParticleFX::IsCPU() { return bCPU; }
+inline float ParticleFX::GetWaitTime() { return mWaitTime; }
+inline eParticleLayout ParticleFX::GetLayout() { return mLayout; }
+inline VertexArrayObject* ParticleFX::GetVAO() { return mVertexArrays[mFront]; }
 
 }
 
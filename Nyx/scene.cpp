@@ -12,6 +12,7 @@
 #include "camera_fp.h"
 #include "particle_node.h"
 #include "Physics/rigid_body.h"
+#include "Script/script_manager.h"
 #include "Math/vector3.h"
 #include "Math/vector4.h"
 #include "Math/matrix3x3.h"
@@ -27,6 +28,9 @@ static const std::string SCRIPT_EXTENSION = ".lua";
 static const std::string KERNEL_EXTENSION = ".cl";
 static const std::string OBJECT_EXTENSION = ".obj";
 static const std::string MATERIAL_EXTENSION = ".mtl";
+static const std::string COOKED_BVH_EXTENSION = ".bvh";
+static const std::string COOKED_HULL_EXTENSION = ".hull";
+static const std::string COOKED_WORLD_EXTENSION = ".physics";
 
 // Utility JSON Parsers
 class CameraParser
@@ -48,11 +52,11 @@ public:
 class ObjectParser
 {
 public:
-    void operator() ( const json& object_source, SceneNodePtr parent, IRenderer* renderer, float aspect_ratio );
+    void operator() ( const json& object_source, SceneNodePtr parent, IRenderer* renderer, float aspect_ratio, PhysicsEnginePtr physics_engine );
     
     std::list<CameraNode*> mCameras;
     std::map<SceneNodePtr, string> mTargets;
-    std::list<PhysicsBodyPtr> mRigidBodies;
+    std::list<PhysicsBodyPtr> mBodies; //rigid and soft
 };
     
 class SkyBoxParser
@@ -65,20 +69,43 @@ class PhysicsParser
 {
 public:
     void operator() ( const json& physics_source, PhysicsEnginePtr physics_engine );
+    
+    float mBackgroundRate = 0.0f;
+};
+
+class BroadphaseParser
+{
+public:
+    void operator() ( const json& broadphase_source, PhysicsEnginePtr physics_engine );
 };
 
 class RigidBodyParser
 {
 public:
-    void operator() ( const json& rb_source, SceneNodePtr parent, IRenderer* renderer, bool has_parent );
+    void operator() ( const json& rb_source, SceneNodePtr parent, IRenderer* renderer, bool has_parent, PhysicsEnginePtr physics_engine );
     
     PhysicsBodyPtr rigidbody;
+    
+private:
+    void SetMeshShape( const json& shape_source, SceneNodePtr parent, bool has_parent );
+    void SetTriangleMeshShape( SceneNodePtr parent, bool has_parent );
+};
+
+class SoftBodyParser
+{
+public:
+    void operator() ( const json& sb_source, SceneNodePtr parent, PhysicsEnginePtr physics_engine );
+    
+    PhysicsBodyPtr softbody;
 };
     
 class ParticleEmitterParser
 {
 public:
     void operator() ( const json& fx_source, SceneNodePtr parent, IRenderer* renderer );
+    
+private:
+    ParticleEmitter ParseEmitter( const json& emitter_source );
 };
   
 // Scene implementation
@@ -89,6 +116,7 @@ Scene::Scene(ApplicationPtr application)
 	//TODO add a factory for physics engines
 	pPhysicsEngine = PhysicsEnginePtr( new DefaultPhysicsEngine() );
 	pPhysicsEngine->InitPhysics(PHYS_RIGID_ONLY);
+	mBackgroundRate = 0.0f;
 }
 
 Scene::~Scene()
@@ -100,26 +128,64 @@ void Scene::Update( void )
 {
     static uint refreshNumber = 0;
     uint deltaT = 0;
+    uint frameTime = 0;
     bool updateAnimation;
+    float physicsInterpolation = 1.0f;
     
-    mEventMng->ProcessEventQueue();
+    bool replaying = mEventMng->IsReplaying();
+    uint lastTime = mApplication->mCurTime;
     
-    mApplication->mCurTime = SDL_GetTicks();
+    if ( replaying )
+    {
+        //replay: the recorded physics and input events stand in for the live ones, and time advances
+        //by one animation step per frame, so that every run of the same log does the same work.
+        //the frame counter is bumped by ProcessEventQueue, below.
+        mApplication->mCurTime = mApplication->mLoopStartTime + (mEventMng->GetFrameNumber() + 1) * mApplication->GetAnimationRate();
+    }
+    else
+    {
+        mApplication->mCurTime = SDL_GetTicks();
+    }
+    
+    //time since the last frame, for the physics. deltaT (time since the loop started) drives the animation refresh.
+    frameTime = (mApplication->mCurTime > lastTime) ? mApplication->mCurTime - lastTime : 0;
     deltaT = mApplication->mCurTime - mApplication->mLoopStartTime;
     
-    updateAnimation = (refreshNumber == 0 || (deltaT / mApplication->GetAnimationRate()) != refreshNumber);
+    if ( pPhysicsEngine && !replaying )
+    {
+        //fixed steps: as many as the elapsed time calls for. The body states are posted as events, 
+        //delivered by ProcessEventQueue right after.
+        physicsInterpolation = pPhysicsEngine->Update( (float)frameTime / 1000.0f );
+    }
     
-    refreshNumber = (deltaT / mApplication->GetAnimationRate());
+    mEventMng->ProcessEventQueue();
     
-    if ( pPhysicsEngine )
+    if ( replaying && mEventMng->IsReplayFinished() )
     {
-        //update physics, for the moment with the same frequency
-        pPhysicsEngine->StepSimulation( (float)deltaT / 1000.0 );
+        LogManager::GetInstance()->LogMessage("Replay finished.");
+        mApplication->bIsRunning = false;
     }
     
+    updateAnimation = (refreshNumber == 0 || (deltaT / mApplication->GetAnimationRate()) != refreshNumber);
+    
+    refreshNumber = (deltaT / mApplication->GetAnimationRate());
+    
+    WindowStatePtr activeState = mApplication->GetWindowPtr()->GetActiveState();
+    
+    if ( activeState )
+        activeState->GetRootNode()->SetPhysicsInterpolation( physicsInterpolation );
+    
     mApplication->GetWindowPtr()->RenderFrame(updateAnimation);
 }
 
+void Scene::SetActive( bool active )
+{
+    //only the world on screen is synchronised with its scene graph: the others are stepped by the
+    //PhysicsWorldPool, and send their state once back on screen.
+    if ( pPhysicsEngine && mBackgroundRate > 0.0f )
+        pPhysicsEngine->SetBackground( !active, mBackgroundRate );
+}
+
 void Scene::HandleUIEvent(UIEvent& event)
 {
     switch ( event.id )
@@ -166,6 +232,50 @@ bool Scene::SetupScene( std::string scene_name )
         return false;
     }
     
+    // the physics world must be set up before any body is added to it
+    auto physics_source = json_source.find("physics");
+    
+    if ( physics_source != json_source.end() && physics_source->find("world") != physics_source->end() )
+    {
+        string world = (*physics_source)["world"].get<std::string>();
+        
+        // soft bodies need a world of their own. The multithreaded one runs on the application's worker threads
+        if ( world == "rigid and soft" )
+        {
+            pPhysicsEngine = PhysicsEnginePtr( new DefaultPhysicsEngine() );
+            pPhysicsEngine->InitPhysics(PHYS_RIGID_AND_SOFT);
+        }
+        else if ( world == "rigid multithreaded" )
+        {
+            pPhysicsEngine = PhysicsEnginePtr( new DefaultPhysicsEngine() );
+            pPhysicsEngine->InitPhysics(PHYS_RIGID_MT);
+        }
+        else if ( world != "rigid" )
+        {
+            LogManager::GetInstance()->LogMessage("Error! Unknown physics world " + world + ": using the rigid one.");
+        }
+    }
+    
+    if ( physics_source != json_source.end() && physics_source->find("broadphase") != physics_source->end() )
+    {
+        BroadphaseParser parser;
+        parser((*physics_source)["broadphase"], pPhysicsEngine);
+    }
+    
+    // scripts query the world the scene ends up with
+    ScriptManager::GetInstance()->SetPhysicsEngine(pPhysicsEngine);
+    
+    // a snapshot of the world saved on an earlier run (see SavePhysicsSnapshot): the top level rigid bodies
+    // are created from it in one go, rather than parsed one by one
+    string world_snapshot;
+    bool has_snapshot = false;
+    
+    if ( physics_source != json_source.end() && physics_source->find("snapshot") != physics_source->end() )
+    {
+        string snapshot_name = (*physics_source)["snapshot"].get<std::string>();
+        has_snapshot = ResourceCache::GetInstance()->RequestCookedData(snapshot_name + COOKED_WORLD_EXTENSION, world_snapshot);
+    }
+    
     for ( auto iterator = json_source.begin(); iterator != json_source.end(); ++iterator )
     {
        if ( iterator.key() == "show title" )
@@ -204,11 +314,11 @@ bool Scene::SetupScene( std::string scene_name )
        else if ( iterator.key() == "object" )
        {
            ObjectParser parser;
-           parser(*iterator, root_node, mRenderer, mWindow->GetAspectRatio());
+           parser(*iterator, root_node, mRenderer, mWindow->GetAspectRatio(), pPhysicsEngine);
            
-           for ( auto rigid_body : parser.mRigidBodies )
+           for ( auto body : parser.mBodies )
            {
-               pPhysicsEngine->AddBody(rigid_body);
+               pPhysicsEngine->AddBody(body);
            }
            
            for ( auto target_pair : parser.mTargets )
@@ -230,11 +340,12 @@ bool Scene::SetupScene( std::string scene_name )
        {
            PhysicsParser parser;
            parser(*iterator, pPhysicsEngine);
+           mBackgroundRate = parser.mBackgroundRate;
        }
-       else if ( iterator.key() == "rigid body" )
+       else if ( iterator.key() == "rigid body" && !has_snapshot )
        {
            RigidBodyParser parser;
-           parser(*iterator, root_node, mRenderer, false);
+           parser(*iterator, root_node, mRenderer, false, pPhysicsEngine);
            pPhysicsEngine->AddBody(parser.rigidbody);
        }
        else if ( iterator.key() == "particle emitter" )
@@ -244,6 +355,21 @@ bool Scene::SetupScene( std::string scene_name )
        }
     }
     
+    // the bodies of the objects are in the world already: they get their saved state back
+    if ( has_snapshot && !pPhysicsEngine->RestoreWorld(world_snapshot) )
+    {
+        // saved by another build: the rigid bodies come from the scene after all
+        for ( auto iterator = json_source.begin(); iterator != json_source.end(); ++iterator )
+        {
+            if ( iterator.key() == "rigid body" )
+            {
+                RigidBodyParser parser;
+                parser(*iterator, root_node, mRenderer, false, pPhysicsEngine);
+                pPhysicsEngine->AddBody(parser.rigidbody);
+            }
+        }
+    }
+    
     // Resolve targets
     // TODO: this only looks for top level nodes. 
     if ( !targets.empty() )
@@ -278,6 +404,10 @@ bool Scene::SetupScene( std::string scene_name )
     
     mWindow->AddWindowState(scene);
     
+    // the scenes not shown first start off screen
+    if ( !scene->IsActive() )
+        SetActive(false);
+    
     return true;
 }
 
@@ -442,6 +572,10 @@ void SkyBoxParser::operator()( const json &skybox_source, RootNodePtr root_node,
 
 void PhysicsParser::operator()( const json &physics_source, PhysicsEnginePtr physics_engine )
 {
+    float rate = 60.0f; //Hz
+    uint max_steps = 5;
+    bool threaded = false;
+    
     for ( auto iterator = physics_source.begin(); iterator != physics_source.end(); ++iterator )
     {
         if ( iterator.key() == "gravity" )
@@ -449,20 +583,100 @@ void PhysicsParser::operator()( const json &physics_source, PhysicsEnginePtr phy
             auto array = iterator.value();
             physics_engine->SetGravity( { array[0], array[1], array[2] } );
         }
+        else if ( iterator.key() == "rate" )
+        {
+            rate = iterator.value().get<float>();
+        }
+        else if ( iterator.key() == "max steps" )
+        {
+            max_steps = iterator.value().get<uint>();
+        }
+        else if ( iterator.key() == "threaded" )
+        {
+            threaded = iterator.value().get<bool>();
+        }
+        else if ( iterator.key() == "background rate" )
+        {
+            mBackgroundRate = iterator.value().get<float>();
+        }
+        else if ( iterator.key() == "motion epsilon" )
+        {
+            physics_engine->SetMotionEpsilon( iterator.value().get<float>() );
+        }
+        else if ( iterator.key() == "gravity field" )
+        {
+            auto field_source = iterator.value();
+            float constant = 0.0f;
+            float opening_angle = 0.7f;
+            
+            for ( auto field = field_source.begin(); field != field_source.end(); ++field )
+            {
+                if ( field.key() == "constant" )
+                    constant = field.value().get<float>();
+                else if ( field.key() == "opening angle" )
+                    opening_angle = field.value().get<float>();
+            }
+            
+            physics_engine->SetGravityField( constant, opening_angle );
+        }
+    }
+    
+    if ( rate <= 0.0f )
+    {
+        LogManager::GetInstance()->LogMessage("Physics rate must be positive, using 60 Hz.");
+        rate = 60.0f;
     }
+    
+    physics_engine->SetFixedTimeStep( 1.0f / rate, max_steps );
+    physics_engine->SetThreaded( threaded );
 }
+
+void BroadphaseParser::operator()( const json &broadphase_source, PhysicsEnginePtr physics_engine )
+{
+    BroadphaseOptions options;
     
-void RigidBodyParser::operator()( const json &rb_source, SceneNodePtr parent, NYX::IRenderer *renderer, bool has_parent )
+    for ( auto iterator = broadphase_source.begin(); iterator != broadphase_source.end(); ++iterator )
+    {
+        if ( iterator.key() == "type" )
+        {
+            string type = iterator.value().get<std::string>();
+            
+            if ( type == "axis sweep" )
+                options.type = BP_AXIS_SWEEP;
+            else if ( type != "dbvt" )
+                LogManager::GetInstance()->LogMessage("Error! Unknown broadphase " + type + ", using dbvt.");
+        }
+        else if ( iterator.key() == "world min" )
+        {
+            auto array = iterator.value();
+            options.worldMin = { array[0], array[1], array[2] };
+        }
+        else if ( iterator.key() == "world max" )
+        {
+            auto array = iterator.value();
+            options.worldMax = { array[0], array[1], array[2] };
+        }
+        else if ( iterator.key() == "max bodies" )
+        {
+            options.maxBodies = iterator.value().get<uint>();
+        }
+    }
+    
+    physics_engine->SetBroadphase( options );
+}
+    
+void RigidBodyParser::operator()( const json &rb_source, SceneNodePtr parent, NYX::IRenderer *renderer, bool has_parent, PhysicsEnginePtr physics_engine )
 {
+    // bodies from the engine share their collision shapes
     if ( has_parent )
     {
-        rigidbody = PhysicsBodyPtr( new RigidBody(parent->GetName(), parent->GetID()) );
+        rigidbody = physics_engine->CreateBody(BDY_RIGID, parent->GetName(), parent->GetID());
         rigidbody->SetInitialState(parent->GetRelativePosition(), parent->GetLocalAttitude());
     }
     else
     {
         string name = *(rb_source.find("name"));
-        rigidbody = PhysicsBodyPtr( new RigidBody(name, 9999) );
+        rigidbody = physics_engine->CreateBody(BDY_RIGID, name, 9999);
     }
     
     Vector3 position, inertia;
@@ -501,8 +715,20 @@ void RigidBodyParser::operator()( const json &rb_source, SceneNodePtr parent, NY
                 auto array = *(shape_source.find("dimensions"));
                 rigidbody->SetCollisionShape(CS_BOX, Vector3(array[0], array[1], array[2]).GetComponents());
             }
+            else if ( shape_name == "mesh" )
+            {
+                SetMeshShape( shape_source, parent, has_parent );
+            }
+            else if ( shape_name == "triangle mesh" )
+            {
+                SetTriangleMeshShape( parent, has_parent );
+            }
             
         }
+        else if ( iterator.key() == "scale" )
+        {
+            rigidbody->SetScale( iterator.value() );
+        }
         else if ( iterator.key() == "mass" )
         {
             mass = iterator.value();
@@ -533,6 +759,156 @@ void RigidBodyParser::operator()( const json &rb_source, SceneNodePtr parent, NY
     rigidbody->Finilize();
 }
 
+void RigidBodyParser::SetMeshShape( const json& shape_source, SceneNodePtr parent, bool has_parent )
+{
+    ModelNode* model_node = has_parent ? dynamic_cast<ModelNode*>(parent.get()) : nullptr;
+    
+    if ( model_node == nullptr || !model_node->GetModel() )
+    {
+        LogManager::GetInstance()->LogMessage("Error! A mesh rigid body needs the model of its object.");
+        return;
+    }
+    
+    MeshHullOptions options;
+    
+    for ( auto iterator = shape_source.begin(); iterator != shape_source.end(); ++iterator )
+    {
+        if ( iterator.key() == "hull" )
+        {
+            string hull = iterator.value();
+            
+            if ( hull == "reduced" )
+                options.hull = MH_REDUCED;
+            else if ( hull == "decomposed" )
+                options.hull = MH_DECOMPOSED;
+            else if ( hull != "full" )
+                LogManager::GetInstance()->LogMessage("Error! Unknown hull " + hull + ": using the full one.");
+        }
+        else if ( iterator.key() == "max vertices" )
+        {
+            options.maxVertices = iterator.value();
+        }
+        else if ( iterator.key() == "max parts" )
+        {
+            options.maxParts = iterator.value();
+        }
+        else if ( iterator.key() == "margin" )
+        {
+            options.margin = iterator.value();
+        }
+    }
+    
+    ModelPtr model = model_node->GetModel();
+    PhysicsBody* body = dynamic_cast<PhysicsBody*>(rigidbody.get());
+    
+    // reducing and decomposing the hull takes a while: the result is kept from one load to the next.
+    string cooked_name = model_node->GetModelName() + COOKED_HULL_EXTENSION;
+    string cooked;
+    bool has_cooked = options.hull != MH_FULL && ResourceCache::GetInstance()->RequestCookedData(cooked_name, cooked);
+    
+    // SetMesh copies the positions and indices, it doesn't change them.
+    body->SetMesh( const_cast<float*>(model->getVertexBuffer()[0].position), model->getNumberOfVertices(), model->getVertexSize(),
+                   const_cast<int*>(model->getIndexBuffer()), model->getNumberOfIndices() );
+    body->SetMeshHull( options, has_cooked ? &cooked : nullptr );
+    body->SetCollisionShape( CS_MESH, nullptr );
+    
+    string new_cooked;
+    
+    if ( body->CookMeshHull(new_cooked) )
+    {
+        ResourceCache::GetInstance()->StoreCookedData(cooked_name, new_cooked);
+    }
+}
+
+void RigidBodyParser::SetTriangleMeshShape( SceneNodePtr parent, bool has_parent )
+{
+    ModelNode* model_node = has_parent ? dynamic_cast<ModelNode*>(parent.get()) : nullptr;
+    
+    if ( model_node == nullptr || !model_node->GetModel() )
+    {
+        LogManager::GetInstance()->LogMessage("Error! A triangle mesh rigid body needs the model of its object.");
+        return;
+    }
+    
+    // the model stays in the resource cache: its buffers are used in place.
+    ModelPtr model = model_node->GetModel();
+    PhysicsBody* body = dynamic_cast<PhysicsBody*>(rigidbody.get());
+    
+    // the BVH cooked on an earlier load, if any: building it takes much longer than reading it.
+    string cooked_name = model_node->GetModelName() + COOKED_BVH_EXTENSION;
+    string cooked;
+    bool has_cooked = ResourceCache::GetInstance()->RequestCookedData(cooked_name, cooked);
+    
+    body->SetTriangleMesh( model->getVertexBuffer()[0].position, model->getNumberOfVertices(), model->getVertexSize(),
+                           model->getIndexBuffer(), model->getNumberOfTriangles(), has_cooked ? &cooked : nullptr );
+    body->SetCollisionShape( CS_TRIANGLE_MESH, nullptr );
+    
+    string new_cooked;
+    
+    if ( body->CookTriangleMesh(new_cooked) )
+    {
+        ResourceCache::GetInstance()->StoreCookedData(cooked_name, new_cooked);
+    }
+}
+
+void SoftBodyParser::operator()( const json &sb_source, SceneNodePtr parent, PhysicsEnginePtr physics_engine )
+{
+    ModelNode* model_node = dynamic_cast<ModelNode*>(parent.get());
+    
+    if ( !model_node->GetModel() || !model_node->GetVertexStream() )
+    {
+        LogManager::GetInstance()->LogMessage("Error! A soft body needs the model of its object.");
+        return;
+    }
+    
+    PhysicsBodyPtr body = physics_engine->CreateBody(BDY_SOFT, parent->GetName(), parent->GetID());
+    SoftBody* soft_body = dynamic_cast<SoftBody*>(body.get());
+    soft_body->SetInitialState(parent->GetRelativePosition(), parent->GetLocalAttitude());
+    
+    float mass = 0.0f;
+    float linear_stiffness = 0.5f, angular_stiffness = 0.0f, volume_stiffness = 0.0f;
+    int iterations = 2;
+    float friction = 0.5f;
+    
+    for ( auto iterator = sb_source.begin(); iterator != sb_source.end(); ++iterator )
+    {
+        if ( iterator.key() == "mass" )
+            mass = iterator.value();
+        else if ( iterator.key() == "stiffness" )
+            linear_stiffness = iterator.value();
+        else if ( iterator.key() == "angular stiffness" )
+            angular_stiffness = iterator.value();
+        else if ( iterator.key() == "volume stiffness" )
+            volume_stiffness = iterator.value();
+        else if ( iterator.key() == "iterations" )
+            iterations = iterator.value();
+        else if ( iterator.key() == "friction" )
+            friction = iterator.value();
+        else if ( iterator.key() == "initial velocity" )
+        {
+            auto array = iterator.value();
+            soft_body->SetVelocity( {array[0], array[1], array[2]} );
+        }
+    }
+    
+    ModelPtr model = model_node->GetModel();
+    
+    // Finilize welds the vertices into nodes: it doesn't change them.
+    soft_body->SetMesh( const_cast<float*>(model->getVertexBuffer()[0].position), model->getNumberOfVertices(), model->getVertexSize(),
+                        const_cast<int*>(model->getIndexBuffer()), model->getNumberOfIndices() );
+    soft_body->SetMaterialInfo( linear_stiffness, angular_stiffness, volume_stiffness, 0.0f );
+    soft_body->SetConfigurationOptions( iterations, friction );
+    soft_body->SetMassAndInertia( mass, Vector3(0.0, 0.0, 0.0) );
+    soft_body->Finilize();
+    
+    if ( soft_body->GetBulletSoftBody() == nullptr )
+        return;
+    
+    // the deformed vertices are written straight into the vertex buffer of the model node
+    soft_body->SetVertexStream(model_node->GetVertexStream());
+    softbody = body;
+}
+
 void ParticleEmitterParser::operator()(const json &fx_source, SceneNodePtr parent, NYX::IRenderer *renderer)
 {
     string name = *(fx_source.find("name"));
@@ -542,6 +918,7 @@ void ParticleEmitterParser::operator()(const json &fx_source, SceneNodePtr paren
     
     string program_file, kernel, material_name;
     int particle_count = 0;
+    eParticleLayout layout = PARTICLE_LAYOUT_AOS;
     
     for ( auto iterator = fx_source.begin(); iterator != fx_source.end(); ++iterator )
     {
@@ -566,6 +943,15 @@ void ParticleEmitterParser::operator()(const json &fx_source, SceneNodePtr paren
         {
             particle_count = iterator.value();
         }
+        else if ( iterator.key() == "particle layout" )
+        {
+            string layout_name = iterator.value().get<std::string>();
+            
+            if ( layout_name == "soa" )
+                layout = PARTICLE_LAYOUT_SOA;
+            else if ( layout_name != "aos" )
+                LogManager::GetInstance()->LogMessage("Error! Unknown particle layout " + layout_name + ": using aos.");
+        }
         else if ( iterator.key() == "script" )
         {
             auto script_source = iterator.value();
@@ -577,6 +963,16 @@ void ParticleEmitterParser::operator()(const json &fx_source, SceneNodePtr paren
             
             fx_node->UseScriptParticleGeneration(file_name, funcName);
         }
+        else if ( iterator.key() == "emitter" )
+        {
+            //particles emitted as the effect runs, instead of a cloud that starts over: no script or kernel needed.
+            fx_node->UseEmitter( ParseEmitter(iterator.value()) );
+        }
+        else if ( iterator.key() == "cloud" )
+        {
+            //the cloud that starts over, from an emitter instead of a script.
+            fx_node->UseCloudEmitter( ParseEmitter(iterator.value()) );
+        }
         else if ( iterator.key() == "kernel" )
         {
             auto kernel_source = iterator.value();
@@ -598,18 +994,85 @@ void ParticleEmitterParser::operator()(const json &fx_source, SceneNodePtr paren
         }
     }
     
-    fx_node->InitializeFX(program_file, kernel, particle_count, material_name);
+    fx_node->InitializeFX(program_file, kernel, particle_count, material_name, layout);
     
     parent->AddChildNode(fxnode);
 }
+
+ParticleEmitter ParticleEmitterParser::ParseEmitter(const json &emitter_source)
+{
+    ParticleEmitter emitter;
+    
+    for ( auto param = emitter_source.begin(); param != emitter_source.end(); ++param )
+    {
+        auto value = param.value();
+        
+        if ( param.key() == "shape" )
+        {
+            string shape = value.get<std::string>();
+            
+            if ( shape == "sphere" )
+                emitter.shape = EMITTER_SPHERE;
+            else if ( shape != "box" )
+                LogManager::GetInstance()->LogMessage("Error! Unknown emitter shape " + shape + ": using box.");
+        }
+        else if ( param.key() == "radius" )
+            emitter.extent[0] = value;
+        else if ( param.key() == "life" )
+        {
+            emitter.lifeMin = value[0];
+            emitter.lifeMax = value[1];
+        }
+        else if ( param.key() == "rate" )
+            emitter.rate = value;
+        else if ( param.key() == "seed" )
+            emitter.seed = value;
+        else if ( param.key() == "velocity cone" )
+        {
+            //instead of velocity min and max: directions within the angle (degrees) of direction, speeds within speed.
+            emitter.velocity = VELOCITY_CONE;
+            
+            for ( uint k = 0; k < 3; k++ )
+                emitter.direction[k] = value["direction"][k];
+            
+            emitter.coneAngle = (float)(value["angle"].get<float>()*DEG2RAD);
+            emitter.speedMin = value["speed"][0];
+            emitter.speedMax = value["speed"][1];
+        }
+        
+        float* vector = nullptr;
+        
+        if ( param.key() == "position" )
+            vector = emitter.position;
+        else if ( param.key() == "extent" )
+            vector = emitter.extent;
+        else if ( param.key() == "velocity min" )
+            vector = emitter.velocityMin;
+        else if ( param.key() == "velocity max" )
+            vector = emitter.velocityMax;
+        else if ( param.key() == "acceleration" )
+            vector = emitter.acceleration;
+        
+        for ( uint k = 0; vector && k < 3; k++ )
+            vector[k] = value[k];
+    }
+    
+    return emitter;
+}
     
-void ObjectParser::operator()( const json &object_source, SceneNodePtr parent, NYX::IRenderer *renderer, float aspect_ratio )
+void ObjectParser::operator()( const json &object_source, SceneNodePtr parent, NYX::IRenderer *renderer, float aspect_ratio, PhysicsEnginePtr physics_engine )
 {
     string name = *(object_source.find("name"));
   
     SceneNodePtr mnode(new ModelNode(dynamic_cast<SceneNode*>(parent.get()), renderer, name));
     ModelNode* model_node = dynamic_cast<ModelNode*>(mnode.get());
     
+    // the physics writes the vertices of a soft body: the node must know before the model builds its buffers
+    if ( object_source.find("soft body") != object_source.end() )
+    {
+        model_node->SetDeformable(true);
+    }
+    
     for ( auto iterator = object_source.begin(); iterator != object_source.end(); ++iterator )
     {
         if ( iterator.key() == "position" )
@@ -642,8 +1105,18 @@ void ObjectParser::operator()( const json &object_source, SceneNodePtr parent, N
         else if ( iterator.key() == "rigid body" )
         {
             RigidBodyParser parser;
-            parser(iterator.value(), mnode, renderer, true);
-            mRigidBodies.push_back(parser.rigidbody);
+            parser(iterator.value(), mnode, renderer, true, physics_engine);
+            mBodies.push_back(parser.rigidbody);
+        }
+        else if ( iterator.key() == "soft body" )
+        {
+            SoftBodyParser parser;
+            parser(iterator.value(), mnode, physics_engine);
+            
+            if ( parser.softbody )
+            {
+                mBodies.push_back(parser.softbody);
+            }
         }
         else if ( iterator.key() == "camera" )
         {
@@ -669,11 +1142,11 @@ void ObjectParser::operator()( const json &object_source, SceneNodePtr parent, N
         else if ( iterator.key() == "object" )
         {
             ObjectParser parser;
-            parser(iterator.value(), mnode, renderer, aspect_ratio);
+            parser(iterator.value(), mnode, renderer, aspect_ratio, physics_engine);
             // should probably add constraints here, since these are most likely connected bodies
-            for ( auto rigid_body : parser.mRigidBodies )
+            for ( auto body : parser.mBodies )
             {
-                mRigidBodies.push_back(rigid_body);
+                mBodies.push_back(body);
             }
             
             for ( auto target_pair : parser.mTargets )
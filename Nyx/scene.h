@@ -28,6 +28,8 @@ public:
 
 	bool SetupScene(std::string scene_name);
 	void Update( void );
+	//on screen or not: off screen, the world keeps running in the background if the scene asks for it.
+	void SetActive( bool active );
 	virtual void HandleUIEvent(UIEvent& event);
 
 protected:
@@ -38,6 +40,7 @@ protected:
 	NYX::ApplicationPtr mApplication;
     WindowPtr mWindow;
 	PhysicsEnginePtr pPhysicsEngine;
+	float mBackgroundRate; //Hz, of the world while off screen. 0 stops it
 	NYX::EventManager* mEventMng;
     IRenderer* mRenderer;
     
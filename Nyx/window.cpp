@@ -26,7 +26,8 @@ Window::~Window()
 	}*/
     
 	delete mRenderEngine;
-	SDL_DestroyWindow(mDisplay);
+	if (mDisplay)
+		SDL_DestroyWindow(mDisplay);
     TTF_Quit();
     SDL_Quit();
 }
@@ -35,6 +36,21 @@ bool Window::InitDisplay(eRenderer backend, unsigned short bitDepth)
 {
 	mBitDepth = bitDepth;
 
+	if ( backend == HEADLESS )
+	{
+		//no display: the labels still render their text with SDL_ttf. Without a GL context to share,
+		//the particle effects run on the CPU.
+		static SDL_SysWMinfo noWinInfo;
+
+		if ( SDL_Init(SDL_INIT_TIMER) < 0 || TTF_Init() < 0 )
+			return false;
+
+		mRenderEngine = CreateRenderer(NULL, noWinInfo, backend);
+		mRenderEngine->SetViewport(0, 0, mWidth, mHeight);
+
+		return true;
+	}
+
 	//TODO: add debug information
 	if ( SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) < 0 )
 		return false;
@@ -29,6 +29,14 @@ WindowState::~WindowState()
     delete mUIManager;
 }
     
+void WindowState::SetActive(bool active)
+{
+    mIsActive = active;
+    
+    if ( mScene )
+        mScene->SetActive(active);
+}
+    
 void WindowState::Render(bool updateAnimation)
 {
 	if(!mSceneRoot) //failsafe
@@ -30,7 +30,7 @@ public:
     Scene* GetScene( void )                     { return mScene; }
 	RootNodePtr GetRootNode( void )             { return mSceneRoot; }
 	bool IsActive( void )                       { return mIsActive; }
-	void SetActive(bool active)                 { mIsActive = active; }
+	void SetActive(bool active); //tells the scene, see Scene::SetActive
 
 	void AssignSceneGraph(RootNodePtr scene)    { mSceneRoot = scene; } //of doubtful usefulness
 
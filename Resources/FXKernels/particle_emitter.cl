@@ -0,0 +1,156 @@
+//particles from an emitter, in the SOA layout: num float4 positions, then num float4 velocities with the life in w.
+//the live particles are packed at the start of the buffer. Every step runs, in order:
+//particle_update, particle_find_holes, particle_compact and particle_emit, with counters zeroed before the first:
+//counters[0] the live particles, counters[1] the holes found, counters[2] the holes filled.
+
+#define EMITTER_BOX 0
+#define EMITTER_SPHERE 1
+
+#define VELOCITY_BOX 0
+#define VELOCITY_CONE 1
+
+//a 32 bit integer hash with good avalanche (lowbias32): the same as in particle_cpu.cpp.
+uint hash_particle(uint x)
+{
+	x ^= x >> 16;
+	x *= 0x7feb352dU;
+	x ^= x >> 15;
+	x *= 0x846ca68bU;
+	x ^= x >> 16;
+	return x;
+}
+
+//uniform in [0, 1): 24 bits of the hash of the particle and the value drawn for it.
+float particle_random(uint seed, uint n, uint stream)
+{
+	return (float)(hash_particle(hash_particle(n ^ seed) + stream) >> 8)*(1.0f/16777216.0f);
+}
+
+//moves the live particles and counts the ones still alive after the step.
+__kernel void particle_update(__global float4* particles, __global int* counters, const float4 acc, const float deltaT, const int num, const int live)
+{
+	const int idx = get_global_id(0);
+
+	__local int groupAlive;
+
+	const float4 kick = (float4)(acc.xyz*deltaT, -deltaT);
+	const float4 drift = 0.5f*acc*(deltaT*deltaT);
+
+	if (get_local_id(0) == 0)
+		groupAlive = 0;
+
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	if (idx < live)
+	{
+		float4 p = particles[idx];
+		float4 v = particles[num + idx];
+
+		p = p + (float4)(v.xyz, 0.0f)*deltaT + drift;
+		v = v + kick;
+
+		particles[idx] = p;
+		particles[num + idx] = v;
+
+		if (v.w >= 0)
+			atomic_inc(&groupAlive);
+	}
+
+	//one global atomic per work group.
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	if (get_local_id(0) == 0 && groupAlive > 0)
+		atomic_add(&counters[0], groupAlive);
+}
+
+//the dead particles among the first counters[0]: the holes the live ones after them go to.
+__kernel void particle_find_holes(__global const float4* particles, __global int* counters, __global int* holes, const int num)
+{
+	const int idx = get_global_id(0);
+
+	if (idx < counters[0] && particles[num + idx].w < 0)
+		holes[atomic_inc(&counters[1])] = idx;
+}
+
+//the live particles past the first counters[0] into the holes: as many of one as of the other.
+__kernel void particle_compact(__global float4* particles, __global int* counters, __global const int* holes, const int num, const int live)
+{
+	const int idx = get_global_id(0);
+
+	if (idx >= counters[0] && idx < live && particles[num + idx].w >= 0)
+	{
+		int hole = holes[atomic_inc(&counters[2])];
+
+		particles[hole] = particles[idx];
+		particles[num + hole] = particles[num + idx];
+	}
+}
+
+//count new particles after the live ones, from the first-th of the emitter on. Past num they are lost.
+//cone is the unit axis of a VELOCITY_CONE and the cosine of its angle in w, speed the range of its length.
+__kernel void particle_emit(__global float4* particles, __global int* counters, const int num, const int shape, const float4 position,
+							const float4 extent, const float4 velocityMin, const float4 velocityMax, const float2 life, const uint seed,
+							const uint first, const int count, const int velocityShape, const float4 cone, const float2 speed)
+{
+	const int idx = get_global_id(0);
+
+	if (idx >= count)
+		return;
+
+	int slot = atomic_inc(&counters[0]);
+
+	if (slot >= num)
+		return;
+
+	uint n = first + idx;
+	float4 p;
+	float4 v;
+
+	if (shape == EMITTER_SPHERE)
+	{
+		float radius = extent.x*cbrt(particle_random(seed, n, 0));
+		float z = 2.0f*particle_random(seed, n, 1) - 1.0f;
+		float phi = 6.28318531f*particle_random(seed, n, 2);
+		float xy = sqrt(fmax(1.0f - z*z, 0.0f));
+
+		p = (float4)(position.x + radius*(xy*cos(phi)), position.y + radius*(xy*sin(phi)), position.z + radius*z, 1.0f);
+	}
+	else
+	{
+		p = (float4)(position.x + extent.x*(2.0f*particle_random(seed, n, 0) - 1.0f),
+					 position.y + extent.y*(2.0f*particle_random(seed, n, 1) - 1.0f),
+					 position.z + extent.z*(2.0f*particle_random(seed, n, 2) - 1.0f),
+					 1.0f);
+	}
+
+	if (velocityShape == VELOCITY_CONE)
+	{
+		//uniform over the cap of the unit sphere around the axis, then scaled: as in particle_cpu.cpp.
+		float3 axis = cone.xyz;
+		float3 other = (fabs(axis.x) < 0.9f) ? (float3)(1.0f, 0.0f, 0.0f) : (float3)(0.0f, 1.0f, 0.0f);
+
+		float3 side = (float3)(other.y*axis.z - other.z*axis.y, other.z*axis.x - other.x*axis.z, other.x*axis.y - other.y*axis.x);
+		side = side / sqrt(side.x*side.x + side.y*side.y + side.z*side.z);
+
+		float3 up = (float3)(axis.y*side.z - axis.z*side.y, axis.z*side.x - axis.x*side.z, axis.x*side.y - axis.y*side.x);
+
+		float z = 1.0f - particle_random(seed, n, 3)*(1.0f - cone.w);
+		float phi = 6.28318531f*particle_random(seed, n, 4);
+		float length = speed.x + (speed.y - speed.x)*particle_random(seed, n, 5);
+		float xy = sqrt(fmax(1.0f - z*z, 0.0f));
+
+		v = (float4)(length*(side*(xy*cos(phi)) + up*(xy*sin(phi)) + axis*z), 0.0f);
+	}
+	else
+	{
+		v = (float4)(velocityMin.x + (velocityMax.x - velocityMin.x)*particle_random(seed, n, 3),
+					 velocityMin.y + (velocityMax.y - velocityMin.y)*particle_random(seed, n, 4),
+					 velocityMin.z + (velocityMax.z - velocityMin.z)*particle_random(seed, n, 5),
+					 0.0f);
+	}
+
+	v.w = life.x + (life.y - life.x)*particle_random(seed, n, 6);
+
+	particles[slot] = p;
+	particles[num + slot] = v;
+}
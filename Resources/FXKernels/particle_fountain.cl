@@ -44,3 +44,35 @@ __kernel void gl_particle_rain(__global struct particle* particles, __global str
 		particles[idx] = p;
 	}
 }
+
+//the same fountain on the SOA layout: num float4 positions, then num float4 velocities with the life in w.
+//whole aligned float4s in and out, and the integration as vector operations.
+__kernel void gl_particle_rain_soa(__global float4* particles, __global const float4* state0, const float deltaT, const int num)
+{
+	const int idx = get_global_id(0);
+
+	const float4 acc = (float4)(0.0f, -1.1f, 0.0f, 0.0f);
+	//what the velocity and the life gain in a step: the life runs down.
+	const float4 kick = (float4)(acc.xyz*deltaT, -deltaT);
+	const float4 drift = 0.5f*acc*(deltaT*deltaT);
+
+	if (idx < num)
+	{
+		float4 p = particles[idx];
+		float4 v = particles[num + idx];
+
+		if (v.w >= 0)
+		{
+			p = p + (float4)(v.xyz, 0.0f)*deltaT + drift;
+			v = v + kick;
+		}
+		else
+		{
+			p = state0[idx];
+			v = state0[num + idx];
+		}
+
+		particles[idx] = p;
+		particles[num + idx] = v;
+	}
+}
@@ -1,30 +1,24 @@
 require "math"
 
-function GenerateParticleCloud(max_particles)
+-- particles is a buffer for max_particles particles: SetFloats fills one in, from 0,
+-- with its position, velocity and life.
+function GenerateParticleCloud(max_particles, particles)
 
-	local pos_offset = 0
-	local vel_offset = 3
-	local life_offset = 6
-	local size = 7
-	
-	local cloud = {}
-	
 	math.randomseed(5)
 	--math.random() returns values form 0 to 1	
-	for i = 0, max_particles do
+	for i = 0, max_particles - 1 do
 		
-		cloud[i*size + pos_offset + 0] = math.random()*0.5 - 0.25
-		cloud[i*size + pos_offset + 1] = -5.0
-		cloud[i*size + pos_offset + 2] = math.random()*0.5 - 0.25
+		local x = math.random()*0.5 - 0.25
+		local z = math.random()*0.5 - 0.25
 		
-		cloud[i*size + vel_offset + 0] = math.random()*0.4 - 0.2
-		cloud[i*size + vel_offset + 1] = math.random()*3.5 + 1.2
-		cloud[i*size + vel_offset + 2] = math.random()*0.4 - 0.2
+		local vx = math.random()*0.4 - 0.2
+		local vy = math.random()*3.5 + 1.2
+		local vz = math.random()*0.4 - 0.2
 
-		cloud[i*size + life_offset] = math.random()*10.0 
+		local life = math.random()*10.0 
+		
+		SetFloats(particles, i, x, -5.0, z, vx, vy, vz, life)
 		
 	end
-
-	return cloud
 	
 end
@@ -8,6 +8,9 @@
 #include "space_scene.h"
 #include "physics_test.h"
 #include "particle_test.h"
+#include "physics_benchmark.h"
+#include "particle_check.h"
+#include "events_check.h"
 
 using namespace NYX;
 
@@ -15,9 +18,51 @@ int main(int argc, char **argv)
 {
 	ApplicationPtr pApplication( new Application(argv[0]) ) ;
 
+	std::string record_file;
+	std::string replay_file;
+	bool replay_window = false;
+	bool physics_benchmark = false;
+	bool particle_check = false;
+	bool events_check = false;
+
 	if (argc > 1)
 	{
 		// process command line arguments
+		//  --record <file>: log all the engine events of the session
+		//  --replay <file>: play a log back instead of live input and physics, with a fixed time step, without
+		//                   opening a window: the scenes are updated but not drawn. Quits at the end of the log
+		//  --window: draw the replay in a window
+		//  --physics-benchmark: time the physics worlds without opening a window, then quit
+		//  --particle-check: compare the CPU particle kernel with the OpenCL one without opening a window, then quit
+		//  --events-check: stress the event manager without opening a window, then quit
+		//  the checks exit with 1 if any of their parts failed
+		for (int i = 1; i < argc; i++)
+		{
+			std::string arg = argv[i];
+
+			if (arg == "--record" && i < argc - 1)
+				record_file = argv[++i];
+			else if (arg == "--replay" && i < argc - 1)
+				replay_file = argv[++i];
+			else if (arg == "--window")
+				replay_window = true;
+			else if (arg == "--physics-benchmark")
+				physics_benchmark = true;
+			else if (arg == "--particle-check")
+				particle_check = true;
+			else if (arg == "--events-check")
+				events_check = true;
+		}
+	}
+	
+	if ( physics_benchmark )
+	{
+		return RunPhysicsBenchmark() ? 0 : 1;
+	}
+
+	if ( events_check )
+	{
+		return RunEventsCheck() ? 0 : 1;
 	}
     
     pApplication->RegisterCacheSearchPath("/", "Resources/Shaders");
@@ -30,7 +75,12 @@ int main(int argc, char **argv)
     // Demo-only data
     pApplication->RegisterCacheSearchPath("/", "Resources/Data");
     
-    pApplication->Initialise( "config" );
+    if ( particle_check )
+    {
+        return RunParticleCheck() ? 0 : 1;
+    }
+    
+    pApplication->Initialise( "config", !replay_file.empty() && !replay_window );
     
     std::string test_names[3];
     test_names[0] = "space scene";
@@ -47,7 +97,14 @@ int main(int argc, char **argv)
     
     pApplication->ShowWindow(true);
     
+    if ( !replay_file.empty() )
+        EventManager::GetInstance()->StartReplay(replay_file);
+    else if ( !record_file.empty() )
+        EventManager::GetInstance()->StartRecording(record_file);
+    
     pApplication->Run();
+    
+    EventManager::GetInstance()->StopRecording();
 
 	return 0;
 }
@@ -0,0 +1,785 @@
+/*
+
+Events Check
+
+*/
+
+#include "events_check.h"
+#include "Events/event_manager.h"
+#include "root_node.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <thread>
+#include <vector>
+
+using namespace NYX;
+using namespace std;
+
+//every heap allocation of the demo goes through here, so that the pool check can count those of a frame.
+static atomic<unsigned long long> sHeapAllocations(0);
+
+void* operator new(size_t size)
+{
+	sHeapAllocations.fetch_add(1, memory_order_relaxed);
+
+	void* block = malloc(size > 0 ? size : 1);
+
+	if (!block)
+		throw bad_alloc();
+
+	return block;
+}
+
+void operator delete(void* block) noexcept
+{
+	free(block);
+}
+
+void operator delete(void* block, size_t) noexcept
+{
+	free(block);
+}
+
+static const uint STRESS_PRODUCERS = 8;
+static const uint STRESS_EVENTS = 200000; //per producer
+static const uint STRESS_IN_FLIGHT = 32768; //producers wait above this, half the default queue capacity
+static const chrono::seconds STRESS_TIMEOUT(60);
+
+static const uint POOL_FRAMES = 100;
+static const uint POOL_WARMUP_FRAMES = 10;
+static const uint POOL_EVENTS_PER_FRAME = 1000; //for half as many objects, each moved twice: half are coalesced
+static const uint POOL_CONTACTS_PER_FRAME = 64;
+static const uint POOL_THREADS = 4;
+static const uint POOL_EVENTS_PER_THREAD = 100000;
+static const uint POOL_HELD_EVENTS = 64; //alive at the same time on each thread
+
+static const uint CHANNEL_SUBSCRIBERS = 200; //as many as the scene nodes of a large scene
+static const uint CHANNEL_EVENTS = 20000;
+
+static const uint TEARDOWN_GROUPS = 100; //children of the root, with 99 children each: 10000 nodes
+static const uint TEARDOWN_GROUP_SIZE = 100;
+
+static const uint RECORDED_FRAMES = 5;
+static const uint RECORDED_OBJECTS = 3;
+static const uint SENT_OBJECT = 9; //sent rather than queued
+static const char* RECORDING_FILE = "events_check.rec";
+
+static const uint COALESCED_OBJECTS = 10000;
+
+static const float DEFAULT_TIMEOUT = 0.01f; //the event manager's own defaults
+static const uint DEFAULT_BUDGET_CHECK_INTERVAL = 8;
+static const float CHECK_TIMEOUT = 1000.0f; //nothing is left waiting for the next frame
+
+//counts the events of each producer, whose id is (producer << 24) | sequence number.
+class ProducerSink
+{
+public:
+
+	ProducerSink() : received(0), outOfOrder(0), last(STRESS_PRODUCERS, -1) {}
+
+	void OnObjectMoved(ObjectMovedEvent& event)
+	{
+		uint producer = event.ID() >> 24;
+		int sequence = (int)(event.ID() & 0xffffff);
+
+		if (producer >= STRESS_PRODUCERS || sequence <= last[producer])
+			outOfOrder++;
+		else
+			last[producer] = sequence;
+
+		received.fetch_add(1, memory_order_release);
+	}
+
+	atomic<uint> received;
+	uint outOfOrder;
+	vector<int> last;
+};
+
+static bool RunQueueStressCheck()
+{
+	LogManager* log = LogManager::GetInstance();
+	EventManager* events = EventManager::GetInstance();
+
+	ProducerSink sink;
+	EventSubscription subscription = events->Subscribe<ObjectMovedEvent, ProducerSink, &ProducerSink::OnObjectMoved>(&sink);
+
+	atomic<uint> queued(0);
+	atomic<uint> rejected(0);
+
+	auto start = chrono::steady_clock::now();
+
+	vector<thread> producers;
+
+	for (uint p = 0; p < STRESS_PRODUCERS; p++)
+	{
+		producers.push_back(thread([&, p]()
+		{
+			EventBatch batch;
+
+			for (uint i = 0; i < STRESS_EVENTS; i++)
+			{
+				//the queue is bounded: keep well below its capacity, so that nothing is dropped.
+				while (queued.load(memory_order_relaxed) - sink.received.load(memory_order_acquire) > STRESS_IN_FLIGHT)
+					this_thread::yield();
+
+				EventPtr event(new ObjectMovedEvent((p << 24) | i, Vector3(), Matrix3x3()));
+				queued.fetch_add(1, memory_order_relaxed);
+
+				if (p % 2 == 0)
+				{
+					if (!events->QueueEvent(event))
+						rejected.fetch_add(1, memory_order_relaxed);
+				}
+				else
+					batch.Add(event);
+			}
+
+			batch.Flush();
+		}));
+	}
+
+	const uint expected = STRESS_PRODUCERS*STRESS_EVENTS;
+	bool timedOut = false;
+
+	while (sink.received.load(memory_order_acquire) < expected)
+	{
+		events->ProcessEventQueue();
+
+		if (chrono::steady_clock::now() - start > STRESS_TIMEOUT)
+		{
+			timedOut = true;
+			break;
+		}
+	}
+
+	for (uint p = 0; p < STRESS_PRODUCERS; p++)
+		producers[p].join();
+
+	double time = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	//anything still in flight after a time out.
+	events->ProcessEventQueue();
+	subscription.Reset();
+
+	uint received = sink.received.load(memory_order_acquire);
+
+	log->LogMessage("Queue stress: " + to_string(STRESS_PRODUCERS) + " producers queueing " + to_string(STRESS_EVENTS) + 
+					" events each, " + to_string(received / time) + " events/s.");
+	log->LogMessage("  received " + to_string(received) + " of " + to_string(expected) + ", " + to_string(sink.outOfOrder) + 
+					" out of order, " + to_string(rejected.load()) + " rejected by a full queue");
+
+	bool passed = !timedOut && received == expected && sink.outOfOrder == 0 && rejected.load() == 0;
+	log->LogMessage(string("  queue stress check ") + (passed ? "passed." : "FAILED."));
+
+	return passed;
+}
+
+class CountingSink
+{
+public:
+
+	CountingSink() : received(0), contacts(0) {}
+
+	void OnObjectMoved(ObjectMovedEvent&) { received++; }
+	void OnContacts(ContactsEvent& event) { contacts += (uint)event.Contacts().size(); }
+
+	uint received;
+	uint contacts;
+};
+
+static bool RunPoolCheck()
+{
+	LogManager* log = LogManager::GetInstance();
+	EventManager* events = EventManager::GetInstance();
+	EventPool<ObjectMovedEvent>& pool = EventPool<ObjectMovedEvent>::GetInstance();
+
+	CountingSink sink;
+	EventSubscription moves = events->Subscribe<ObjectMovedEvent, CountingSink, &CountingSink::OnObjectMoved>(&sink);
+	EventSubscription contacts = events->Subscribe<ContactsEvent, CountingSink, &CountingSink::OnContacts>(&sink);
+
+	events->SetCoalescing(EV_OBJECT_MOVED, true);
+
+	uint liveBefore = pool.LiveCount();
+	uint chunksAfterWarmup = 0;
+	uint peakLive = 0;
+	unsigned long long allocationsAfterWarmup = 0;
+
+	//the physics engine's contact list, handed over to a ContactsEvent at every step.
+	vector<ContactReport> stepContacts;
+
+	//the same events every frame, as the physics engine publishes them: once warm, nothing on the way from
+	//the producer to the subscribers (pool, batch, queue, lanes, coalescing table, contact lists) may allocate.
+	for (uint frame = 0; frame < POOL_FRAMES; frame++)
+	{
+		if (frame == POOL_WARMUP_FRAMES)
+		{
+			chunksAfterWarmup = pool.ChunkCount();
+			allocationsAfterWarmup = sHeapAllocations.load();
+		}
+
+		{
+			EventBatch batch;
+
+			for (uint i = 0; i < POOL_EVENTS_PER_FRAME; i++)
+				batch.Add(EventPtr(new ObjectMovedEvent(i % (POOL_EVENTS_PER_FRAME / 2), Vector3(), Matrix3x3())));
+
+			for (uint i = 0; i < POOL_CONTACTS_PER_FRAME; i++)
+				stepContacts.push_back(ContactReport());
+
+			ContactsEvent* contactsEvent = new ContactsEvent();
+			contactsEvent->Contacts().swap(stepContacts);
+			batch.Add(EventPtr(contactsEvent));
+		}
+
+		peakLive = max(peakLive, pool.LiveCount());
+		events->ProcessEventQueue();
+	}
+
+	unsigned long long steadyAllocations = sHeapAllocations.load() - allocationsAfterWarmup;
+	uint chunksAtEnd = pool.ChunkCount();
+	uint liveAfterFrames = pool.LiveCount();
+
+	events->SetCoalescing(EV_OBJECT_MOVED, false);
+	contacts.Reset();
+
+	log->LogMessage("Event pool: " + to_string(POOL_FRAMES) + " frames of " + to_string(POOL_EVENTS_PER_FRAME) + 
+					" object moves and " + to_string(POOL_CONTACTS_PER_FRAME) + " contacts, " + to_string(peakLive) + " moves alive at the peak.");
+	log->LogMessage("  heap allocations after " + to_string(POOL_WARMUP_FRAMES) + " frames: " + to_string(steadyAllocations) + 
+					", chunks: " + to_string(chunksAfterWarmup) + " then " + to_string(chunksAtEnd) + 
+					", events left alive: " + to_string(liveAfterFrames - liveBefore));
+
+	//events created and destroyed on several threads at once, as physics and loading workers do.
+	auto start = chrono::steady_clock::now();
+
+	vector<thread> workers;
+
+	for (uint t = 0; t < POOL_THREADS; t++)
+	{
+		workers.push_back(thread([]()
+		{
+			vector<EventPtr> held(POOL_HELD_EVENTS);
+
+			for (uint i = 0; i < POOL_EVENTS_PER_THREAD; i++)
+				held[i % POOL_HELD_EVENTS] = EventPtr(new ObjectMovedEvent(i, Vector3(), Matrix3x3()));
+		}));
+	}
+
+	for (uint t = 0; t < POOL_THREADS; t++)
+		workers[t].join();
+
+	double time = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+	uint liveAfterThreads = pool.LiveCount();
+
+	log->LogMessage("  " + to_string(POOL_THREADS) + " threads creating " + to_string(POOL_EVENTS_PER_THREAD) + " events each: " + 
+					to_string(time * 1000.0 / (POOL_THREADS*POOL_EVENTS_PER_THREAD)) + " ns/event, events left alive: " + 
+					to_string(liveAfterThreads - liveBefore));
+
+	moves.Reset();
+
+	bool passed = steadyAllocations == 0 && chunksAtEnd == chunksAfterWarmup && liveAfterFrames == liveBefore && 
+				  liveAfterThreads == liveBefore && sink.received == POOL_FRAMES*POOL_EVENTS_PER_FRAME / 2 && 
+				  sink.contacts == POOL_FRAMES*POOL_CONTACTS_PER_FRAME;
+	log->LogMessage(string("  event pool check ") + (passed ? "passed." : "FAILED."));
+
+	return passed;
+}
+
+//stands in for a scene node: keeps the position of its own object.
+class MovedNode
+{
+public:
+
+	MovedNode() : id(0), x(-1.0f), received(0) {}
+
+	void OnObjectMoved(ObjectMovedEvent& event)
+	{
+		if (event.ID() != id)
+			return;
+
+		x = event.Position().X();
+		received++;
+	}
+
+	uint id;
+	float x;
+	uint received;
+};
+
+//the same, the way the scene nodes listened before the channels: a switch on the type and a dynamic_cast.
+class MovedNodeListener : public BaseEventListener
+{
+public:
+
+	MovedNodeListener(MovedNode* node) : BaseEventListener("Moved Node Listener"), mNode(node) {}
+
+	virtual bool ProcessEvent(EventPtr event)
+	{
+		switch (event->GetEventType())
+		{
+		case EV_OBJECT_MOVED:
+		{
+			ObjectMovedEvent* moved = dynamic_cast<ObjectMovedEvent*>(event.get());
+
+			if (moved->ID() != mNode->id)
+				return false;
+
+			mNode->x = moved->Position().X();
+			mNode->received++;
+			return true;
+		}
+		default:
+			return false;
+		}
+	}
+
+private:
+
+	MovedNode* mNode;
+};
+
+//on its first event, drops another subscriber and adds a new one, while the event is being dispatched.
+class ReshufflingNode
+{
+public:
+
+	ReshufflingNode() : droppedSubscription(NULL), dropped(NULL), added(NULL), addedSubscription(NULL), receivedByDropped(0) {}
+
+	void OnObjectMoved(ObjectMovedEvent&)
+	{
+		if (!droppedSubscription)
+			return;
+
+		//slots are recycled, the dropped node may come first and have the event already.
+		receivedByDropped = dropped->received;
+		droppedSubscription->Reset();
+		droppedSubscription = NULL; //once only
+		*addedSubscription = EventManager::GetInstance()->Subscribe<ObjectMovedEvent, MovedNode, &MovedNode::OnObjectMoved>(added);
+	}
+
+	EventSubscription* droppedSubscription;
+	MovedNode* dropped;
+	MovedNode* added;
+	EventSubscription* addedSubscription;
+	uint receivedByDropped; //when it was dropped
+};
+
+static bool CheckNodes(vector<MovedNode>& nodes, uint expectedEvents)
+{
+	for (uint i = 0; i < nodes.size(); i++)
+	{
+		//the last event of node i is the last i + k*size below CHANNEL_EVENTS.
+		uint last = i + ((CHANNEL_EVENTS - 1 - i) / (uint)nodes.size())*(uint)nodes.size();
+
+		if (nodes[i].received != expectedEvents || nodes[i].x != (float)last)
+			return false;
+	}
+
+	return true;
+}
+
+static bool RunChannelCheck()
+{
+	LogManager* log = LogManager::GetInstance();
+	EventManager* events = EventManager::GetInstance();
+
+	vector<EventPtr> moves;
+	moves.reserve(CHANNEL_EVENTS);
+
+	for (uint i = 0; i < CHANNEL_EVENTS; i++)
+		moves.push_back(EventPtr(new ObjectMovedEvent(i % CHANNEL_SUBSCRIBERS, Vector3((float)i, 0.0f, 0.0f), Matrix3x3())));
+
+	uint perNode = CHANNEL_EVENTS / CHANNEL_SUBSCRIBERS;
+
+	//generic listeners
+	vector<MovedNode> listenerNodes(CHANNEL_SUBSCRIBERS);
+	vector<EventListenerPtr> listeners;
+
+	for (uint i = 0; i < CHANNEL_SUBSCRIBERS; i++)
+	{
+		listenerNodes[i].id = i;
+		listeners.push_back(EventListenerPtr(new MovedNodeListener(&listenerNodes[i])));
+		events->RegisterListener(EV_OBJECT_MOVED, listeners.back());
+	}
+
+	auto start = chrono::steady_clock::now();
+
+	for (uint i = 0; i < CHANNEL_EVENTS; i++)
+		events->SendEvent(moves[i]);
+
+	double listenerTime = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / CHANNEL_EVENTS;
+
+	for (uint i = 0; i < CHANNEL_SUBSCRIBERS; i++)
+		events->UnregisterListener(listeners[i]);
+
+	//typed channel, all the subscriptions in one group
+	vector<MovedNode> channelNodes(CHANNEL_SUBSCRIBERS);
+	vector<EventSubscription> subscriptions(CHANNEL_SUBSCRIBERS);
+	int group = 0;
+
+	for (uint i = 0; i < CHANNEL_SUBSCRIBERS; i++)
+	{
+		channelNodes[i].id = i;
+		subscriptions[i] = events->Subscribe<ObjectMovedEvent, MovedNode, &MovedNode::OnObjectMoved>(&channelNodes[i], &group);
+	}
+
+	start = chrono::steady_clock::now();
+
+	for (uint i = 0; i < CHANNEL_EVENTS; i++)
+		events->SendEvent(moves[i]);
+
+	double channelTime = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / CHANNEL_EVENTS;
+
+	bool delivered = CheckNodes(listenerNodes, perNode) && CheckNodes(channelNodes, perNode);
+	uint groupRemoved = events->UnsubscribeGroup(&group);
+
+	log->LogMessage("Event channels: " + to_string(CHANNEL_SUBSCRIBERS) + " subscribers, " + to_string(CHANNEL_EVENTS) + " events.");
+	log->LogMessage("  listeners: " + to_string(listenerTime) + " ns/event, channel: " + to_string(channelTime) + " ns/event (x" + 
+					to_string(listenerTime / channelTime) + ")");
+
+	//subscribing and unsubscribing during a dispatch
+	MovedNode first, dropped, added;
+	first.id = dropped.id = added.id = 0;
+
+	ReshufflingNode reshuffling;
+	EventSubscription firstSubscription = events->Subscribe<ObjectMovedEvent, MovedNode, &MovedNode::OnObjectMoved>(&first);
+	EventSubscription reshufflingSubscription = events->Subscribe<ObjectMovedEvent, ReshufflingNode, &ReshufflingNode::OnObjectMoved>(&reshuffling);
+	EventSubscription droppedSubscription = events->Subscribe<ObjectMovedEvent, MovedNode, &MovedNode::OnObjectMoved>(&dropped);
+	EventSubscription addedSubscription;
+
+	reshuffling.droppedSubscription = &droppedSubscription;
+	reshuffling.dropped = &dropped;
+	reshuffling.added = &added;
+	reshuffling.addedSubscription = &addedSubscription;
+
+	events->SendEvent(moves[0]);
+	events->SendEvent(moves[CHANNEL_SUBSCRIBERS]);
+
+	//nothing reaches the dropped node once dropped, the added one gets only the second event.
+	bool reshuffled = first.received == 2 && dropped.received == reshuffling.receivedByDropped && added.received == 1 && 
+					  !droppedSubscription.IsValid();
+
+	log->LogMessage("  group removed " + to_string(groupRemoved) + " subscriptions, subscribed during a dispatch: " + 
+					to_string(added.received) + " events, unsubscribed during a dispatch: " + 
+					to_string(dropped.received - reshuffling.receivedByDropped) + " events after");
+
+	firstSubscription.Reset();
+	reshufflingSubscription.Reset();
+	addedSubscription.Reset();
+
+	bool passed = delivered && groupRemoved == CHANNEL_SUBSCRIBERS && reshuffled;
+	log->LogMessage(string("  channel check ") + (passed ? "passed." : "FAILED."));
+
+	return passed;
+}
+
+//a scene node with nothing to draw.
+class EmptyNode : public SceneNode
+{
+public:
+	EmptyNode(SceneNode* parent, string name) : SceneNode(parent, NULL, name) {}
+
+	virtual void ProcessNode() {}
+};
+
+//a root with TEARDOWN_GROUPS children of TEARDOWN_GROUP_SIZE - 1 children each, every node subscribed to ObjectMovedEvent.
+static SceneNodePtr BuildScene()
+{
+	SceneNodePtr root(new RootNode(NULL, "teardown root"));
+
+	for (uint g = 0; g < TEARDOWN_GROUPS; g++)
+	{
+		SceneNodePtr group(new EmptyNode(root.get(), "group " + to_string(g)));
+
+		for (uint i = 1; i < TEARDOWN_GROUP_SIZE; i++)
+			group->AddChildNode(SceneNodePtr(new EmptyNode(group.get(), "node " + to_string(g) + " " + to_string(i))));
+
+		root->AddChildNode(group);
+	}
+
+	return root;
+}
+
+static bool RunTeardownCheck()
+{
+	LogManager* log = LogManager::GetInstance();
+	EventManager* events = EventManager::GetInstance();
+
+	uint subscriptionsBefore = events->GetSubscriptionCount();
+	uint listenersBefore = events->GetListenerCount();
+
+	auto start = chrono::steady_clock::now();
+	SceneNodePtr root = BuildScene();
+	double buildTime = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+	uint subscriptionsBuilt = events->GetSubscriptionCount();
+
+	//RootNode::~RootNode drops the subscriptions of the whole scene in one go.
+	start = chrono::steady_clock::now();
+	root.reset();
+	double groupTime = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+	uint subscriptionsAfterGroup = events->GetSubscriptionCount();
+
+	//the same scene with the nodes removed one by one, each dropping its own subscription.
+	root = BuildScene();
+
+	start = chrono::steady_clock::now();
+	root->ClearAllChildren();
+	root.reset();
+	double nodeTime = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+	uint subscriptionsAfter = events->GetSubscriptionCount();
+	uint listenersAfter = events->GetListenerCount();
+
+	log->LogMessage("Scene teardown: " + to_string(TEARDOWN_GROUPS*TEARDOWN_GROUP_SIZE) + " nodes under a root, built in " + 
+					to_string(buildTime) + " ms with " + to_string(subscriptionsBuilt - subscriptionsBefore) + " subscriptions.");
+	log->LogMessage("  destroyed with the root: " + to_string(groupTime) + " ms, node by node: " + to_string(nodeTime) + " ms");
+	log->LogMessage("  subscriptions left: " + to_string(subscriptionsAfterGroup) + " after the root, " + to_string(subscriptionsAfter) + 
+					" after node by node, listeners left: " + to_string(listenersAfter));
+
+	//the nodes and the root (object moves, and camera changes for the root).
+	uint expected = TEARDOWN_GROUPS*TEARDOWN_GROUP_SIZE + 2;
+
+	bool passed = subscriptionsBefore == 0 && listenersBefore == 0 && subscriptionsBuilt == expected && 
+				  subscriptionsAfterGroup == 0 && subscriptionsAfter == 0 && listenersAfter == 0;
+	log->LogMessage(string("  scene teardown check ") + (passed ? "passed." : "FAILED."));
+
+	return passed;
+}
+
+//writes down every event it gets. Sent events are delivered a frame later when replayed (see
+//EventManager::ReplayEvents), in the same order: their frame is left out.
+class EventLog
+{
+public:
+
+	void OnKey(KeyEvent& event)
+	{
+		Add("key " + to_string(event.Key()), true);
+	}
+
+	void OnCameraMoved(CameraMovedEvent& event)
+	{
+		if (event.bIsRot)
+			Add("camera rotated " + to_string(event.RotAngle()) + " around " + to_string(event.RotAxis()), true);
+		else
+			Add("camera moved to " + ToString(event.Position()), true);
+	}
+
+	void OnObjectMoved(ObjectMovedEvent& event)
+	{
+		string entry = "object " + to_string(event.ID()) + " moved to " + ToString(event.Position());
+
+		if (event.bUseQuaternion)
+			entry += " rotation " + to_string(event.Rotation().GetScalarPart());
+
+		if (event.bHasPreviousState)
+			entry += " from " + ToString(event.PreviousPosition());
+
+		if (event.bIsSoft)
+			entry += " soft";
+
+		Add(entry, event.ID() != SENT_OBJECT);
+	}
+
+	vector<string> entries;
+
+private:
+
+	void Add(const string& entry, bool withFrame)
+	{
+		if (withFrame)
+			entries.push_back(to_string(EventManager::GetInstance()->GetFrameNumber()) + ": " + entry);
+		else
+			entries.push_back(entry);
+	}
+
+	static string ToString(Vector3 v)
+	{
+		return to_string(v.X()) + " " + to_string(v.Y()) + " " + to_string(v.Z());
+	}
+};
+
+//the positions each object was moved to, in order.
+class MoveSink
+{
+public:
+
+	MoveSink() : moves(COALESCED_OBJECTS) {}
+
+	void OnObjectMoved(ObjectMovedEvent& event)
+	{
+		if (event.ID() < COALESCED_OBJECTS)
+			moves[event.ID()].push_back(event.Position().X());
+	}
+
+	vector< vector<float> > moves;
+};
+
+static bool RunCoalescingCheck()
+{
+	LogManager* log = LogManager::GetInstance();
+	EventManager* events = EventManager::GetInstance();
+
+	MoveSink sink;
+	EventSubscription subscription = events->Subscribe<ObjectMovedEvent, MoveSink, &MoveSink::OnObjectMoved>(&sink);
+
+	events->SetCoalescing(EV_OBJECT_MOVED, true);
+	events->SetBudgetCheckInterval(1);
+
+	//twice in the same frame: only the second move of each object is queued.
+	for (uint pass = 0; pass < 2; pass++)
+		for (uint i = 0; i < COALESCED_OBJECTS; i++)
+			events->QueueEvent(EventPtr(new ObjectMovedEvent(i, Vector3((float)pass, 0.0f, 0.0f), Matrix3x3())));
+
+	//no time at all: a few moves are dispatched, the others are left in the backlog.
+	events->ResetTimeoutThreshold(0.0f);
+	events->ProcessEventQueue();
+
+	uint sameFrameCoalesced = events->GetLaneStats(EV_PRIORITY_LOW).coalesced;
+	uint dispatchedEarly = events->GetLaneStats(EV_PRIORITY_LOW).processed;
+
+	//the next frame moves every object again: those still in the backlog are replaced where they are.
+	for (uint i = 0; i < COALESCED_OBJECTS; i++)
+		events->QueueEvent(EventPtr(new ObjectMovedEvent(i, Vector3(2.0f, 0.0f, 0.0f), Matrix3x3())));
+
+	events->ResetTimeoutThreshold(CHECK_TIMEOUT);
+	events->ProcessEventQueue();
+
+	uint backlogCoalesced = events->GetLaneStats(EV_PRIORITY_LOW).coalesced;
+
+	subscription.Reset();
+	events->SetCoalescing(EV_OBJECT_MOVED, false);
+	events->SetBudgetCheckInterval(DEFAULT_BUDGET_CHECK_INTERVAL);
+
+	//an object is moved to 1 (if dispatched before the last moves arrived), then to 2.
+	uint delivered = 0;
+	bool latest = true;
+
+	for (uint i = 0; i < COALESCED_OBJECTS; i++)
+	{
+		vector<float>& moves = sink.moves[i];
+		delivered += (uint)moves.size();
+		latest = latest && !moves.empty() && moves.back() == 2.0f && (moves.size() == 1 || (moves.size() == 2 && moves[0] == 1.0f));
+	}
+
+	log->LogMessage("Coalescing: " + to_string(COALESCED_OBJECTS) + " objects moved twice in a frame, " + to_string(dispatchedEarly) + 
+					" dispatched before running out of time, then moved again.");
+	log->LogMessage("  coalesced in the same frame: " + to_string(sameFrameCoalesced) + ", in the backlog: " + to_string(backlogCoalesced) + 
+					", delivered: " + to_string(delivered));
+
+	bool passed = latest && sameFrameCoalesced == COALESCED_OBJECTS && backlogCoalesced == COALESCED_OBJECTS - dispatchedEarly && 
+				  delivered == COALESCED_OBJECTS + dispatchedEarly;
+	log->LogMessage(string("  coalescing check ") + (passed ? "passed." : "FAILED."));
+
+	return passed;
+}
+
+static bool RunRecordingCheck()
+{
+	LogManager* log = LogManager::GetInstance();
+	EventManager* events = EventManager::GetInstance();
+
+	EventLog eventLog;
+	EventSubscription keys = events->Subscribe<KeyEvent, EventLog, &EventLog::OnKey>(&eventLog);
+	EventSubscription cameras = events->Subscribe<CameraMovedEvent, EventLog, &EventLog::OnCameraMoved>(&eventLog);
+	EventSubscription objects = events->Subscribe<ObjectMovedEvent, EventLog, &EventLog::OnObjectMoved>(&eventLog);
+
+	//whatever was waiting does not belong to the recording.
+	events->ProcessEventQueue();
+	eventLog.entries.clear();
+
+	bool recorded = events->StartRecording(RECORDING_FILE);
+
+	for (uint frame = 0; frame < RECORDED_FRAMES; frame++)
+	{
+		events->QueueEvent(EventPtr(new KeyEvent(frame)));
+		events->ProcessEventQueue();
+
+		EventBatch batch;
+
+		for (uint i = 0; i < RECORDED_OBJECTS; i++)
+		{
+			ObjectMovedEvent* moved = new ObjectMovedEvent(i, Vector3((float)frame, (float)i, 0.0f), Matrix3x3());
+			moved->SetPreviousState(Vector3((float)frame - 1.0f, (float)i, 0.0f), Matrix3x3());
+			moved->bIsSoft = (i == RECORDED_OBJECTS - 1);
+			batch.Add(EventPtr(moved));
+		}
+
+		batch.Flush();
+
+		if (frame % 2 == 0)
+			events->QueueEvent(EventPtr(new CameraMovedEvent(0.5f*frame, AX_Y)));
+		else
+			events->QueueEvent(EventPtr(new CameraMovedEvent(Vector3(0.0f, 0.0f, (float)frame))));
+
+		if (frame == RECORDED_FRAMES / 2)
+			events->SendEvent(EventPtr(new ObjectMovedEvent(SENT_OBJECT, Vector3(1.0f, 2.0f, 3.0f), Quaternion(1.0f, 0.0f, 0.0f, 0.0f))));
+	}
+
+	events->ProcessEventQueue();
+	events->StopRecording();
+
+	vector<string> live;
+	live.swap(eventLog.entries);
+
+	//live events are ignored while replaying: the key presses below must not show up.
+	bool replayed = events->StartReplay(RECORDING_FILE);
+	uint frames = 0;
+
+	while (replayed && !events->IsReplayFinished() && frames < 2*RECORDED_FRAMES)
+	{
+		events->QueueEvent(EventPtr(new KeyEvent(-1)));
+		events->ProcessEventQueue();
+		frames++;
+	}
+
+	events->StopReplay();
+	//the ignored key presses are not queued, nothing is left to process.
+	events->ProcessEventQueue();
+
+	keys.Reset();
+	cameras.Reset();
+	objects.Reset();
+
+	remove(RECORDING_FILE);
+
+	uint firstDifference = 0;
+
+	while (firstDifference < live.size() && firstDifference < eventLog.entries.size() && live[firstDifference] == eventLog.entries[firstDifference])
+		firstDifference++;
+
+	log->LogMessage("Recording: " + to_string(RECORDED_FRAMES) + " frames, " + to_string(live.size()) + " events delivered live, " + 
+					to_string(eventLog.entries.size()) + " replayed in " + to_string(frames) + " frames.");
+
+	if (firstDifference < live.size() || firstDifference < eventLog.entries.size())
+		log->LogMessage("  first difference: \"" + (firstDifference < live.size() ? live[firstDifference] : string("")) + "\" live, \"" + 
+						(firstDifference < eventLog.entries.size() ? eventLog.entries[firstDifference] : string("")) + "\" replayed");
+
+	bool passed = recorded && replayed && !live.empty() && live == eventLog.entries && !events->IsReplaying();
+	log->LogMessage(string("  recording check ") + (passed ? "passed." : "FAILED."));
+
+	return passed;
+}
+
+bool RunEventsCheck()
+{
+	EventManager* events = EventManager::GetInstance();
+
+	//every part runs, whatever the ones before it found.
+	events->ResetTimeoutThreshold(CHECK_TIMEOUT);
+	bool passed = RunQueueStressCheck();
+	passed = RunPoolCheck() && passed;
+	passed = RunChannelCheck() && passed;
+	passed = RunCoalescingCheck() && passed;
+	passed = RunTeardownCheck() && passed;
+	passed = RunRecordingCheck() && passed;
+	events->ResetTimeoutThreshold(DEFAULT_TIMEOUT);
+
+	return passed;
+}
@@ -0,0 +1,31 @@
+/*
+
+Events Check
+
+*/
+
+#ifndef EVENTS_CHECK_H
+#define EVENTS_CHECK_H
+
+/*
+Headless check of the event manager. 8 producer threads queue 200000 ObjectMovedEvents each while the main
+thread processes the queue: half the producers queue one event at a time, the others through an EventBatch.
+Checks that every event is delivered once and in the order its producer queued it, and logs the events/s.
+Then 100 frames of 1000 coalesced object moves and a ContactsEvent, as the physics engine publishes them:
+counting the calls to operator new, checks that nothing is allocated once warm, that the event pool stops
+growing and that no event is leaked, also when 4 threads create and destroy events at the same time.
+Then 200 subscribers, each keeping the position of its own object out of 20000 ObjectMovedEvents, registered
+as listeners and subscribed to the typed channel: checks that each gets its own events, and logs the ns/event
+of both. Also subscribes and unsubscribes from within a handler, and drops a group of subscriptions.
+Then moves 10000 objects twice in a frame with coalescing on and no time to dispatch them, and once more the
+next frame: checks that each newer move replaces the older one, in the frame and in the backlog left over.
+Then builds a scene of 10000 nodes under a RootNode and times its destruction, which drops all the subscriptions
+of the scene at once, against removing the nodes one by one: no subscription or listener may be left behind.
+Last, records 5 frames of key presses, camera moves and object moves (queued, batched and sent) to a temporary
+file, replays it while queueing live key presses, and checks that the same events come back in the same frames.
+The settings of the event manager are put back as they were after each part.
+Returns false if any part fails. Run with: demo --events-check
+*/
+bool RunEventsCheck();
+
+#endif // EVENTS_CHECK_H
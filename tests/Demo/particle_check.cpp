@@ -0,0 +1,533 @@
+/*
+
+Particle Check
+
+*/
+
+#include "particle_check.h"
+#include "particlefx.h"
+#include "Renderer/fx_manager.h"
+#include "Script/script_manager.h"
+#include "Utils/task_scheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <thread>
+
+using namespace NYX;
+using namespace std;
+
+static const uint PARTICLES = 100000;
+static const size_t WORK_GROUP_SIZE = 100; //as ParticleFX runs the kernels
+static const uint STEPS = 600; //10 s at 60 Hz: every particle starts over at least once
+static const float TIME_STEP = 1.0f / 60.0f;
+
+static const float EMITTER_RATE = 15000.0f; //about 75000 particles alive with lives of 0 to 10 s
+
+static const uint BENCHMARK_MAX_PARTICLES = 4000000;
+static const uint BENCHMARK_STEPS = 60;
+
+static const uint OVERLAP_PARTICLES = 1000000;
+static const uint OVERLAP_STEPS = 120;
+static const chrono::milliseconds OVERLAP_FRAME(8); //stands in for the draws of a frame
+
+static const uint CLOUD_PARTICLES = 1000000;
+
+static const float MATCH_TOLERANCE = 0.01f; //m, m/s and s: well above the drift below, well below a particle's move in a step
+
+static const char* LAYOUT_NAMES[2] = { "aos", "soa" };
+static const char* KERNEL_NAMES[2] = { "gl_particle_rain", "gl_particle_rain_soa" };
+
+static float Random(float scale, float offset)
+{
+	return ((float)rand() / (float)RAND_MAX)*scale + offset;
+}
+
+//the fountain of particle_fountain.lua.
+static void BuildFountain(uint count, vector<Particle>& particles)
+{
+	srand(5);
+	particles.resize(count);
+
+	for (uint i = 0; i < count; i++)
+	{
+		particles[i].position[0] = Random(0.5f, -0.25f);
+		particles[i].position[1] = -5.0f;
+		particles[i].position[2] = Random(0.5f, -0.25f);
+
+		particles[i].velocity[0] = Random(0.4f, -0.2f);
+		particles[i].velocity[1] = Random(3.5f, 1.2f);
+		particles[i].velocity[2] = Random(0.4f, -0.2f);
+
+		particles[i].life = Random(10.0f, 0.0f);
+	}
+}
+
+static double MeasureCPU(eParticleLayout layout, const vector<Particle>& cloud, uint steps, vector<Particle>& result)
+{
+	uint count = (uint)cloud.size();
+	CPUParticleKernel kernel;
+	kernel.Initialize(&cloud[0].position[0], count, layout);
+
+	vector<float> buffer(ParticleBufferSize(layout, count) / sizeof(float));
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+	for (uint step = 0; step < steps; step++)
+		kernel.Execute(TIME_STEP, &buffer[0]);
+
+	double stepTime = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / steps;
+
+	result.resize(count);
+	UnpackParticles(&buffer[0], count, layout, &result[0].position[0]);
+
+	return stepTime;
+}
+
+static bool MeasureCL(FXManager& fxManager, eParticleLayout layout, const vector<Particle>& cloud, uint steps, vector<Particle>& result, double& stepTime)
+{
+	cl_kernel kernel = fxManager.GetKernel("particle_fountain.cl", KERNEL_NAMES[layout]);
+
+	if (kernel == NULL)
+		return false;
+
+	uint count = (uint)cloud.size();
+	cl_context ctx = fxManager.GetCLContext();
+	cl_command_queue queue = fxManager.GetCommandQueue();
+	size_t size = ParticleBufferSize(layout, count);
+	cl_int error, error0;
+
+	vector<float> packed(size / sizeof(float));
+	PackParticles(&cloud[0].position[0], count, layout, &packed[0]);
+
+	cl_mem particles = clCreateBuffer(ctx, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, size, &packed[0], &error);
+	cl_mem state0 = clCreateBuffer(ctx, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, size, &packed[0], &error0);
+
+	if (error != 0 || error0 != 0)
+	{
+		LogManager::GetInstance()->LogMessage("Error! Failed to create the CL buffers.");
+
+		if (particles)
+			clReleaseMemObject(particles);
+		if (state0)
+			clReleaseMemObject(state0);
+
+		return false;
+	}
+
+	int num = (int)count;
+	float timeStep = TIME_STEP;
+	const size_t total_ws = ((count + WORK_GROUP_SIZE - 1) / WORK_GROUP_SIZE)*WORK_GROUP_SIZE;
+
+	error = clSetKernelArg(kernel, 0, sizeof(cl_mem), &particles);
+	error |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &state0);
+	error |= clSetKernelArg(kernel, 2, sizeof(float), &timeStep);
+	error |= clSetKernelArg(kernel, 3, sizeof(int), &num);
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+	//one step at a time, as ParticleFX waits for each before drawing.
+	for (uint step = 0; step < steps; step++)
+	{
+		error |= clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &total_ws, &WORK_GROUP_SIZE, 0, NULL, NULL);
+		error |= clFinish(queue);
+	}
+
+	stepTime = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / steps;
+
+	error |= clEnqueueReadBuffer(queue, particles, CL_TRUE, 0, size, &packed[0], 0, NULL, NULL);
+
+	clReleaseMemObject(particles);
+	clReleaseMemObject(state0);
+
+	if (error != 0)
+	{
+		LogManager::GetInstance()->LogMessage("Error! Failed to run " + string(KERNEL_NAMES[layout]) + ": " + to_string(error));
+		return false;
+	}
+
+	result.resize(count);
+	UnpackParticles(&packed[0], count, layout, &result[0].position[0]);
+
+	return true;
+}
+
+/*
+ParticleFX's schedule, with plain buffers for the vertex buffers: the kernel steps the particles in a buffer of their own
+and a copy goes to one of two others while the frame draws from the second. overlapped, the next step only waits for
+the last one; otherwise every step is finished before the frame, as ParticleFX used to. waitTime is the ms per step
+the CPU waited.
+*/
+static bool MeasureOverlap(FXManager& fxManager, const vector<Particle>& cloud, bool overlapped, vector<Particle>& result, double& waitTime)
+{
+	const eParticleLayout layout = PARTICLE_LAYOUT_SOA;
+	cl_kernel kernel = fxManager.GetKernel("particle_fountain.cl", KERNEL_NAMES[layout]);
+
+	if (kernel == NULL)
+		return false;
+
+	uint count = (uint)cloud.size();
+	cl_context ctx = fxManager.GetCLContext();
+	cl_command_queue queue = fxManager.GetCommandQueue();
+	size_t size = ParticleBufferSize(layout, count);
+	cl_int error = 0, bufferError = 0;
+
+	vector<float> packed(size / sizeof(float));
+	PackParticles(&cloud[0].position[0], count, layout, &packed[0]);
+
+	cl_mem buffers[4] = {}; //the particles, the initial state, the two to draw
+	cl_event copied[2] = {};
+
+	for (uint i = 0; i < 4; i++)
+	{
+		buffers[i] = clCreateBuffer(ctx, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, size, &packed[0], &bufferError);
+		error |= bufferError;
+	}
+
+	int num = (int)count;
+	float timeStep = TIME_STEP;
+	const size_t total_ws = ((count + WORK_GROUP_SIZE - 1) / WORK_GROUP_SIZE)*WORK_GROUP_SIZE;
+
+	error |= clSetKernelArg(kernel, 0, sizeof(cl_mem), &buffers[0]);
+	error |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &buffers[1]);
+	error |= clSetKernelArg(kernel, 2, sizeof(float), &timeStep);
+	error |= clSetKernelArg(kernel, 3, sizeof(int), &num);
+
+	uint front = 0;
+	bool pending = false;
+	chrono::steady_clock::duration waited(0);
+
+	for (uint step = 0; step < OVERLAP_STEPS && error == 0; step++)
+	{
+		uint back = 1 - front;
+
+		if (pending)
+		{
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+			error |= clWaitForEvents(1, &copied[back]);
+			waited += chrono::steady_clock::now() - start;
+
+			clReleaseEvent(copied[back]);
+			copied[back] = NULL;
+			front = back;
+			back = 1 - front;
+		}
+
+		error |= clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &total_ws, &WORK_GROUP_SIZE, 0, NULL, NULL);
+		error |= clEnqueueCopyBuffer(queue, buffers[0], buffers[2 + back], 0, 0, size, 0, NULL, &copied[back]);
+
+		if (overlapped)
+		{
+			error |= clFlush(queue);
+			pending = true;
+		}
+		else
+		{
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+			error |= clFinish(queue);
+			waited += chrono::steady_clock::now() - start;
+
+			clReleaseEvent(copied[back]);
+			copied[back] = NULL;
+			front = back;
+		}
+
+		this_thread::sleep_for(OVERLAP_FRAME);
+	}
+
+	//the last step, still on its way.
+	error |= clFinish(queue);
+
+	if (pending)
+		front = 1 - front;
+
+	waitTime = chrono::duration<double, milli>(waited).count() / OVERLAP_STEPS;
+
+	error |= clEnqueueReadBuffer(queue, buffers[2 + front], CL_TRUE, 0, size, &packed[0], 0, NULL, NULL);
+
+	for (uint i = 0; i < 2; i++)
+	{
+		if (copied[i])
+			clReleaseEvent(copied[i]);
+	}
+
+	for (uint i = 0; i < 4; i++)
+	{
+		if (buffers[i])
+			clReleaseMemObject(buffers[i]);
+	}
+
+	if (error != 0)
+	{
+		LogManager::GetInstance()->LogMessage("Error! Failed to run " + string(KERNEL_NAMES[layout]) + ": " + to_string(error));
+		return false;
+	}
+
+	result.resize(count);
+	UnpackParticles(&packed[0], count, layout, &result[0].position[0]);
+
+	return true;
+}
+
+//the device may fuse multiply and add where the CPU doesn't: the two drift apart by a few ulps per step.
+static string Difference(const vector<Particle>& a, const vector<Particle>& b, bool& matched)
+{
+	float position = 0.0f, velocity = 0.0f, life = 0.0f;
+
+	for (uint i = 0; i < a.size(); i++)
+	{
+		for (uint k = 0; k < 3; k++)
+		{
+			position = max(position, fabs(a[i].position[k] - b[i].position[k]));
+			velocity = max(velocity, fabs(a[i].velocity[k] - b[i].velocity[k]));
+		}
+
+		life = max(life, fabs(a[i].life - b[i].life));
+	}
+
+	matched = a.size() == b.size() && position <= MATCH_TOLERANCE && velocity <= MATCH_TOLERANCE && life <= MATCH_TOLERANCE;
+
+	return "position " + to_string(position) + " m, velocity " + to_string(velocity) + " m/s, life " + to_string(life) + " s";
+}
+
+//by life, then position: the kernels fill the holes in no particular order.
+static bool ParticleLess(const Particle& a, const Particle& b)
+{
+	if (a.life != b.life)
+		return a.life < b.life;
+
+	return lexicographical_compare(a.position, a.position + 3, b.position, b.position + 3);
+}
+
+static bool RunEmitterCheck(bool clAvailable)
+{
+	LogManager* log = LogManager::GetInstance();
+	bool passed = true;
+
+	ParticleEmitter emitter;
+	emitter.rate = EMITTER_RATE;
+
+	CPUParticleKernel kernel;
+	kernel.InitializeEmitter(emitter, PARTICLES);
+
+	vector<float> buffer(ParticleBufferSize(PARTICLE_LAYOUT_SOA, PARTICLES) / sizeof(float));
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+	for (uint step = 0; step < STEPS; step++)
+		kernel.Execute(TIME_STEP, &buffer[0]);
+
+	double cpuTime = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / STEPS;
+	string line = "  emitter: CPU " + to_string(cpuTime) + " ms/step, " + to_string(kernel.GetLiveCount()) + " alive";
+
+	cl_context ctx = FXManager::GetInstance()->GetCLContext();
+	cl_int error = 0, counterError = 0, holesError = 0;
+	cl_mem particles = nullptr, counters = nullptr, holes = nullptr;
+
+	if (clAvailable)
+	{
+		particles = clCreateBuffer(ctx, CL_MEM_READ_WRITE, buffer.size()*sizeof(float), NULL, &error);
+		counters = clCreateBuffer(ctx, CL_MEM_READ_WRITE, sizeof(cl_int)*4, NULL, &counterError);
+		holes = clCreateBuffer(ctx, CL_MEM_READ_WRITE, sizeof(cl_int)*PARTICLES, NULL, &holesError);
+	}
+
+	if (!clAvailable)
+	{
+		log->LogMessage(line);
+	}
+	else if (error != 0 || counterError != 0 || holesError != 0)
+	{
+		log->LogMessage(line);
+		log->LogMessage("Error! Failed to create the particle emitter buffers: " + to_string(error | counterError | holesError));
+		passed = false;
+	}
+	else
+	{
+		uint live = 0, emitted = 0, countMismatches = 0;
+		float carry = 0.0f;
+
+		//the same steps again for the live counts, which have to agree at every step.
+		CPUParticleKernel reference;
+		reference.InitializeEmitter(emitter, PARTICLES);
+
+		double clTime = 0.0;
+
+		for (uint step = 0; step < STEPS && error == 0; step++)
+		{
+			uint emitCount = emitter.EmissionCount(TIME_STEP, carry);
+
+			start = chrono::steady_clock::now();
+			error = ExecuteEmitterKernels(particles, counters, holes, PARTICLES, emitter, TIME_STEP, emitted, emitCount, live);
+			clTime += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+			emitted += emitCount;
+			reference.Execute(TIME_STEP, &buffer[0]);
+
+			if (live != reference.GetLiveCount())
+				countMismatches++;
+		}
+
+		vector<float> clBuffer(buffer.size());
+		error |= clEnqueueReadBuffer(FXManager::GetInstance()->GetCommandQueue(), particles, CL_TRUE, 0, clBuffer.size()*sizeof(float), &clBuffer[0], 0, NULL, NULL);
+
+		if (error != 0)
+		{
+			log->LogMessage("Error! Failed to run the particle emitter: " + to_string(error));
+			passed = false;
+		}
+		else
+		{
+			vector<Particle> cpuResult(PARTICLES), clResult(PARTICLES);
+			UnpackParticles(&buffer[0], PARTICLES, PARTICLE_LAYOUT_SOA, &cpuResult[0].position[0]);
+			UnpackParticles(&clBuffer[0], PARTICLES, PARTICLE_LAYOUT_SOA, &clResult[0].position[0]);
+
+			cpuResult.resize(reference.GetLiveCount());
+			clResult.resize(min(live, reference.GetLiveCount()));
+			cpuResult.resize(clResult.size());
+
+			sort(cpuResult.begin(), cpuResult.end(), ParticleLess);
+			sort(clResult.begin(), clResult.end(), ParticleLess);
+
+			bool matched = false;
+			line += ", OpenCL " + to_string(clTime / STEPS) + " ms/step, " + to_string(live) + " alive, " + to_string(countMismatches) + 
+					" steps with a different count. Largest difference: " + Difference(cpuResult, clResult, matched);
+			passed = matched && countMismatches == 0;
+		}
+
+		log->LogMessage(line);
+	}
+
+	if (particles)
+		clReleaseMemObject(particles);
+	if (counters)
+		clReleaseMemObject(counters);
+	if (holes)
+		clReleaseMemObject(holes);
+
+	return passed;
+}
+
+//the clouds a particle effect can start from, of a million particles: from an emitter, from a script filling in
+//a buffer and from a script returning a table (particle_fountain_table.lua, in the demo data).
+static bool RunCloudBenchmark()
+{
+	LogManager* log = LogManager::GetInstance();
+	ScriptManager* scripts = ScriptManager::GetInstance();
+
+	//without a window, the application hasn't started the scripting engine.
+	scripts->Init();
+
+	vector<Particle> emitted(CLOUD_PARTICLES), filled(CLOUD_PARTICLES), returned(CLOUD_PARTICLES);
+	string line = "Particle cloud of " + to_string(CLOUD_PARTICLES) + " particles: emitter ";
+	bool passed = false;
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	GenerateParticles(ParticleEmitter(), CLOUD_PARTICLES, &emitted[0].position[0]);
+	line += to_string(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count()) + " ms";
+
+	if (scripts->RegisterLuaFunction("particle_fountain.lua", "GenerateParticleCloud") &&
+		scripts->RegisterLuaFunction("particle_fountain_table.lua", "GenerateParticleTable"))
+	{
+		start = chrono::steady_clock::now();
+		bool bufferDone = RunParticleScript("GenerateParticleCloud", CLOUD_PARTICLES, &filled[0].position[0]);
+		double bufferTime = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+		start = chrono::steady_clock::now();
+		bool tableDone = RunParticleScript("GenerateParticleTable", CLOUD_PARTICLES, &returned[0].position[0]);
+		double tableTime = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+		//the same random numbers: the two have to agree.
+		if (bufferDone && tableDone)
+			line += ", script buffer " + to_string(bufferTime) + " ms, script table " + to_string(tableTime) + " ms. Largest difference: " + 
+					Difference(filled, returned, passed);
+	}
+
+	log->LogMessage(line);
+
+	return passed;
+}
+
+bool RunParticleCheck()
+{
+	LogManager* log = LogManager::GetInstance();
+	bool passed = true;
+
+	vector<Particle> cloud, cpuResult, clResult;
+	BuildFountain(PARTICLES, cloud);
+
+	log->LogMessage("Particle check: " + to_string(PARTICLES) + " particles, " + to_string(STEPS) + " steps at 60 Hz. Hardware threads: " +
+					to_string(TaskScheduler::GetInstance()->GetMaxThreadCount()));
+
+	FXManager fxManager;
+	bool clAvailable = fxManager.InitializeCompute();
+
+	if (!clAvailable)
+		log->LogMessage("  no OpenCL device to compare with: CPU timings only.");
+
+	for (uint layout = PARTICLE_LAYOUT_AOS; layout <= PARTICLE_LAYOUT_SOA; layout++)
+	{
+		double cpuTime = MeasureCPU((eParticleLayout)layout, cloud, STEPS, cpuResult);
+		string line = "  " + string(LAYOUT_NAMES[layout]) + ": CPU " + to_string(cpuTime) + " ms/step";
+
+		double clTime = 0.0;
+		bool matched = !clAvailable;
+
+		if (clAvailable && MeasureCL(fxManager, (eParticleLayout)layout, cloud, STEPS, clResult, clTime))
+			line += ", OpenCL " + to_string(clTime) + " ms/step. Largest difference: " + Difference(cpuResult, clResult, matched);
+
+		log->LogMessage(line);
+		passed = passed && matched;
+	}
+
+	passed = RunEmitterCheck(clAvailable) && passed;
+	passed = RunCloudBenchmark() && passed;
+
+	if (clAvailable)
+	{
+		double finishWait = 0.0, overlapWait = 0.0;
+		BuildFountain(OVERLAP_PARTICLES, cloud);
+
+		bool matched = false;
+
+		if (MeasureOverlap(fxManager, cloud, false, cpuResult, finishWait) && MeasureOverlap(fxManager, cloud, true, clResult, overlapWait))
+		{
+			log->LogMessage("  " + to_string(OVERLAP_PARTICLES) + " particles drawn while the next step runs: the CPU waits " + to_string(overlapWait) + 
+							" ms/step, " + to_string(finishWait) + " ms/step finishing every step. Largest difference: " + Difference(cpuResult, clResult, matched));
+		}
+
+		passed = passed && matched;
+	}
+
+	//millions of particles: the time goes in moving them through memory, which is what the layouts change.
+	log->LogMessage("Particle layouts, " + to_string(BENCHMARK_STEPS) + " steps:");
+
+	for (uint count = BENCHMARK_MAX_PARTICLES / 4; count <= BENCHMARK_MAX_PARTICLES; count *= 2)
+	{
+		BuildFountain(count, cloud);
+		string line = "  " + to_string(count) + " particles:";
+
+		for (uint layout = PARTICLE_LAYOUT_AOS; layout <= PARTICLE_LAYOUT_SOA; layout++)
+		{
+			double clTime = 0.0;
+			line += string(" ") + LAYOUT_NAMES[layout] + " CPU " + to_string(MeasureCPU((eParticleLayout)layout, cloud, BENCHMARK_STEPS, cpuResult)) + " ms";
+
+			if (clAvailable)
+			{
+				if (MeasureCL(fxManager, (eParticleLayout)layout, cloud, BENCHMARK_STEPS, clResult, clTime))
+					line += ", OpenCL " + to_string(clTime) + " ms";
+				else
+					passed = false;
+			}
+
+			line += (layout == PARTICLE_LAYOUT_AOS) ? ";" : "";
+		}
+
+		log->LogMessage(line);
+	}
+
+	log->LogMessage(string("Particle check ") + (passed ? "passed." : "FAILED."));
+
+	return passed;
+}
@@ -0,0 +1,27 @@
+/*
+
+Particle Check
+
+*/
+
+#ifndef PARTICLE_CHECK_H
+#define PARTICLE_CHECK_H
+
+/*
+Headless check of the CPU particle kernel against the OpenCL ones: a fountain of 100000 particles, spread as
+particle_fountain.lua spreads them, stepped for 10 s at 60 Hz by CPUParticleKernel and by the kernel of each
+particle layout (gl_particle_rain and gl_particle_rain_soa), on an OpenCL device of its own (no GL sharing).
+Logs the largest difference in position, velocity and life between the two, and the time per step of each.
+The same for particles from an emitter (particle_emitter.cl), about 75000 alive at a time, also checking that
+both keep as many alive at every step. Then how long the CPU waits per step for 1 million particles drawn as
+ParticleFX draws them, a step behind the kernel, against finishing every step before drawing it.
+How long a cloud of 1 million particles takes to build from an emitter, from particle_fountain.lua filling in
+a buffer and from the same script returning a table. Then the two layouts with 1, 2 and 4 million particles.
+On a machine without an NVIDIA GPU the OpenCL device is the CPU one. Without OpenCL only the CPU timings are logged.
+Returns false if a kernel or a script fails, if two results that should agree differ by more than 0.01 or if the
+emitters keep different counts alive.
+Needs Resources/FXKernels, Resources/Scripts and Resources/Data in the cache search paths. Run with: demo --particle-check
+*/
+bool RunParticleCheck();
+
+#endif // PARTICLE_CHECK_H
@@ -0,0 +1,1232 @@
+/*
+
+Physics Benchmark
+
+*/
+
+#include "physics_benchmark.h"
+#include "Physics/physics_engine.h"
+#include "Physics/collision_shape_cache.h"
+#include "Physics/gravity_field.h"
+#include "Physics/soft_body.h"
+#include "Utils/task_scheduler.h"
+#include "Events/event_manager.h"
+#include "scene_node.h"
+#include "mesh.h"
+#include "json.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+
+using namespace NYX;
+using namespace std;
+using nlohmann::json;
+
+static const uint COLUMNS = 25; //per side
+static const uint BOXES_PER_COLUMN = 8; //25 x 25 x 8 = 5000 boxes
+static const uint WARMUP_STEPS = 30;
+static const uint MEASURED_STEPS = 300;
+static const uint THREADED_FRAMES = 120;
+static const uint FRAME_WORK_MS = 10; //the main thread's own work every frame, outside IPhysicsEngine::Update
+
+static const uint SETTLED_SIDE = 100; //100 x 100 = 10000 boxes resting on the ground
+static const uint MAX_SETTLE_STEPS = 600; //Bullet puts a body to sleep after 2 s at rest
+
+static const uint TORUS_RINGS = 64; //64 x 32 = 2048 vertices
+static const uint TORUS_SIDES = 32;
+static const uint TORUS_PILE_SIDE = 6; //6 x 6 x 4 = 144 tori dropped in a pile
+static const uint TORUS_LAYERS = 4;
+
+static const uint GRAVITY_ACCURACY_BODIES = 4000;
+static const uint GRAVITY_MAX_BODIES = 100000;
+static const uint GRAVITY_MAX_DIRECT_BODIES = 20000; //beyond that the direct sum takes too long
+
+static const uint TERRAIN_SIDE = 708; //708 x 708 cells, 2 triangles each: about 1M triangles
+static const uint TERRAIN_RAYS = 100000;
+
+static const uint QUERY_RAYS = 10000; //per frame
+static const uint QUERY_FRAMES = 60;
+
+static const uint SNAPSHOT_SIDE = 100; //100 x 100 = 10000 boxes, loaded from JSON and from a snapshot
+
+static const uint SPARSE_BODIES = 16000; //drifting in a cube of SPARSE_EXTENT m, a few km apart
+static const float SPARSE_EXTENT = 10000.0f;
+
+static const uint INTERPOLATION_FRAMES = 600; //2 to 40 ms each, at random
+static const float INTERPOLATION_SPEED = 10.0f; //m/s
+
+static const uint CLOTH_SIDE = 40; //40 x 40 quads, in two halves that share no vertices along the seam
+
+//stands in for the scene nodes, which are not there in a headless run.
+struct BodyStateSink
+{
+	BodyStateSink() : received(0) {}
+	void OnObjectMoved(ObjectMovedEvent& event) { received++; }
+
+	uint received;
+};
+
+static void BuildScene(IPhysicsEngine* engine, uint columns, uint boxesPerColumn)
+{
+	Matrix3x3 identity;
+	identity.LoadIdentity();
+
+	float plane[4] = { 0.0f, 1.0f, 0.0f, 0.0f };
+	//bodies from the engine share their collision shapes: one box shape for the whole scene.
+	PhysicsBodyPtr ground = engine->CreateBody(BDY_RIGID, "ground", 1);
+	ground->SetCollisionShape(CS_PLANE, plane);
+	ground->SetMassAndInertia(0.0f, Vector3(0.0, 0.0, 0.0));
+	ground->SetInitialState(Vector3(0.0, 0.0, 0.0), identity);
+	ground->Finilize();
+	engine->AddBody(ground);
+
+	float halfExtents[3] = { 0.5f, 0.5f, 0.5f };
+	uint id = 2;
+
+	for (uint x = 0; x < columns; x++)
+		for (uint z = 0; z < columns; z++)
+			for (uint y = 0; y < boxesPerColumn; y++)
+			{
+				PhysicsBodyPtr box = engine->CreateBody(BDY_RIGID, "box", id++);
+				box->SetCollisionShape(CS_BOX, halfExtents);
+				box->SetMassAndInertia(1.0f, Vector3(0.0, 0.0, 0.0));
+				box->SetInitialState(Vector3(x*1.5f, 0.5f + y*1.01f, z*1.5f), identity);
+				box->Finilize();
+				engine->AddBody(box);
+			}
+}
+
+//average step time, in ms.
+static double MeasureWorld(ePhysicsWorld world)
+{
+	EventManager* eventManager = EventManager::GetInstance();
+
+	DefaultPhysicsEngine engine;
+	engine.InitPhysics(world);
+	engine.SetGravity(Vector3(0.0, -9.81, 0.0));
+
+	BuildScene(&engine, COLUMNS, BOXES_PER_COLUMN);
+
+	const float timeStep = 1.0f/60.0f;
+
+	for (uint i = 0; i < WARMUP_STEPS; i++)
+	{
+		engine.StepSimulation(timeStep);
+		eventManager->ProcessEventQueue();
+	}
+
+	double total = 0.0;
+
+	for (uint i = 0; i < MEASURED_STEPS; i++)
+	{
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		engine.StepSimulation(timeStep);
+		total += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+		//the body states are posted as events: don't let them pile up.
+		eventManager->ProcessEventQueue();
+	}
+
+	return total / MEASURED_STEPS;
+}
+
+/*the stacked boxes through frames where the main thread is busy for FRAME_WORK_MS outside Update, stepped in
+  Update and on the physics thread: PhysicsStats::overlapTime is how much of the stepping that work hid.*/
+static bool RunThreadedBenchmark()
+{
+	LogManager* log = LogManager::GetInstance();
+	EventManager* eventManager = EventManager::GetInstance();
+
+	log->LogMessage("Threaded physics: " + to_string(THREADED_FRAMES) + " frames with " + to_string(FRAME_WORK_MS) + " ms of work on the main thread.");
+
+	bool passed = true;
+
+	for (uint threaded = 0; threaded < 2; threaded++)
+	{
+		DefaultPhysicsEngine engine;
+		engine.InitPhysics(PHYS_RIGID_ONLY);
+		engine.SetGravity(Vector3(0.0, -9.81, 0.0));
+		BuildScene(&engine, COLUMNS, BOXES_PER_COLUMN);
+		engine.SetThreaded(threaded == 1);
+
+		double frameTime = 1.0/60.0, stepTime = 0.0, overlapTime = 0.0, mainThreadTime = 0.0;
+		uint steps = 0;
+
+		for (uint i = 0; i < THREADED_FRAMES; i++)
+		{
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+			engine.Update((float)frameTime);
+			eventManager->ProcessEventQueue();
+
+			const PhysicsStats& stats = engine.GetStats();
+			steps += stats.steps;
+			stepTime += stats.stepTime;
+			overlapTime += stats.overlapTime;
+			mainThreadTime += stats.mainThreadTime;
+
+			while (chrono::steady_clock::now() - start < chrono::milliseconds(FRAME_WORK_MS));
+
+			frameTime = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		}
+
+		engine.SetThreaded(false);
+
+		//stepped in Update nothing runs alongside the frame; on its thread the world can't overlap more than it stepped.
+		if (threaded)
+			passed = passed && overlapTime > 0.0 && overlapTime <= stepTime;
+		else
+			passed = passed && overlapTime == 0.0;
+
+		log->LogMessage(string("  ") + (threaded ? "threaded: " : "in Update: ") + to_string(steps) + " steps, " + to_string(stepTime) + 
+						" ms stepping, " + to_string(overlapTime) + " ms of it alongside the frame, " + to_string(mainThreadTime) + " ms in Update");
+	}
+
+	log->LogMessage(string("  overlap check ") + (passed ? "passed." : "FAILED."));
+
+	return passed;
+}
+
+//a scene where nothing moves: average time per step, including the delivery of the body states.
+static double MeasureSettled(float motionEpsilon, PhysicsStats& stats)
+{
+	EventManager* eventManager = EventManager::GetInstance();
+
+	DefaultPhysicsEngine engine;
+	engine.InitPhysics(PHYS_RIGID_ONLY);
+	engine.SetGravity(Vector3(0.0, -9.81, 0.0));
+	engine.SetMotionEpsilon(motionEpsilon);
+
+	BuildScene(&engine, SETTLED_SIDE, 1);
+
+	const float timeStep = 1.0f/60.0f;
+
+	for (uint i = 0; i < MAX_SETTLE_STEPS; i++)
+	{
+		engine.StepSimulation(timeStep);
+		eventManager->ProcessEventQueue();
+
+		if (engine.GetStats().activeBodies == 0)
+			break;
+	}
+
+	double total = 0.0;
+	uint published = 0;
+
+	for (uint i = 0; i < MEASURED_STEPS; i++)
+	{
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		engine.StepSimulation(timeStep);
+		eventManager->ProcessEventQueue();
+		total += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+		published += engine.GetStats().publishedBodies;
+	}
+
+	stats = engine.GetStats();
+	stats.publishedBodies = published / MEASURED_STEPS;
+
+	return total / MEASURED_STEPS;
+}
+
+static void RunSettledBenchmark()
+{
+	LogManager* log = LogManager::GetInstance();
+
+	log->LogMessage("Settled scene: " + to_string(SETTLED_SIDE*SETTLED_SIDE) + " boxes at rest on the ground.");
+
+	//a negative epsilon publishes every dynamic body at every step.
+	float epsilons[2] = { -1.0f, 1e-4f };
+	const char* names[2] = { "  every body", "  moved bodies only" };
+
+	for (uint i = 0; i < 2; i++)
+	{
+		PhysicsStats stats;
+		double time = MeasureSettled(epsilons[i], stats);
+
+		log->LogMessage(string(names[i]) + ": " + to_string(time) + " ms/step, " + to_string(stats.publishedBodies) + 
+						" events/step, " + to_string(stats.activeBodies) + " active, " + to_string(stats.sleepingBodies) + " sleeping");
+
+		if (i == 0)
+		{
+			//without sharing, every body would have a shape of its own.
+			log->LogMessage("  collision shapes: " + to_string(stats.collisionShapes) + " for " + to_string(stats.collisionShapeUsers) + 
+							" bodies, " + to_string(stats.collisionShapeMemory) + " bytes (" + 
+							to_string(stats.collisionShapeUsers*sizeof(btBoxShape)) + " bytes unshared)");
+		}
+	}
+}
+
+//a concave model: its full hull covers the hole in the middle.
+static void BuildTorus(vector<float>& vertices, vector<int>& indices)
+{
+	const float ring = 1.0f, tube = 0.35f, twoPi = 6.2831853f;
+
+	for (uint i = 0; i < TORUS_RINGS; i++)
+		for (uint j = 0; j < TORUS_SIDES; j++)
+		{
+			float u = twoPi*i / TORUS_RINGS, v = twoPi*j / TORUS_SIDES;
+			vertices.push_back((ring + tube*cosf(v)) * cosf(u));
+			vertices.push_back(tube*sinf(v));
+			vertices.push_back((ring + tube*cosf(v)) * sinf(u));
+		}
+
+	for (uint i = 0; i < TORUS_RINGS; i++)
+		for (uint j = 0; j < TORUS_SIDES; j++)
+		{
+			int a = i*TORUS_SIDES + j, b = ((i + 1) % TORUS_RINGS)*TORUS_SIDES + j;
+			int c = ((i + 1) % TORUS_RINGS)*TORUS_SIDES + (j + 1) % TORUS_SIDES, d = i*TORUS_SIDES + (j + 1) % TORUS_SIDES;
+			int quad[6] = { a, b, c, a, c, d };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+}
+
+//average time per step of a pile of tori colliding as the given hull, and the time taken to build it.
+static double MeasureMeshHull(const MeshHullOptions& options, vector<float>& vertices, vector<int>& indices, double& buildTime)
+{
+	DefaultPhysicsEngine engine;
+	engine.InitPhysics(PHYS_RIGID_ONLY);
+	engine.SetGravity(Vector3(0.0, -9.81, 0.0));
+
+	Matrix3x3 identity;
+	identity.LoadIdentity();
+
+	float plane[4] = { 0.0f, 1.0f, 0.0f, 0.0f };
+	PhysicsBodyPtr ground = engine.CreateBody(BDY_RIGID, "ground", 1);
+	ground->SetCollisionShape(CS_PLANE, plane);
+	ground->SetMassAndInertia(0.0f, Vector3(0.0, 0.0, 0.0));
+	ground->SetInitialState(Vector3(0.0, 0.0, 0.0), identity);
+	ground->Finilize();
+	engine.AddBody(ground);
+
+	uint id = 2;
+	buildTime = 0.0;
+
+	for (uint x = 0; x < TORUS_PILE_SIDE; x++)
+		for (uint z = 0; z < TORUS_PILE_SIDE; z++)
+			for (uint y = 0; y < TORUS_LAYERS; y++)
+			{
+				PhysicsBodyPtr body = engine.CreateBody(BDY_RIGID, "torus", id++);
+				PhysicsBody* torus = dynamic_cast<PhysicsBody*>(body.get());
+
+				//the first torus builds the hull, the others share it.
+				chrono::steady_clock::time_point start = chrono::steady_clock::now();
+				torus->SetMesh(&vertices[0], (int)vertices.size()/3, 3*sizeof(float), &indices[0], (int)indices.size());
+				torus->SetMeshHull(options);
+				torus->SetCollisionShape(CS_MESH);
+				buildTime += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+				torus->SetMassAndInertia(1.0f, Vector3(0.0, 0.0, 0.0));
+				torus->SetInitialState(Vector3(x*2.2f, 0.5f + y*0.8f, z*2.2f + (y % 2)*1.1f), identity);
+				torus->Finilize();
+				engine.AddBody(body);
+			}
+
+	const float timeStep = 1.0f/60.0f;
+	double total = 0.0;
+
+	for (uint i = 0; i < WARMUP_STEPS + MEASURED_STEPS; i++)
+	{
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		engine.StepSimulation(timeStep);
+		EventManager::GetInstance()->ProcessEventQueue();
+
+		if (i >= WARMUP_STEPS)
+			total += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+	}
+
+	return total / MEASURED_STEPS;
+}
+
+static void RunMeshHullBenchmark()
+{
+	LogManager* log = LogManager::GetInstance();
+
+	vector<float> vertices;
+	vector<int> indices;
+	BuildTorus(vertices, indices);
+
+	log->LogMessage("Mesh hulls: " + to_string(TORUS_PILE_SIDE*TORUS_PILE_SIDE*TORUS_LAYERS) + " tori of " + to_string(vertices.size()/3) + 
+					" vertices dropped on the ground.");
+
+	eMeshHull hulls[3] = { MH_FULL, MH_REDUCED, MH_DECOMPOSED };
+	const char* names[3] = { "  full hull", "  reduced hull", "  decomposed" };
+
+	for (uint i = 0; i < 3; i++)
+	{
+		MeshHullOptions options;
+		options.hull = hulls[i];
+
+		double buildTime;
+		double time = MeasureMeshHull(options, vertices, indices, buildTime);
+
+		log->LogMessage(string(names[i]) + ": " + to_string(time) + " ms/step, built in " + to_string(buildTime) + " ms");
+	}
+}
+
+//a cluster of stars: denser at the centre, masses from 0.1 to 1.
+static void BuildCluster(uint numBodies, vector<float>& positions, vector<float>& masses)
+{
+	positions.resize(3*numBodies);
+	masses.resize(numBodies);
+
+	srand(1);
+
+	for (uint i = 0; i < numBodies; i++)
+	{
+		float direction[3], length2;
+
+		do
+		{
+			for (int k = 0; k < 3; k++)
+				direction[k] = 2.0f*rand()/RAND_MAX - 1.0f;
+
+			length2 = direction[0]*direction[0] + direction[1]*direction[1] + direction[2]*direction[2];
+		}
+		while (length2 > 1.0f || length2 == 0.0f);
+
+		float radius = 100.0f * powf((float)rand()/RAND_MAX, 2.0f) / sqrtf(length2);
+
+		for (int k = 0; k < 3; k++)
+			positions[3*i + k] = direction[k]*radius;
+
+		masses[i] = 0.1f + 0.9f*rand()/RAND_MAX;
+	}
+}
+
+//the pull of every body on every other, summed one pair at a time in double precision. shares no code with
+//GravityField, so the error of its leaf kernel shows up as well as that of the tree.
+static void DirectSum(const vector<float>& positions, const vector<float>& masses, double constant, double softening, vector<double>& exact)
+{
+	size_t count = masses.size();
+	exact.assign(3*count, 0.0);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		for (size_t j = 0; j < count; j++)
+		{
+			double d[3];
+			for (int k = 0; k < 3; k++)
+				d[k] = (double)positions[3*j + k] - (double)positions[3*i + k];
+
+			double r2 = d[0]*d[0] + d[1]*d[1] + d[2]*d[2] + softening;
+			if (r2 <= 0.0)
+				continue;
+
+			double f = constant*masses[j] / (r2*sqrt(r2));
+			for (int k = 0; k < 3; k++)
+				exact[3*i + k] += d[k]*f;
+		}
+	}
+}
+
+//rms of the error of the accelerations, over the rms of the accelerations.
+static double RelativeError(const vector<float>& accelerations, const vector<double>& exact)
+{
+	double error = 0.0, total = 0.0;
+
+	for (size_t i = 0; i < exact.size(); i++)
+	{
+		error += (accelerations[i] - exact[i])*(accelerations[i] - exact[i]);
+		total += exact[i]*exact[i];
+	}
+
+	return sqrt(error / total);
+}
+
+static void RunGravityBenchmark()
+{
+	LogManager* log = LogManager::GetInstance();
+
+	GravityField field;
+	field.SetConstant(1.0f);
+	field.SetSoftening(0.01f);
+
+	vector<float> positions, masses, accelerations;
+	vector<double> exact;
+
+	log->LogMessage("Gravity field: Barnes-Hut against the direct sum, " + to_string(GRAVITY_ACCURACY_BODIES) + " bodies.");
+
+	BuildCluster(GRAVITY_ACCURACY_BODIES, positions, masses);
+	accelerations.resize(positions.size());
+	DirectSum(positions, masses, 1.0, 0.01, exact);
+
+	field.ComputeDirect(&positions[0], &masses[0], GRAVITY_ACCURACY_BODIES, &accelerations[0]);
+	log->LogMessage("  field direct sum: relative error " + to_string(RelativeError(accelerations, exact)));
+
+	float angles[3] = { 0.5f, 0.7f, 0.9f };
+
+	for (uint i = 0; i < 3; i++)
+	{
+		field.SetOpeningAngle(angles[i]);
+		field.Compute(&positions[0], &masses[0], GRAVITY_ACCURACY_BODIES, &accelerations[0]);
+		log->LogMessage("  opening angle " + to_string(angles[i]) + ": relative error " + to_string(RelativeError(accelerations, exact)));
+	}
+
+	field.SetOpeningAngle(0.7f);
+
+	for (uint bodies = 1000; bodies <= GRAVITY_MAX_BODIES; bodies *= 10)
+	{
+		BuildCluster(bodies, positions, masses);
+		accelerations.resize(positions.size());
+
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		field.Compute(&positions[0], &masses[0], bodies, &accelerations[0]);
+		double treeTime = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+		string line = "  " + to_string(bodies) + " bodies: " + to_string(treeTime) + " ms (" + to_string(field.GetNodeCount()) + " nodes)";
+
+		if (bodies <= GRAVITY_MAX_DIRECT_BODIES)
+		{
+			start = chrono::steady_clock::now();
+			field.ComputeDirect(&positions[0], &masses[0], bodies, &accelerations[0]);
+			line += ", direct sum " + to_string(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count()) + " ms";
+		}
+
+		log->LogMessage(line);
+	}
+}
+
+//counts the triangles hit by a ray.
+struct RayHitCounter : public btTriangleCallback
+{
+	RayHitCounter() : hits(0) {}
+	virtual void processTriangle(btVector3* triangle, int partId, int triangleIndex) { hits++; }
+
+	uint hits;
+};
+
+//a height field as a Model would hold it: positions at the start of each vertex, 3 indices per triangle.
+static void BuildTerrain(uint side, vector<Vertex>& vertices, vector<int>& indices)
+{
+	uint rowVertices = side + 1;
+	vertices.resize(rowVertices*rowVertices);
+
+	for (uint z = 0; z < rowVertices; z++)
+		for (uint x = 0; x < rowVertices; x++)
+		{
+			Vertex& vertex = vertices[z*rowVertices + x];
+			vertex.position[0] = (float)x;
+			vertex.position[1] = sinf(x*0.1f) * cosf(z*0.1f) * 4.0f;
+			vertex.position[2] = (float)z;
+		}
+
+	indices.reserve(side*side*6);
+
+	for (uint z = 0; z < side; z++)
+		for (uint x = 0; x < side; x++)
+		{
+			int corner = z*rowVertices + x;
+			int quad[6] = { corner, corner + (int)rowVertices, corner + 1, corner + 1, corner + (int)rowVertices, corner + (int)rowVertices + 1 };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+}
+
+//load time of a static triangle mesh with its BVH built and read back from cooked data, then vertical ray casts against it.
+static void RunTriangleMeshBenchmark()
+{
+	LogManager* log = LogManager::GetInstance();
+
+	vector<Vertex> vertices;
+	vector<int> indices;
+	BuildTerrain(TERRAIN_SIDE, vertices, indices);
+
+	int numTriangles = (int)indices.size() / 3;
+	log->LogMessage("Static triangle mesh: " + to_string(numTriangles) + " triangles, " + to_string(vertices.size()) + " vertices.");
+
+	string cooked;
+	double buildTime = 0.0;
+
+	{
+		CollisionShapeCache cache;
+
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		btBvhTriangleMeshShape* shape = cache.AcquireTriangleMesh(vertices[0].position, (int)vertices.size(), sizeof(Vertex), 
+																  &indices[0], numTriangles);
+		buildTime = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+		cache.CookTriangleMesh(shape, cooked);
+		cache.Release(shape);
+	}
+
+	CollisionShapeCache cache;
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	btBvhTriangleMeshShape* shape = cache.AcquireTriangleMesh(vertices[0].position, (int)vertices.size(), sizeof(Vertex), 
+															  &indices[0], numTriangles, &cooked);
+	double cookedTime = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+	log->LogMessage("  BVH built on load: " + to_string(buildTime) + " ms, read from cooked data: " + to_string(cookedTime) + 
+					" ms (" + to_string(cooked.size()) + " bytes)");
+
+	RayHitCounter counter;
+	float extent = (float)TERRAIN_SIDE;
+
+	start = chrono::steady_clock::now();
+
+	for (uint i = 0; i < TERRAIN_RAYS; i++)
+	{
+		float x = extent * (float)((i*7919) % TERRAIN_RAYS) / TERRAIN_RAYS;
+		float z = extent * (float)i / TERRAIN_RAYS;
+		shape->performRaycast(&counter, btVector3(x, 100.0f, z), btVector3(x, -100.0f, z));
+	}
+
+	double rayTime = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+
+	log->LogMessage("  ray casts: " + to_string(rayTime / TERRAIN_RAYS) + " us/ray, " + to_string(counter.hits) + 
+					" triangles hit by " + to_string(TERRAIN_RAYS) + " rays");
+
+	cache.Release(shape);
+}
+
+//a frame's worth of queries against the stacked boxes: time per batch, in ms.
+static double MeasureQueries(IPhysicsEngine* engine, vector<PhysicsQuery>& queries, vector<PhysicsQueryResult>& results, 
+							 uint batchSize, uint& hits)
+{
+	uint numQueries = (uint)queries.size();
+	double total = 0.0;
+
+	for (uint frame = 0; frame < QUERY_FRAMES; frame++)
+	{
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+		for (uint i = 0; i < numQueries; i += batchSize)
+			engine->RunQueries(&queries[i], min(batchSize, numQueries - i), &results[i]);
+
+		total += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+	}
+
+	hits = 0;
+
+	for (uint i = 0; i < numQueries; i++)
+		hits += results[i].bHit ? 1 : 0;
+
+	return total / QUERY_FRAMES;
+}
+
+//rays cast down on the boxes of the first benchmark in a single batch, on 1, 4 and 8 threads, against one query per call.
+//then as many sweeps and overlaps.
+static void RunQueryBenchmark()
+{
+	LogManager* log = LogManager::GetInstance();
+	TaskScheduler* scheduler = TaskScheduler::GetInstance();
+	EventManager* eventManager = EventManager::GetInstance();
+
+	DefaultPhysicsEngine engine;
+	engine.InitPhysics(PHYS_RIGID_ONLY);
+	engine.SetGravity(Vector3(0.0, -9.81, 0.0));
+
+	BuildScene(&engine, COLUMNS, BOXES_PER_COLUMN);
+
+	for (uint i = 0; i < WARMUP_STEPS; i++)
+	{
+		engine.StepSimulation(1.0f/60.0f);
+		eventManager->ProcessEventQueue();
+	}
+
+	vector<PhysicsQuery> queries(QUERY_RAYS);
+	vector<PhysicsQueryResult> results(QUERY_RAYS);
+	float extent = COLUMNS*1.5f;
+
+	for (uint i = 0; i < QUERY_RAYS; i++)
+	{
+		float x = extent * (float)((i*7919) % QUERY_RAYS) / QUERY_RAYS;
+		float z = extent * (float)i / QUERY_RAYS;
+
+		queries[i].type = QRY_RAY;
+		queries[i].from = Vector3(x, 20.0f, z);
+		queries[i].to = Vector3(x, -1.0f, z);
+	}
+
+	log->LogMessage("Physics queries: " + to_string(QUERY_RAYS) + " per frame against the " + to_string(COLUMNS*COLUMNS*BOXES_PER_COLUMN) + 
+					" stacked boxes.");
+
+	uint hits = 0;
+	uint threadCounts[3] = { 1, 4, 8 };
+
+	for (uint i = 0; i < 3; i++)
+	{
+		scheduler->SetThreadCount(threadCounts[i]);
+		double time = MeasureQueries(&engine, queries, results, QUERY_RAYS, hits);
+		log->LogMessage("  rays, one batch, " + to_string(threadCounts[i]) + " threads: " + to_string(time) + " ms/frame, " + to_string(hits) + " hits");
+	}
+
+	scheduler->SetThreadCount(1);
+	double single = MeasureQueries(&engine, queries, results, 1, hits);
+	log->LogMessage("  rays, one per call: " + to_string(single) + " ms/frame");
+
+	scheduler->SetThreadCount(threadCounts[2]);
+
+	for (uint i = 0; i < QUERY_RAYS; i++)
+	{
+		queries[i].type = QRY_SWEEP;
+		queries[i].radius = 0.25f;
+	}
+
+	double time = MeasureQueries(&engine, queries, results, QUERY_RAYS, hits);
+	log->LogMessage("  sweeps of radius 0.25, one batch: " + to_string(time) + " ms/frame, " + to_string(hits) + " hits");
+
+	for (uint i = 0; i < QUERY_RAYS; i++)
+	{
+		queries[i].type = QRY_OVERLAP;
+		queries[i].from.SetComponents(queries[i].from.X(), 0.5f + (i % BOXES_PER_COLUMN)*1.01f, queries[i].from.Z());
+		queries[i].radius = 1.0f;
+	}
+
+	time = MeasureQueries(&engine, queries, results, QUERY_RAYS, hits);
+	log->LogMessage("  overlaps of radius 1, one batch: " + to_string(time) + " ms/frame, " + to_string(hits) + " hits");
+}
+
+//the rigid body blocks of a scene file: a grid of boxes on a ground box, as settled boxes are.
+static string BuildSceneJson(uint side)
+{
+	json bodies = json::array();
+
+	bodies.push_back({ { "name", "ground" }, { "position", { side*0.75f, -0.5f, side*0.75f } }, { "attitude", { 0.0f, 0.0f, 0.0f } },
+					   { "shape", { { "name", "box" }, { "dimensions", { side*1.5f, 0.5f, side*1.5f } } } }, { "mass", 0.0f }, 
+					   { "friction", 0.5f } });
+
+	for (uint x = 0; x < side; x++)
+		for (uint z = 0; z < side; z++)
+		{
+			bodies.push_back({ { "name", "box" + to_string(x*side + z) }, { "position", { x*1.5f, 0.5f, z*1.5f } }, 
+							   { "attitude", { 0.0f, 0.0f, 0.0f } }, { "shape", { { "name", "box" }, { "dimensions", { 0.5f, 0.5f, 0.5f } } } },
+							   { "mass", 1.0f }, { "inertia", { 0.0f, 0.0f, 0.0f } }, { "friction", 0.5f } });
+		}
+
+	return bodies.dump();
+}
+
+//what the scene does with each rigid body block (see RigidBodyParser), without the scene. The ids are those
+//scene nodes would give the bodies of their objects: one per body.
+static void LoadSceneJson(IPhysicsEngine* engine, const string& text)
+{
+	json bodies = json::parse(text);
+	uint id = 1;
+
+	for (auto body = bodies.begin(); body != bodies.end(); ++body)
+	{
+		PhysicsBodyPtr rigidBody = engine->CreateBody(BDY_RIGID, (*body)["name"].get<string>(), id++);
+		Vector3 position, inertia;
+		Matrix3x3 rotation, rotx, roty, rotz;
+		float mass = 0.0f;
+
+		for (auto iterator = body->begin(); iterator != body->end(); ++iterator)
+		{
+			auto& value = iterator.value();
+
+			if (iterator.key() == "position")
+			{
+				position = { value[0], value[1], value[2] };
+			}
+			else if (iterator.key() == "attitude")
+			{
+				rotx.LoadRotX(value[0]);
+				roty.LoadRotY(value[1]);
+				rotz.LoadRotZ(value[2]);
+				rotation = rotz * roty * rotx;
+			}
+			else if (iterator.key() == "shape")
+			{
+				auto dimensions = value["dimensions"];
+				rigidBody->SetCollisionShape(CS_BOX, Vector3(dimensions[0], dimensions[1], dimensions[2]).GetComponents());
+			}
+			else if (iterator.key() == "mass")
+			{
+				mass = value;
+			}
+			else if (iterator.key() == "inertia")
+			{
+				inertia = { value[0], value[1], value[2] };
+			}
+			else if (iterator.key() == "friction")
+			{
+				rigidBody->SetFriction(value);
+			}
+		}
+
+		rigidBody->SetInitialState(position, rotation);
+		rigidBody->SetMassAndInertia(mass, inertia);
+		rigidBody->Finilize();
+		engine->AddBody(rigidBody);
+	}
+}
+
+//a settled scene loaded from its JSON and from a snapshot saved once it had settled, then rolled back to that snapshot.
+static void RunSnapshotBenchmark()
+{
+	LogManager* log = LogManager::GetInstance();
+	EventManager* eventManager = EventManager::GetInstance();
+	const float timeStep = 1.0f/60.0f;
+
+	string text = BuildSceneJson(SNAPSHOT_SIDE);
+	string snapshot;
+
+	log->LogMessage("World snapshots: " + to_string(SNAPSHOT_SIDE*SNAPSHOT_SIDE) + " boxes on a ground box.");
+
+	{
+		DefaultPhysicsEngine engine;
+		engine.InitPhysics(PHYS_RIGID_ONLY);
+		engine.SetGravity(Vector3(0.0, -9.81, 0.0));
+
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		LoadSceneJson(&engine, text);
+		double jsonTime = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+		for (uint i = 0; i < MAX_SETTLE_STEPS; i++)
+		{
+			engine.StepSimulation(timeStep);
+			eventManager->ProcessEventQueue();
+
+			if (engine.GetStats().activeBodies == 0)
+				break;
+		}
+
+		start = chrono::steady_clock::now();
+		engine.SaveWorld(snapshot);
+		double saveTime = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+		log->LogMessage("  loaded from JSON (" + to_string(text.size()) + " bytes): " + to_string(jsonTime) + " ms, settled: " + 
+						to_string(engine.GetStats().sleepingBodies) + " sleeping");
+		log->LogMessage("  saved after settling: " + to_string(saveTime) + " ms, " + to_string(snapshot.size()) + " bytes");
+
+		//knocked about, then put back as it was.
+		for (uint i = 0; i < SNAPSHOT_SIDE*SNAPSHOT_SIDE; i++)
+			engine.SetBodyVelocity(2 + i, Vector3(0.0, 5.0, 0.0));
+
+		for (uint i = 0; i < WARMUP_STEPS; i++)
+		{
+			engine.StepSimulation(timeStep);
+			eventManager->ProcessEventQueue();
+		}
+
+		start = chrono::steady_clock::now();
+		engine.RestoreWorld(snapshot);
+		double rollbackTime = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+		engine.StepSimulation(timeStep);
+		eventManager->ProcessEventQueue();
+
+		log->LogMessage("  rolled back: " + to_string(rollbackTime) + " ms, then " + to_string(engine.GetStats().activeBodies) + " active, " +
+						to_string(engine.GetStats().sleepingBodies) + " sleeping");
+	}
+
+	DefaultPhysicsEngine engine;
+	engine.InitPhysics(PHYS_RIGID_ONLY);
+	engine.SetGravity(Vector3(0.0, -9.81, 0.0));
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	engine.RestoreWorld(snapshot);
+	double restoreTime = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+	engine.StepSimulation(timeStep);
+	eventManager->ProcessEventQueue();
+
+	log->LogMessage("  loaded from the snapshot: " + to_string(restoreTime) + " ms, then " + to_string(engine.GetStats().activeBodies) + 
+					" active, " + to_string(engine.GetStats().sleepingBodies) + " sleeping");
+}
+
+//boxes scattered far apart with no gravity, drifting: most of the world is empty.
+static void BuildSparseScene(IPhysicsEngine* engine)
+{
+	Matrix3x3 identity;
+	identity.LoadIdentity();
+
+	float halfExtents[3] = { 0.5f, 0.5f, 0.5f };
+	srand(1);
+
+	for (uint i = 0; i < SPARSE_BODIES; i++)
+	{
+		float position[3], velocity[3];
+
+		for (uint k = 0; k < 3; k++)
+		{
+			position[k] = SPARSE_EXTENT * ((float)rand()/RAND_MAX - 0.5f);
+			velocity[k] = 20.0f * ((float)rand()/RAND_MAX - 0.5f);
+		}
+
+		PhysicsBodyPtr box = engine->CreateBody(BDY_RIGID, "box", i + 1);
+		box->SetCollisionShape(CS_BOX, halfExtents);
+		box->SetMassAndInertia(1.0f, Vector3(0.0, 0.0, 0.0));
+		box->SetInitialState(Vector3(position[0], position[1], position[2]), identity);
+		box->Finilize();
+		engine->AddBody(box);
+		engine->SetBodyVelocity(i + 1, Vector3(velocity[0], velocity[1], velocity[2]));
+	}
+}
+
+//average step time and broadphase time, in ms, and the pairs found by the last step.
+static double MeasureBroadphase(const BroadphaseOptions& options, bool sparse, double& broadphaseTime, uint& pairs)
+{
+	EventManager* eventManager = EventManager::GetInstance();
+
+	DefaultPhysicsEngine engine;
+	engine.SetBroadphase(options);
+	engine.InitPhysics(PHYS_RIGID_ONLY);
+
+	if (sparse)
+	{
+		engine.SetGravity(Vector3(0.0, 0.0, 0.0));
+		BuildSparseScene(&engine);
+	}
+	else
+	{
+		engine.SetGravity(Vector3(0.0, -9.81, 0.0));
+		BuildScene(&engine, COLUMNS, BOXES_PER_COLUMN);
+	}
+
+	const float timeStep = 1.0f/60.0f;
+
+	for (uint i = 0; i < WARMUP_STEPS; i++)
+	{
+		engine.StepSimulation(timeStep);
+		eventManager->ProcessEventQueue();
+	}
+
+	double total = 0.0;
+	broadphaseTime = 0.0;
+
+	for (uint i = 0; i < MEASURED_STEPS; i++)
+	{
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		engine.StepSimulation(timeStep);
+		total += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+		broadphaseTime += engine.GetStats().broadphaseTime;
+
+		eventManager->ProcessEventQueue();
+	}
+
+	pairs = engine.GetStats().broadphasePairs;
+	broadphaseTime /= MEASURED_STEPS;
+
+	return total / MEASURED_STEPS;
+}
+
+//the same scenes with each broadphase: the stacked boxes in tight bounds, and a huge sparse world.
+static void RunBroadphaseBenchmark()
+{
+	LogManager* log = LogManager::GetInstance();
+
+	const char* names[3] = { "dbvt", "axis sweep, 16 bit", "axis sweep, 32 bit" };
+	BroadphaseOptions options[3];
+	options[1].type = BP_AXIS_SWEEP;
+	options[2].type = BP_AXIS_SWEEP;
+	options[2].maxBodies = 65536;
+
+	for (uint scene = 0; scene < 2; scene++)
+	{
+		bool sparse = scene == 1;
+
+		if (sparse)
+		{
+			log->LogMessage("Broadphase: " + to_string(SPARSE_BODIES) + " boxes drifting in a " + to_string((uint)SPARSE_EXTENT) + " m cube.");
+
+			for (uint i = 1; i < 3; i++)
+			{
+				options[i].worldMin = Vector3(-SPARSE_EXTENT, -SPARSE_EXTENT, -SPARSE_EXTENT);
+				options[i].worldMax = Vector3(SPARSE_EXTENT, SPARSE_EXTENT, SPARSE_EXTENT);
+			}
+		}
+		else
+		{
+			log->LogMessage("Broadphase: " + to_string(COLUMNS*COLUMNS*BOXES_PER_COLUMN) + " stacked boxes, in bounds around the stacks.");
+
+			for (uint i = 1; i < 3; i++)
+			{
+				options[i].worldMin = Vector3(-5.0, -5.0, -5.0);
+				options[i].worldMax = Vector3(COLUMNS*1.5f + 5.0f, BOXES_PER_COLUMN*1.01f + 5.0f, COLUMNS*1.5f + 5.0f);
+			}
+		}
+
+		for (uint i = 0; i < 3; i++)
+		{
+			double broadphaseTime;
+			uint pairs;
+			double stepTime = MeasureBroadphase(options[i], sparse, broadphaseTime, pairs);
+
+			log->LogMessage("  " + string(names[i]) + ": " + to_string(stepTime) + " ms/step, broadphase " + to_string(broadphaseTime) + 
+							" ms/step, " + to_string(pairs) + " pairs");
+		}
+	}
+}
+
+//a scene node with nothing to draw, so that the states it is given by the physics can be followed without a renderer.
+class HeadlessNode : public SceneNode
+{
+public:
+	HeadlessNode(SceneNode* parent, string name) : SceneNode(parent, NULL, name) {}
+
+	virtual void ProcessNode() {}
+
+	bool ShowPhysicsState(float alpha)
+	{
+		if (bHasPhysicsState)
+			ApplyPhysicsState(alpha);
+
+		return bHasPhysicsState;
+	}
+};
+
+/*a body moving at constant speed, followed by a node without a parent through frames of uneven length, as
+  Scene::Update drives them. The node is drawn a step behind the simulation: at every frame it must be where 
+  the body was a step before, whatever the number of steps the frame took.*/
+static bool RunInterpolationCheck()
+{
+	LogManager* log = LogManager::GetInstance();
+	EventManager* eventManager = EventManager::GetInstance();
+
+	const float timeStep = 1.0f/60.0f;
+
+	log->LogMessage("Interpolation: " + to_string(INTERPOLATION_FRAMES) + " frames of 2 to 40 ms, physics at 60 Hz.");
+
+	DefaultPhysicsEngine engine;
+	engine.InitPhysics(PHYS_RIGID_ONLY);
+	engine.SetGravity(Vector3(0.0, 0.0, 0.0));
+	engine.SetFixedTimeStep(timeStep, 5);
+
+	HeadlessNode node(NULL, "interpolated");
+
+	Matrix3x3 identity;
+	identity.LoadIdentity();
+
+	float radius = 0.5f;
+	PhysicsBodyPtr ball = engine.CreateBody(BDY_RIGID, "ball", node.GetID());
+	ball->SetCollisionShape(CS_SPHERE, &radius);
+	ball->SetMassAndInertia(1.0f, Vector3(0.0, 0.0, 0.0));
+	ball->SetInitialState(Vector3(0.0, 0.0, 0.0), identity);
+	ball->SetVelocity(Vector3(INTERPOLATION_SPEED, 0.0, 0.0));
+	ball->Finilize();
+	engine.AddBody(ball);
+
+	srand(1);
+
+	double realTime = 0.0;
+	double maxError = 0.0;
+	float lastShown = 0.0f;
+	uint shownFrames = 0, backwards = 0;
+
+	for (uint i = 0; i < INTERPOLATION_FRAMES; i++)
+	{
+		float frameTime = (2 + rand() % 39) / 1000.0f;
+		realTime += frameTime;
+
+		float alpha = engine.Update(frameTime);
+		eventManager->ProcessEventQueue();
+
+		if (!node.ShowPhysicsState(alpha))
+			continue;
+
+		float shown = node.GetAbsolutePosition().X();
+		double expected = INTERPOLATION_SPEED * (realTime - timeStep);
+
+		maxError = max(maxError, fabs(shown - expected));
+
+		if (shown < lastShown)
+			backwards++;
+
+		lastShown = shown;
+		shownFrames++;
+	}
+
+	//a frame drawn at the last step instead would be up to a step ahead: 17 cm at 10 m/s. What is left is the
+	//accumulator adding up the frame times in single precision.
+	bool passed = maxError < 0.01 && backwards == 0 && shownFrames > 0;
+
+	log->LogMessage("  " + to_string(shownFrames) + " frames shown, largest distance from the body a step behind " + to_string(maxError) + 
+					" m, " + to_string(backwards) + " frames moving backwards");
+	log->LogMessage(string("  interpolation check ") + (passed ? "passed." : "FAILED."));
+
+	return passed;
+}
+
+/*a square of cloth as a Model would hold it, lying flat: the two halves are textured apart, so the vertices
+  along the seam between them come twice, with the same position. seam holds the pairs.*/
+static void BuildCloth(uint side, vector<Vertex>& vertices, vector<int>& indices, vector<pair<int, int>>& seam)
+{
+	uint half = side / 2;
+	uint rowVertices = side + 1;
+	uint halfVertices = (half + 1)*rowVertices;
+
+	vertices.resize(2*halfVertices);
+
+	for (uint h = 0; h < 2; h++)
+		for (uint x = 0; x <= half; x++)
+			for (uint z = 0; z < rowVertices; z++)
+			{
+				Vertex& vertex = vertices[h*halfVertices + x*rowVertices + z];
+				vertex.position[0] = (h*half + x)*0.05f;
+				vertex.position[2] = z*0.05f;
+				vertex.normal[1] = 1.0f;
+				vertex.texCoord[0] = (float)h;
+			}
+
+	for (uint h = 0; h < 2; h++)
+		for (uint x = 0; x < half; x++)
+			for (uint z = 0; z < side; z++)
+			{
+				int corner = h*halfVertices + x*rowVertices + z;
+				int quad[6] = { corner, corner + (int)rowVertices, corner + 1, corner + 1, corner + (int)rowVertices, corner + (int)rowVertices + 1 };
+				indices.insert(indices.end(), quad, quad + 6);
+			}
+
+	for (uint z = 0; z < rowVertices; z++)
+		seam.push_back(make_pair(half*rowVertices + z, halfVertices + z));
+}
+
+/*a cloth dropped on the ground, built as the scene builds a soft body object, with its vertices streamed into
+  memory regions as a model node does without a persistently mapped buffer.*/
+static bool RunSoftBodyBenchmark()
+{
+	LogManager* log = LogManager::GetInstance();
+	EventManager* eventManager = EventManager::GetInstance();
+
+	vector<Vertex> vertices;
+	vector<int> indices;
+	vector<pair<int, int>> seam;
+	BuildCloth(CLOTH_SIDE, vertices, indices, seam);
+
+	log->LogMessage("Soft body: a cloth of " + to_string(vertices.size()) + " vertices dropped on the ground, " + to_string(MEASURED_STEPS) + " steps.");
+
+	DefaultPhysicsEngine engine;
+	engine.InitPhysics(PHYS_RIGID_AND_SOFT);
+	engine.SetGravity(Vector3(0.0, -9.81, 0.0));
+
+	Matrix3x3 identity;
+	identity.LoadIdentity();
+
+	float plane[4] = { 0.0f, 1.0f, 0.0f, 0.0f };
+	PhysicsBodyPtr ground = engine.CreateBody(BDY_RIGID, "ground", 1);
+	ground->SetCollisionShape(CS_PLANE, plane);
+	ground->SetMassAndInertia(0.0f, Vector3(0.0, 0.0, 0.0));
+	ground->SetInitialState(Vector3(0.0, 0.0, 0.0), identity);
+	ground->Finilize();
+	engine.AddBody(ground);
+
+	PhysicsBodyPtr body = engine.CreateBody(BDY_SOFT, "cloth", 2);
+	SoftBody* cloth = dynamic_cast<SoftBody*>(body.get());
+	cloth->SetInitialState(Vector3(0.0, 1.0, 0.0), identity);
+	cloth->SetMesh(vertices[0].position, (int)vertices.size(), sizeof(Vertex), &indices[0], (int)indices.size());
+	cloth->SetMaterialInfo(0.5f, 0.0f, 0.0f, 0.0f);
+	cloth->SetConfigurationOptions(4, 0.5f);
+	cloth->SetMassAndInertia(1.0f, Vector3(0.0, 0.0, 0.0));
+	cloth->Finilize();
+
+	uint stride = sizeof(Vertex) / sizeof(float);
+	uint numVertices = (uint)vertices.size();
+	vector<float> regionData(VertexStream::MAX_REGIONS*numVertices*stride);
+	float* regions[VertexStream::MAX_REGIONS];
+
+	for (uint i = 0; i < VertexStream::MAX_REGIONS; i++)
+	{
+		regions[i] = &regionData[i*numVertices*stride];
+		memcpy(regions[i], &vertices[0], numVertices*sizeof(Vertex));
+	}
+
+	VertexStreamPtr stream(new VertexStream());
+	stream->SetRegions(regions, VertexStream::MAX_REGIONS, numVertices, stride);
+
+	cloth->SetVertexStream(stream);
+	engine.AddBody(body);
+
+	const float timeStep = 1.0f/60.0f;
+	double total = 0.0;
+	int shown = 0;
+	uint updates = 0;
+
+	for (uint i = 0; i < MEASURED_STEPS; i++)
+	{
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		engine.StepSimulation(timeStep);
+		total += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+		eventManager->ProcessEventQueue();
+
+		int region = stream->AcquireLatest();
+
+		if (region >= 0)
+		{
+			stream->Release(shown);
+			shown = region;
+			updates++;
+		}
+	}
+
+	//the seam must not have torn, the texture coordinates must be those of the model, and the cloth must have fallen.
+	const float* shownVertices = stream->GetRegion(shown);
+	uint torn = 0, overwritten = 0;
+	float lowest = 1.0f, highest = -1.0f;
+
+	for (auto pair : seam)
+		for (uint k = 0; k < 3; k++)
+			if (shownVertices[pair.first*stride + k] != shownVertices[pair.second*stride + k])
+			{
+				torn++;
+				break;
+			}
+
+	btTransform toWorld = cloth->GetBulletSoftBody()->getWorldTransform();
+
+	for (uint i = 0; i < numVertices; i++)
+	{
+		const float* vertex = shownVertices + i*stride;
+
+		if (vertex[6] != vertices[i].texCoord[0])
+			overwritten++;
+
+		float height = toWorld(btVector3(vertex[0], vertex[1], vertex[2])).y();
+		lowest = min(lowest, height);
+		highest = max(highest, height);
+	}
+
+	stream->Close();
+
+	uint expectedNodes = (CLOTH_SIDE + 1)*(CLOTH_SIDE + 1);
+	uint nodes = (uint)cloth->GetBulletSoftBody()->m_nodes.size();
+	bool passed = nodes == expectedNodes && torn == 0 && overwritten == 0 && updates == MEASURED_STEPS && highest < 1.0f;
+
+	log->LogMessage("  " + to_string(total / MEASURED_STEPS) + " ms/step, " + to_string(nodes) + " nodes (" + to_string(expectedNodes) + 
+					" expected), " + to_string(updates) + " mesh updates, " + to_string(torn) + " torn seam vertices, " + 
+					to_string(overwritten) + " texture coordinates overwritten, height " + to_string(lowest) + " to " + to_string(highest));
+	log->LogMessage(string("  soft body check ") + (passed ? "passed." : "FAILED."));
+
+	return passed;
+}
+
+bool RunPhysicsBenchmark()
+{
+	LogManager* log = LogManager::GetInstance();
+	TaskScheduler* scheduler = TaskScheduler::GetInstance();
+
+	BodyStateSink sink;
+	EventSubscription subscription = EventManager::GetInstance()->Subscribe<ObjectMovedEvent, BodyStateSink, &BodyStateSink::OnObjectMoved>(&sink);
+
+	log->LogMessage("Physics benchmark: " + to_string(COLUMNS*COLUMNS*BOXES_PER_COLUMN) + " stacked boxes, " + 
+					to_string(MEASURED_STEPS) + " steps at 60 Hz. Hardware threads: " + to_string(scheduler->GetMaxThreadCount()));
+
+	double singleThreaded = MeasureWorld(PHYS_RIGID_ONLY);
+	log->LogMessage("  PHYS_RIGID_ONLY: " + to_string(singleThreaded) + " ms/step");
+
+	uint threadCounts[3] = { 1, 4, 8 };
+
+	for (uint i = 0; i < 3; i++)
+	{
+		scheduler->SetThreadCount(threadCounts[i]);
+		double multiThreaded = MeasureWorld(PHYS_RIGID_MT);
+		log->LogMessage("  PHYS_RIGID_MT, " + to_string(threadCounts[i]) + " threads: " + to_string(multiThreaded) + 
+						" ms/step (x" + to_string(singleThreaded / multiThreaded) + ")");
+	}
+
+	bool passed = RunThreadedBenchmark();
+	RunSettledBenchmark();
+	RunMeshHullBenchmark();
+	RunGravityBenchmark();
+	RunTriangleMeshBenchmark();
+	RunQueryBenchmark();
+	RunSnapshotBenchmark();
+	RunBroadphaseBenchmark();
+	passed = RunSoftBodyBenchmark() && passed;
+	passed = RunInterpolationCheck() && passed;
+
+	return passed;
+}
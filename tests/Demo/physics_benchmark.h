@@ -0,0 +1,35 @@
+/*
+
+Physics Benchmark
+
+*/
+
+#ifndef PHYSICS_BENCHMARK_H
+#define PHYSICS_BENCHMARK_H
+
+/*
+Headless benchmark of the Bullet worlds: 5000 boxes stacked in columns on a ground plane, stepped at
+60 Hz with the single threaded world and with the multithreaded one on 1, 4 and 8 threads, then stepped in
+Update and on the physics thread while the main thread works on its frame: how much of the stepping that hides.
+Then 10000 boxes left to settle and go to sleep, stepped publishing every body and only the moving ones,
+with the number and size of the collision shapes they share.
+Then a pile of tori colliding as their full hull, a reduced one and a convex decomposition.
+The gravity field against the direct sum, for accuracy, and from 1000 to 100000 bodies.
+Then a static triangle mesh of about 1M triangles: its load time with the BVH built and read from cooked 
+data, and the cost of a ray cast against it.
+Then 10000 ray casts per frame against the stacked boxes through IPhysicsEngine::RunQueries, batched and
+one by one, and as many sphere sweeps and overlaps.
+Then 10000 boxes loaded from their scene JSON, saved with IPhysicsEngine::SaveWorld once settled, rolled back
+to that snapshot and loaded from it into a new world.
+Then the stacked boxes and 16000 boxes drifting far apart, with the DBVT broadphase and the 16 and 32 bit axis
+sweeps: time per step, the part of it spent in the broadphase, and the pairs it finds.
+Then a cloth dropped on the ground as a soft body, its vertices streamed as a model node receives them: the
+time per step, and that the seam between its halves holds.
+Last a body followed by a scene node through frames of 2 to 40 ms: the node must be drawn where the body was
+a step before, at every frame.
+Results go to the log. Returns false if the overlap, soft body or interpolation check fails.
+Run with: demo --physics-benchmark
+*/
+bool RunPhysicsBenchmark();
+
+#endif // PHYSICS_BENCHMARK_H